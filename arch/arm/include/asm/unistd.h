@@ -413,6 +413,13 @@
 #define __ARM_NR_usr32			(__ARM_NR_BASE+4)
 #define __ARM_NR_set_tls		(__ARM_NR_BASE+5)
 
+/*
+ * Local additions that are not in mainline.  They live in the ARM
+ * private range, well above the calls mainline adds there, so that they
+ * can never collide with a syscall number mainline assigns later.
+ */
+#define __ARM_NR_epoll_ctl_batch	(__ARM_NR_BASE+0x000100)
+
 /*
  * *NOTE*: This is a ghost syscall private to the kernel.  Only the
  * __kuser_cmpxchg code in entry-armv.S should be aware of its
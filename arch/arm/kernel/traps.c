@@ -27,6 +27,7 @@
 #include <linux/delay.h>
 #include <linux/init.h>
 #include <linux/sched.h>
+#include <linux/syscalls.h>
 
 #include <linux/atomic.h>
 #include <asm/cacheflush.h>
@@ -572,6 +573,11 @@ asmlinkage int arm_syscall(int no, struct pt_regs *regs)
 		}
 		return 0;
 
+	case NR(epoll_ctl_batch):
+		return sys_epoll_ctl_batch(regs->ARM_r0, regs->ARM_r1,
+			regs->ARM_r2,
+			(struct epoll_ctl_cmd __user *)regs->ARM_r3);
+
 #ifdef CONFIG_NEEDS_SYSCALL_FOR_CMPXCHG
 	/*
 	 * Atomically store r1 in *r2 if *r2 is equal to r0 for user space.
@@ -28,6 +28,8 @@
 #include <linux/suspend.h>
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
+#include <linux/mutex.h>
+#include <linux/pm_qos_params.h>
 
 #include <asm/cputime.h>
 #include <asm/cacheflush.h>
@@ -1337,6 +1339,49 @@ int tegra_emc_disable_eack(void) {
 	return tegra_emc_set_eack_state(0);
 }
 
+/*
+ * PM_QOS_EMC_FREQ_MIN (kHz) is applied as an extra shared emc user, so
+ * it combines with all other bus requests like any client does.
+ */
+static struct clk *emc_qos_clk;
+static bool emc_qos_enabled;
+static DEFINE_MUTEX(emc_qos_lock);
+
+static int emc_qos_notify(struct notifier_block *nb, unsigned long khz,
+			  void *data)
+{
+	mutex_lock(&emc_qos_lock);
+	if (khz) {
+		clk_set_rate(emc_qos_clk, khz * 1000);
+		if (!emc_qos_enabled) {
+			clk_enable(emc_qos_clk);
+			emc_qos_enabled = true;
+		}
+	} else if (emc_qos_enabled) {
+		clk_disable(emc_qos_clk);
+		emc_qos_enabled = false;
+	}
+	mutex_unlock(&emc_qos_lock);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block emc_qos_nb = {
+	.notifier_call = emc_qos_notify,
+};
+
+static int __init tegra_emc_qos_init(void)
+{
+	emc_qos_clk = clk_get_sys("qos.emc", NULL);
+	if (IS_ERR(emc_qos_clk)) {
+		pr_err("%s: cannot get qos.emc clock\n", __func__);
+		return PTR_ERR(emc_qos_clk);
+	}
+
+	return pm_qos_add_notifier(PM_QOS_EMC_FREQ_MIN, &emc_qos_nb);
+}
+late_initcall(tegra_emc_qos_init);
+
 #ifdef CONFIG_DEBUG_FS
 
 static struct dentry *emc_debugfs_root;
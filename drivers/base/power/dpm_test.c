@@ -0,0 +1,230 @@
+/*
+ * drivers/base/power/dpm_test.c - Test of dependency ordered async PM.
+ *
+ * Registers a few dummy platform devices, some of them async, linked by
+ * parent/child relations and by supplier links, whose suspend and resume
+ * callbacks each take dpm_test.delay_ms.  After every system suspend the
+ * recorded callback times are checked against the dependencies, and for
+ * the independent async subtrees to have overlapped.  Use it with
+ *
+ *	echo devices > /sys/power/pm_test
+ *	echo mem > /sys/power/state
+ *
+ * and look for "dpm_test:" in the kernel log.
+ *
+ * This file is released under the GPLv2.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/moduleparam.h>
+#include <linux/platform_device.h>
+#include <linux/suspend.h>
+#include <linux/ktime.h>
+#include <linux/delay.h>
+
+#include "power.h"
+
+static unsigned int delay_ms = 20;
+module_param(delay_ms, uint, 0644);
+
+struct dpm_test_dev {
+	const char		*name;
+	int			parent;		/* index, or -1 */
+	bool			async;
+	struct platform_device	*pdev;
+	ktime_t			suspend[2];	/* callback start and end */
+	ktime_t			resume[2];
+};
+
+/*
+ * Registered in this order, so that the consumers c and d come before
+ * their suppliers on dpm_list until the links are added.  a and b are
+ * independent subtrees, e is a sync child of an async parent and d is a
+ * sync consumer of an async supplier.
+ */
+static struct dpm_test_dev dpm_test_devs[] = {
+	{ "c",  -1, true },
+	{ "d",  -1, false },
+	{ "a0", -1, true },
+	{ "a1",  2, true },
+	{ "a2",  3, true },
+	{ "b0", -1, true },
+	{ "b1",  5, true },
+	{ "e",   6, false },
+};
+
+/* consumer, supplier */
+static const int dpm_test_links[][2] = {
+	{ 0, 4 },	/* c needs a2 */
+	{ 0, 6 },	/* c needs b1 */
+	{ 1, 3 },	/* d needs a1 */
+};
+
+static struct dpm_test_dev *to_test_dev(struct device *dev)
+{
+	return &dpm_test_devs[to_platform_device(dev)->id];
+}
+
+static int dpm_test_suspend(struct device *dev)
+{
+	struct dpm_test_dev *tdev = to_test_dev(dev);
+
+	tdev->suspend[0] = ktime_get();
+	msleep(delay_ms);
+	tdev->suspend[1] = ktime_get();
+	return 0;
+}
+
+static int dpm_test_resume(struct device *dev)
+{
+	struct dpm_test_dev *tdev = to_test_dev(dev);
+
+	tdev->resume[0] = ktime_get();
+	msleep(delay_ms);
+	tdev->resume[1] = ktime_get();
+	return 0;
+}
+
+static const struct dev_pm_ops dpm_test_pm_ops = {
+	.suspend = dpm_test_suspend,
+	.resume = dpm_test_resume,
+};
+
+static struct platform_driver dpm_test_driver = {
+	.driver = {
+		.name	= "dpm_test",
+		.owner	= THIS_MODULE,
+		.pm	= &dpm_test_pm_ops,
+	},
+};
+
+/* Did @later start its callback only after @first had finished its own? */
+static int dpm_test_order(const char *phase, ktime_t *first_t,
+			  const char *first, ktime_t *later_t,
+			  const char *later)
+{
+	if (later_t[0].tv64 >= first_t[1].tv64)
+		return 0;
+
+	pr_err("dpm_test: %s of %s started before %s was done\n",
+	       phase, later, first);
+	return 1;
+}
+
+static int dpm_test_check(void)
+{
+	struct dpm_test_dev *a0 = &dpm_test_devs[2], *b0 = &dpm_test_devs[5];
+	int i, errors = 0;
+
+	for (i = 0; i < ARRAY_SIZE(dpm_test_devs); i++) {
+		struct dpm_test_dev *tdev = &dpm_test_devs[i];
+		struct dpm_test_dev *parent;
+
+		if (!tdev->suspend[1].tv64 || !tdev->resume[1].tv64) {
+			pr_err("dpm_test: %s missed a callback\n", tdev->name);
+			return 1;
+		}
+		if (tdev->parent < 0)
+			continue;
+		parent = &dpm_test_devs[tdev->parent];
+		errors += dpm_test_order("suspend", tdev->suspend, tdev->name,
+					 parent->suspend, parent->name);
+		errors += dpm_test_order("resume", parent->resume, parent->name,
+					 tdev->resume, tdev->name);
+	}
+
+	for (i = 0; i < ARRAY_SIZE(dpm_test_links); i++) {
+		struct dpm_test_dev *c = &dpm_test_devs[dpm_test_links[i][0]];
+		struct dpm_test_dev *s = &dpm_test_devs[dpm_test_links[i][1]];
+
+		errors += dpm_test_order("suspend", c->suspend, c->name,
+					 s->suspend, s->name);
+		errors += dpm_test_order("resume", s->resume, s->name,
+					 c->resume, c->name);
+	}
+
+	/* the two independent async roots must have run at the same time */
+	if (pm_async_enabled &&
+	    (a0->resume[0].tv64 >= b0->resume[1].tv64 ||
+	     b0->resume[0].tv64 >= a0->resume[1].tv64)) {
+		pr_err("dpm_test: %s and %s were not resumed in parallel\n",
+		       a0->name, b0->name);
+		errors++;
+	}
+
+	return errors;
+}
+
+static int dpm_test_notify(struct notifier_block *nb, unsigned long event,
+			   void *unused)
+{
+	int i;
+
+	switch (event) {
+	case PM_SUSPEND_PREPARE:
+		for (i = 0; i < ARRAY_SIZE(dpm_test_devs); i++) {
+			dpm_test_devs[i].suspend[1].tv64 = 0;
+			dpm_test_devs[i].resume[1].tv64 = 0;
+		}
+		break;
+	case PM_POST_SUSPEND:
+		pr_info("dpm_test: %s\n", dpm_test_check() ? "FAIL" : "PASS");
+		break;
+	}
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block dpm_test_nb = {
+	.notifier_call = dpm_test_notify,
+};
+
+static int __init dpm_test_init(void)
+{
+	struct platform_device *pdev;
+	int i, error;
+
+	error = platform_driver_register(&dpm_test_driver);
+	if (error)
+		return error;
+
+	for (i = 0; i < ARRAY_SIZE(dpm_test_devs); i++) {
+		struct dpm_test_dev *tdev = &dpm_test_devs[i];
+
+		pdev = platform_device_alloc("dpm_test", i);
+		if (!pdev)
+			return -ENOMEM;
+		if (tdev->parent >= 0)
+			pdev->dev.parent =
+				&dpm_test_devs[tdev->parent].pdev->dev;
+		if (tdev->async)
+			device_enable_async_suspend(&pdev->dev);
+		error = platform_device_add(pdev);
+		if (error) {
+			platform_device_put(pdev);
+			return error;
+		}
+		tdev->pdev = pdev;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(dpm_test_links); i++) {
+		error = device_pm_add_supplier(
+			&dpm_test_devs[dpm_test_links[i][0]].pdev->dev,
+			&dpm_test_devs[dpm_test_links[i][1]].pdev->dev);
+		if (error)
+			return error;
+	}
+
+	/* a link that closes a cycle must be refused */
+	error = device_pm_add_supplier(&dpm_test_devs[2].pdev->dev,
+				       &dpm_test_devs[0].pdev->dev);
+	if (error != -EINVAL) {
+		pr_err("dpm_test: cyclic link accepted\n");
+		if (!error)
+			device_pm_remove_supplier(&dpm_test_devs[2].pdev->dev,
+						  &dpm_test_devs[0].pdev->dev);
+	}
+
+	return register_pm_notifier(&dpm_test_nb);
+}
+late_initcall(dpm_test_init);
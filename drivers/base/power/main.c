@@ -28,6 +28,8 @@
 #include <linux/async.h>
 #include <linux/suspend.h>
 #include <linux/timer.h>
+#include <linux/rwsem.h>
+#include <linux/slab.h>
 
 #include "../base.h"
 #include "power.h"
@@ -49,6 +51,24 @@ LIST_HEAD(dpm_noirq_list);
 
 static DEFINE_MUTEX(dpm_list_mtx);
 static pm_message_t pm_transition;
+static ktime_t dpm_phase_start;
+
+/*
+ * Explicit supplier -> consumer dependencies that are not expressed by the
+ * device hierarchy.  A consumer is resumed after, and suspended before, all
+ * of its suppliers, exactly as a child is with respect to its parent.
+ * Nested inside dpm_links_rwsem is dpm_list_mtx.
+ */
+struct dpm_link {
+	struct device		*supplier;
+	struct device		*consumer;
+	struct list_head	s_node;	/* on supplier->power.consumers */
+	struct list_head	c_node;	/* on consumer->power.suppliers */
+	unsigned int		count;	/* device_pm_add_supplier() calls */
+};
+
+static DECLARE_RWSEM(dpm_links_rwsem);
+static void dpm_purge_links(struct device *dev);
 
 static void dpm_drv_timeout(unsigned long data);
 struct dpm_drv_wd_data {
@@ -72,6 +92,9 @@ void device_pm_init(struct device *dev)
 	spin_lock_init(&dev->power.lock);
 	pm_runtime_init(dev);
 	INIT_LIST_HEAD(&dev->power.entry);
+	INIT_LIST_HEAD(&dev->power.suppliers);
+	INIT_LIST_HEAD(&dev->power.consumers);
+	dev->power.dpm_waited_on = NULL;
 }
 
 /**
@@ -118,6 +141,7 @@ void device_pm_remove(struct device *dev)
 	mutex_lock(&dpm_list_mtx);
 	list_del_init(&dev->power.entry);
 	mutex_unlock(&dpm_list_mtx);
+	dpm_purge_links(dev);
 	device_wakeup_disable(dev);
 	pm_runtime_remove(dev);
 }
@@ -161,6 +185,146 @@ void device_pm_move_last(struct device *dev)
 	list_move_tail(&dev->power.entry, &dpm_list);
 }
 
+static void dpm_free_link(struct dpm_link *link)
+{
+	list_del(&link->s_node);
+	list_del(&link->c_node);
+	put_device(link->supplier);
+	put_device(link->consumer);
+	kfree(link);
+}
+
+/* Drop all dependencies of a device that is going away. */
+static void dpm_purge_links(struct device *dev)
+{
+	struct dpm_link *link, *tmp;
+
+	down_write(&dpm_links_rwsem);
+	list_for_each_entry_safe(link, tmp, &dev->power.suppliers, c_node)
+		dpm_free_link(link);
+	list_for_each_entry_safe(link, tmp, &dev->power.consumers, s_node)
+		dpm_free_link(link);
+	up_write(&dpm_links_rwsem);
+}
+
+static int dpm_is_dependent_fn(struct device *dev, void *target);
+
+/* Does @target (transitively) have to wait for @dev on resume? */
+static int dpm_is_dependent(struct device *dev, struct device *target)
+{
+	struct dpm_link *link;
+
+	if (dev == target)
+		return 1;
+	if (device_for_each_child(dev, target, dpm_is_dependent_fn))
+		return 1;
+	list_for_each_entry(link, &dev->power.consumers, s_node)
+		if (dpm_is_dependent(link->consumer, target))
+			return 1;
+	return 0;
+}
+
+static int dpm_is_dependent_fn(struct device *dev, void *target)
+{
+	return dpm_is_dependent(dev, target);
+}
+
+static int dpm_reorder_fn(struct device *dev, void *unused);
+
+/*
+ * Move @dev, its children and its consumers to the end of dpm_list, so that
+ * devices handled synchronously keep suppliers before consumers.  Devices in
+ * the middle of a transition are not on dpm_list and are left alone, their
+ * new ordering takes effect from the next transition on.
+ */
+static void dpm_reorder_to_tail(struct device *dev)
+{
+	struct dpm_link *link;
+
+	if (dev->power.is_prepared || list_empty(&dev->power.entry))
+		return;
+	list_move_tail(&dev->power.entry, &dpm_list);
+	device_for_each_child(dev, NULL, dpm_reorder_fn);
+	list_for_each_entry(link, &dev->power.consumers, s_node)
+		dpm_reorder_to_tail(link->consumer);
+}
+
+static int dpm_reorder_fn(struct device *dev, void *unused)
+{
+	dpm_reorder_to_tail(dev);
+	return 0;
+}
+
+/**
+ * device_pm_add_supplier - Make a device's PM transitions depend on another.
+ * @consumer: Device to be resumed after and suspended before @supplier.
+ * @supplier: Device @consumer depends on.
+ *
+ * Must not be called from within system suspend or resume callbacks.
+ */
+int device_pm_add_supplier(struct device *consumer, struct device *supplier)
+{
+	struct dpm_link *link, *l;
+	int error = 0;
+
+	if (!consumer || !supplier)
+		return -EINVAL;
+
+	link = kzalloc(sizeof(*link), GFP_KERNEL);
+	if (!link)
+		return -ENOMEM;
+
+	down_write(&dpm_links_rwsem);
+	if (dpm_is_dependent(consumer, supplier)) {
+		error = -EINVAL;
+		goto out;
+	}
+	list_for_each_entry(l, &consumer->power.suppliers, c_node)
+		if (l->supplier == supplier) {
+			l->count++;
+			goto out;
+		}
+
+	link->count = 1;
+	link->supplier = get_device(supplier);
+	link->consumer = get_device(consumer);
+	list_add_tail(&link->s_node, &supplier->power.consumers);
+	list_add_tail(&link->c_node, &consumer->power.suppliers);
+	link = NULL;
+
+	mutex_lock(&dpm_list_mtx);
+	dpm_reorder_to_tail(consumer);
+	mutex_unlock(&dpm_list_mtx);
+ out:
+	up_write(&dpm_links_rwsem);
+	kfree(link);
+	return error;
+}
+EXPORT_SYMBOL_GPL(device_pm_add_supplier);
+
+/**
+ * device_pm_remove_supplier - Drop a dependency added by device_pm_add_supplier.
+ * @consumer: Consumer device.
+ * @supplier: Supplier device.
+ *
+ * The dependency goes away with the last of the calls that added it.
+ */
+void device_pm_remove_supplier(struct device *consumer,
+			       struct device *supplier)
+{
+	struct dpm_link *link;
+
+	down_write(&dpm_links_rwsem);
+	list_for_each_entry(link, &consumer->power.suppliers, c_node)
+		if (link->supplier == supplier) {
+			if (!--link->count)
+				dpm_free_link(link);
+			break;
+		}
+	up_write(&dpm_links_rwsem);
+}
+EXPORT_SYMBOL_GPL(device_pm_remove_supplier);
+
 static ktime_t initcall_debug_start(struct device *dev)
 {
 	ktime_t calltime = ktime_set(0, 0);
@@ -187,30 +351,141 @@ static void initcall_debug_report(struct device *dev, ktime_t calltime,
 	}
 }
 
+static bool is_async(struct device *dev)
+{
+	return dev->power.async_suspend && pm_async_enabled
+		&& !pm_trace_is_enabled();
+}
+
 /**
  * dpm_wait - Wait for a PM operation to complete.
  * @dev: Device to wait for.
- * @async: If unset, wait only if the device's power.async_suspend flag is set.
+ * @async: If unset, wait only if the device is handled asynchronously.
  */
 static void dpm_wait(struct device *dev, bool async)
 {
 	if (!dev)
 		return;
 
-	if (async || (pm_async_enabled && dev->power.async_suspend))
+	if (async || is_async(dev))
 		wait_for_completion(&dev->power.completion);
 }
 
-static int dpm_wait_fn(struct device *dev, void *async_ptr)
+/**
+ * dpm_wait_dep - Wait for a device @dev depends on in this phase.
+ * @dev: Device about to be handled.
+ * @dep: Device to wait for.
+ * @async: If true, @dev is being handled asynchronously.
+ *
+ * Also remember the dependency that finished last, which is the one @dev
+ * really waited for, to reconstruct the critical path of the transition.
+ */
+static void dpm_wait_dep(struct device *dev, struct device *dep, bool async)
+{
+	struct device *prev = dev->power.dpm_waited_on;
+
+	if (!dep)
+		return;
+
+	dpm_wait(dep, async);
+	if (dep->power.dpm_end.tv64 < dpm_phase_start.tv64)
+		return;
+	if (!prev || dep->power.dpm_end.tv64 > prev->power.dpm_end.tv64)
+		dev->power.dpm_waited_on = dep;
+}
+
+struct dpm_wait_data {
+	struct device *dev;
+	bool async;
+};
+
+static int dpm_wait_fn(struct device *dev, void *data)
 {
-	dpm_wait(dev, *((bool *)async_ptr));
+	struct dpm_wait_data *wd = data;
+
+	dpm_wait_dep(wd->dev, dev, wd->async);
 	return 0;
 }
 
 static void dpm_wait_for_children(struct device *dev, bool async)
 {
-       device_for_each_child(dev, &async, dpm_wait_fn);
+	struct dpm_wait_data wd = { .dev = dev, .async = async };
+
+	device_for_each_child(dev, &wd, dpm_wait_fn);
+}
+
+/*
+ * Return a reference to the @n-th supplier (or consumer) of @dev, or NULL.
+ * The waits are done without dpm_links_rwsem held: a writer queued behind
+ * the read side would otherwise hold up every device that is still to look
+ * at its links, including the ones the waiting device depends on.
+ */
+static struct device *dpm_get_link_dev(struct device *dev, int n,
+				       bool suppliers)
+{
+	struct device *ret = NULL;
+	struct dpm_link *link;
+
+	down_read(&dpm_links_rwsem);
+	if (suppliers) {
+		list_for_each_entry(link, &dev->power.suppliers, c_node)
+			if (!n--) {
+				ret = get_device(link->supplier);
+				break;
+			}
+	} else {
+		list_for_each_entry(link, &dev->power.consumers, s_node)
+			if (!n--) {
+				ret = get_device(link->consumer);
+				break;
+			}
+	}
+	up_read(&dpm_links_rwsem);
+	return ret;
+}
+
+static void dpm_wait_for_links(struct device *dev, bool async, bool suppliers)
+{
+	struct device *dep;
+	int n;
+
+	for (n = 0; (dep = dpm_get_link_dev(dev, n, suppliers)); n++) {
+		dpm_wait_dep(dev, dep, async);
+		put_device(dep);
+	}
+}
+
+static void dpm_wait_for_suppliers(struct device *dev, bool async)
+{
+	dpm_wait_for_links(dev, async, true);
+}
+
+static void dpm_wait_for_consumers(struct device *dev, bool async)
+{
+	dpm_wait_for_links(dev, async, false);
+}
+
+#ifdef CONFIG_SUSPEND_TIME
+/* Hand the callback times of the devices handled in this phase over. */
+static void dpm_report_times(struct list_head *list, bool resume)
+{
+	struct device *dev, *last = NULL;
+
+	mutex_lock(&dpm_list_mtx);
+	suspend_time_dev_begin(resume);
+	list_for_each_entry(dev, list, power.entry) {
+		if (dev->power.dpm_end.tv64 < dpm_phase_start.tv64)
+			continue;
+		suspend_time_dev_record(dev, resume, dpm_phase_start);
+		if (!last || dev->power.dpm_end.tv64 > last->power.dpm_end.tv64)
+			last = dev;
+	}
+	suspend_time_dev_end(last, resume, dpm_phase_start);
+	mutex_unlock(&dpm_list_mtx);
 }
+#else
+static inline void dpm_report_times(struct list_head *list, bool resume) {}
+#endif
 
 /**
  * pm_op - Execute the PM operation appropriate for given PM event.
@@ -517,7 +792,10 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 	TRACE_DEVICE(dev);
 	TRACE_RESUME(0);
 
-	dpm_wait(dev->parent, async);
+	dev->power.dpm_waited_on = NULL;
+	dpm_wait_dep(dev, dev->parent, async);
+	dpm_wait_for_suppliers(dev, async);
+	dev->power.dpm_start = ktime_get();
 	device_lock(dev);
 
 	/*
@@ -571,6 +849,7 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 
  Unlock:
 	device_unlock(dev);
+	dev->power.dpm_end = ktime_get();
 	complete_all(&dev->power.completion);
 
 	TRACE_RESUME(error);
@@ -592,12 +871,6 @@ static void async_resume(void *data, async_cookie_t cookie)
 	put_device(dev);
 }
 
-static bool is_async(struct device *dev)
-{
-	return dev->power.async_suspend && pm_async_enabled
-		&& !pm_trace_is_enabled();
-}
-
 /**
  *	dpm_drv_timeout - Driver suspend / resume watchdog handler
  *	@data: struct device which timed out
@@ -639,6 +912,7 @@ void dpm_resume(pm_message_t state)
 	mutex_lock(&dpm_list_mtx);
 	pm_transition = state;
 	async_error = 0;
+	dpm_phase_start = ktime_get();
 
 	list_for_each_entry(dev, &dpm_suspended_list, power.entry) {
 		INIT_COMPLETION(dev->power.completion);
@@ -669,6 +943,7 @@ void dpm_resume(pm_message_t state)
 	mutex_unlock(&dpm_list_mtx);
 	async_synchronize_full();
 	dpm_show_time(starttime, state, NULL);
+	dpm_report_times(&dpm_prepared_list, true);
 }
 
 /**
@@ -883,7 +1158,10 @@ static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 	struct timer_list timer;
 	struct dpm_drv_wd_data data;
 
+	dev->power.dpm_waited_on = NULL;
 	dpm_wait_for_children(dev, async);
+	dpm_wait_for_consumers(dev, async);
+	dev->power.dpm_start = ktime_get();
 
 	data.dev = dev;
 	data.tsk = get_current();
@@ -951,6 +1229,7 @@ static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 	del_timer_sync(&timer);
 	destroy_timer_on_stack(&timer);
 
+	dev->power.dpm_end = ktime_get();
 	complete_all(&dev->power.completion);
 
 	if (error) {
@@ -979,7 +1258,7 @@ static int device_suspend(struct device *dev)
 {
 	INIT_COMPLETION(dev->power.completion);
 
-	if (pm_async_enabled && dev->power.async_suspend) {
+	if (is_async(dev)) {
 		get_device(dev);
 		async_schedule(async_suspend, dev);
 		return 0;
@@ -1002,6 +1281,7 @@ int dpm_suspend(pm_message_t state)
 	mutex_lock(&dpm_list_mtx);
 	pm_transition = state;
 	async_error = 0;
+	dpm_phase_start = ktime_get();
 	while (!list_empty(&dpm_prepared_list)) {
 		struct device *dev = to_device(dpm_prepared_list.prev);
 
@@ -1028,6 +1308,7 @@ int dpm_suspend(pm_message_t state)
 		error = async_error;
 	if (!error)
 		dpm_show_time(starttime, state, NULL);
+	dpm_report_times(&dpm_suspended_list, false);
 	return error;
 }
 
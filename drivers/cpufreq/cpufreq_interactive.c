@@ -30,17 +30,9 @@
 
 #include <asm/cputime.h>
 
-#include <linux/input.h>
-#include <linux/slab.h>
-#include <linux/ktime.h>
-
 extern void set_up2g0_delay(int delay);
-static ktime_t freq_change_time_input;
 //static DEFINE_MUTEX(dbs_mutex);
 
-#define DEFAULT_MIN_SAMPLE_INPUT_TIME 1500000
-static unsigned long min_sample_input_time;
-
 
 struct cpufreq_interactive_cpuinfo {
 	struct timer_list cpu_timer;
@@ -320,20 +312,18 @@ static void cpufreq_interactive_timer(unsigned long data)
 		}
 	}
 
+	/*
+	 * Input boosts are applied as a PM QoS floor on the policy, see
+	 * kernel/power/input_boost.c.
+	 */
 	if (new_freq < pcpu->target_freq) {
-		if ( pcpu->policy->cpu != 0 || ktime_to_us(ktime_sub(ktime_get(), freq_change_time_input)) >= min_sample_input_time)
-		{
-			pcpu->target_freq = new_freq;
-		}
+		pcpu->target_freq = new_freq;
 		spin_lock_irqsave(&down_cpumask_lock, flags);
 		cpumask_set_cpu(data, &down_cpumask);
 		spin_unlock_irqrestore(&down_cpumask_lock, flags);
 		queue_work(down_wq, &freq_scale_down_work);
 	} else {
-		if ( pcpu->policy->cpu != 0 || ktime_to_us(ktime_sub(ktime_get(), freq_change_time_input)) >= min_sample_input_time)
-		{
-			pcpu->target_freq = new_freq;
-		}
+		pcpu->target_freq = new_freq;
 		spin_lock_irqsave(&up_cpumask_lock, flags);
 		cpumask_set_cpu(data, &up_cpumask);
 		spin_unlock_irqrestore(&up_cpumask_lock, flags);
@@ -613,7 +603,6 @@ DECL_CPUFREQ_INTERACTIVE_ATTR(min_sample_time)
 DECL_CPUFREQ_INTERACTIVE_ATTR(timer_rate)
 DECL_CPUFREQ_INTERACTIVE_ATTR(high_freq_min_delay)
 DECL_CPUFREQ_INTERACTIVE_ATTR(max_normal_freq)
-DECL_CPUFREQ_INTERACTIVE_ATTR(min_sample_input_time)
 
 #undef DECL_CPUFREQ_INTERACTIVE_ATTR
 
@@ -630,7 +619,6 @@ static struct attribute *interactive_attributes[] = {
 	&timer_rate_attr.attr,
 	&high_freq_min_delay_attr.attr,
 	&max_normal_freq_attr.attr,
-	 &min_sample_input_time_attr.attr,
 	NULL,
 };
 
@@ -639,95 +627,6 @@ static struct attribute_group interactive_attr_group = {
 	.name = "interactive",
 };
 
-static void dbs_refresh_callback(struct work_struct *unused)
-{
-	struct cpufreq_interactive_cpuinfo *pcpu;
-	//only scale the freq to max on CPU0:
-	pcpu = &per_cpu(cpuinfo, 0);
-	if (!pcpu->governor_enabled)
-		return;
-
-	/*spin_lock_irqsave(&up_cpumask_lock, flags);
-	cpumask_set_cpu(0, &up_cpumask);
-	spin_unlock_irqrestore(&up_cpumask_lock, flags);*/
-	//printk("cur:%d\n",pcpu->policy->cur);
-	freq_change_time_input = ktime_get();
-	if (pcpu->policy->cur < pcpu->policy->max-200000) {//minus 200Mhz for now
-		pcpu->target_freq = pcpu->policy->max;
-		__cpufreq_driver_target(pcpu->policy,
-						pcpu->target_freq,
-						CPUFREQ_RELATION_H);
-		pcpu->freq_change_time_in_idle =
-				get_cpu_idle_time_us(0, &pcpu->freq_change_time);
-		//printk("UP!!! %d: set tgt=%d (actual=%d)\n", 0, pcpu->target_freq, pcpu->policy->cur);
-	}
-}
-
-static DECLARE_WORK(dbs_refresh_work, dbs_refresh_callback);
-
-static void dbs_input_event(struct input_handle *handle, unsigned int type,
-		unsigned int code, int value)
-{
-	schedule_work(&dbs_refresh_work);
-}
-
-static int dbs_input_connect(struct input_handler *handler,
-		struct input_dev *dev, const struct input_device_id *id)
-{
-	struct input_handle *handle;
-	int error;
-
-	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
-	if (!handle)
-		return -ENOMEM;
-
-	handle->dev = dev;
-	handle->handler = handler;
-	handle->name = "cpufreq";
-
-	error = input_register_handle(handle);
-	if (error)
-		goto err2;
-
-	error = input_open_device(handle);
-	if (error)
-		goto err1;
-
-	return 0;
-err1:
-	input_unregister_handle(handle);
-err2:
-	kfree(handle);
-	return error;
-}
-
-static void dbs_input_disconnect(struct input_handle *handle)
-{
-	input_close_device(handle);
-	input_unregister_handle(handle);
-	kfree(handle);
-}
-
-static const struct input_device_id dbs_ids[] = {
-	{
-		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
-			 INPUT_DEVICE_ID_MATCH_ABSBIT,
-		.evbit = { BIT_MASK(EV_ABS) },
-		.absbit = { [BIT_WORD(ABS_MT_POSITION_X)] =
-			    BIT_MASK(ABS_MT_POSITION_X) |
-			    BIT_MASK(ABS_MT_POSITION_Y) },
-	}, /* multi-touch touchscreen */
-	{},
-};
-
-static struct input_handler dbs_input_handler = {
-	.event		= dbs_input_event,
-	.connect	= dbs_input_connect,
-	.disconnect	= dbs_input_disconnect,
-	.name		= "cpufreq_interactive",
-	.id_table	= dbs_ids,
-};
-
 static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 		unsigned int event)
 {
@@ -784,11 +683,6 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 				mutex_unlock(&gov_state_lock);
 				return rc;
 			}
-
-			if(policy->cpu == 0) {
-				freq_change_time_input = ktime_get();
-				input_register_handler(&dbs_input_handler);
-			}
 		}
 		mutex_unlock(&gov_state_lock);
 
@@ -822,9 +716,6 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 					&interactive_attr_group);
 			kobject_uevent(interactive_kobj, KOBJ_REMOVE);
 			kobject_put(interactive_kobj);
-			if(policy->cpu == 0)
-				input_unregister_handler(&dbs_input_handler);
-
 		}
 
 		mutex_unlock(&gov_state_lock);
@@ -875,7 +766,6 @@ static int __init cpufreq_interactive_init(void)
 	timer_rate = DEFAULT_TIMER_RATE;
 	high_freq_min_delay = DEFAULT_HIGH_FREQ_MIN_DELAY;
 	max_normal_freq = DEFAULT_MAX_NORMAL_FREQ;
-	min_sample_input_time = DEFAULT_MIN_SAMPLE_INPUT_TIME;
 
 	/* Initalize per-cpu timers */
 	for_each_possible_cpu(i) {
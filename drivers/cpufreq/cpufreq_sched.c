@@ -0,0 +1,435 @@
+/*
+ * drivers/cpufreq/cpufreq_sched.c
+ *
+ * Scheduler-driven cpufreq governor.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Instead of sampling idle time from a timer, the scheduler reports the
+ * decayed utilization of each runqueue whenever a task is enqueued or
+ * dequeued and on every tick.  The new target frequency is computed
+ * right there; only the driver call, which may sleep, is deferred to a
+ * SCHED_FIFO kthread.  The scheduler wakes the kthread as soon as it has
+ * dropped the runqueue lock.
+ */
+
+#include <linux/cpu.h>
+#include <linux/cpufreq.h>
+#include <linux/init.h>
+#include <linux/jiffies.h>
+#include <linux/kthread.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/timer.h>
+
+struct cpufreq_sched_cpuinfo {
+	struct update_util_data update_util;
+	struct cpufreq_policy *policy;
+	struct cpufreq_frequency_table *freq_table;
+	/* re-evaluates a decrease held back by min_sample_time */
+	struct timer_list slack_timer;
+	/* the kthread is to arm slack_timer */
+	int slack_pending;
+	unsigned int cpu;
+	unsigned int target_freq;
+	u64 freq_change_time;
+	int governor_enabled;
+};
+
+static DEFINE_PER_CPU(struct cpufreq_sched_cpuinfo, cpuinfo);
+
+static struct task_struct *speed_task;
+static cpumask_t speed_cpumask;
+static DEFINE_SPINLOCK(speed_cpumask_lock);
+static DEFINE_MUTEX(gov_state_lock);
+static unsigned int active_count;
+
+/* Go to max speed when cpu utilization is at or above this value (%). */
+#define DEFAULT_GO_MAXSPEED_LOAD 85
+static unsigned long go_maxspeed_load;
+
+/*
+ * Utilization (%) the governor aims for at the selected frequency.
+ * Lower values leave more headroom and select higher frequencies.
+ */
+#define DEFAULT_TARGET_LOAD 80
+static unsigned long target_load;
+
+/* The minimum amount of time (us) to spend at a frequency before ramping down. */
+#define DEFAULT_MIN_SAMPLE_TIME 20000
+static unsigned long min_sample_time;
+
+static int cpufreq_governor_sched(struct cpufreq_policy *policy,
+		unsigned int event);
+
+#ifndef CONFIG_CPU_FREQ_DEFAULT_GOV_SCHED
+static
+#endif
+struct cpufreq_governor cpufreq_gov_sched = {
+	.name = "sched",
+	.governor = cpufreq_governor_sched,
+	.max_transition_latency = 10000000,
+	.owner = THIS_MODULE,
+};
+
+/*
+ * util is the fraction of time the cpu was busy at the current speed,
+ * so scale the current speed rather than the maximum one.
+ */
+static unsigned int cpufreq_sched_get_target(unsigned long util,
+		unsigned long max, struct cpufreq_policy *policy)
+{
+	unsigned int load = util * 100 / max;
+
+	if (load >= go_maxspeed_load)
+		return policy->max;
+
+	return min(policy->cur * load / (unsigned int)target_load, policy->max);
+}
+
+static void cpufreq_sched_queue(struct cpufreq_sched_cpuinfo *pcpu)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&speed_cpumask_lock, flags);
+	cpumask_set_cpu(pcpu->cpu, &speed_cpumask);
+	spin_unlock_irqrestore(&speed_cpumask_lock, flags);
+}
+
+/*
+ * Called by the scheduler with the runqueue of pcpu->cpu locked and
+ * interrupts disabled.  Nothing may be woken up or armed from here, so
+ * return true to have cpufreq_sched_kick() called once the lock is gone.
+ */
+static bool cpufreq_sched_update_util(struct update_util_data *data,
+		u64 time, unsigned long util, unsigned long max)
+{
+	struct cpufreq_sched_cpuinfo *pcpu =
+		container_of(data, struct cpufreq_sched_cpuinfo, update_util);
+	struct cpufreq_policy *policy = pcpu->policy;
+	unsigned int new_freq;
+	unsigned int index;
+
+	if (!pcpu->governor_enabled)
+		return false;
+
+	new_freq = cpufreq_sched_get_target(util, max, policy);
+	if (cpufreq_frequency_table_target(policy, pcpu->freq_table,
+					   new_freq, CPUFREQ_RELATION_H,
+					   &index))
+		return false;
+
+	new_freq = pcpu->freq_table[index].frequency;
+	if (new_freq == pcpu->target_freq)
+		return false;
+
+	/*
+	 * Do not scale down unless we have been at this frequency for the
+	 * minimum sample time.  If the cpu goes idle in the meantime
+	 * nothing would re-evaluate it, so leave the slack timer to do that.
+	 */
+	if (new_freq < pcpu->target_freq) {
+		if (time - pcpu->freq_change_time <
+		    (u64)min_sample_time * NSEC_PER_USEC) {
+			if (pcpu->slack_pending ||
+			    timer_pending(&pcpu->slack_timer))
+				return false;
+			pcpu->slack_pending = 1;
+			cpufreq_sched_queue(pcpu);
+			return true;
+		}
+	}
+
+	pcpu->target_freq = new_freq;
+	pcpu->freq_change_time = time;
+	cpufreq_sched_queue(pcpu);
+	return true;
+}
+
+static void cpufreq_sched_kick(struct update_util_data *data)
+{
+	wake_up_process(speed_task);
+}
+
+static void cpufreq_sched_slack_timer(unsigned long data)
+{
+	struct cpufreq_sched_cpuinfo *pcpu = &per_cpu(cpuinfo, data);
+
+	smp_rmb();
+
+	if (!pcpu->governor_enabled)
+		return;
+
+	/*
+	 * A busy cpu reports its utilization on every tick; only an idle
+	 * one can be left stuck above the minimum speed.
+	 */
+	if (idle_cpu(data) && pcpu->target_freq > pcpu->policy->min) {
+		pcpu->target_freq = pcpu->policy->min;
+		cpufreq_sched_queue(pcpu);
+		wake_up_process(speed_task);
+	}
+}
+
+static int cpufreq_sched_speed_task(void *data)
+{
+	unsigned int cpu;
+	cpumask_t tmp_mask;
+	unsigned long flags;
+	struct cpufreq_sched_cpuinfo *pcpu;
+
+	while (1) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		spin_lock_irqsave(&speed_cpumask_lock, flags);
+
+		if (cpumask_empty(&speed_cpumask)) {
+			spin_unlock_irqrestore(&speed_cpumask_lock, flags);
+			schedule();
+
+			if (kthread_should_stop())
+				break;
+
+			spin_lock_irqsave(&speed_cpumask_lock, flags);
+		}
+
+		set_current_state(TASK_RUNNING);
+		tmp_mask = speed_cpumask;
+		cpumask_clear(&speed_cpumask);
+		spin_unlock_irqrestore(&speed_cpumask_lock, flags);
+
+		for_each_cpu(cpu, &tmp_mask) {
+			unsigned int j;
+			unsigned int max_freq = 0;
+
+			pcpu = &per_cpu(cpuinfo, cpu);
+			smp_rmb();
+
+			mutex_lock(&gov_state_lock);
+			if (!pcpu->governor_enabled) {
+				mutex_unlock(&gov_state_lock);
+				continue;
+			}
+
+			if (pcpu->slack_pending) {
+				pcpu->slack_pending = 0;
+				mod_timer(&pcpu->slack_timer, jiffies +
+					  usecs_to_jiffies(min_sample_time));
+			}
+
+			for_each_cpu(j, pcpu->policy->cpus) {
+				struct cpufreq_sched_cpuinfo *pjcpu =
+					&per_cpu(cpuinfo, j);
+
+				if (pjcpu->target_freq > max_freq)
+					max_freq = pjcpu->target_freq;
+			}
+
+			if (max_freq != pcpu->policy->cur)
+				__cpufreq_driver_target(pcpu->policy, max_freq,
+							CPUFREQ_RELATION_H);
+
+			mutex_unlock(&gov_state_lock);
+		}
+	}
+
+	return 0;
+}
+
+#define DECL_CPUFREQ_SCHED_ATTR(name) \
+static ssize_t show_##name(struct kobject *kobj, \
+	struct attribute *attr, char *buf) \
+{ \
+	return sprintf(buf, "%lu\n", name); \
+} \
+\
+static ssize_t store_##name(struct kobject *kobj,\
+		struct attribute *attr, const char *buf, size_t count) \
+{ \
+	int ret; \
+	unsigned long val; \
+\
+	ret = strict_strtoul(buf, 0, &val); \
+	if (ret < 0) \
+		return ret; \
+	name = val; \
+	return count; \
+} \
+\
+static struct global_attr name##_attr = __ATTR(name, 0644, \
+		show_##name, store_##name);
+
+DECL_CPUFREQ_SCHED_ATTR(go_maxspeed_load)
+DECL_CPUFREQ_SCHED_ATTR(min_sample_time)
+
+#undef DECL_CPUFREQ_SCHED_ATTR
+
+static ssize_t show_target_load(struct kobject *kobj,
+	struct attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", target_load);
+}
+
+static ssize_t store_target_load(struct kobject *kobj,
+		struct attribute *attr, const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = strict_strtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	if (!val || val > 100)
+		return -EINVAL;
+	target_load = val;
+	return count;
+}
+
+static struct global_attr target_load_attr = __ATTR(target_load, 0644,
+		show_target_load, store_target_load);
+
+static struct attribute *sched_attributes[] = {
+	&go_maxspeed_load_attr.attr,
+	&target_load_attr.attr,
+	&min_sample_time_attr.attr,
+	NULL,
+};
+
+static struct attribute_group sched_attr_group = {
+	.attrs = sched_attributes,
+	.name = "sched",
+};
+
+static int cpufreq_governor_sched(struct cpufreq_policy *policy,
+		unsigned int event)
+{
+	int rc;
+	unsigned int j;
+	struct cpufreq_sched_cpuinfo *pcpu;
+	struct cpufreq_frequency_table *freq_table;
+
+	switch (event) {
+	case CPUFREQ_GOV_START:
+		if (!cpu_online(policy->cpu))
+			return -EINVAL;
+
+		freq_table = cpufreq_frequency_get_table(policy->cpu);
+		if (!freq_table)
+			return -EINVAL;
+
+		mutex_lock(&gov_state_lock);
+		for_each_cpu(j, policy->cpus) {
+			pcpu = &per_cpu(cpuinfo, j);
+			pcpu->policy = policy;
+			pcpu->target_freq = policy->cur;
+			pcpu->freq_table = freq_table;
+			pcpu->freq_change_time = 0;
+			pcpu->slack_pending = 0;
+			pcpu->governor_enabled = 1;
+			smp_wmb();
+
+			cpufreq_set_update_util_data(j, &pcpu->update_util);
+		}
+
+		active_count++;
+		/*
+		 * Do not create sysfs entries if we have already done so.
+		 */
+		if (active_count == 1) {
+			rc = sysfs_create_group(cpufreq_global_kobject,
+					&sched_attr_group);
+			if (rc) {
+				mutex_unlock(&gov_state_lock);
+				return rc;
+			}
+		}
+		mutex_unlock(&gov_state_lock);
+
+		break;
+
+	case CPUFREQ_GOV_STOP:
+		mutex_lock(&gov_state_lock);
+		for_each_cpu(j, policy->cpus) {
+			pcpu = &per_cpu(cpuinfo, j);
+			cpufreq_set_update_util_data(j, NULL);
+			pcpu->governor_enabled = 0;
+			smp_wmb();
+		}
+		mutex_unlock(&gov_state_lock);
+
+		/* wait for callbacks already running on other cpus */
+		synchronize_sched();
+
+		for_each_cpu(j, policy->cpus)
+			del_timer_sync(&per_cpu(cpuinfo, j).slack_timer);
+
+		mutex_lock(&gov_state_lock);
+		active_count--;
+
+		if (active_count == 0)
+			sysfs_remove_group(cpufreq_global_kobject,
+					&sched_attr_group);
+		mutex_unlock(&gov_state_lock);
+
+		break;
+
+	case CPUFREQ_GOV_LIMITS:
+		if (policy->max < policy->cur)
+			__cpufreq_driver_target(policy,
+					policy->max, CPUFREQ_RELATION_H);
+		else if (policy->min > policy->cur)
+			__cpufreq_driver_target(policy,
+					policy->min, CPUFREQ_RELATION_L);
+		break;
+	}
+	return 0;
+}
+
+static int __init cpufreq_sched_init(void)
+{
+	unsigned int i;
+	struct cpufreq_sched_cpuinfo *pcpu;
+	struct sched_param param = { .sched_priority = MAX_RT_PRIO-1 };
+
+	go_maxspeed_load = DEFAULT_GO_MAXSPEED_LOAD;
+	target_load = DEFAULT_TARGET_LOAD;
+	min_sample_time = DEFAULT_MIN_SAMPLE_TIME;
+
+	for_each_possible_cpu(i) {
+		pcpu = &per_cpu(cpuinfo, i);
+		pcpu->cpu = i;
+		pcpu->update_util.func = cpufreq_sched_update_util;
+		pcpu->update_util.kick = cpufreq_sched_kick;
+		init_timer(&pcpu->slack_timer);
+		pcpu->slack_timer.function = cpufreq_sched_slack_timer;
+		pcpu->slack_timer.data = i;
+	}
+
+	speed_task = kthread_create(cpufreq_sched_speed_task, NULL,
+				    "kschedfreq");
+	if (IS_ERR(speed_task))
+		return PTR_ERR(speed_task);
+
+	sched_setscheduler_nocheck(speed_task, SCHED_FIFO, &param);
+	get_task_struct(speed_task);
+
+	return cpufreq_register_governor(&cpufreq_gov_sched);
+}
+
+#ifdef CONFIG_CPU_FREQ_DEFAULT_GOV_SCHED
+fs_initcall(cpufreq_sched_init);
+#else
+module_init(cpufreq_sched_init);
+#endif
+
+MODULE_DESCRIPTION("'cpufreq_sched' - A cpufreq governor driven by "
+	"scheduler utilization updates");
+MODULE_LICENSE("GPL");
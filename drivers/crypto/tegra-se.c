@@ -34,6 +34,8 @@
 #include <linux/interrupt.h>
 #include <linux/types.h>
 #include <linux/errno.h>
+#include <linux/moduleparam.h>
+#include <linux/delay.h>
 #include <crypto/scatterwalk.h>
 #include <crypto/algapi.h>
 #include <crypto/aes.h>
@@ -94,16 +96,54 @@ struct tegra_se_dev {
 	dma_addr_t ctx_save_buf_adr;	/* LP context buffer dma address*/
 	struct completion complete;	/* Tells the task completion */
 	bool work_q_busy;	/* Work queue busy status */
+	unsigned long nr_batches;	/* AES operations started */
+	unsigned long nr_batched_reqs;	/* AES requests completed by them */
 };
 
 static struct tegra_se_dev *sg_tegra_se_dev;
 
+/*
+ * Run the queued AES requests through the kernel's software ciphers instead
+ * of the engine, with the same queue, batching and completion as the
+ * hardware.  The device then needs no resources at all, which allows to
+ * measure the batching without the SoC.
+ */
+static bool soft_engine;
+module_param(soft_engine, bool, S_IRUGO);
+MODULE_PARM_DESC(soft_engine, "Process AES requests in software");
+
+/*
+ * What the engine spends on an operation besides the data: IV load,
+ * configuration and the completion interrupt.  The soft engine sleeps this
+ * long once per operation, so that batching saves what it saves on the
+ * hardware.  The default is a guess, set it from a measurement of
+ * tegra_se_start_operation() on the device.
+ */
+static unsigned int soft_engine_op_us = 20;
+module_param(soft_engine_op_us, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(soft_engine_op_us,
+	"Modelled per operation setup and interrupt time in us");
+
+static unsigned int batch_max = TEGRA_SE_MAX_BATCH_REQS;
+module_param(batch_max, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(batch_max, "AES requests per operation, 1 disables batching");
+
+/* Security Engine AES request batch, executed as one operation */
+struct tegra_se_batch {
+	struct ablkcipher_request *req[TEGRA_SE_MAX_BATCH_REQS];
+	u32 nr_reqs;	/* number of requests in the batch */
+	u32 nbytes;	/* total number of bytes */
+	u32 num_src_sgs;	/* total number of source buffers */
+	u32 num_dst_sgs;	/* total number of destination buffers */
+};
+
 /* Security Engine AES context */
 struct tegra_se_aes_context {
 	struct tegra_se_dev *se_dev;	/* Security Engine device */
 	struct tegra_se_slot *slot;	/* Security Engine key slot */
 	u32 keylen;	/* key length in bits */
 	u32 op_mode;	/* AES operation mode */
+	struct crypto_blkcipher *sw_tfm;	/* soft_engine cipher */
 };
 
 /* Security Engine random number generator context */
@@ -186,7 +226,15 @@ static void tegra_se_leftshift_onebit(u8 *in_buf, u32 size, u8 *org_msb)
 	}
 }
 
+#ifdef CONFIG_ARCH_TEGRA
 extern unsigned long long tegra_chip_uid(void);
+#else
+/* Only the soft engine builds off Tegra, and it does not register the RNG */
+static inline unsigned long long tegra_chip_uid(void)
+{
+	return 0;
+}
+#endif
 
 static inline void se_writel(struct tegra_se_dev *se_dev,
 	unsigned int val, unsigned int reg_offset)
@@ -683,29 +731,15 @@ static void tegra_se_free_ll_buf(struct tegra_se_dev *se_dev)
 	}
 }
 
-static int tegra_se_setup_ablk_req(struct tegra_se_dev *se_dev,
-	struct ablkcipher_request *req)
+static int tegra_se_map_ablk_req(struct tegra_se_dev *se_dev,
+	struct ablkcipher_request *req, struct tegra_se_ll **src_llp,
+	struct tegra_se_ll **dst_llp)
 {
 	struct scatterlist *src_sg, *dst_sg;
-	struct tegra_se_ll *src_ll, *dst_ll;
-	u32 total, num_src_sgs, num_dst_sgs;
+	struct tegra_se_ll *src_ll = *src_llp, *dst_ll = *dst_llp;
+	u32 total;
 	int ret = 0;
 
-	num_src_sgs = tegra_se_count_sgs(req->src, req->nbytes);
-	num_dst_sgs = tegra_se_count_sgs(req->dst, req->nbytes);
-
-	if ((num_src_sgs > SE_MAX_SRC_SG_COUNT) ||
-		(num_dst_sgs > SE_MAX_DST_SG_COUNT)) {
-			dev_err(se_dev->dev, "num of SG buffers are more\n");
-			return -EINVAL;
-	}
-
-	*se_dev->src_ll_buf = num_src_sgs-1;
-	*se_dev->dst_ll_buf = num_dst_sgs-1;
-
-	src_ll = (struct tegra_se_ll *)(se_dev->src_ll_buf + 1);
-	dst_ll = (struct tegra_se_ll *)(se_dev->dst_ll_buf + 1);
-
 	src_sg = req->src;
 	dst_sg = req->dst;
 	total = req->nbytes;
@@ -737,6 +771,38 @@ static int tegra_se_setup_ablk_req(struct tegra_se_dev *se_dev,
 		src_ll++;
 		WARN_ON(((total != 0) && (!src_sg || !dst_sg)));
 	}
+
+	*src_llp = src_ll;
+	*dst_llp = dst_ll;
+	return ret;
+}
+
+/* Chain the buffers of all requests of a batch into one linked list */
+static int tegra_se_setup_ablk_batch(struct tegra_se_dev *se_dev,
+	struct tegra_se_batch *batch)
+{
+	struct tegra_se_ll *src_ll, *dst_ll;
+	int ret = 0;
+	u32 i;
+
+	if ((batch->num_src_sgs > SE_MAX_SRC_SG_COUNT) ||
+		(batch->num_dst_sgs > SE_MAX_DST_SG_COUNT)) {
+			dev_err(se_dev->dev, "num of SG buffers are more\n");
+			return -EINVAL;
+	}
+
+	*se_dev->src_ll_buf = batch->num_src_sgs-1;
+	*se_dev->dst_ll_buf = batch->num_dst_sgs-1;
+
+	src_ll = (struct tegra_se_ll *)(se_dev->src_ll_buf + 1);
+	dst_ll = (struct tegra_se_ll *)(se_dev->dst_ll_buf + 1);
+
+	for (i = 0; i < batch->nr_reqs; i++) {
+		ret = tegra_se_map_ablk_req(se_dev, batch->req[i],
+			&src_ll, &dst_ll);
+		if (ret < 0)
+			break;
+	}
 	return ret;
 }
 
@@ -760,19 +826,128 @@ static void tegra_se_dequeue_complete_req(struct tegra_se_dev *se_dev,
 	}
 }
 
-static void tegra_se_process_new_req(struct crypto_async_request *async_req)
+/*
+ * Does the counter of @next continue where @prev ends?  The engine
+ * increments the 128 bit big endian counter once per block.
+ */
+static bool tegra_se_ctr_continues(struct ablkcipher_request *prev,
+	struct ablkcipher_request *next)
 {
-	struct tegra_se_dev *se_dev = sg_tegra_se_dev;
-	struct ablkcipher_request *req = ablkcipher_request_cast(async_req);
+	u8 ctr[TEGRA_SE_AES_IV_SIZE];
+	u32 carry = prev->nbytes / TEGRA_SE_AES_BLOCK_SIZE;
+	int i;
+
+	if (!prev->info || !next->info)
+		return false;
+
+	memcpy(ctr, prev->info, TEGRA_SE_AES_IV_SIZE);
+	for (i = TEGRA_SE_AES_IV_SIZE - 1; i >= 0 && carry; i--) {
+		carry += ctr[i];
+		ctr[i] = carry & 0xff;
+		carry >>= 8;
+	}
+
+	return !memcmp(ctr, next->info, TEGRA_SE_AES_IV_SIZE);
+}
+
+/*
+ * Can @req be appended to @batch and processed in the same operation?
+ * The engine loads one IV per operation, so this only works for requests
+ * of the same key and direction in ECB mode, or in CTR mode when the
+ * counters are contiguous.  CBC and OFB requests, such as dm-crypt's
+ * aes-cbc-essiv sectors, each carry an IV of their own and are never
+ * batched.  The soft engine follows the same rules, so that both process
+ * the same batches.
+ */
+static bool tegra_se_can_batch(struct tegra_se_batch *batch,
+	struct ablkcipher_request *req)
+{
+	struct ablkcipher_request *last = batch->req[batch->nr_reqs - 1];
+	struct tegra_se_req_context *req_ctx = ablkcipher_request_ctx(req);
+	struct tegra_se_req_context *last_ctx = ablkcipher_request_ctx(last);
+
+	if (batch->nr_reqs >= min_t(u32, batch_max, TEGRA_SE_MAX_BATCH_REQS))
+		return false;
+
+	if (crypto_ablkcipher_reqtfm(req) != crypto_ablkcipher_reqtfm(last) ||
+		req_ctx->op_mode != last_ctx->op_mode ||
+		req_ctx->encrypt != last_ctx->encrypt)
+		return false;
+
+	if ((batch->num_src_sgs + tegra_se_count_sgs(req->src, req->nbytes) >
+		SE_MAX_SRC_SG_COUNT) ||
+		(batch->num_dst_sgs + tegra_se_count_sgs(req->dst, req->nbytes) >
+		SE_MAX_DST_SG_COUNT))
+		return false;
+
+	switch (req_ctx->op_mode) {
+	case SE_AES_OP_MODE_ECB:
+		return true;
+	case SE_AES_OP_MODE_CTR:
+		return tegra_se_ctr_continues(last, req);
+	default:
+		return false;
+	}
+}
+
+static void tegra_se_batch_add(struct tegra_se_batch *batch,
+	struct ablkcipher_request *req)
+{
+	batch->req[batch->nr_reqs++] = req;
+	batch->nbytes += req->nbytes;
+	batch->num_src_sgs += tegra_se_count_sgs(req->src, req->nbytes);
+	batch->num_dst_sgs += tegra_se_count_sgs(req->dst, req->nbytes);
+}
+
+static int tegra_se_soft_process_batch(struct tegra_se_batch *batch)
+{
+	u32 i;
+	int ret = 0;
+
+	if (soft_engine_op_us)
+		usleep_range(soft_engine_op_us, soft_engine_op_us);
+
+	for (i = 0; i < batch->nr_reqs && !ret; i++) {
+		struct ablkcipher_request *req = batch->req[i];
+		struct tegra_se_req_context *req_ctx =
+				ablkcipher_request_ctx(req);
+		struct tegra_se_aes_context *aes_ctx =
+			crypto_ablkcipher_ctx(crypto_ablkcipher_reqtfm(req));
+		struct blkcipher_desc desc = {
+			.tfm = aes_ctx->sw_tfm,
+			.info = req->info,
+		};
+
+		if (req_ctx->encrypt)
+			ret = crypto_blkcipher_encrypt_iv(&desc, req->dst,
+				req->src, req->nbytes);
+		else
+			ret = crypto_blkcipher_decrypt_iv(&desc, req->dst,
+				req->src, req->nbytes);
+	}
+
+	return ret;
+}
+
+static void tegra_se_process_batch(struct tegra_se_dev *se_dev,
+	struct tegra_se_batch *batch)
+{
+	struct ablkcipher_request *req = batch->req[0];
 	struct tegra_se_req_context *req_ctx = ablkcipher_request_ctx(req);
 	struct tegra_se_aes_context *aes_ctx =
 			crypto_ablkcipher_ctx(crypto_ablkcipher_reqtfm(req));
 	int ret = 0;
+	u32 i;
 
 	/* take access to the hw */
 	mutex_lock(&se_hw_lock);
 
-	/* write IV */
+	if (soft_engine) {
+		ret = tegra_se_soft_process_batch(batch);
+		goto out;
+	}
+
+	/* write IV, the following requests continue from it */
 	if (req->info) {
 		if (req_ctx->op_mode == SE_AES_OP_MODE_CTR) {
 			tegra_se_write_seed(se_dev, (u32 *)req->info);
@@ -783,16 +958,25 @@ static void tegra_se_process_new_req(struct crypto_async_request *async_req)
 				SE_KEY_TABLE_TYPE_ORGIV);
 		}
 	}
-	tegra_se_setup_ablk_req(se_dev, req);
-	tegra_se_config_algo(se_dev, req_ctx->op_mode, req_ctx->encrypt,
-		aes_ctx->keylen);
-	tegra_se_config_crypto(se_dev, req_ctx->op_mode, req_ctx->encrypt,
-			aes_ctx->slot->slot_num, req->info ? true : false);
-	ret = tegra_se_start_operation(se_dev, req->nbytes, false);
-	tegra_se_dequeue_complete_req(se_dev, req);
+	ret = tegra_se_setup_ablk_batch(se_dev, batch);
+	if (ret >= 0) {
+		tegra_se_config_algo(se_dev, req_ctx->op_mode,
+			req_ctx->encrypt, aes_ctx->keylen);
+		tegra_se_config_crypto(se_dev, req_ctx->op_mode,
+			req_ctx->encrypt, aes_ctx->slot->slot_num,
+			req->info ? true : false);
+		ret = tegra_se_start_operation(se_dev, batch->nbytes, false);
+	}
+	for (i = 0; i < batch->nr_reqs; i++)
+		tegra_se_dequeue_complete_req(se_dev, batch->req[i]);
 
+out:
+	se_dev->nr_batches++;
+	se_dev->nr_batched_reqs += batch->nr_reqs;
 	mutex_unlock(&se_hw_lock);
-	req->base.complete(&req->base, ret);
+
+	for (i = 0; i < batch->nr_reqs; i++)
+		batch->req[i]->base.complete(&batch->req[i]->base, ret);
 }
 
 static irqreturn_t tegra_se_irq(int irq, void *dev)
@@ -812,32 +996,55 @@ static irqreturn_t tegra_se_irq(int irq, void *dev)
 	return IRQ_HANDLED;
 }
 
+static struct ablkcipher_request *tegra_se_peek_req(struct crypto_queue *queue)
+{
+	if (list_empty(&queue->list))
+		return NULL;
+
+	return ablkcipher_request_cast(list_first_entry(&queue->list,
+			struct crypto_async_request, list));
+}
+
 static void tegra_se_work_handler(struct work_struct *work)
 {
 	struct tegra_se_dev *se_dev = sg_tegra_se_dev;
 	struct crypto_async_request *async_req = NULL;
-	struct crypto_async_request *backlog = NULL;
+	struct crypto_async_request *backlog[TEGRA_SE_MAX_BATCH_REQS];
+	struct ablkcipher_request *next;
+	struct tegra_se_batch batch;
+	u32 i, nr_backlog;
 
 	pm_runtime_get_sync(se_dev->dev);
 
 	do {
+		memset(&batch, 0, sizeof(batch));
+		nr_backlog = 0;
+
+		/* gather the queued requests that can share one operation */
 		spin_lock_irq(&se_dev->lock);
-		backlog = crypto_get_backlog(&se_dev->queue);
-		async_req = crypto_dequeue_request(&se_dev->queue);
-		if (!async_req)
+		do {
+			next = tegra_se_peek_req(&se_dev->queue);
+			if (!next || (batch.nr_reqs &&
+				!tegra_se_can_batch(&batch, next)))
+				break;
+
+			backlog[nr_backlog] = crypto_get_backlog(&se_dev->queue);
+			if (backlog[nr_backlog])
+				nr_backlog++;
+			async_req = crypto_dequeue_request(&se_dev->queue);
+			tegra_se_batch_add(&batch,
+				ablkcipher_request_cast(async_req));
+		} while (batch.nr_reqs < TEGRA_SE_MAX_BATCH_REQS);
+		if (!batch.nr_reqs)
 			se_dev->work_q_busy = false;
 
 		spin_unlock_irq(&se_dev->lock);
 
-		if (backlog) {
-			backlog->complete(backlog, -EINPROGRESS);
-			backlog = NULL;
-		}
+		for (i = 0; i < nr_backlog; i++)
+			backlog[i]->complete(backlog[i], -EINPROGRESS);
 
-		if (async_req) {
-			tegra_se_process_new_req(async_req);
-			async_req = NULL;
-		}
+		if (batch.nr_reqs)
+			tegra_se_process_batch(se_dev, &batch);
 	} while (se_dev->work_q_busy);
 	pm_runtime_put(se_dev->dev);
 }
@@ -968,6 +1175,13 @@ static int tegra_se_aes_setkey(struct crypto_ablkcipher *tfm,
 		return -EINVAL;
 	}
 
+	if (soft_engine) {
+		if (!key)
+			return -EINVAL;
+		ctx->keylen = keylen;
+		return crypto_blkcipher_setkey(ctx->sw_tfm, key, keylen);
+	}
+
 	if (key) {
 		if (!ctx->slot || (ctx->slot &&
 		    ctx->slot->slot_num == ssk_slot.slot_num)) {
@@ -1006,6 +1220,17 @@ static int tegra_se_aes_cra_init(struct crypto_tfm *tfm)
 	ctx->se_dev = sg_tegra_se_dev;
 	tfm->crt_ablkcipher.reqsize = sizeof(struct tegra_se_req_context);
 
+	if (soft_engine) {
+		ctx->sw_tfm = crypto_alloc_blkcipher(crypto_tfm_alg_name(tfm),
+			0, CRYPTO_ALG_ASYNC);
+		if (IS_ERR(ctx->sw_tfm)) {
+			int err = PTR_ERR(ctx->sw_tfm);
+
+			ctx->sw_tfm = NULL;
+			return err;
+		}
+	}
+
 	return 0;
 }
 
@@ -1013,6 +1238,10 @@ static void tegra_se_aes_cra_exit(struct crypto_tfm *tfm)
 {
 	struct tegra_se_aes_context *ctx = crypto_tfm_ctx(tfm);
 
+	if (ctx->sw_tfm) {
+		crypto_free_blkcipher(ctx->sw_tfm);
+		ctx->sw_tfm = NULL;
+	}
 	tegra_se_free_key_slot(ctx->slot);
 	ctx->slot = NULL;
 }
@@ -1427,7 +1656,7 @@ int tegra_se_aes_cmac_final(struct ahash_request *req)
 	temp_buffer = cmac_ctx->buffer;
 	while (sg_miter_next(&miter) && total < req->nbytes) {
 		unsigned int len;
-		len = min(miter.length, req->nbytes - total);
+		len = min_t(unsigned int, miter.length, req->nbytes - total);
 		if ((req->nbytes - (total + len)) <= last_block_bytes) {
 			bytes_to_copy =
 				last_block_bytes -
@@ -1850,6 +2079,60 @@ static struct ahash_alg hash_algs[] = {
 	}
 };
 
+static ssize_t tegra_se_batch_stats_show(struct device *dev,
+	struct device_attribute *attr, char *buf)
+{
+	struct tegra_se_dev *se_dev = dev_get_drvdata(dev);
+
+	return sprintf(buf, "%lu %lu\n", se_dev->nr_batches,
+		se_dev->nr_batched_reqs);
+}
+
+static DEVICE_ATTR(batch_stats, S_IRUGO, tegra_se_batch_stats_show, NULL);
+
+static int tegra_se_soft_probe(struct tegra_se_dev *se_dev)
+{
+	int err = 0, i;
+
+	se_work_q = alloc_workqueue("se_work_q", WQ_HIGHPRI | WQ_UNBOUND, 16);
+	if (!se_work_q) {
+		dev_err(se_dev->dev, "alloc_workqueue failed\n");
+		return -ENOMEM;
+	}
+
+	sg_tegra_se_dev = se_dev;
+
+	/* only the ciphers that have a generic implementation to fall on */
+	for (i = 0; i < ARRAY_SIZE(aes_algs); i++) {
+		INIT_LIST_HEAD(&aes_algs[i].cra_list);
+		if (aes_algs[i].cra_type != &crypto_ablkcipher_type ||
+			!crypto_has_blkcipher(aes_algs[i].cra_name, 0,
+				CRYPTO_ALG_ASYNC))
+			continue;
+		err = crypto_register_alg(&aes_algs[i]);
+		if (err) {
+			dev_err(se_dev->dev,
+				"crypto_register_alg failed index[%d]\n", i);
+			goto clean;
+		}
+	}
+
+	if (device_create_file(se_dev->dev, &dev_attr_batch_stats))
+		dev_warn(se_dev->dev, "can not create batch_stats\n");
+
+	dev_info(se_dev->dev, "%s: software engine", __func__);
+	return 0;
+
+clean:
+	for (i = 0; i < ARRAY_SIZE(aes_algs); i++)
+		if (!list_empty(&aes_algs[i].cra_list))
+			crypto_unregister_alg(&aes_algs[i]);
+	destroy_workqueue(se_work_q);
+	se_work_q = NULL;
+
+	return err;
+}
+
 static int tegra_se_probe(struct platform_device *pdev)
 {
 	struct tegra_se_dev *se_dev = NULL;
@@ -1867,6 +2150,13 @@ static int tegra_se_probe(struct platform_device *pdev)
 	platform_set_drvdata(pdev, se_dev);
 	se_dev->dev = &pdev->dev;
 
+	if (soft_engine) {
+		err = tegra_se_soft_probe(se_dev);
+		if (err)
+			goto fail;
+		return 0;
+	}
+
 	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
 	if (!res) {
 		err = -ENXIO;
@@ -1905,8 +2195,8 @@ static int tegra_se_probe(struct platform_device *pdev)
 	/* Initialize the clock */
 	se_dev->pclk = clk_get(se_dev->dev, "se");
 	if (IS_ERR(se_dev->pclk)) {
-		dev_err(se_dev->dev, "clock intialization failed (%d)\n",
-			(int)se_dev->pclk);
+		dev_err(se_dev->dev, "clock intialization failed (%ld)\n",
+			PTR_ERR(se_dev->pclk));
 		err = -ENODEV;
 		goto clean;
 	}
@@ -1977,6 +2267,9 @@ static int tegra_se_probe(struct platform_device *pdev)
 	}
 #endif
 
+	if (device_create_file(se_dev->dev, &dev_attr_batch_stats))
+		dev_warn(se_dev->dev, "can not create batch_stats\n");
+
 	dev_info(se_dev->dev, "%s: complete", __func__);
 	return 0;
 
@@ -2019,6 +2312,19 @@ static int __devexit tegra_se_remove(struct platform_device *pdev)
 	if (!se_dev)
 		return -ENODEV;
 
+	device_remove_file(se_dev->dev, &dev_attr_batch_stats);
+
+	if (soft_engine) {
+		cancel_work_sync(&se_work);
+		destroy_workqueue(se_work_q);
+		for (i = 0; i < ARRAY_SIZE(aes_algs); i++)
+			if (!list_empty(&aes_algs[i].cra_list))
+				crypto_unregister_alg(&aes_algs[i]);
+		kfree(se_dev);
+		sg_tegra_se_dev = NULL;
+		return 0;
+	}
+
 	pm_runtime_disable(se_dev->dev);
 
 	cancel_work_sync(&se_work);
@@ -2316,6 +2622,10 @@ static int tegra_se_suspend(struct device *dev)
 	if (!se_dev)
 		return -ENODEV;
 
+	/* nothing of the engine is in use */
+	if (soft_engine)
+		return 0;
+
 	/* Generate SRK */
 	err = tegra_se_generate_srk(se_dev);
 	if (err) {
@@ -2415,14 +2725,16 @@ static int tegra_se_runtime_resume(struct device *dev)
 	clk_enable(sg_tegra_se_dev->pclk);
 	return 0;
 }
+#endif
 
+#if defined(CONFIG_PM)
 static const struct dev_pm_ops tegra_se_dev_pm_ops = {
+#if defined(CONFIG_PM_RUNTIME)
 	.runtime_suspend = tegra_se_runtime_suspend,
 	.runtime_resume = tegra_se_runtime_resume,
-#if defined(CONFIG_PM)
+#endif
 	.suspend = tegra_se_suspend,
 	.resume = tegra_se_resume,
-#endif
 };
 #endif
 
@@ -2432,19 +2744,45 @@ static struct platform_driver tegra_se_driver = {
 	.driver = {
 		.name   = "tegra-se",
 		.owner  = THIS_MODULE,
-#if defined(CONFIG_PM_RUNTIME)
+#if defined(CONFIG_PM)
 		.pm = &tegra_se_dev_pm_ops,
 #endif
 	},
 };
 
+#ifndef CONFIG_ARCH_TEGRA_3x_SOC
+/* No board provides the engine here, the soft engine brings its own device */
+static struct platform_device *tegra_se_soft_pdev;
+#endif
+
 static int __init tegra_se_module_init(void)
 {
-	return  platform_driver_register(&tegra_se_driver);
+	int err;
+
+	err = platform_driver_register(&tegra_se_driver);
+	if (err)
+		return err;
+
+#ifndef CONFIG_ARCH_TEGRA_3x_SOC
+	if (soft_engine) {
+		tegra_se_soft_pdev = platform_device_register_simple(
+				DRIVER_NAME, -1, NULL, 0);
+		if (IS_ERR(tegra_se_soft_pdev)) {
+			platform_driver_unregister(&tegra_se_driver);
+			return PTR_ERR(tegra_se_soft_pdev);
+		}
+	}
+#endif
+
+	return 0;
 }
 
 static void __exit tegra_se_module_exit(void)
 {
+#ifndef CONFIG_ARCH_TEGRA_3x_SOC
+	if (tegra_se_soft_pdev)
+		platform_device_unregister(tegra_se_soft_pdev);
+#endif
 	platform_driver_unregister(&tegra_se_driver);
 }
 
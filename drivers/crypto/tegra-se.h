@@ -31,6 +31,7 @@
 #define TEGRA_SE_CRYPTO_QUEUE_LENGTH 50
 #define SE_MAX_SRC_SG_COUNT		50
 #define SE_MAX_DST_SG_COUNT		50
+#define TEGRA_SE_MAX_BATCH_REQS		16
 
 #define TEGRA_SE_KEYSLOT_COUNT		16
 
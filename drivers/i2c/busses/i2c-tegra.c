@@ -996,6 +996,8 @@ static int __devinit tegra_i2c_probe(struct platform_device *pdev)
 	init_completion(&i2c_dev->msg_complete);
 
 	platform_set_drvdata(pdev, i2c_dev);
+	/* its adapters and clients need nothing else, let them start early */
+	device_enable_async_suspend(&pdev->dev);
 
 	if (i2c_dev->is_clkon_always)
 		tegra_i2c_clock_enable(i2c_dev);
@@ -535,6 +535,8 @@ i2c_new_device(struct i2c_adapter *adap, struct i2c_board_info const *info)
 		goto out_err;
 
 	client->dev.parent = &client->adapter->dev;
+	/* waits for the adapter, and for its regulators through their links */
+	device_enable_async_suspend(&client->dev);
 	client->dev.bus = &i2c_bus_type;
 	client->dev.type = &i2c_client_type;
 	client->dev.of_node = info->of_node;
@@ -845,6 +847,7 @@ static int i2c_register_adapter(struct i2c_adapter *adap)
 	dev_set_name(&adap->dev, "i2c-%d", adap->nr);
 	adap->dev.bus = &i2c_bus_type;
 	adap->dev.type = &i2c_adapter_type;
+	device_enable_async_suspend(&adap->dev);
 	res = device_register(&adap->dev);
 	if (res)
 		goto out_list;
@@ -17,6 +17,7 @@
 #include <linux/slab.h>
 #include <linux/crypto.h>
 #include <linux/workqueue.h>
+#include <linux/kthread.h>
 #include <linux/backing-dev.h>
 #include <asm/atomic.h>
 #include <linux/scatterlist.h>
@@ -38,8 +39,10 @@ struct convert_context {
 	unsigned int offset_out;
 	unsigned int idx_in;
 	unsigned int idx_out;
+	unsigned int sectors_left;
 	sector_t sector;
 	atomic_t pending;
+	struct ablkcipher_request *req;
 };
 
 /*
@@ -55,9 +58,16 @@ struct dm_crypt_io {
 	atomic_t pending;
 	int error;
 	sector_t sector;
+	/* part of base_bio converted by this io, in bytes */
+	unsigned int offset;
+	unsigned int size;
 	struct dm_crypt_io *base_io;
+	/* see kcryptd_io_read_inline() */
+	atomic_t inline_read;
 };
 
+enum { INLINE_READ_NONE, INLINE_READ_SUBMITTING, INLINE_READ_DONE };
+
 struct dm_crypt_request {
 	struct convert_context *ctx;
 	struct scatterlist sg_in;
@@ -89,7 +99,8 @@ struct iv_benbi_private {
  * Crypt: maps a linear range of a block device
  * and encrypts / decrypts at the same time.
  */
-enum flags { DM_CRYPT_SUSPENDED, DM_CRYPT_KEY_VALID };
+enum flags { DM_CRYPT_SUSPENDED, DM_CRYPT_KEY_VALID,
+	     DM_CRYPT_SINGLE_CPU, DM_CRYPT_INLINE_READS };
 struct crypt_config {
 	struct dm_dev *dev;
 	sector_t start;
@@ -106,6 +117,14 @@ struct crypt_config {
 	struct workqueue_struct *io_queue;
 	struct workqueue_struct *crypt_queue;
 
+	/*
+	 * Encrypted writes converted in parallel are handed to write_thread,
+	 * which submits them sorted by sector.
+	 */
+	struct task_struct *write_thread;
+	spinlock_t write_lock;
+	struct bio *write_bios;
+
 	char *cipher;
 	char *cipher_string;
 
@@ -131,7 +150,6 @@ struct crypt_config {
 	 * correctly aligned.
 	 */
 	unsigned int dmreq_start;
-	struct ablkcipher_request *req;
 
 	struct crypto_ablkcipher *tfm;
 	unsigned long flags;
@@ -143,10 +161,17 @@ struct crypt_config {
 #define MIN_POOL_PAGES 32
 #define MIN_BIO_PAGES  8
 
+/*
+ * Bios larger than this are converted in pieces by several kcryptd
+ * workers at once; inline reads must not be larger.
+ */
+#define CRYPT_BATCH_SECTORS 128
+
 static struct kmem_cache *_crypt_io_pool;
 
 static void clone_init(struct dm_crypt_io *, struct bio *);
 static void kcryptd_queue_crypt(struct dm_crypt_io *io);
+static void kcryptd_crypt_read_convert(struct dm_crypt_io *io);
 
 /*
  * Different IV generation algorithms:
@@ -383,10 +408,37 @@ static void crypt_convert_init(struct crypt_config *cc,
 	ctx->offset_out = 0;
 	ctx->idx_in = bio_in ? bio_in->bi_idx : 0;
 	ctx->idx_out = bio_out ? bio_out->bi_idx : 0;
+	ctx->sectors_left = bio_in ? bio_sectors(bio_in) : 0;
 	ctx->sector = sector + cc->iv_offset;
 	init_completion(&ctx->restart);
 }
 
+/*
+ * Start the conversion @offset bytes into the input bio and stop after
+ * @size bytes.  An in-place conversion moves the output along.
+ */
+static void crypt_convert_seek(struct convert_context *ctx,
+			       unsigned int offset, unsigned int size)
+{
+	struct bio_vec *bv;
+
+	for (; offset; ctx->idx_in++) {
+		bv = bio_iovec_idx(ctx->bio_in, ctx->idx_in);
+		if (offset < bv->bv_len) {
+			ctx->offset_in = offset;
+			break;
+		}
+		offset -= bv->bv_len;
+	}
+
+	if (ctx->bio_out == ctx->bio_in) {
+		ctx->idx_out = ctx->idx_in;
+		ctx->offset_out = ctx->offset_in;
+	}
+
+	ctx->sectors_left = size >> SECTOR_SHIFT;
+}
+
 static struct dm_crypt_request *dmreq_of_req(struct crypt_config *cc,
 					     struct ablkcipher_request *req)
 {
@@ -434,6 +486,8 @@ static int crypt_convert_block(struct crypt_config *cc,
 		ctx->idx_out++;
 	}
 
+	ctx->sectors_left--;
+
 	if (cc->iv_gen_ops) {
 		r = cc->iv_gen_ops->generator(cc, iv, ctx->sector);
 		if (r < 0)
@@ -456,13 +510,13 @@ static void kcryptd_async_done(struct crypto_async_request *async_req,
 static void crypt_alloc_req(struct crypt_config *cc,
 			    struct convert_context *ctx)
 {
-	if (!cc->req)
-		cc->req = mempool_alloc(cc->req_pool, GFP_NOIO);
-	ablkcipher_request_set_tfm(cc->req, cc->tfm);
-	ablkcipher_request_set_callback(cc->req, CRYPTO_TFM_REQ_MAY_BACKLOG |
+	if (!ctx->req)
+		ctx->req = mempool_alloc(cc->req_pool, GFP_NOIO);
+	ablkcipher_request_set_tfm(ctx->req, cc->tfm);
+	ablkcipher_request_set_callback(ctx->req, CRYPTO_TFM_REQ_MAY_BACKLOG |
 					CRYPTO_TFM_REQ_MAY_SLEEP,
 					kcryptd_async_done,
-					dmreq_of_req(cc, cc->req));
+					dmreq_of_req(cc, ctx->req));
 }
 
 /*
@@ -475,14 +529,15 @@ static int crypt_convert(struct crypt_config *cc,
 
 	atomic_set(&ctx->pending, 1);
 
-	while(ctx->idx_in < ctx->bio_in->bi_vcnt &&
+	while(ctx->sectors_left &&
+	      ctx->idx_in < ctx->bio_in->bi_vcnt &&
 	      ctx->idx_out < ctx->bio_out->bi_vcnt) {
 
 		crypt_alloc_req(cc, ctx);
 
 		atomic_inc(&ctx->pending);
 
-		r = crypt_convert_block(cc, ctx, cc->req);
+		r = crypt_convert_block(cc, ctx, ctx->req);
 
 		switch (r) {
 		/* async */
@@ -491,7 +546,7 @@ static int crypt_convert(struct crypt_config *cc,
 			INIT_COMPLETION(ctx->restart);
 			/* fall through*/
 		case -EINPROGRESS:
-			cc->req = NULL;
+			ctx->req = NULL;
 			ctx->sector++;
 			continue;
 
@@ -590,17 +645,24 @@ static void crypt_free_buffer_pages(struct crypt_config *cc, struct bio *clone)
 }
 
 static struct dm_crypt_io *crypt_io_alloc(struct dm_target *ti,
-					  struct bio *bio, sector_t sector)
+					  struct bio *bio, sector_t sector,
+					  gfp_t gfp)
 {
 	struct crypt_config *cc = ti->private;
 	struct dm_crypt_io *io;
 
-	io = mempool_alloc(cc->io_pool, GFP_NOIO);
+	io = mempool_alloc(cc->io_pool, gfp);
+	if (!io)
+		return NULL;
 	io->target = ti;
 	io->base_bio = bio;
 	io->sector = sector;
+	io->offset = 0;
+	io->size = bio->bi_size;
 	io->error = 0;
 	io->base_io = NULL;
+	atomic_set(&io->inline_read, INLINE_READ_NONE);
+	io->ctx.req = NULL;
 	atomic_set(&io->pending, 0);
 
 	return io;
@@ -626,6 +688,8 @@ static void crypt_dec_pending(struct dm_crypt_io *io)
 	if (!atomic_dec_and_test(&io->pending))
 		return;
 
+	if (io->ctx.req)
+		mempool_free(io->ctx.req, cc->req_pool);
 	mempool_free(io, cc->io_pool);
 
 	if (likely(!base_io))
@@ -669,7 +733,10 @@ static void crypt_endio(struct bio *clone, int error)
 	bio_put(clone);
 
 	if (rw == READ && !error) {
-		kcryptd_queue_crypt(io);
+		/* leave a synchronous completion to the submitter */
+		if (atomic_cmpxchg(&io->inline_read, INLINE_READ_SUBMITTING,
+				   INLINE_READ_DONE) != INLINE_READ_SUBMITTING)
+			kcryptd_queue_crypt(io);
 		return;
 	}
 
@@ -690,26 +757,32 @@ static void clone_init(struct dm_crypt_io *io, struct bio *clone)
 	clone->bi_destructor = dm_crypt_bio_destructor;
 }
 
-static void kcryptd_io_read(struct dm_crypt_io *io)
+/*
+ * Returns 1 if the clone bio could not be allocated with @gfp and the
+ * read should be retried from kcryptd_io.
+ */
+static int kcryptd_io_read(struct dm_crypt_io *io, gfp_t gfp)
 {
 	struct crypt_config *cc = io->target->private;
 	struct bio *base_bio = io->base_bio;
 	struct bio *clone;
 
-	crypt_inc_pending(io);
-
 	/*
 	 * The block layer might modify the bvec array, so always
 	 * copy the required bvecs because we need the original
 	 * one in order to decrypt the whole bio data *afterwards*.
 	 */
-	clone = bio_alloc_bioset(GFP_NOIO, bio_segments(base_bio), cc->bs);
+	clone = bio_alloc_bioset(gfp, bio_segments(base_bio), cc->bs);
 	if (unlikely(!clone)) {
+		if (gfp != GFP_NOIO)
+			return 1;
+		crypt_inc_pending(io);
 		io->error = -ENOMEM;
 		crypt_dec_pending(io);
-		return;
+		return 0;
 	}
 
+	crypt_inc_pending(io);
 	clone_init(io, clone);
 	clone->bi_idx = 0;
 	clone->bi_vcnt = bio_segments(base_bio);
@@ -719,6 +792,7 @@ static void kcryptd_io_read(struct dm_crypt_io *io)
 	       sizeof(struct bio_vec) * clone->bi_vcnt);
 
 	generic_make_request(clone);
+	return 0;
 }
 
 static void kcryptd_io_write(struct dm_crypt_io *io)
@@ -727,13 +801,39 @@ static void kcryptd_io_write(struct dm_crypt_io *io)
 	generic_make_request(clone);
 }
 
+/*
+ * Submit a read from kcryptd_io and, if the device completed it before
+ * generic_make_request() returned (ramdisk, for example), decrypt it
+ * here instead of queueing it to kcryptd.  Only this path can see such
+ * a completion: a read submitted from crypt_map() is held back on
+ * current->bio_list until the map returns.
+ */
+static void kcryptd_io_read_inline(struct dm_crypt_io *io)
+{
+	/* kcryptd may finish io as soon as the read is submitted */
+	crypt_inc_pending(io);
+
+	atomic_set(&io->inline_read, INLINE_READ_SUBMITTING);
+	kcryptd_io_read(io, GFP_NOIO);
+
+	if (atomic_xchg(&io->inline_read, INLINE_READ_NONE) ==
+	    INLINE_READ_DONE)
+		kcryptd_crypt_read_convert(io);
+
+	crypt_dec_pending(io);
+}
+
 static void kcryptd_io(struct work_struct *work)
 {
 	struct dm_crypt_io *io = container_of(work, struct dm_crypt_io, work);
+	struct crypt_config *cc = io->target->private;
 
-	if (bio_data_dir(io->base_bio) == READ)
-		kcryptd_io_read(io);
-	else
+	if (bio_data_dir(io->base_bio) == READ) {
+		if (test_bit(DM_CRYPT_INLINE_READS, &cc->flags))
+			kcryptd_io_read_inline(io);
+		else
+			kcryptd_io_read(io, GFP_NOIO);
+	} else
 		kcryptd_io_write(io);
 }
 
@@ -745,6 +845,64 @@ static void kcryptd_queue_io(struct dm_crypt_io *io)
 	queue_work(cc->io_queue, &io->work);
 }
 
+/*
+ * dmcrypt_write: submits the writes encrypted by parallel kcryptd
+ * workers.  The workers finish in any order, so the clones are kept
+ * sorted by sector and submitted under one plug to give the device
+ * the sequential stream the filesystem issued.
+ */
+static int dmcrypt_write(void *data)
+{
+	struct crypt_config *cc = data;
+	struct bio *bios, *clone;
+	struct blk_plug plug;
+
+	while (1) {
+		set_current_state(TASK_INTERRUPTIBLE);
+
+		spin_lock_irq(&cc->write_lock);
+		bios = cc->write_bios;
+		cc->write_bios = NULL;
+		spin_unlock_irq(&cc->write_lock);
+
+		if (!bios) {
+			if (kthread_should_stop())
+				break;
+			schedule();
+			continue;
+		}
+		__set_current_state(TASK_RUNNING);
+
+		blk_start_plug(&plug);
+		while (bios) {
+			clone = bios;
+			bios = bios->bi_next;
+			clone->bi_next = NULL;
+			generic_make_request(clone);
+		}
+		blk_finish_plug(&plug);
+	}
+	__set_current_state(TASK_RUNNING);
+
+	return 0;
+}
+
+static void kcryptd_queue_write(struct crypt_config *cc, struct bio *clone)
+{
+	unsigned long flags;
+	struct bio **p;
+
+	spin_lock_irqsave(&cc->write_lock, flags);
+	for (p = &cc->write_bios; *p; p = &(*p)->bi_next)
+		if ((*p)->bi_sector > clone->bi_sector)
+			break;
+	clone->bi_next = *p;
+	*p = clone;
+	spin_unlock_irqrestore(&cc->write_lock, flags);
+
+	wake_up_process(cc->write_thread);
+}
+
 static void kcryptd_crypt_write_io_submit(struct dm_crypt_io *io,
 					  int error, int async)
 {
@@ -764,7 +922,9 @@ static void kcryptd_crypt_write_io_submit(struct dm_crypt_io *io,
 
 	clone->bi_sector = cc->start + io->sector;
 
-	if (async)
+	if (cc->write_thread)
+		kcryptd_queue_write(cc, clone);
+	else if (async)
 		kcryptd_queue_io(io);
 	else
 		generic_make_request(clone);
@@ -777,7 +937,7 @@ static void kcryptd_crypt_write_convert(struct dm_crypt_io *io)
 	struct dm_crypt_io *new_io;
 	int crypt_finished;
 	unsigned out_of_pages = 0;
-	unsigned remaining = io->base_bio->bi_size;
+	unsigned remaining = io->size;
 	sector_t sector = io->sector;
 	int r;
 
@@ -786,6 +946,7 @@ static void kcryptd_crypt_write_convert(struct dm_crypt_io *io)
 	 */
 	crypt_inc_pending(io);
 	crypt_convert_init(cc, &io->ctx, NULL, io->base_bio, sector);
+	crypt_convert_seek(&io->ctx, io->offset, io->size);
 
 	/*
 	 * The allocated buffers can be smaller than the whole bio,
@@ -835,7 +996,7 @@ static void kcryptd_crypt_write_convert(struct dm_crypt_io *io)
 		 */
 		if (unlikely(!crypt_finished && remaining)) {
 			new_io = crypt_io_alloc(io->target, io->base_bio,
-						sector);
+						sector, GFP_NOIO);
 			crypt_inc_pending(new_io);
 			crypt_convert_init(cc, &new_io->ctx, NULL,
 					   io->base_bio, sector);
@@ -878,6 +1039,7 @@ static void kcryptd_crypt_read_convert(struct dm_crypt_io *io)
 
 	crypt_convert_init(cc, &io->ctx, io->base_bio, io->base_bio,
 			   io->sector);
+	crypt_convert_seek(&io->ctx, io->offset, io->size);
 
 	r = crypt_convert(cc, &io->ctx);
 
@@ -911,10 +1073,76 @@ static void kcryptd_async_done(struct crypto_async_request *async_req,
 		kcryptd_crypt_write_io_submit(io, error, 1);
 }
 
+/*
+ * Cut a large bio into CRYPT_BATCH_SECTORS pieces which kcryptd workers
+ * on different cpus convert at the same time.  Each piece is an io of
+ * its own that completes into @io.  Returns 0 if @io is to be converted
+ * as a whole.
+ *
+ * This runs in a kcryptd worker, and the pieces can only be freed by
+ * other kcryptd workers, so they must not wait on io_pool.  If the pool
+ * runs dry, this worker converts whatever is left itself.
+ */
+static int kcryptd_crypt_split(struct dm_crypt_io *io)
+{
+	struct crypt_config *cc = io->target->private;
+	unsigned int batch = CRYPT_BATCH_SECTORS << SECTOR_SHIFT;
+	struct dm_crypt_io *new_io;
+	unsigned int offset;
+
+	if (test_bit(DM_CRYPT_SINGLE_CPU, &cc->flags) || io->base_io ||
+	    io->size <= batch)
+		return 0;
+
+	crypt_inc_pending(io);
+
+	for (offset = 0; offset < io->size; offset += batch) {
+		new_io = crypt_io_alloc(io->target, io->base_bio,
+					io->sector + (offset >> SECTOR_SHIFT),
+					GFP_NOWAIT);
+		if (!new_io)
+			break;
+		new_io->offset = io->offset + offset;
+		new_io->size = min(batch, io->size - offset);
+		new_io->base_io = io;
+		crypt_inc_pending(io);
+		/*
+		 * A read piece has no clone of its own, hold the reference
+		 * that kcryptd_crypt_read_convert() expects a clone to hold.
+		 */
+		if (bio_data_dir(io->base_bio) == READ)
+			crypt_inc_pending(new_io);
+		kcryptd_queue_crypt(new_io);
+	}
+
+	if (offset < io->size) {
+		/*
+		 * The conversion takes over the reference of a read's
+		 * finished clone, as it does for an io that is not split.
+		 */
+		io->sector += offset >> SECTOR_SHIFT;
+		io->offset += offset;
+		io->size -= offset;
+		if (bio_data_dir(io->base_bio) == READ)
+			kcryptd_crypt_read_convert(io);
+		else
+			kcryptd_crypt_write_convert(io);
+	} else if (bio_data_dir(io->base_bio) == READ) {
+		/* A read also drops the reference held by its finished clone */
+		crypt_dec_pending(io);
+	}
+	crypt_dec_pending(io);
+
+	return 1;
+}
+
 static void kcryptd_crypt(struct work_struct *work)
 {
 	struct dm_crypt_io *io = container_of(work, struct dm_crypt_io, work);
 
+	if (kcryptd_crypt_split(io))
+		return;
+
 	if (bio_data_dir(io->base_bio) == READ)
 		kcryptd_crypt_read_convert(io);
 	else
@@ -1004,6 +1232,9 @@ static void crypt_dtr(struct dm_target *ti)
 	if (!cc)
 		return;
 
+	if (cc->write_thread)
+		kthread_stop(cc->write_thread);
+
 	if (cc->io_queue)
 		destroy_workqueue(cc->io_queue);
 	if (cc->crypt_queue)
@@ -1183,7 +1414,7 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	const char *opt_string;
 
 	static struct dm_arg _args[] = {
-		{0, 1, "Invalid number of feature args"},
+		{0, 3, "Invalid number of feature args"},
 	};
 
 	if (argc < 5) {
@@ -1224,7 +1455,6 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		ti->error = "Cannot allocate crypt request mempool";
 		goto bad;
 	}
-	cc->req = NULL;
 
 	cc->page_pool = mempool_create_page_pool(MIN_POOL_PAGES, 0);
 	if (!cc->page_pool) {
@@ -1268,15 +1498,24 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		if (ret)
 			goto bad;
 
-		opt_string = dm_shift_arg(&as);
+		ret = -EINVAL;
+		while (opt_params--) {
+			opt_string = dm_shift_arg(&as);
+			if (!opt_string) {
+				ti->error = "Not enough feature arguments";
+				goto bad;
+			}
 
-		if (opt_params == 1 && opt_string &&
-		    !strcasecmp(opt_string, "allow_discards"))
-			ti->num_discard_requests = 1;
-		else if (opt_params) {
-			ret = -EINVAL;
-			ti->error = "Invalid feature arguments";
-			goto bad;
+			if (!strcasecmp(opt_string, "allow_discards"))
+				ti->num_discard_requests = 1;
+			else if (!strcasecmp(opt_string, "single_cpu_crypt"))
+				set_bit(DM_CRYPT_SINGLE_CPU, &cc->flags);
+			else if (!strcasecmp(opt_string, "inline_reads"))
+				set_bit(DM_CRYPT_INLINE_READS, &cc->flags);
+			else {
+				ti->error = "Invalid feature arguments";
+				goto bad;
+			}
 		}
 	}
 
@@ -1287,12 +1526,30 @@ static int crypt_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		goto bad;
 	}
 
-	cc->crypt_queue = create_singlethread_workqueue("kcryptd");
+	if (test_bit(DM_CRYPT_SINGLE_CPU, &cc->flags))
+		cc->crypt_queue = create_singlethread_workqueue("kcryptd");
+	else
+		cc->crypt_queue = alloc_workqueue("kcryptd",
+						  WQ_UNBOUND | WQ_CPU_INTENSIVE |
+						  WQ_MEM_RECLAIM,
+						  num_possible_cpus());
 	if (!cc->crypt_queue) {
 		ti->error = "Couldn't create kcryptd queue";
 		goto bad;
 	}
 
+	spin_lock_init(&cc->write_lock);
+	if (!test_bit(DM_CRYPT_SINGLE_CPU, &cc->flags)) {
+		cc->write_thread = kthread_run(dmcrypt_write, cc,
+					       "dmcrypt_write");
+		if (IS_ERR(cc->write_thread)) {
+			ret = PTR_ERR(cc->write_thread);
+			cc->write_thread = NULL;
+			ti->error = "Couldn't spawn write thread";
+			goto bad;
+		}
+	}
+
 	ti->num_flush_requests = 1;
 	ti->discard_zeroes_data_unsupported = 1;
 
@@ -1322,11 +1579,22 @@ static int crypt_map(struct dm_target *ti, struct bio *bio,
 		return DM_MAPIO_REMAPPED;
 	}
 
-	io = crypt_io_alloc(ti, bio, dm_target_offset(ti, bio->bi_sector));
+	io = crypt_io_alloc(ti, bio, dm_target_offset(ti, bio->bi_sector),
+			    GFP_NOIO);
+	cc = ti->private;
 
-	if (bio_data_dir(io->base_bio) == READ)
-		kcryptd_queue_io(io);
-	else
+	if (bio_data_dir(io->base_bio) == READ) {
+		/*
+		 * Small inline reads skip kcryptd_io and are submitted in
+		 * the caller's context.
+		 */
+		if (test_bit(DM_CRYPT_INLINE_READS, &cc->flags) &&
+		    io->size <= CRYPT_BATCH_SECTORS << SECTOR_SHIFT) {
+			if (kcryptd_io_read(io, GFP_NOWAIT))
+				kcryptd_queue_io(io);
+		} else
+			kcryptd_queue_io(io);
+	} else
 		kcryptd_queue_crypt(io);
 
 	return DM_MAPIO_SUBMITTED;
@@ -1337,6 +1605,7 @@ static int crypt_status(struct dm_target *ti, status_type_t type,
 {
 	struct crypt_config *cc = ti->private;
 	unsigned int sz = 0;
+	int num_feature_args;
 
 	switch (type) {
 	case STATUSTYPE_INFO:
@@ -1361,8 +1630,18 @@ static int crypt_status(struct dm_target *ti, status_type_t type,
 		DMEMIT(" %llu %s %llu", (unsigned long long)cc->iv_offset,
 				cc->dev->name, (unsigned long long)cc->start);
 
-		if (ti->num_discard_requests)
-			DMEMIT(" 1 allow_discards");
+		num_feature_args = !!ti->num_discard_requests +
+			test_bit(DM_CRYPT_SINGLE_CPU, &cc->flags) +
+			test_bit(DM_CRYPT_INLINE_READS, &cc->flags);
+		if (num_feature_args) {
+			DMEMIT(" %d", num_feature_args);
+			if (ti->num_discard_requests)
+				DMEMIT(" allow_discards");
+			if (test_bit(DM_CRYPT_SINGLE_CPU, &cc->flags))
+				DMEMIT(" single_cpu_crypt");
+			if (test_bit(DM_CRYPT_INLINE_READS, &cc->flags))
+				DMEMIT(" inline_reads");
+		}
 
 		break;
 	}
@@ -1460,7 +1739,7 @@ static int crypt_iterate_devices(struct dm_target *ti,
 
 static struct target_type crypt_target = {
 	.name   = "crypt",
-	.version = {1, 8, 0},
+	.version = {1, 9, 0},
 	.module = THIS_MODULE,
 	.ctr    = crypt_ctr,
 	.dtr    = crypt_dtr,
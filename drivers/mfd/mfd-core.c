@@ -87,6 +87,9 @@ static int mfd_add_device(struct device *parent, int id,
 		goto fail_device;
 
 	pdev->dev.parent = parent;
+	/* the functions of an async chip need the chip and their supplies */
+	if (device_async_suspend_enabled(parent))
+		device_enable_async_suspend(&pdev->dev);
 
 	if (cell->pdata_size) {
 		ret = platform_device_add_data(pdev,
@@ -1008,6 +1008,8 @@ static int __devinit ricoh583_add_subdevs(struct ricoh583 *ricoh583,
 		pdev = platform_device_alloc(subdev->name, subdev->id);
 
 		pdev->dev.parent = ricoh583->dev;
+		if (device_async_suspend_enabled(ricoh583->dev))
+			device_enable_async_suspend(&pdev->dev);
 		pdev->dev.platform_data = subdev->platform_data;
 
 		ret = platform_device_add(pdev);
@@ -490,6 +490,8 @@ static int __devinit tps6586x_add_subdevs(struct tps6586x *tps6586x,
 		}
 
 		pdev->dev.parent = tps6586x->dev;
+		if (device_async_suspend_enabled(tps6586x->dev))
+			device_enable_async_suspend(&pdev->dev);
 		pdev->dev.platform_data = subdev->platform_data;
 
 		ret = platform_device_add(pdev);
@@ -746,6 +746,8 @@ static int __devinit tps6591x_add_subdevs(struct tps6591x *tps6591x,
 		pdev = platform_device_alloc(subdev->name, subdev->id);
 
 		pdev->dev.parent = tps6591x->dev;
+		if (device_async_suspend_enabled(tps6591x->dev))
+			device_enable_async_suspend(&pdev->dev);
 		pdev->dev.platform_data = subdev->platform_data;
 
 		ret = platform_device_add(pdev);
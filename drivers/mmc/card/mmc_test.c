@@ -2418,6 +2418,269 @@ static int mmc_test_profile_sglen_r_nonblock_perf(struct mmc_test_card *test)
 	return mmc_test_rw_multiple_sg_len(test, &test_data);
 }
 
+/*
+ * Packed writes (eMMC 4.5).  Each entry of a packed command is written
+ * with a pattern derived from its sector address, so that any sector can
+ * be checked on its own afterwards.
+ */
+struct mmc_test_packed_entry {
+	unsigned int addr;
+	unsigned int blocks;
+};
+
+static void mmc_test_packed_pattern(u8 *buf, unsigned int addr)
+{
+	int i;
+
+	for (i = 0; i < 512; i++)
+		buf[i] = (addr * 37 + i) ^ 0x5a;
+}
+
+static int mmc_test_packed_supported(struct mmc_test_card *test,
+				     unsigned int nr)
+{
+	struct mmc_card *card = test->card;
+
+	if (!mmc_host_cmd23(card->host) || !mmc_host_packed_wr(card->host))
+		return RESULT_UNSUP_HOST;
+	if (!mmc_card_mmc(card) || card->ext_csd.max_packed_writes < nr ||
+	    !card->ext_csd.packed_event_en)
+		return RESULT_UNSUP_CARD;
+	return 0;
+}
+
+/*
+ * Send @nr entries as one packed write: a CMD23 with the packed flag
+ * and a CMD25 whose first block is the packed header.
+ */
+static int mmc_test_packed_write(struct mmc_test_card *test,
+	const struct mmc_test_packed_entry *e, unsigned int nr)
+{
+	struct mmc_request mrq = {0};
+	struct mmc_command sbc = {0};
+	struct mmc_command cmd = {0};
+	struct mmc_command stop = {0};
+	struct mmc_data data = {0};
+	struct scatterlist sg;
+	unsigned int i, j, blocks = 0;
+	__le32 *hdr;
+	u8 *buf, *p;
+	int ret, busy;
+
+	for (i = 0; i < nr; i++)
+		blocks += e[i].blocks;
+
+	buf = kzalloc((blocks + 1) * 512, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	hdr = (__le32 *)buf;
+	hdr[0] = cpu_to_le32((nr << 16) | (PACKED_CMD_WR << 8) |
+			     PACKED_CMD_VER);
+	p = buf + 512;
+	for (i = 0; i < nr; i++) {
+		/* the CMD23 and CMD25 arguments of each entry */
+		hdr[(i + 1) * 2] = cpu_to_le32(e[i].blocks);
+		hdr[(i + 1) * 2 + 1] = cpu_to_le32(e[i].addr);
+		if (!mmc_card_blockaddr(test->card))
+			hdr[(i + 1) * 2 + 1] = cpu_to_le32(e[i].addr << 9);
+		for (j = 0; j < e[i].blocks; j++, p += 512)
+			mmc_test_packed_pattern(p, e[i].addr + j);
+	}
+
+	mrq.sbc = &sbc;
+	mrq.cmd = &cmd;
+	mrq.data = &data;
+	mrq.stop = &stop;
+
+	sg_init_one(&sg, buf, (blocks + 1) * 512);
+	mmc_test_prepare_mrq(test, &mrq, &sg, 1, e[0].addr, blocks + 1, 512, 1);
+
+	sbc.opcode = MMC_SET_BLOCK_COUNT;
+	sbc.arg = MMC_CMD23_ARG_PACKED | (blocks + 1);
+	sbc.flags = MMC_RSP_R1 | MMC_CMD_AC;
+
+	mmc_wait_for_req(test->card->host, &mrq);
+
+	ret = sbc.error ? sbc.error : mmc_test_check_result(test, &mrq);
+	busy = mmc_test_wait_busy(test);
+
+	kfree(buf);
+	return ret ? ret : busy;
+}
+
+/*
+ * Check that sector @addr holds its pattern if @written, else the data
+ * mmc_test_prepare_write() put there
+ */
+static int mmc_test_packed_check_sector(struct mmc_test_card *test,
+	unsigned int addr, int written)
+{
+	int ret;
+
+	if (written)
+		mmc_test_packed_pattern(test->scratch, addr);
+	else
+		memset(test->scratch, 0xDF, 512);
+
+	ret = mmc_test_buffer_transfer(test, test->buffer, addr, 512, 0);
+	if (ret)
+		return ret;
+
+	if (memcmp(test->buffer, test->scratch, 512)) {
+		printk(KERN_INFO "%s: sector %u %s\n",
+		       mmc_hostname(test->card->host), addr,
+		       written ? "not written" : "overwritten");
+		return RESULT_FAIL;
+	}
+
+	return 0;
+}
+
+/*
+ * Check all prepared sectors: those covered by @e must hold their
+ * pattern, all others must be untouched.
+ */
+static int mmc_test_packed_check(struct mmc_test_card *test,
+	const struct mmc_test_packed_entry *e, unsigned int nr)
+{
+	unsigned int addr, i;
+	int ret, written;
+
+	for (addr = 0; addr < BUFFER_SIZE / 512; addr++) {
+		written = 0;
+		for (i = 0; i < nr; i++)
+			if (addr >= e[i].addr && addr < e[i].addr + e[i].blocks)
+				written = 1;
+
+		ret = mmc_test_packed_check_sector(test, addr, written);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static int mmc_test_packed_send_status(struct mmc_test_card *test,
+				       u32 *status)
+{
+	struct mmc_command cmd = {0};
+	int ret;
+
+	cmd.opcode = MMC_SEND_STATUS;
+	cmd.arg = test->card->rca << 16;
+	cmd.flags = MMC_RSP_R1 | MMC_CMD_AC;
+
+	ret = mmc_wait_for_cmd(test->card->host, &cmd, 0);
+	*status = cmd.resp[0];
+	return ret;
+}
+
+/*
+ * Four entries of different sizes, out of order and with gaps between
+ * them
+ */
+static int mmc_test_packed_write_basic(struct mmc_test_card *test)
+{
+	static const struct mmc_test_packed_entry e[] = {
+		{ 12, 4 }, { 0, 1 }, { 2, 2 }, { 5, 3 },
+	};
+	int ret;
+
+	ret = mmc_test_packed_supported(test, ARRAY_SIZE(e));
+	if (ret)
+		return ret;
+
+	ret = mmc_test_packed_write(test, e, ARRAY_SIZE(e));
+	if (ret)
+		return ret;
+
+	return mmc_test_packed_check(test, e, ARRAY_SIZE(e));
+}
+
+/*
+ * The third entry addresses the first sector past the end of the card.
+ * The card must report a packed failure with that entry's index, and
+ * must have written the entries before it.  The remainder is then sent
+ * again as a packed write with the failed entry moved into range, which
+ * is what the block driver does on a failure index (minus the move).
+ */
+static int mmc_test_packed_write_fail(struct mmc_test_card *test)
+{
+	struct mmc_test_packed_entry e[] = {
+		{ 0, 2 }, { 4, 2 }, { 0, 1 }, { 8, 2 },
+	};
+	const unsigned int bad = 2;
+	unsigned int idx, i, j;
+	u32 status;
+	u8 *ext_csd;
+	int ret;
+
+	ret = mmc_test_packed_supported(test, ARRAY_SIZE(e));
+	if (ret)
+		return ret;
+
+	e[bad].addr = mmc_test_capacity(test->card);
+
+	/* the transfer itself may or may not see an error */
+	mmc_test_packed_write(test, e, ARRAY_SIZE(e));
+
+	ret = mmc_test_packed_send_status(test, &status);
+	if (ret)
+		return ret;
+	if (!(status & R1_EXCEPTION_EVENT)) {
+		printk(KERN_INFO "%s: no exception event, status %#x\n",
+		       mmc_hostname(test->card->host), status);
+		return RESULT_FAIL;
+	}
+
+	ext_csd = kmalloc(512, GFP_KERNEL);
+	if (!ext_csd)
+		return -ENOMEM;
+
+	ret = mmc_send_ext_csd(test->card, ext_csd);
+	if (ret)
+		goto out;
+
+	if (!(ext_csd[EXT_CSD_EXP_EVENTS_STATUS] & EXT_CSD_PACKED_FAILURE) ||
+	    !(ext_csd[EXT_CSD_PACKED_CMD_STATUS] &
+	      EXT_CSD_PACKED_INDEXED_ERROR) ||
+	    ext_csd[EXT_CSD_PACKED_FAILURE_INDEX] != bad + 1) {
+		printk(KERN_INFO "%s: events %#x, packed status %#x, "
+		       "failure index %u, expected %u\n",
+		       mmc_hostname(test->card->host),
+		       ext_csd[EXT_CSD_EXP_EVENTS_STATUS],
+		       ext_csd[EXT_CSD_PACKED_CMD_STATUS],
+		       ext_csd[EXT_CSD_PACKED_FAILURE_INDEX], bad + 1);
+		ret = RESULT_FAIL;
+		goto out;
+	}
+	idx = ext_csd[EXT_CSD_PACKED_FAILURE_INDEX] - 1;
+
+	/*
+	 * The entries before the failed one must be done.  Those after it
+	 * may or may not have been written.
+	 */
+	for (i = 0; i < idx; i++) {
+		for (j = 0; j < e[i].blocks; j++) {
+			ret = mmc_test_packed_check_sector(test,
+							   e[i].addr + j, 1);
+			if (ret)
+				goto out;
+		}
+	}
+
+	e[bad].addr = 12;
+	ret = mmc_test_packed_write(test, e + idx, ARRAY_SIZE(e) - idx);
+	if (ret)
+		goto out;
+
+	ret = mmc_test_packed_check(test, e, ARRAY_SIZE(e));
+out:
+	kfree(ext_csd);
+	return ret;
+}
+
 static const struct mmc_test_case mmc_test_cases[] = {
 	{
 		.name = "Basic write (no data verification)",
@@ -2740,6 +3003,20 @@ static const struct mmc_test_case mmc_test_cases[] = {
 		.run = mmc_test_profile_sglen_r_nonblock_perf,
 		.cleanup = mmc_test_area_cleanup,
 	},
+
+	{
+		.name = "Packed write",
+		.prepare = mmc_test_prepare_write,
+		.run = mmc_test_packed_write_basic,
+		.cleanup = mmc_test_cleanup,
+	},
+
+	{
+		.name = "Packed write failure and retry",
+		.prepare = mmc_test_prepare_write,
+		.run = mmc_test_packed_write_fail,
+		.cleanup = mmc_test_cleanup,
+	},
 };
 
 static DEFINE_MUTEX(mmc_test_lock);
@@ -12,6 +12,7 @@
 #include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/stat.h>
+#include <linux/uaccess.h>
 
 #include <linux/mmc/card.h>
 #include <linux/mmc/host.h>
@@ -284,6 +285,118 @@ static const struct file_operations mmc_dbg_ext_csd_fops = {
 	.llseek		= default_llseek,
 };
 
+#define WR_PACK_STATS_STR_LEN	4096
+
+static const char * const mmc_pack_stop_reason_names[MAX_REASONS] = {
+	[EXCEEDS_SEGMENTS]	= "exceeds max segments",
+	[EXCEEDS_SECTORS]	= "exceeds max sectors",
+	[WRONG_DATA_DIR]	= "wrong data direction",
+	[FLUSH_OR_DISCARD]	= "flush or discard",
+	[EMPTY_QUEUE]		= "empty queue",
+	[REL_WRITE]		= "reliable write",
+	[THRESHOLD]		= "threshold reached",
+};
+
+static int mmc_wr_pack_stats_open(struct inode *inode, struct file *filp)
+{
+	struct mmc_card *card = inode->i_private;
+	struct mmc_wr_pack_stats *stats = &card->wr_pack_stats;
+	char *buf;
+	ssize_t n = 0;
+	int i;
+
+	buf = kmalloc(WR_PACK_STATS_STR_LEN, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	spin_lock(&stats->lock);
+
+	n += scnprintf(buf + n, WR_PACK_STATS_STR_LEN - n,
+		       "write packing statistics %s\n",
+		       stats->enabled ? "enabled" : "disabled");
+
+	for (i = 2; i <= MMC_PACKED_NR_MAX; i++)
+		if (stats->packing_events[i])
+			n += scnprintf(buf + n, WR_PACK_STATS_STR_LEN - n,
+				       "packed %d requests: %u times\n",
+				       i, stats->packing_events[i]);
+
+	for (i = 0; i < MAX_REASONS; i++)
+		n += scnprintf(buf + n, WR_PACK_STATS_STR_LEN - n,
+			       "stopped packing (%s): %u times\n",
+			       mmc_pack_stop_reason_names[i],
+			       stats->pack_stop_reason[i]);
+
+	n += scnprintf(buf + n, WR_PACK_STATS_STR_LEN - n,
+		       "packed failures reported by card: %u\n"
+		       "packed groups reissued unpacked: %u\n",
+		       stats->packed_failures, stats->unpacked_fallbacks);
+
+	spin_unlock(&stats->lock);
+
+	filp->private_data = buf;
+	return 0;
+}
+
+static ssize_t mmc_wr_pack_stats_read(struct file *filp, char __user *ubuf,
+				      size_t cnt, loff_t *ppos)
+{
+	char *buf = filp->private_data;
+
+	return simple_read_from_buffer(ubuf, cnt, ppos, buf, strlen(buf));
+}
+
+/*
+ * Writing a non-zero value clears the counters and starts collecting,
+ * writing 0 stops collecting.
+ */
+static ssize_t mmc_wr_pack_stats_write(struct file *filp,
+				       const char __user *ubuf, size_t cnt,
+				       loff_t *ppos)
+{
+	struct mmc_card *card = filp->f_path.dentry->d_inode->i_private;
+	struct mmc_wr_pack_stats *stats = &card->wr_pack_stats;
+	unsigned long value;
+	char kbuf[8];
+
+	if (cnt >= sizeof(kbuf))
+		return -EINVAL;
+	if (copy_from_user(kbuf, ubuf, cnt))
+		return -EFAULT;
+	kbuf[cnt] = '\0';
+
+	if (strict_strtoul(strstrip(kbuf), 0, &value))
+		return -EINVAL;
+
+	spin_lock(&stats->lock);
+	if (value) {
+		memset(stats->packing_events, 0,
+		       sizeof(stats->packing_events));
+		memset(stats->pack_stop_reason, 0,
+		       sizeof(stats->pack_stop_reason));
+		stats->packed_failures = 0;
+		stats->unpacked_fallbacks = 0;
+	}
+	stats->enabled = !!value;
+	spin_unlock(&stats->lock);
+
+	return cnt;
+}
+
+static int mmc_wr_pack_stats_release(struct inode *inode, struct file *file)
+{
+	kfree(file->private_data);
+	return 0;
+}
+
+static const struct file_operations mmc_dbg_wr_pack_stats_fops = {
+	.open		= mmc_wr_pack_stats_open,
+	.read		= mmc_wr_pack_stats_read,
+	.write		= mmc_wr_pack_stats_write,
+	.release	= mmc_wr_pack_stats_release,
+	.llseek		= default_llseek,
+};
+
 void mmc_add_card_debugfs(struct mmc_card *card)
 {
 	struct mmc_host	*host = card->host;
@@ -316,6 +429,12 @@ void mmc_add_card_debugfs(struct mmc_card *card)
 					&mmc_dbg_ext_csd_fops))
 			goto err;
 
+	if (mmc_card_mmc(card) && (host->caps2 & MMC_CAP2_PACKED_WR))
+		if (!debugfs_create_file("wr_pack_stats", S_IRUSR | S_IWUSR,
+					 root, card,
+					 &mmc_dbg_wr_pack_stats_fops))
+			goto err;
+
 	return;
 
 err:
@@ -1214,6 +1214,13 @@ static int __devinit sdhci_tegra_probe(struct platform_device *pdev)
 #ifdef CONFIG_MMC_BKOPS
 	host->mmc->caps |= MMC_CAP_BKOPS;
 #endif
+#ifdef CONFIG_MMC_PACKED_CMD
+	/* Packed commands are framed by a CMD23 carrying the packed bit */
+	if (plat->mmc_data.built_in) {
+		host->mmc->caps |= MMC_CAP_CMD23;
+		host->mmc->caps2 |= MMC_CAP2_PACKED_WR;
+	}
+#endif
 
 	tegra_sdhost_min_freq = TEGRA_SDHOST_MIN_FREQ;
 #ifdef CONFIG_ARCH_TEGRA_2x_SOC
@@ -1147,6 +1147,12 @@ static struct regulator *create_regulator(struct regulator_dev *rdev,
 				  dev->kobj.name, err);
 			goto link_name_err;
 		}
+
+		/* resume the consumer after, and suspend it before, us */
+		err = device_pm_add_supplier(dev, &rdev->dev);
+		if (err)
+			rdev_dbg(rdev, "no PM dependency for %s err %d\n",
+				 dev->kobj.name, err);
 	} else {
 		regulator->supply_name = kstrdup(supply_name, GFP_KERNEL);
 		if (regulator->supply_name == NULL)
@@ -1353,6 +1359,7 @@ void regulator_put(struct regulator *regulator)
 
 	/* remove any sysfs entries */
 	if (regulator->dev) {
+		device_pm_remove_supplier(regulator->dev, &rdev->dev);
 		sysfs_remove_link(&rdev->dev.kobj, regulator->supply_name);
 		device_remove_file(regulator->dev, &regulator->dev_attr);
 		kfree(regulator->dev_attr.attr.name);
@@ -2692,6 +2699,8 @@ struct regulator_dev *regulator_register(struct regulator_desc *regulator_desc,
 	rdev->dev.parent = dev;
 	dev_set_name(&rdev->dev, "regulator.%d",
 		     atomic_inc_return(&regulator_no) - 1);
+	/* consumers wait for us through their PM dependencies */
+	device_enable_async_suspend(&rdev->dev);
 	ret = device_register(&rdev->dev);
 	if (ret != 0) {
 		put_device(&rdev->dev);
@@ -573,6 +573,9 @@ static int rndis_init_response(int configNr, rndis_init_msg_type *buf)
 	if (!params->dev)
 		return -ENOTSUPP;
 
+	/* the largest transfer the host will take from us */
+	params->dl_max_xfer_size = le32_to_cpu(buf->MaxTransferSize);
+
 	r = rndis_add_response(configNr, sizeof(rndis_init_cmplt_type));
 	if (!r)
 		return -ENOMEM;
@@ -586,12 +589,14 @@ static int rndis_init_response(int configNr, rndis_init_msg_type *buf)
 	resp->MinorVersion = cpu_to_le32(RNDIS_MINOR_VERSION);
 	resp->DeviceFlags = cpu_to_le32(RNDIS_DF_CONNECTIONLESS);
 	resp->Medium = cpu_to_le32(RNDIS_MEDIUM_802_3);
-	resp->MaxPacketsPerTransfer = cpu_to_le32(1);
+	resp->MaxPacketsPerTransfer = cpu_to_le32(
+		max_t(u32, params->ul_max_pkts_per_xfer, 1));
 	resp->MaxTransferSize = cpu_to_le32(
-		  params->dev->mtu
+		max_t(u32, params->ul_max_pkts_per_xfer, 1) *
+		(params->dev->mtu
 		+ sizeof(struct ethhdr)
 		+ sizeof(struct rndis_packet_msg_type)
-		+ 22);
+		+ 22));
 	resp->PacketAlignmentFactor = cpu_to_le32(0);
 	resp->AFListOffset = cpu_to_le32(0);
 	resp->AFListSize = cpu_to_le32(0);
@@ -780,6 +785,7 @@ void rndis_uninit(int configNr)
 	if (configNr >= RNDIS_MAX_CONFIGS)
 		return;
 	rndis_per_dev_params[configNr].state = RNDIS_UNINITIALIZED;
+	rndis_per_dev_params[configNr].dl_max_xfer_size = 0;
 
 	/* drain the response queue */
 	while ((buf = rndis_get_next_response(configNr, &length)))
@@ -956,6 +962,25 @@ int rndis_set_param_medium(u8 configNr, u32 medium, u32 speed)
 	return 0;
 }
 
+/* how many packets the host may put in one transfer to us */
+int rndis_set_max_pkt_xfer(u8 configNr, u32 max_pkt_per_xfer)
+{
+	pr_debug("%s: %u\n", __func__, max_pkt_per_xfer);
+	if (configNr >= RNDIS_MAX_CONFIGS) return -1;
+
+	rndis_per_dev_params[configNr].ul_max_pkts_per_xfer = max_pkt_per_xfer;
+
+	return 0;
+}
+
+/* the host's limit for transfers to it, 0 until it initialized us */
+u32 rndis_get_dl_max_xfer_size(u8 configNr)
+{
+	if (configNr >= RNDIS_MAX_CONFIGS) return 0;
+
+	return rndis_per_dev_params[configNr].dl_max_xfer_size;
+}
+
 void rndis_add_hdr(struct sk_buff *skb)
 {
 	struct rndis_packet_msg_type *header;
@@ -1024,30 +1049,64 @@ static rndis_resp_t *rndis_add_response(int configNr, u32 length)
 	return r;
 }
 
+/*
+ * A transfer may carry several packet messages when the host aggregates
+ * (see MaxPacketsPerTransfer).  All but the last are split off as clones
+ * sharing the transfer buffer; anything after the last message that is
+ * not another packet message is padding.
+ */
 int rndis_rm_hdr(struct gether *port,
 			struct sk_buff *skb,
 			struct sk_buff_head *list)
 {
-	/* tmp points to a struct rndis_packet_msg_type */
-	__le32 *tmp = (void *)skb->data;
+	for (;;) {
+		/* tmp points to a struct rndis_packet_msg_type */
+		__le32 *tmp = (void *)skb->data;
+		struct sk_buff *skb2;
+		u32 msg_len, data_offset, data_len;
+
+		/* MessageType, MessageLength */
+		if (skb->len < 16 || cpu_to_le32(REMOTE_NDIS_PACKET_MSG)
+				!= get_unaligned(tmp++)) {
+			dev_kfree_skb_any(skb);
+			return -EINVAL;
+		}
+		msg_len = get_unaligned_le32(tmp++);
+
+		/* DataOffset, DataLength */
+		data_offset = get_unaligned_le32(tmp++) + 8;
+		data_len = get_unaligned_le32(tmp++);
+
+		if (msg_len < skb->len - 16 && msg_len >= 16
+				&& cpu_to_le32(REMOTE_NDIS_PACKET_MSG)
+				== get_unaligned((__le32 *)(skb->data + msg_len))) {
+			if (data_offset > msg_len
+					|| data_len > msg_len - data_offset) {
+				dev_kfree_skb_any(skb);
+				return -EOVERFLOW;
+			}
+			skb2 = skb_clone(skb, GFP_ATOMIC);
+			if (!skb2) {
+				dev_kfree_skb_any(skb);
+				return -ENOMEM;
+			}
+			skb_pull(skb2, data_offset);
+			skb_trim(skb2, data_len);
+			skb_queue_tail(list, skb2);
 
-	/* MessageType, MessageLength */
-	if (cpu_to_le32(REMOTE_NDIS_PACKET_MSG)
-			!= get_unaligned(tmp++)) {
-		dev_kfree_skb_any(skb);
-		return -EINVAL;
-	}
-	tmp++;
+			skb_pull(skb, msg_len);
+			continue;
+		}
 
-	/* DataOffset, DataLength */
-	if (!skb_pull(skb, get_unaligned_le32(tmp++) + 8)) {
-		dev_kfree_skb_any(skb);
-		return -EOVERFLOW;
-	}
-	skb_trim(skb, get_unaligned_le32(tmp++));
+		if (!skb_pull(skb, data_offset)) {
+			dev_kfree_skb_any(skb);
+			return -EOVERFLOW;
+		}
+		skb_trim(skb, data_len);
 
-	skb_queue_tail(list, skb);
-	return 0;
+		skb_queue_tail(list, skb);
+		return 0;
+	}
 }
 
 #ifdef CONFIG_USB_GADGET_DEBUG_FILES
@@ -24,10 +24,12 @@
 
 #include <linux/kernel.h>
 #include <linux/gfp.h>
+#include <linux/slab.h>
 #include <linux/device.h>
 #include <linux/ctype.h>
 #include <linux/etherdevice.h>
 #include <linux/ethtool.h>
+#include <linux/if_vlan.h>
 
 #include "u_ether.h"
 
@@ -51,6 +53,12 @@
  * responsible for ensuring that each configuration includes at most one
  * instance of is network link.  (The network layer provides ways for
  * this single "physical" link to be used by multiple virtual links.)
+ *
+ * Received frames are queued by the USB completion handler and handed to
+ * the stack from a NAPI poll, so GRO can merge them.  Functions whose
+ * framing allows several packets per transfer (RNDIS) can have transmit
+ * frames copied back to back into preallocated request buffers instead
+ * of sending one skb per USB request.
  */
 
 #define UETH__VERSION	"29-May-2008"
@@ -70,6 +78,14 @@ struct eth_dev {
 	atomic_t		tx_qlen;
 
 	struct sk_buff_head	rx_frames;
+	struct napi_struct	napi;
+	unsigned		ul_max_pkts;
+
+	/* multi-packet transmit, guarded by req_lock */
+	unsigned		tx_buf_size;	/* 0: one skb per request */
+	struct usb_request	*tx_agg_req;	/* being filled, not queued */
+	unsigned		tx_agg_pkts;
+	unsigned		tx_inflight;
 
 	unsigned		header_len;
 	struct sk_buff		*(*wrap)(struct gether *, struct sk_buff *skb);
@@ -92,6 +108,8 @@ struct eth_dev {
 
 #define DEFAULT_QLEN	2	/* double buffering by default */
 
+#define NAPI_WEIGHT	64
+
 
 #ifdef CONFIG_USB_GADGET_DUALSPEED
 
@@ -238,6 +256,8 @@ rx_submit(struct eth_dev *dev, struct usb_request *req, gfp_t gfp_flags)
 	 */
 	size += sizeof(struct ethhdr) + dev->net->mtu + RX_EXTRA;
 	size += dev->port_usb->header_len;
+	if (dev->ul_max_pkts > 1)
+		size *= dev->ul_max_pkts;
 	size += out->maxpacket - 1;
 	size -= size % out->maxpacket;
 
@@ -278,7 +298,7 @@ enomem:
 
 static void rx_complete(struct usb_ep *ep, struct usb_request *req)
 {
-	struct sk_buff	*skb = req->context, *skb2;
+	struct sk_buff	*skb = req->context;
 	struct eth_dev	*dev = ep->driver_data;
 	int		status = req->status;
 
@@ -301,33 +321,18 @@ static void rx_complete(struct usb_ep *ep, struct usb_request *req)
 				status = -ENOTCONN;
 			}
 			spin_unlock_irqrestore(&dev->lock, flags);
+			if (status < 0) {
+				dev->net->stats.rx_errors++;
+				dev->net->stats.rx_length_errors++;
+				DBG(dev, "rx unwrap %d\n", status);
+			}
 		} else {
 			skb_queue_tail(&dev->rx_frames, skb);
 		}
 		skb = NULL;
 
-		skb2 = skb_dequeue(&dev->rx_frames);
-		while (skb2) {
-			if (status < 0
-					|| ETH_HLEN > skb2->len
-					|| skb2->len > ETH_FRAME_LEN) {
-				dev->net->stats.rx_errors++;
-				dev->net->stats.rx_length_errors++;
-				DBG(dev, "rx length %d\n", skb2->len);
-				dev_kfree_skb_any(skb2);
-				goto next_frame;
-			}
-			skb2->protocol = eth_type_trans(skb2, dev->net);
-			dev->net->stats.rx_packets++;
-			dev->net->stats.rx_bytes += skb2->len;
-
-			/* no buffer copies needed, unless hardware can't
-			 * use skb buffers.
-			 */
-			status = netif_rx(skb2);
-next_frame:
-			skb2 = skb_dequeue(&dev->rx_frames);
-		}
+		/* eth_poll() hands the frames to the stack */
+		napi_schedule(&dev->napi);
 		break;
 
 	/* software-driven interface shutdown */
@@ -368,6 +373,65 @@ clean:
 		rx_submit(dev, req, GFP_ATOMIC);
 }
 
+/*
+ * Copy a received frame into an skb of its own size, summing the payload
+ * on the way.  The checksum comes for free with the copy and lets TCP GRO
+ * merge the frames, which it never does for CHECKSUM_NONE.  The copy also
+ * keeps frames unwrapped from a multi-packet transfer from each pinning
+ * the whole rx buffer.  If no skb can be had, the frame goes up as is.
+ */
+static struct sk_buff *eth_copy_csum(struct eth_dev *dev, struct sk_buff *skb)
+{
+	struct sk_buff	*skb2;
+	int		len = skb->len - ETH_HLEN;
+
+	skb2 = netdev_alloc_skb_ip_align(dev->net, skb->len);
+	if (!skb2)
+		return skb;
+
+	memcpy(skb_put(skb2, ETH_HLEN), skb->data, ETH_HLEN);
+	/* eth_type_trans() pulls the header without adjusting skb->csum */
+	skb2->csum = csum_partial_copy_nocheck(skb->data + ETH_HLEN,
+			skb_put(skb2, len), len, 0);
+	skb2->ip_summed = CHECKSUM_COMPLETE;
+
+	dev_kfree_skb(skb);
+	return skb2;
+}
+
+static int eth_poll(struct napi_struct *napi, int budget)
+{
+	struct eth_dev	*dev = container_of(napi, struct eth_dev, napi);
+	struct sk_buff	*skb;
+	int		work = 0;
+
+	while (work < budget && (skb = skb_dequeue(&dev->rx_frames))) {
+		work++;
+
+		if (ETH_HLEN > skb->len || skb->len > ETH_FRAME_LEN) {
+			dev->net->stats.rx_errors++;
+			dev->net->stats.rx_length_errors++;
+			DBG(dev, "rx length %d\n", skb->len);
+			dev_kfree_skb(skb);
+			continue;
+		}
+		skb = eth_copy_csum(dev, skb);
+		skb->protocol = eth_type_trans(skb, dev->net);
+		dev->net->stats.rx_packets++;
+		dev->net->stats.rx_bytes += skb->len;
+
+		napi_gro_receive(napi, skb);
+	}
+
+	if (work < budget) {
+		napi_complete(napi);
+		/* rx_complete() may have queued more after the last dequeue */
+		if (!skb_queue_empty(&dev->rx_frames))
+			napi_schedule(napi);
+	}
+	return work;
+}
+
 static int prealloc(struct list_head *list, struct usb_ep *ep, unsigned n)
 {
 	unsigned		i;
@@ -426,6 +490,40 @@ done:
 	return status;
 }
 
+/* preallocate request buffers for multi-packet transmit */
+static void alloc_tx_buffers(struct eth_dev *dev, struct gether *link)
+{
+	struct usb_request	*req;
+	unsigned		size;
+
+	size = link->dl_max_pkts_per_xfer *
+		(dev->net->mtu + VLAN_ETH_HLEN + link->header_len);
+
+	spin_lock(&dev->req_lock);
+	list_for_each_entry(req, &dev->tx_reqs, list)
+		req->buf = NULL;
+	list_for_each_entry(req, &dev->tx_reqs, list) {
+		/* one spare byte for the zlp workaround in tx_agg_queue() */
+		req->buf = kmalloc(size + 1, GFP_ATOMIC);
+		if (!req->buf)
+			goto fail;
+	}
+	dev->tx_buf_size = size;
+	dev->tx_agg_req = NULL;
+	dev->tx_agg_pkts = 0;
+	dev->tx_inflight = 0;
+	spin_unlock(&dev->req_lock);
+	return;
+
+fail:
+	list_for_each_entry(req, &dev->tx_reqs, list) {
+		kfree(req->buf);
+		req->buf = NULL;
+	}
+	spin_unlock(&dev->req_lock);
+	DBG(dev, "no tx buffers, one packet per transfer\n");
+}
+
 static void rx_fill(struct eth_dev *dev, gfp_t gfp_flags)
 {
 	struct usb_request	*req;
@@ -462,10 +560,45 @@ static void eth_work(struct work_struct *work)
 		DBG(dev, "work done, flags = 0x%lx\n", dev->todo);
 }
 
+static void tx_complete(struct usb_ep *ep, struct usb_request *req);
+
+/* queue a filled multi-packet request; called without req_lock */
+static void tx_agg_queue(struct eth_dev *dev, struct usb_ep *in,
+		struct usb_request *req)
+{
+	unsigned long	flags;
+	int		retval;
+
+	req->context = NULL;
+	req->complete = tx_complete;
+	req->zero = 1;
+	if (!dev->zlp && (req->length % in->maxpacket) == 0)
+		req->length++;
+	/* completions flush the request being filled, never skip them */
+	req->no_interrupt = 0;
+
+	retval = usb_ep_queue(in, req, GFP_ATOMIC);
+	if (!retval) {
+		dev->net->trans_start = jiffies;
+		atomic_inc(&dev->tx_qlen);
+		return;
+	}
+
+	DBG(dev, "tx queue err %d\n", retval);
+	dev->net->stats.tx_dropped++;
+	spin_lock_irqsave(&dev->req_lock, flags);
+	dev->tx_inflight--;
+	list_add(&req->list, &dev->tx_reqs);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+	if (netif_carrier_ok(dev->net))
+		netif_wake_queue(dev->net);
+}
+
 static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 {
-	struct sk_buff	*skb = req->context;
-	struct eth_dev	*dev = ep->driver_data;
+	struct sk_buff		*skb = req->context;
+	struct eth_dev		*dev = ep->driver_data;
+	struct usb_request	*held = NULL;
 
 	switch (req->status) {
 	default:
@@ -476,14 +609,30 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 	case -ESHUTDOWN:		/* disconnect etc */
 		break;
 	case 0:
-		dev->net->stats.tx_bytes += skb->len;
+		/* multi-packet requests count packets when filled */
+		dev->net->stats.tx_bytes += skb ? skb->len : req->actual;
 	}
-	dev->net->stats.tx_packets++;
 
 	spin_lock(&dev->req_lock);
 	list_add(&req->list, &dev->tx_reqs);
+	if (!skb) {
+		/* the endpoint drained: send what was collected meanwhile */
+		dev->tx_inflight--;
+		if (dev->tx_agg_req && req->status != -ECONNRESET
+				&& req->status != -ESHUTDOWN) {
+			held = dev->tx_agg_req;
+			dev->tx_agg_req = NULL;
+			dev->tx_inflight++;
+		}
+	}
 	spin_unlock(&dev->req_lock);
-	dev_kfree_skb_any(skb);
+
+	if (skb) {
+		dev->net->stats.tx_packets++;
+		dev_kfree_skb_any(skb);
+	}
+	if (held)
+		tx_agg_queue(dev, ep, held);
 
 	atomic_dec(&dev->tx_qlen);
 	if (netif_carrier_ok(dev->net))
@@ -495,6 +644,88 @@ static inline int is_promisc(u16 cdc_filter)
 	return cdc_filter & USB_CDC_PACKET_TYPE_PROMISCUOUS;
 }
 
+/*
+ * Multi-packet transmit: wrapped frames are copied back to back into the
+ * buffer of one request.  While earlier transfers are still in flight the
+ * request is held back to collect more frames, and tx_complete() queues
+ * it once the endpoint drains; an idle link sends every frame right away.
+ */
+static netdev_tx_t eth_xmit_agg(struct eth_dev *dev, struct sk_buff *skb,
+		struct usb_ep *in)
+{
+	struct net_device	*net = dev->net;
+	struct usb_request	*req;
+	struct usb_request	*flush = NULL;
+	unsigned long		flags;
+	unsigned		limit = 0, max_pkts = 0, frame_max;
+
+	/* a frame always fits the request being filled (see below), so
+	 * only an empty freelist can make us busy; check before wrapping,
+	 * the stack hands busy skbs back unchanged.
+	 */
+	spin_lock_irqsave(&dev->req_lock, flags);
+	if (!dev->tx_agg_req && list_empty(&dev->tx_reqs)) {
+		spin_unlock_irqrestore(&dev->req_lock, flags);
+		return NETDEV_TX_BUSY;
+	}
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	spin_lock_irqsave(&dev->lock, flags);
+	if (dev->port_usb) {
+		limit = min(dev->tx_buf_size, dev->port_usb->dl_max_xfer_size);
+		max_pkts = dev->port_usb->dl_max_pkts_per_xfer;
+		if (dev->wrap)
+			skb = dev->wrap(dev->port_usb, skb);
+	} else {
+		dev_kfree_skb_any(skb);
+		skb = NULL;
+	}
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	frame_max = net->mtu + VLAN_ETH_HLEN + dev->header_len;
+	if (!skb || skb->len > frame_max) {
+		if (skb)
+			dev_kfree_skb_any(skb);
+		net->stats.tx_dropped++;
+		return NETDEV_TX_OK;
+	}
+
+	spin_lock_irqsave(&dev->req_lock, flags);
+	req = dev->tx_agg_req;
+	if (!req) {
+		/* tx_complete() only empties tx_agg_req after returning
+		 * its own request, so the freelist still has one
+		 */
+		req = container_of(dev->tx_reqs.next, struct usb_request, list);
+		list_del(&req->list);
+		req->length = 0;
+		dev->tx_agg_req = req;
+		dev->tx_agg_pkts = 0;
+	}
+
+	memcpy(req->buf + req->length, skb->data, skb->len);
+	req->length += skb->len;
+	dev->tx_agg_pkts++;
+	net->stats.tx_packets++;
+
+	if (dev->tx_agg_pkts >= max_pkts || req->length + frame_max > limit
+			|| !dev->tx_inflight) {
+		dev->tx_agg_req = NULL;
+		dev->tx_inflight++;
+		flush = req;
+	}
+
+	/* temporarily stop TX queue when nothing is left to fill */
+	if (!dev->tx_agg_req && list_empty(&dev->tx_reqs))
+		netif_stop_queue(net);
+	spin_unlock_irqrestore(&dev->req_lock, flags);
+
+	dev_kfree_skb_any(skb);
+	if (flush)
+		tx_agg_queue(dev, in, flush);
+	return NETDEV_TX_OK;
+}
+
 static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 					struct net_device *net)
 {
@@ -544,6 +775,9 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		/* ignores USB_CDC_PACKET_TYPE_DIRECTED */
 	}
 
+	if (dev->tx_buf_size)
+		return eth_xmit_agg(dev, skb, in);
+
 	spin_lock_irqsave(&dev->req_lock, flags);
 	/*
 	 * this freelist can be empty if an interrupt triggered disconnect()
@@ -658,6 +892,7 @@ static int eth_open(struct net_device *net)
 	struct gether	*link;
 
 	DBG(dev, "%s\n", __func__);
+	napi_enable(&dev->napi);
 	if (netif_carrier_ok(dev->net))
 		eth_start(dev, GFP_KERNEL);
 
@@ -710,6 +945,9 @@ static int eth_stop(struct net_device *net)
 	}
 	spin_unlock_irqrestore(&dev->lock, flags);
 
+	napi_disable(&dev->napi);
+	skb_queue_purge(&dev->rx_frames);
+
 	return 0;
 }
 
@@ -815,6 +1053,7 @@ int gether_setup_name(struct usb_gadget *g, u8 ethaddr[ETH_ALEN],
 	INIT_LIST_HEAD(&dev->rx_reqs);
 
 	skb_queue_head_init(&dev->rx_frames);
+	netif_napi_add(net, &dev->napi, eth_poll, NAPI_WEIGHT);
 
 	/* network device setup */
 	dev->net = net;
@@ -871,6 +1110,7 @@ void gether_cleanup(void)
 
 	unregister_netdev(the_dev->net);
 	flush_work_sync(&the_dev->work);
+	skb_queue_purge(&the_dev->rx_frames);
 	free_netdev(the_dev->net);
 
 	the_dev = NULL;
@@ -924,6 +1164,9 @@ struct net_device *gether_connect(struct gether *link)
 		dev->zlp = link->is_zlp_ok;
 		DBG(dev, "qlen %d\n", qlen(dev->gadget));
 
+		if (link->dl_max_pkts_per_xfer > 1)
+			alloc_tx_buffers(dev, link);
+		dev->ul_max_pkts = link->ul_max_pkts_per_xfer;
 		dev->header_len = link->header_len;
 		dev->unwrap = link->unwrap;
 		dev->wrap = link->wrap;
@@ -988,15 +1231,22 @@ void gether_disconnect(struct gether *link)
 	 */
 	usb_ep_disable(link->in_ep);
 	spin_lock(&dev->req_lock);
+	if (dev->tx_agg_req) {
+		list_add(&dev->tx_agg_req->list, &dev->tx_reqs);
+		dev->tx_agg_req = NULL;
+	}
 	while (!list_empty(&dev->tx_reqs)) {
 		req = container_of(dev->tx_reqs.next,
 					struct usb_request, list);
 		list_del(&req->list);
 
 		spin_unlock(&dev->req_lock);
+		if (dev->tx_buf_size)
+			kfree(req->buf);
 		usb_ep_free_request(link->in_ep, req);
 		spin_lock(&dev->req_lock);
 	}
+	dev->tx_buf_size = 0;
 	spin_unlock(&dev->req_lock);
 	link->in_ep->driver_data = NULL;
 	link->in_ep->desc = NULL;
@@ -1017,6 +1267,7 @@ void gether_disconnect(struct gether *link)
 	link->out_ep->desc = NULL;
 
 	/* finish forgetting about this USB link episode */
+	dev->ul_max_pkts = 0;
 	dev->header_len = 0;
 	dev->unwrap = NULL;
 	dev->wrap = NULL;
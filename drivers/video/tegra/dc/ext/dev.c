@@ -23,6 +23,7 @@
 #include <linux/uaccess.h>
 #include <linux/slab.h>
 #include <linux/workqueue.h>
+#include <linux/input_boost.h>
 
 #include <video/tegra_dc_ext.h>
 
@@ -408,6 +409,7 @@ static void tegra_dc_ext_flip_worker(struct work_struct *work)
 		tegra_dc_update_windows(wins, nr_win);
 		/* TODO: implement swapinterval here */
 		tegra_dc_sync_windows(wins, nr_win);
+		input_boost_frame_done();
 		if (!tegra_dc_has_multiple_dc()) {
 			spin_lock(&flip_callback_lock);
 			if (flip_callback)
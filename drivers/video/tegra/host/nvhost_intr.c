@@ -33,8 +33,10 @@
 
 struct nvhost_waitlist {
 	struct list_head list;
+	struct rb_node node;
 	struct kref refcount;
 	u32 thresh;
+	u32 seq;
 	enum nvhost_intr_action action;
 	atomic_t state;
 	void *data;
@@ -53,74 +55,141 @@ static void waiter_release(struct kref *kref)
 	kfree(container_of(kref, struct nvhost_waitlist, refcount));
 }
 
+/*
+ * Waiters are kept in an rbtree per sync point, with the earliest one
+ * cached, so adding one and removing the earliest are both O(log n)
+ * however many jobs are in flight.  The tree node is part of the
+ * waiter, which the caller allocates before submitting, so queueing a
+ * waiter never needs memory.  Thresholds compare with wrapping
+ * arithmetic, as sync point values do; waiters with equal thresholds
+ * keep their arrival order.
+ */
+static inline bool waiter_before(struct nvhost_waitlist *a,
+				 struct nvhost_waitlist *b)
+{
+	s32 diff = (s32)(a->thresh - b->thresh);
+
+	if (diff)
+		return diff < 0;
+	return (s32)(a->seq - b->seq) < 0;
+}
+
+/**
+ * remove a waiter from its sync point's tree
+ */
+static void remove_waiter_from_tree(struct nvhost_intr_syncpt *syncpt,
+				    struct nvhost_waitlist *waiter)
+{
+	if (syncpt->wait_first == waiter) {
+		struct rb_node *next = rb_next(&waiter->node);
+
+		syncpt->wait_first = next ?
+			rb_entry(next, struct nvhost_waitlist, node) : NULL;
+	}
+	rb_erase(&waiter->node, &syncpt->wait_tree);
+	syncpt->wait_len--;
+}
+
+static inline struct nvhost_waitlist *first_waiter(
+		struct nvhost_intr_syncpt *syncpt)
+{
+	return syncpt->wait_first;
+}
+
 /**
- * add a waiter to a waiter queue, sorted by threshold
- * returns true if it was added at the head of the queue
+ * add a waiter to a sync point's tree, ordered by threshold
+ * returns true if it became the earliest waiter
  */
 static bool add_waiter_to_queue(struct nvhost_waitlist *waiter,
-				struct list_head *queue)
+				struct nvhost_intr_syncpt *syncpt)
 {
-	struct nvhost_waitlist *pos;
-	u32 thresh = waiter->thresh;
+	struct rb_node **link = &syncpt->wait_tree.rb_node;
+	struct rb_node *parent = NULL;
+	bool first = true;
 
-	list_for_each_entry_reverse(pos, queue, list)
-		if ((s32)(pos->thresh - thresh) <= 0) {
-			list_add(&waiter->list, &pos->list);
-			return false;
+	waiter->seq = syncpt->wait_seq++;
+
+	while (*link) {
+		parent = *link;
+		if (waiter_before(waiter, rb_entry(parent,
+				struct nvhost_waitlist, node))) {
+			link = &parent->rb_left;
+		} else {
+			link = &parent->rb_right;
+			first = false;
 		}
+	}
+
+	rb_link_node(&waiter->node, parent, link);
+	rb_insert_color(&waiter->node, &syncpt->wait_tree);
+	syncpt->wait_len++;
+
+	if (first)
+		syncpt->wait_first = waiter;
+
+	return first;
+}
+
+/**
+ * find an earlier submit complete for the same channel in a batch,
+ * so the channel only gets updated once
+ */
+static struct nvhost_waitlist *find_submit_complete(struct list_head *dest,
+						    void *data)
+{
+	struct nvhost_waitlist *prev;
 
-	list_add(&waiter->list, queue);
-	return true;
+	list_for_each_entry_reverse(prev, dest, list)
+		if (prev->data == data)
+			return prev;
+	return NULL;
 }
 
 /**
- * run through a waiter queue for a single sync point ID
- * and gather all completed waiters into lists by actions
+ * pop all completed waiters for a single sync point ID off its tree
+ * and gather them into lists by actions
  */
-static void remove_completed_waiters(struct list_head *head, u32 sync,
+static void remove_completed_waiters(struct nvhost_intr_syncpt *syncpt,
+			u32 sync,
 			struct list_head completed[NVHOST_INTR_ACTION_COUNT])
 {
 	struct list_head *dest;
-	struct nvhost_waitlist *waiter, *next, *prev;
+	struct nvhost_waitlist *waiter, *prev;
 
-	list_for_each_entry_safe(waiter, next, head, list) {
+	while ((waiter = first_waiter(syncpt)) != NULL) {
 		if ((s32)(waiter->thresh - sync) > 0)
 			break;
 
+		remove_waiter_from_tree(syncpt, waiter);
 		dest = completed + waiter->action;
 
 		/* consolidate submit cleanups */
-		if (waiter->action == NVHOST_INTR_ACTION_SUBMIT_COMPLETE
-			&& !list_empty(dest)) {
-			prev = list_entry(dest->prev,
-					struct nvhost_waitlist, list);
-			if (prev->data == waiter->data) {
+		if (waiter->action == NVHOST_INTR_ACTION_SUBMIT_COMPLETE) {
+			prev = find_submit_complete(dest, waiter->data);
+			if (prev) {
 				prev->count++;
 				dest = NULL;
 			}
 		}
 
 		/* PENDING->REMOVED or CANCELLED->HANDLED */
-		if (atomic_inc_return(&waiter->state) == WLS_HANDLED || !dest) {
-			list_del(&waiter->list);
+		if (atomic_inc_return(&waiter->state) == WLS_HANDLED || !dest)
 			kref_put(&waiter->refcount, waiter_release);
-		} else {
-			list_move_tail(&waiter->list, dest);
-		}
+		else
+			list_add_tail(&waiter->list, dest);
 	}
 }
 
-void reset_threshold_interrupt(struct nvhost_intr *intr,
-			       struct list_head *head,
-			       unsigned int id)
+static void reset_threshold_interrupt(struct nvhost_intr *intr,
+				      struct nvhost_intr_syncpt *syncpt)
 {
-	u32 thresh = list_first_entry(head,
-				struct nvhost_waitlist, list)->thresh;
+	u32 thresh = first_waiter(syncpt)->thresh;
+
 	BUG_ON(!(intr_op().set_syncpt_threshold &&
 		 intr_op().enable_syncpt_intr));
 
-	intr_op().set_syncpt_threshold(intr, id, thresh);
-	intr_op().enable_syncpt_intr(intr, id);
+	intr_op().set_syncpt_threshold(intr, syncpt->id, thresh);
+	intr_op().enable_syncpt_intr(intr, syncpt->id);
 }
 
 
@@ -207,14 +276,13 @@ static int process_wait_list(struct nvhost_intr *intr,
 
 	spin_lock(&syncpt->lock);
 
-	remove_completed_waiters(&syncpt->wait_head, threshold, completed);
+	remove_completed_waiters(syncpt, threshold, completed);
 
-	empty = list_empty(&syncpt->wait_head);
+	empty = !syncpt->wait_len;
 	if (empty)
 		intr_op().disable_syncpt_intr(intr, syncpt->id);
 	else
-		reset_threshold_interrupt(intr, &syncpt->wait_head,
-					  syncpt->id);
+		reset_threshold_interrupt(intr, syncpt);
 
 	spin_unlock(&syncpt->lock);
 
@@ -305,9 +373,9 @@ int nvhost_intr_add_action(struct nvhost_intr *intr, u32 id, u32 thresh,
 		spin_lock(&syncpt->lock);
 	}
 
-	queue_was_empty = list_empty(&syncpt->wait_head);
+	queue_was_empty = !syncpt->wait_len;
 
-	if (add_waiter_to_queue(waiter, &syncpt->wait_head)) {
+	if (add_waiter_to_queue(waiter, syncpt)) {
 		/* added at head of list - new threshold value */
 		intr_op().set_syncpt_threshold(intr, id, thresh);
 
@@ -371,7 +439,10 @@ int nvhost_intr_init(struct nvhost_intr *intr, u32 irq_gen, u32 irq_sync)
 		syncpt->irq = irq_sync + id;
 		syncpt->irq_requested = 0;
 		spin_lock_init(&syncpt->lock);
-		INIT_LIST_HEAD(&syncpt->wait_head);
+		syncpt->wait_tree = RB_ROOT;
+		syncpt->wait_first = NULL;
+		syncpt->wait_len = 0;
+		syncpt->wait_seq = 0;
 		snprintf(syncpt->thresh_irq_name,
 			sizeof(syncpt->thresh_irq_name),
 			"host_sp_%02d", id);
@@ -418,16 +489,21 @@ void nvhost_intr_stop(struct nvhost_intr *intr)
 	for (id = 0, syncpt = intr->syncpt;
 	     id < nb_pts;
 	     ++id, ++syncpt) {
-		struct nvhost_waitlist *waiter, *next;
-		list_for_each_entry_safe(waiter, next, &syncpt->wait_head, list) {
+		struct rb_node *node = rb_first(&syncpt->wait_tree);
+
+		while (node) {
+			struct nvhost_waitlist *waiter =
+				rb_entry(node, struct nvhost_waitlist, node);
+
+			node = rb_next(node);
 			if (atomic_cmpxchg(&waiter->state, WLS_CANCELLED, WLS_HANDLED)
 				== WLS_CANCELLED) {
-				list_del(&waiter->list);
+				remove_waiter_from_tree(syncpt, waiter);
 				kref_put(&waiter->refcount, waiter_release);
 			}
 		}
 
-		if (!list_empty(&syncpt->wait_head)) {  /* output diagnostics */
+		if (syncpt->wait_len) {  /* output diagnostics */
 			printk(KERN_DEBUG "%s id=%d\n", __func__, id);
 			BUG_ON(1);
 		}
@@ -439,3 +515,7 @@ void nvhost_intr_stop(struct nvhost_intr *intr)
 
 	mutex_unlock(&intr->mutex);
 }
+
+#ifdef CONFIG_TEGRA_GRHOST_INTR_TEST
+#include "nvhost_intr_test.c"
+#endif
@@ -24,6 +24,7 @@
 #include <linux/kthread.h>
 #include <linux/semaphore.h>
 #include <linux/interrupt.h>
+#include <linux/rbtree.h>
 
 struct nvhost_channel;
 
@@ -56,6 +57,7 @@ enum nvhost_intr_action {
 };
 
 struct nvhost_intr;
+struct nvhost_waitlist;
 
 struct nvhost_intr_syncpt {
 	struct  nvhost_intr *intr;
@@ -63,7 +65,11 @@ struct nvhost_intr_syncpt {
 	u8 irq_requested;
 	u16 irq;
 	spinlock_t lock;
-	struct list_head wait_head;
+	/* pending waiters ordered by threshold, earliest cached */
+	struct rb_root wait_tree;
+	struct nvhost_waitlist *wait_first;
+	unsigned int wait_len;
+	u32 wait_seq;
 	char thresh_irq_name[12];
 };
 
@@ -0,0 +1,243 @@
+/*
+ * drivers/video/tegra/host/nvhost_intr_test.c
+ *
+ * Tegra Graphics Host Interrupt Management self test
+ *
+ * Copyright (c) 2012, NVIDIA Corporation.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Included from nvhost_intr.c.  Runs the waiter queue against a fake
+ * sync point backend: the threshold and interrupt enable are plain
+ * variables, and incrementing a fake sync point past the programmed
+ * threshold calls process_wait_list() the way the threshold interrupt
+ * would.  Every wakeup is logged, and the log is checked for the right
+ * waiters having fired, in threshold order, and for the threshold and
+ * interrupt state left behind.  It runs before host1x probes, while the
+ * real interrupt ops can be swapped out.
+ */
+
+#include <linux/random.h>
+
+#define TEST_PTS	2
+#define TEST_WAITERS	512
+
+static struct nvhost_intr_test {
+	struct nvhost_intr intr;
+	struct nvhost_intr_syncpt syncpt[TEST_PTS];
+	u32 min[TEST_PTS];
+	u32 thresh[TEST_PTS];
+	bool enabled[TEST_PTS];
+
+	struct nvhost_intr_test_waiter {
+		wait_queue_head_t wq;
+		wait_queue_t wait;
+		u32 thresh;
+	} waiter[TEST_WAITERS];
+	int log[TEST_WAITERS];
+	int nr_log;
+	int errors;
+} *t;
+
+#define test_check(cond, fmt, args...)					\
+	do {								\
+		if (!(cond)) {						\
+			pr_err("nvhost_intr_test: " fmt "\n", ##args);	\
+			t->errors++;					\
+		}							\
+	} while (0)
+
+static void test_set_syncpt_threshold(struct nvhost_intr *intr, u32 id,
+				      u32 thresh)
+{
+	t->thresh[id] = thresh;
+}
+
+static void test_enable_syncpt_intr(struct nvhost_intr *intr, u32 id)
+{
+	t->enabled[id] = true;
+}
+
+static void test_disable_syncpt_intr(struct nvhost_intr *intr, u32 id)
+{
+	t->enabled[id] = false;
+}
+
+static int test_request_syncpt_irq(struct nvhost_intr_syncpt *syncpt)
+{
+	syncpt->irq_requested = 1;
+	return 0;
+}
+
+static int test_wake(wait_queue_t *wait, unsigned mode, int flags, void *key)
+{
+	struct nvhost_intr_test_waiter *w =
+		container_of(wait, struct nvhost_intr_test_waiter, wait);
+
+	t->log[t->nr_log++] = w - t->waiter;
+	return 1;
+}
+
+/* advance a fake sync point, raising its threshold interrupt if due */
+static void test_incr(u32 id, u32 incrs)
+{
+	t->min[id] += incrs;
+	if (t->enabled[id] && (s32)(t->min[id] - t->thresh[id]) >= 0)
+		process_wait_list(&t->intr, &t->syncpt[id], t->min[id]);
+}
+
+static void test_add(u32 id, int i, u32 thresh)
+{
+	struct nvhost_intr_test_waiter *w = &t->waiter[i];
+	int err;
+
+	w->thresh = thresh;
+	err = nvhost_intr_add_action(&t->intr, id, thresh,
+				     NVHOST_INTR_ACTION_WAKEUP, &w->wq,
+				     nvhost_intr_alloc_waiter(), NULL);
+	test_check(!err, "add_action %d: %d", i, err);
+}
+
+/*
+ * Check that the wakeups logged since @first are for thresholds up to
+ * the sync point value, in order, that no earlier waiter is left behind,
+ * and that the hardware is programmed for the earliest remaining waiter.
+ */
+static void test_verify(u32 id, int first, int nr_pending)
+{
+	struct nvhost_intr_syncpt *syncpt = &t->syncpt[id];
+	int i;
+
+	for (i = first; i < t->nr_log; i++) {
+		u32 thresh = t->waiter[t->log[i]].thresh;
+
+		test_check((s32)(thresh - t->min[id]) <= 0,
+			   "waiter %d woken early at %u", t->log[i], t->min[id]);
+		test_check(i == first ||
+			   (s32)(thresh - t->waiter[t->log[i - 1]].thresh) >= 0,
+			   "waiter %d woken out of order", t->log[i]);
+	}
+
+	test_check(syncpt->wait_len == nr_pending,
+		   "%u waiters queued, expected %d", syncpt->wait_len,
+		   nr_pending);
+	test_check(t->enabled[id] == !!nr_pending,
+		   "interrupt %s with %d waiters",
+		   t->enabled[id] ? "enabled" : "disabled", nr_pending);
+	if (nr_pending) {
+		u32 thresh = syncpt->wait_first->thresh;
+
+		test_check((s32)(thresh - t->min[id]) > 0,
+			   "completed waiter left queued at %u", t->min[id]);
+		test_check(t->thresh[id] == thresh,
+			   "threshold %u, earliest waiter %u", t->thresh[id],
+			   thresh);
+	}
+}
+
+/* waiters in random order, completed by random increments */
+static void test_random(u32 id, u32 start)
+{
+	int i, queued = 0, done;
+
+	t->nr_log = 0;
+	t->min[id] = start;
+
+	for (i = 0; i < TEST_WAITERS; i++) {
+		done = t->nr_log;
+		test_add(id, i, start + 1 + random32() % (4 * TEST_WAITERS));
+		queued++;
+
+		/*
+		 * Now and then let some complete while more are queued.  A
+		 * threshold already passed raises the interrupt right away.
+		 */
+		test_incr(id, random32() % 8 ? 0 : random32() % 16);
+		queued -= t->nr_log - done;
+		test_verify(id, done, queued);
+	}
+
+	while (queued) {
+		done = t->nr_log;
+		test_incr(id, 1 + random32() % 64);
+		queued -= t->nr_log - done;
+		test_verify(id, done, queued);
+	}
+	test_check(t->nr_log == TEST_WAITERS, "%d of %d waiters woken",
+		   t->nr_log, TEST_WAITERS);
+}
+
+/* equal thresholds complete in the order they were queued */
+static void test_fifo(u32 id)
+{
+	int i;
+
+	t->nr_log = 0;
+	t->min[id] = 100;
+	for (i = 0; i < 8; i++)
+		test_add(id, i, i % 2 ? 102 : 101);
+
+	test_incr(id, 2);
+	test_verify(id, 0, 0);
+	for (i = 0; i < 8; i++)
+		test_check(t->log[i] == (i < 4 ? 2 * i : 2 * (i - 4) + 1),
+			   "wakeup %d went to waiter %d", i, t->log[i]);
+}
+
+static int __init nvhost_intr_test(void)
+{
+	struct nvhost_intr_ops saved, *ops;
+	int i;
+
+	if (!nvhost_bus_get())
+		return -ENODEV;
+	ops = &intr_op();
+
+	t = kzalloc(sizeof(*t), GFP_KERNEL);
+	if (!t)
+		return -ENOMEM;
+
+	saved = *ops;
+	ops->set_syncpt_threshold = test_set_syncpt_threshold;
+	ops->enable_syncpt_intr = test_enable_syncpt_intr;
+	ops->disable_syncpt_intr = test_disable_syncpt_intr;
+	ops->request_syncpt_irq = test_request_syncpt_irq;
+
+	mutex_init(&t->intr.mutex);
+	t->intr.syncpt = t->syncpt;
+	for (i = 0; i < TEST_PTS; i++) {
+		t->syncpt[i].intr = &t->intr;
+		t->syncpt[i].id = i;
+		spin_lock_init(&t->syncpt[i].lock);
+		t->syncpt[i].wait_tree = RB_ROOT;
+	}
+	for (i = 0; i < TEST_WAITERS; i++) {
+		init_waitqueue_head(&t->waiter[i].wq);
+		init_waitqueue_func_entry(&t->waiter[i].wait, test_wake);
+		add_wait_queue(&t->waiter[i].wq, &t->waiter[i].wait);
+	}
+
+	test_random(0, 0);
+	/* thresholds that wrap around */
+	test_random(1, (u32)-TEST_WAITERS);
+	test_fifo(0);
+
+	*ops = saved;
+	pr_info("nvhost_intr_test: %s\n", t->errors ? "FAIL" : "PASS");
+	kfree(t);
+	return 0;
+}
+/* the nvhost bus and its ops exist by now, host1x probes at rootfs */
+fs_initcall(nvhost_intr_test);
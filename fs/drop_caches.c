@@ -37,6 +37,15 @@ static void drop_pagecache_sb(struct super_block *sb, void *unused)
 	iput(toput_inode);
 }
 
+/*
+ * Drop all clean, unmapped page cache, e.g. so that it does not have to be
+ * saved in a hibernation image.
+ */
+void drop_pagecache(void)
+{
+	iterate_supers(drop_pagecache_sb, NULL);
+}
+
 static void drop_slab(void)
 {
 	int nr_objects;
@@ -59,7 +68,7 @@ int drop_caches_sysctl_handler(ctl_table *table, int write,
 		return ret;
 	if (write) {
 		if (sysctl_drop_caches & 1)
-			iterate_supers(drop_pagecache_sb, NULL);
+			drop_pagecache();
 		if (sysctl_drop_caches & 2)
 			drop_slab();
 	}
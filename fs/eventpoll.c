@@ -33,6 +33,8 @@
 #include <linux/bitops.h>
 #include <linux/mutex.h>
 #include <linux/anon_inodes.h>
+#include <linux/log2.h>
+#include <linux/vmalloc.h>
 #include <asm/uaccess.h>
 #include <asm/system.h>
 #include <asm/io.h>
@@ -88,7 +90,7 @@
  */
 
 /* Epoll private bits inside the event mask */
-#define EP_PRIVATE_BITS (EPOLLONESHOT | EPOLLET)
+#define EP_PRIVATE_BITS (EPOLLONESHOT | EPOLLET | EPOLLEXCLUSIVE | EPOLLROUNDROBIN)
 
 /* Maximum number of nesting allowed inside epoll sets */
 #define EP_MAX_NESTS 4
@@ -197,6 +199,26 @@ struct eventpoll {
 
 	/* The user that created the eventpoll descriptor */
 	struct user_struct *user;
+
+	/*
+	 * Ready ring shared with userspace, set up by ep_eventpoll_mmap()
+	 * and filled by ep_poll_callback() under ->lock.
+	 */
+	struct epoll_ring *ring;
+	unsigned long ring_size;
+	unsigned int ring_nr;
+	/* What the ring is charged to user->epoll_watches */
+	long ring_charge;
+	/* Our copy of ring->head, userspace can write to the shared one */
+	u32 ring_head;
+
+	/* Counters shown in /proc/<pid>/fdinfo, updated under ->lock */
+	unsigned long nr_callbacks;
+	unsigned long nr_wakeups;
+	/* Exclusive wakeups we did not take, left to the next epoll set */
+	unsigned long nr_exclusive_passed;
+	unsigned long nr_ring_events;
+	unsigned long nr_ring_overflows;
 };
 
 /* Wait structure used by the poll hooks */
@@ -223,6 +245,9 @@ struct ep_pqueue {
 	struct epitem *epi;
 };
 
+/* Number of epoll_ctl_batch() operations applied per "mtx" hold */
+#define EP_CTL_BATCH_CHUNK 8
+
 /* Used by the ep_send_events() function as callback private data */
 struct ep_send_events_data {
 	int maxevents;
@@ -337,6 +362,19 @@ static inline int ep_events_available(struct eventpoll *ep)
 	return !list_empty(&ep->rdllist) || ep->ovflist != EP_UNACTIVE_PTR;
 }
 
+/**
+ * ep_ring_pending - Checks if the mmap-ed ready ring holds events that
+ *                   userspace did not consume yet.
+ *
+ * @ep: Pointer to the eventpoll context.
+ *
+ * Returns: Returns a value different than zero if the ring is not empty.
+ */
+static inline int ep_ring_pending(struct eventpoll *ep)
+{
+	return ep->ring && ep->ring_head != ACCESS_ONCE(ep->ring->tail);
+}
+
 /**
  * ep_call_nested - Perform a bound (possibly) nested call, by checking
  *                  that the recursion limit is not exceeded, and that
@@ -643,7 +681,10 @@ static void ep_free(struct eventpoll *ep)
 
 	mutex_unlock(&epmutex);
 	mutex_destroy(&ep->mtx);
+	/* The mappings hold a file reference, so they are all gone by now */
+	atomic_long_sub(ep->ring_charge, &ep->user->epoll_watches);
 	free_uid(ep->user);
+	vfree(ep->ring);
 	kfree(ep);
 }
 
@@ -692,6 +733,9 @@ static unsigned int ep_eventpoll_poll(struct file *file, poll_table *wait)
 	/* Insert inside our poll wait queue */
 	poll_wait(file, &ep->poll_wait, wait);
 
+	if (ep_ring_pending(ep))
+		return POLLIN | POLLRDNORM;
+
 	/*
 	 * Proceed to find out if wanted events are really available inside
 	 * the ready list. This need to be done under ep_call_nested()
@@ -704,10 +748,84 @@ static unsigned int ep_eventpoll_poll(struct file *file, poll_table *wait)
 	return pollflags != -1 ? pollflags : 0;
 }
 
+/*
+ * Map the ready ring. The first mmap() allocates it, sized from the
+ * mapping length, later ones must map the same size. A ring never needs
+ * more slots than the user may have watches, and its memory is charged
+ * to the user's watches at EP_ITEM_COST apiece.
+ */
+static int ep_eventpoll_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	int error;
+	unsigned long size = vma->vm_end - vma->vm_start;
+	unsigned long nr_slots;
+	unsigned int nr;
+	long charge;
+	struct eventpoll *ep = file->private_data;
+	struct epoll_ring *ring;
+
+	if (vma->vm_pgoff)
+		return -EINVAL;
+	if (vma->vm_flags & VM_EXEC)
+		return -EPERM;
+
+	mutex_lock(&ep->mtx);
+	if (ep->ring) {
+		error = -EINVAL;
+		if (size == ep->ring_size)
+			error = remap_vmalloc_range(vma, ep->ring, 0);
+		goto out_unlock;
+	}
+
+	error = -EINVAL;
+	if (size <= sizeof(struct epoll_ring) + sizeof(struct epoll_event))
+		goto out_unlock;
+	nr_slots = (size - sizeof(struct epoll_ring)) /
+		sizeof(struct epoll_event);
+	/* Allow for the mapping being rounded up to a page */
+	if (nr_slots > max_user_watches + PAGE_SIZE / sizeof(struct epoll_event))
+		goto out_unlock;
+	nr = rounddown_pow_of_two(min_t(unsigned long, nr_slots, 1U << 30));
+
+	error = -ENOSPC;
+	charge = DIV_ROUND_UP(size, EP_ITEM_COST);
+	if (atomic_long_add_return(charge, &ep->user->epoll_watches) >
+	    max_user_watches)
+		goto out_uncharge;
+
+	error = -ENOMEM;
+	ring = vmalloc_user(size);
+	if (!ring)
+		goto out_uncharge;
+	ring->nr = nr;
+
+	error = remap_vmalloc_range(vma, ring, 0);
+	if (error) {
+		vfree(ring);
+		goto out_uncharge;
+	}
+
+	spin_lock_irq(&ep->lock);
+	ep->ring_nr = nr;
+	ep->ring_size = size;
+	ep->ring_charge = charge;
+	ep->ring = ring;
+	spin_unlock_irq(&ep->lock);
+	goto out_unlock;
+
+out_uncharge:
+	atomic_long_sub(charge, &ep->user->epoll_watches);
+
+out_unlock:
+	mutex_unlock(&ep->mtx);
+	return error;
+}
+
 /* File callbacks that implement the eventpoll file behaviour */
 static const struct file_operations eventpoll_fops = {
 	.release	= ep_eventpoll_release,
 	.poll		= ep_eventpoll_poll,
+	.mmap		= ep_eventpoll_mmap,
 	.llseek		= noop_llseek,
 };
 
@@ -717,6 +835,29 @@ static inline int is_file_epoll(struct file *f)
 	return f->f_op == &eventpoll_fops;
 }
 
+/*
+ * Format the wakeup counters of an epoll file for /proc/<pid>/fdinfo.
+ * Returns the number of characters written, 0 if @file is not an epoll file.
+ */
+int eventpoll_fdinfo(struct file *file, char *buf, int size)
+{
+	struct eventpoll *ep;
+
+	if (!is_file_epoll(file))
+		return 0;
+
+	ep = file->private_data;
+	return scnprintf(buf, size,
+			 "ep_callbacks:\t%lu\n"
+			 "ep_wakeups:\t%lu\n"
+			 "ep_exclusive_passed:\t%lu\n"
+			 "ep_ring_events:\t%lu\n"
+			 "ep_ring_overflows:\t%lu\n",
+			 ep->nr_callbacks, ep->nr_wakeups,
+			 ep->nr_exclusive_passed, ep->nr_ring_events,
+			 ep->nr_ring_overflows);
+}
+
 /*
  * This is called from eventpoll_release() to unlink files from the eventpoll
  * interface. We need to have this facility to cleanup correctly files that are
@@ -815,19 +956,57 @@ static struct epitem *ep_find(struct eventpoll *ep, struct file *file, int fd)
 	return epir;
 }
 
+/*
+ * Post an event straight to the mmap-ed ready ring. Must be called with
+ * "ep->lock" held. Returns zero if the ring is full.
+ */
+static int ep_ring_post(struct eventpoll *ep, struct epitem *epi,
+			unsigned int revents)
+{
+	struct epoll_ring *ring = ep->ring;
+	struct epoll_event *event;
+	u32 head = ep->ring_head;
+
+	/* A bogus tail from userspace only makes the ring look full */
+	if (head - ACCESS_ONCE(ring->tail) >= ep->ring_nr) {
+		ring->overflow = 1;
+		ep->nr_ring_overflows++;
+		return 0;
+	}
+
+	event = &ring->events[head & (ep->ring_nr - 1)];
+	event->events = revents & epi->event.events;
+	event->data = epi->event.data;
+	/* Publish the entry before the new head */
+	smp_wmb();
+	ep->ring_head = ++head;
+	ring->head = head;
+	ep->nr_ring_events++;
+
+	if (epi->event.events & EPOLLONESHOT)
+		epi->event.events &= EP_PRIVATE_BITS;
+
+	return 1;
+}
+
 /*
  * This is the callback that is passed to the wait queue wakeup
  * mechanism. It is called by the stored file descriptors when they
  * have events to report.
+ *
+ * For EPOLLEXCLUSIVE items, the return value tells the waker whether this
+ * epoll set took the wakeup, so that it only consumes an exclusive wakeup
+ * when a task is actually woken up.
  */
 static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *key)
 {
-	int pwake = 0;
+	int pwake = 0, ewake = 0;
 	unsigned long flags;
 	struct epitem *epi = ep_item_from_wait(wait);
 	struct eventpoll *ep = epi->ep;
 
 	spin_lock_irqsave(&ep->lock, flags);
+	ep->nr_callbacks++;
 
 	/*
 	 * If the event mask does not contain any poll(2) event, we consider the
@@ -847,6 +1026,14 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 	if (key && !((unsigned long) key & epi->event.events))
 		goto out_unlock;
 
+	/*
+	 * Edge triggered items whose events we know can go to the ready ring,
+	 * with no need for a later f_op->poll() call or ready list scan.
+	 */
+	if (ep->ring && key && (epi->event.events & EPOLLET) &&
+	    ep_ring_post(ep, epi, (unsigned long) key))
+		goto wakeup;
+
 	/*
 	 * If we are transferring events to userspace, we can hold no locks
 	 * (because we're accessing user memory, and because of linux f_op->poll()
@@ -865,23 +1052,39 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 	if (!ep_is_linked(&epi->rdllink))
 		list_add_tail(&epi->rdllink, &ep->rdllist);
 
+wakeup:
 	/*
 	 * Wake up ( if active ) both the eventpoll wait list and the ->poll()
 	 * wait list.
 	 */
-	if (waitqueue_active(&ep->wq))
+	if (waitqueue_active(&ep->wq)) {
+		ewake = 1;
+		ep->nr_wakeups++;
 		wake_up_locked(&ep->wq);
-	if (waitqueue_active(&ep->poll_wait))
+	}
+	if (waitqueue_active(&ep->poll_wait)) {
+		ewake = 1;
 		pwake++;
+	}
 
 out_unlock:
+	/*
+	 * For EPOLLROUNDROBIN items the waker moves the entry to the tail of
+	 * the target wait queue when we take the wakeup, so that the next
+	 * one goes to the next epoll set.
+	 */
+	if (epi->event.events & EPOLLEXCLUSIVE) {
+		if (!ewake)
+			ep->nr_exclusive_passed++;
+	} else
+		ewake = 1;
 	spin_unlock_irqrestore(&ep->lock, flags);
 
 	/* We have to call this outside the lock */
 	if (pwake)
 		ep_poll_safewake(&ep->poll_wait);
 
-	return 1;
+	return ewake;
 }
 
 /*
@@ -898,7 +1101,12 @@ static void ep_ptable_queue_proc(struct file *file, wait_queue_head_t *whead,
 		init_waitqueue_func_entry(&pwq->wait, ep_poll_callback);
 		pwq->whead = whead;
 		pwq->base = epi;
-		add_wait_queue(whead, &pwq->wait);
+		if (epi->event.events & EPOLLROUNDROBIN)
+			pwq->wait.flags |= WQ_FLAG_ROUNDROBIN;
+		if (epi->event.events & EPOLLEXCLUSIVE)
+			add_wait_queue_exclusive(whead, &pwq->wait);
+		else
+			add_wait_queue(whead, &pwq->wait);
 		list_add_tail(&pwq->llink, &epi->pwqlist);
 		epi->nwait++;
 	} else {
@@ -1204,7 +1412,7 @@ static int ep_poll(struct eventpoll *ep, struct epoll_event __user *events,
 fetch_events:
 	spin_lock_irqsave(&ep->lock, flags);
 
-	if (!ep_events_available(ep)) {
+	if (!ep_events_available(ep) && !ep_ring_pending(ep)) {
 		/*
 		 * We don't have any available event to return to the caller.
 		 * We need to sleep here, and we will be wake up by
@@ -1220,7 +1428,8 @@ fetch_events:
 			 * to TASK_INTERRUPTIBLE before doing the checks.
 			 */
 			set_current_state(TASK_INTERRUPTIBLE);
-			if (ep_events_available(ep) || timed_out)
+			if (ep_events_available(ep) || ep_ring_pending(ep) ||
+			    timed_out)
 				break;
 			if (signal_pending(current)) {
 				res = -EINTR;
@@ -1246,10 +1455,12 @@ check_events:
 	/*
 	 * Try to transfer events to user space. In case we get 0 events and
 	 * there's still timeout left over, we go trying again in search of
-	 * more luck.
+	 * more luck. Events waiting in the ready ring end the wait, with 0
+	 * returned if there is nothing else.
 	 */
 	if (!res && eavail &&
-	    !(res = ep_send_events(ep, events, maxevents)) && !timed_out)
+	    !(res = ep_send_events(ep, events, maxevents)) && !timed_out &&
+	    !ep_ring_pending(ep))
 		goto fetch_events;
 
 	return res;
@@ -1350,6 +1561,88 @@ SYSCALL_DEFINE1(epoll_create, int, size)
 	return sys_epoll_create1(0);
 }
 
+/*
+ * Checks that @tfile can be added to, or changed or removed in, the
+ * interest set of the eventpoll file @file.
+ */
+static int ep_ctl_check(struct file *file, struct file *tfile)
+{
+	/* The target file descriptor must support poll */
+	if (!tfile->f_op || !tfile->f_op->poll)
+		return -EPERM;
+
+	/*
+	 * We have to check that the file structure underneath the file descriptor
+	 * the user passed to us _is_ an eventpoll file. And also we do not permit
+	 * adding an epoll file descriptor inside itself.
+	 */
+	if (file == tfile || !is_file_epoll(file))
+		return -EINVAL;
+
+	return 0;
+}
+
+/*
+ * Apply one insert/remove/modify operation to the interest set. Must be
+ * called with "mtx" held, and with "epmutex" held too when adding an
+ * epoll file.
+ */
+static int ep_ctl_locked(struct eventpoll *ep, int op, struct file *tfile,
+			 int fd, struct epoll_event *epds)
+{
+	int error;
+	struct epitem *epi;
+
+	/*
+	 * The exclusive modes decide how the item is queued on the target
+	 * wait queues, so they can only be chosen when it is added. Epoll
+	 * files wake their own waiters through ep_poll_safewake(), which
+	 * does not support them.
+	 */
+	if (ep_op_has_event(op)) {
+		if (epds->events & EPOLLROUNDROBIN)
+			epds->events |= EPOLLEXCLUSIVE;
+		if ((epds->events & EPOLLEXCLUSIVE) &&
+		    (op != EPOLL_CTL_ADD || is_file_epoll(tfile)))
+			return -EINVAL;
+	}
+
+	/*
+	 * Try to lookup the file inside our RB tree, Since we grabbed "mtx"
+	 * above, we can be sure to be able to use the item looked up by
+	 * ep_find() till we release the mutex.
+	 */
+	epi = ep_find(ep, tfile, fd);
+
+	error = -EINVAL;
+	switch (op) {
+	case EPOLL_CTL_ADD:
+		if (!epi) {
+			epds->events |= POLLERR | POLLHUP;
+			error = ep_insert(ep, epds, tfile, fd);
+		} else
+			error = -EEXIST;
+		break;
+	case EPOLL_CTL_DEL:
+		if (epi)
+			error = ep_remove(ep, epi);
+		else
+			error = -ENOENT;
+		break;
+	case EPOLL_CTL_MOD:
+		if (epi && (epi->event.events & EPOLLEXCLUSIVE)) {
+			error = -EINVAL;
+		} else if (epi) {
+			epds->events |= POLLERR | POLLHUP;
+			error = ep_modify(ep, epi, epds);
+		} else
+			error = -ENOENT;
+		break;
+	}
+
+	return error;
+}
+
 /*
  * The following function implements the controller interface for
  * the eventpoll file that enables the insertion/removal/change of
@@ -1362,7 +1655,6 @@ SYSCALL_DEFINE4(epoll_ctl, int, epfd, int, op, int, fd,
 	int did_lock_epmutex = 0;
 	struct file *file, *tfile;
 	struct eventpoll *ep;
-	struct epitem *epi;
 	struct epoll_event epds;
 
 	error = -EFAULT;
@@ -1381,18 +1673,8 @@ SYSCALL_DEFINE4(epoll_ctl, int, epfd, int, op, int, fd,
 	if (!tfile)
 		goto error_fput;
 
-	/* The target file descriptor must support poll */
-	error = -EPERM;
-	if (!tfile->f_op || !tfile->f_op->poll)
-		goto error_tgt_fput;
-
-	/*
-	 * We have to check that the file structure underneath the file descriptor
-	 * the user passed to us _is_ an eventpoll file. And also we do not permit
-	 * adding an epoll file descriptor inside itself.
-	 */
-	error = -EINVAL;
-	if (file == tfile || !is_file_epoll(file))
+	error = ep_ctl_check(file, tfile);
+	if (error)
 		goto error_tgt_fput;
 
 	/*
@@ -1421,37 +1703,7 @@ SYSCALL_DEFINE4(epoll_ctl, int, epfd, int, op, int, fd,
 
 
 	mutex_lock_nested(&ep->mtx, 0);
-
-	/*
-	 * Try to lookup the file inside our RB tree, Since we grabbed "mtx"
-	 * above, we can be sure to be able to use the item looked up by
-	 * ep_find() till we release the mutex.
-	 */
-	epi = ep_find(ep, tfile, fd);
-
-	error = -EINVAL;
-	switch (op) {
-	case EPOLL_CTL_ADD:
-		if (!epi) {
-			epds.events |= POLLERR | POLLHUP;
-			error = ep_insert(ep, &epds, tfile, fd);
-		} else
-			error = -EEXIST;
-		break;
-	case EPOLL_CTL_DEL:
-		if (epi)
-			error = ep_remove(ep, epi);
-		else
-			error = -ENOENT;
-		break;
-	case EPOLL_CTL_MOD:
-		if (epi) {
-			epds.events |= POLLERR | POLLHUP;
-			error = ep_modify(ep, epi, &epds);
-		} else
-			error = -ENOENT;
-		break;
-	}
+	error = ep_ctl_locked(ep, op, tfile, fd, &epds);
 	mutex_unlock(&ep->mtx);
 
 error_tgt_fput:
@@ -1466,6 +1718,120 @@ error_return:
 	return error;
 }
 
+/*
+ * Apply one operation of an epoll_ctl_batch() call. Must be called with
+ * "mtx" held. The target file reference is returned in @ptfile, to be
+ * dropped by the caller after releasing "mtx": the final fput() may end
+ * up in eventpoll_release_file(), which takes "mtx".
+ */
+static int ep_ctl_batch_one(struct eventpoll *ep, struct file *file,
+			    struct epoll_ctl_cmd *cmd, struct file **ptfile)
+{
+	int error;
+	struct file *tfile;
+	struct epoll_event epds;
+
+	if (cmd->flags)
+		return -EINVAL;
+
+	tfile = fget(cmd->fd);
+	if (!tfile)
+		return -EBADF;
+	*ptfile = tfile;
+
+	error = ep_ctl_check(file, tfile);
+	if (error)
+		return error;
+
+	epds.events = cmd->events;
+	epds.data = cmd->data;
+
+	if (likely(!is_file_epoll(tfile) || cmd->op != EPOLL_CTL_ADD))
+		return ep_ctl_locked(ep, cmd->op, tfile, cmd->fd, &epds);
+
+	/* See sys_epoll_ctl(), "epmutex" nests outside of "mtx" */
+	mutex_unlock(&ep->mtx);
+	mutex_lock(&epmutex);
+	error = ep_loop_check(ep, tfile) != 0 ? -ELOOP : 0;
+	mutex_lock_nested(&ep->mtx, 0);
+	if (!error)
+		error = ep_ctl_locked(ep, cmd->op, tfile, cmd->fd, &epds);
+	mutex_unlock(&epmutex);
+
+	return error;
+}
+
+/*
+ * Apply a list of epoll_ctl() operations with a single syscall, taking
+ * "mtx" once per chunk of operations instead of once per file descriptor.
+ * The operations are applied in order and each one gets its result stored
+ * in its ->result. Processing stops at the first failing one.
+ *
+ * Returns the number of operations that succeeded, or an error code if
+ * the call itself is invalid.
+ */
+SYSCALL_DEFINE4(epoll_ctl_batch, int, epfd, int, flags, int, ncmds,
+		struct epoll_ctl_cmd __user *, cmds)
+{
+	int error, done = 0, n, i, j;
+	struct file *file;
+	struct eventpoll *ep;
+	struct epoll_ctl_cmd kcmds[EP_CTL_BATCH_CHUNK];
+	struct file *tfiles[EP_CTL_BATCH_CHUNK];
+
+	if (flags || ncmds <= 0 || ncmds > EPOLL_CTL_BATCH_MAX)
+		return -EINVAL;
+
+	/* Get the "struct file *" for the eventpoll file */
+	file = fget(epfd);
+	if (!file)
+		return -EBADF;
+
+	error = -EINVAL;
+	if (!is_file_epoll(file))
+		goto error_fput;
+	ep = file->private_data;
+
+	while (done < ncmds) {
+		n = min(ncmds - done, EP_CTL_BATCH_CHUNK);
+		error = -EFAULT;
+		if (copy_from_user(kcmds, cmds + done, n * sizeof(kcmds[0])))
+			goto error_fput;
+
+		memset(tfiles, 0, sizeof(tfiles));
+		error = 0;
+		mutex_lock_nested(&ep->mtx, 0);
+		for (i = 0; i < n && !error; i++) {
+			error = ep_ctl_batch_one(ep, file, &kcmds[i],
+						 &tfiles[i]);
+			kcmds[i].result = error;
+		}
+		mutex_unlock(&ep->mtx);
+
+		for (j = 0; j < i; j++)
+			if (tfiles[j])
+				fput(tfiles[j]);
+
+		for (j = 0; j < i; j++)
+			if (put_user(kcmds[j].result, &cmds[done + j].result)) {
+				error = -EFAULT;
+				goto error_fput;
+			}
+
+		if (error) {
+			done += i - 1;
+			break;
+		}
+		done += n;
+	}
+	error = done;
+
+error_fput:
+	fput(file);
+
+	return error;
+}
+
 /*
  * Implement the event wait interface for the eventpoll file. It is the kernel
  * part of the user space epoll_wait(2).
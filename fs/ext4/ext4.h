@@ -866,6 +866,9 @@ struct ext4_inode_info {
 	 */
 	tid_t i_sync_tid;
 	tid_t i_datasync_tid;
+
+	/* Transaction in which the inode cannot be fast committed */
+	tid_t i_fc_ineligible_tid;
 };
 
 /*
@@ -924,6 +927,9 @@ struct ext4_inode_info {
 #define test_opt(sb, opt)		(EXT4_SB(sb)->s_mount_opt & \
 					 EXT4_MOUNT_##opt)
 
+#define EXT4_MOUNT2_FAST_COMMIT		0x00000001 /* Log small fsyncs to the
+						      fast commit area */
+
 #define clear_opt2(sb, opt)		EXT4_SB(sb)->s_mount_opt2 &= \
 						~EXT4_MOUNT2_##opt
 #define set_opt2(sb, opt)		EXT4_SB(sb)->s_mount_opt2 |= \
@@ -1175,9 +1181,12 @@ struct ext4_sb_info {
 	unsigned int s_mb_order2_reqs;
 	unsigned int s_mb_group_prealloc;
 	unsigned int s_max_writeback_mb_bump;
-	/* where last allocation was done - for stream allocation */
-	unsigned long s_mb_last_group;
-	unsigned long s_mb_last_start;
+	unsigned int s_mb_optimize_scan;
+	/* where last allocation was done - for stream allocation, per cpu */
+	struct ext4_mb_goal __percpu *s_mb_last_goals;
+	/* initialized groups, indexed by the order of their largest extent */
+	struct list_head *s_mb_largest_free_orders;
+	rwlock_t *s_mb_largest_free_orders_locks;
 
 	/* stats for buddy allocator */
 	atomic_t s_bal_reqs;	/* number of reqs with len > 1 */
@@ -1187,6 +1196,11 @@ struct ext4_sb_info {
 	atomic_t s_bal_goals;	/* goal hits */
 	atomic_t s_bal_breaks;	/* too long searches */
 	atomic_t s_bal_2orders;	/* 2^order hits */
+	atomic_t s_bal_groups_scanned;	/* groups whose buddy was scanned */
+	atomic_t s_bal_order_picks;	/* groups picked from order lists */
+	atomic_t s_bal_cX_groups_considered[4];
+	atomic_t s_bal_cX_hits[4];
+	atomic_t s_bal_cX_failed[4];	/* criteria passes that found nothing */
 	spinlock_t s_bal_lock;
 	unsigned long s_mb_buddies_generated;
 	unsigned long long s_mb_generation_time;
@@ -1221,6 +1235,14 @@ struct ext4_sb_info {
 
 	/* record the last minlen when FITRIM is called. */
 	atomic_t s_last_trim_minblks;
+
+	/* Fast commit area state, see fast_commit.c */
+	struct mutex s_fc_lock;
+	tid_t s_fc_tid;			/* Transaction the area is used for */
+	unsigned int s_fc_next;		/* Next free block in the area */
+	tid_t s_fc_ineligible_tid;	/* No fast commits in this one */
+	unsigned int s_fc_commits;
+	unsigned int s_fc_fallbacks;
 };
 
 static inline struct ext4_sb_info *EXT4_SB(struct super_block *sb)
@@ -1706,6 +1728,31 @@ struct mmpd_data {
  */
 #define EXT4_MMP_MAX_CHECK_INTERVAL	300UL
 
+/*
+ * Fast commit record, one per block of the journal's fast commit area.
+ * It carries just enough of an inode to redo an fsync of a file whose
+ * only changes in the running transaction are its size, timestamps and
+ * the extents held in the inode itself.
+ */
+#define EXT4_FC_MAGIC		0xFC0DE4E4
+#define EXT4_FC_BLOCKS		64	/* Size of the fast commit area */
+
+struct ext4_fc_block {
+	__le32	fc_magic;		/* EXT4_FC_MAGIC */
+	__le32	fc_tid;			/* Transaction the record belongs to */
+	__le32	fc_index;		/* Position in the fast commit area */
+	__le32	fc_csum;		/* crc32 over the uuid and the record */
+	__le32	fc_ino;
+	__le32	fc_flags;		/* i_flags */
+	__le64	fc_size;		/* i_size */
+	__le32	fc_blocks;		/* i_blocks_lo */
+	__le32	fc_mtime;
+	__le32	fc_mtime_extra;
+	__le32	fc_ctime;
+	__le32	fc_ctime_extra;
+	__le32	fc_data[EXT4_N_BLOCKS];	/* Extent tree root */
+};
+
 /*
  * Function prototypes
  */
@@ -1769,6 +1816,13 @@ extern void ext4_htree_free_dir_info(struct dir_private_info *p);
 extern int ext4_sync_file(struct file *, loff_t, loff_t, int);
 extern int ext4_flush_completed_IO(struct inode *);
 
+/* fast_commit.c */
+extern void ext4_fc_mark_ineligible(struct super_block *sb,
+				    struct inode *inode);
+extern int ext4_fc_commit(struct inode *inode, tid_t commit_tid);
+extern int ext4_fc_replay(journal_t *journal, tid_t tid);
+extern void ext4_fc_setup(struct super_block *sb);
+
 /* hash.c */
 extern int ext4fs_dirhash(const char *name, int len, struct
 			  dx_hash_info *hinfo);
@@ -2078,7 +2132,9 @@ struct ext4_group_info {
 	ext4_grpblk_t	bb_free;	/* total free blocks */
 	ext4_grpblk_t	bb_fragments;	/* nr of freespace fragments */
 	ext4_grpblk_t	bb_largest_free_order;/* order of largest frag in BG */
+	ext4_group_t	bb_group;	/* group number */
 	struct          list_head bb_prealloc_list;
+	struct          list_head bb_largest_free_order_node;
 #ifdef DOUBLE_CHECK
 	void            *bb_bitmap;
 #endif
@@ -0,0 +1,448 @@
+/*
+ *  linux/fs/ext4/fast_commit.c
+ *
+ * Fast commits: fsync of a file whose only metadata changes in the
+ * running transaction are its size, timestamps and in-inode extents
+ * writes a single record to an area at the end of the journal instead
+ * of committing the transaction.  The transaction commits later on its
+ * own schedule; until it does, recovery replays the records on top of
+ * the log.
+ *
+ * Anything the records cannot describe makes the inode, or for block
+ * frees the whole transaction, ineligible, and fsync falls back to a
+ * full commit.
+ */
+
+#include <linux/fs.h>
+#include <linux/buffer_head.h>
+#include <linux/blkdev.h>
+#include <linux/crc32.h>
+#include <linux/quotaops.h>
+#include "ext4.h"
+#include "ext4_jbd2.h"
+#include "ext4_extents.h"
+
+/**
+ * ext4_fc_mark_ineligible - disallow fast commits until the next commit
+ * @sb:		filesystem
+ * @inode:	inode whose change cannot be logged, NULL for the whole fs
+ *
+ * Must be called once the change is part of a transaction, i.e. with
+ * the handle that made it still open or after it has been dirtied.
+ */
+void ext4_fc_mark_ineligible(struct super_block *sb, struct inode *inode)
+{
+	journal_t *journal = EXT4_SB(sb)->s_journal;
+	tid_t tid;
+
+	if (!journal || !test_opt2(sb, FAST_COMMIT))
+		return;
+
+	read_lock(&journal->j_state_lock);
+	if (journal->j_running_transaction)
+		tid = journal->j_running_transaction->t_tid;
+	else
+		tid = journal->j_transaction_sequence;
+	read_unlock(&journal->j_state_lock);
+
+	if (inode)
+		EXT4_I(inode)->i_fc_ineligible_tid = tid;
+	else
+		EXT4_SB(sb)->s_fc_ineligible_tid = tid;
+}
+
+/* Called with i_data_sem held so that the extent tree depth is stable */
+static int ext4_fc_eligible(struct inode *inode, tid_t tid)
+{
+	struct super_block *sb = inode->i_sb;
+
+	/*
+	 * In data=writeback mode freed blocks can be reallocated within the
+	 * same transaction, so a record pointing at them is only safe once
+	 * the free is on disk.
+	 */
+	if (EXT4_SB(sb)->s_fc_ineligible_tid == tid ||
+	    EXT4_I(inode)->i_fc_ineligible_tid == tid)
+		return 0;
+	if (!S_ISREG(inode->i_mode) ||
+	    !ext4_test_inode_flag(inode, EXT4_INODE_EXTENTS) ||
+	    ext4_test_inode_flag(inode, EXT4_INODE_HUGE_FILE) ||
+	    ext4_should_journal_data(inode) || sb_any_quota_loaded(sb))
+		return 0;
+	return ext_depth(inode) == 0 && inode->i_blocks <= 0xffffffffULL;
+}
+
+static __le32 ext4_fc_csum(struct super_block *sb, struct ext4_fc_block *fc)
+{
+	struct ext4_super_block *es = EXT4_SB(sb)->s_es;
+	__le32 csum = fc->fc_csum;
+	u32 crc;
+
+	fc->fc_csum = 0;
+	crc = crc32_le(~0, es->s_uuid, sizeof(es->s_uuid));
+	crc = crc32_le(crc, (unsigned char *)fc, sizeof(*fc));
+	fc->fc_csum = csum;
+	return cpu_to_le32(crc);
+}
+
+static int ext4_fc_write_block(journal_t *journal, unsigned int index,
+			       struct ext4_fc_block *fc)
+{
+	struct buffer_head *bh;
+	int ret = 0;
+
+	bh = jbd2_fc_get_buf(journal, index);
+	if (!bh)
+		return -EIO;
+
+	lock_buffer(bh);
+	memset(bh->b_data, 0, bh->b_size);
+	memcpy(bh->b_data, fc, sizeof(*fc));
+	set_buffer_uptodate(bh);
+	clear_buffer_dirty(bh);
+	bh->b_end_io = end_buffer_write_sync;
+	get_bh(bh);
+	/*
+	 * On an internal journal the flush also covers the file data the
+	 * caller wrote back, which the record must not get ahead of.
+	 */
+	submit_bh(journal->j_flags & JBD2_BARRIER ?
+		  WRITE_FLUSH_FUA : WRITE_SYNC, bh);
+	wait_on_buffer(bh);
+	if (!buffer_uptodate(bh))
+		ret = -EIO;
+	brelse(bh);
+	return ret;
+}
+
+/**
+ * ext4_fc_commit - make an inode's changes durable without a commit
+ * @inode:	inode being synced, i_mutex held
+ * @commit_tid:	transaction holding the changes fsync is waiting for
+ *
+ * Returns -EAGAIN if the inode cannot be fast committed, in which case
+ * the caller commits @commit_tid the usual way.
+ */
+int ext4_fc_commit(struct inode *inode, tid_t commit_tid)
+{
+	struct super_block *sb = inode->i_sb;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_inode_info *ei = EXT4_I(inode);
+	journal_t *journal = sbi->s_journal;
+	struct ext4_fc_block fc;
+	handle_t *handle;
+	tid_t tid;
+	int ret;
+
+	/* Nothing to gain once the transaction has started to commit */
+	read_lock(&journal->j_state_lock);
+	ret = journal->j_running_transaction &&
+	      journal->j_running_transaction->t_tid == commit_tid;
+	read_unlock(&journal->j_state_lock);
+	if (!ret || journal->j_fc_first == journal->j_fc_last)
+		return -EAGAIN;
+
+	/*
+	 * The handle keeps the transaction from committing while the inode
+	 * is copied, so the record holds its state as of that transaction
+	 * and no later one.
+	 */
+	handle = ext4_journal_start(inode, 1);
+	if (IS_ERR(handle))
+		return -EAGAIN;
+	tid = handle->h_transaction->t_tid;
+
+	ret = -EAGAIN;
+	down_read(&ei->i_data_sem);
+	if (tid == commit_tid && ext4_fc_eligible(inode, tid)) {
+		memset(&fc, 0, sizeof(fc));
+		fc.fc_magic = cpu_to_le32(EXT4_FC_MAGIC);
+		fc.fc_tid = cpu_to_le32(tid);
+		fc.fc_ino = cpu_to_le32(inode->i_ino);
+		fc.fc_flags = cpu_to_le32(ei->i_flags);
+		fc.fc_blocks = cpu_to_le32(inode->i_blocks);
+		fc.fc_size = cpu_to_le64(ei->i_disksize);
+		fc.fc_mtime = cpu_to_le32(inode->i_mtime.tv_sec);
+		fc.fc_mtime_extra = ext4_encode_extra_time(&inode->i_mtime);
+		fc.fc_ctime = cpu_to_le32(inode->i_ctime.tv_sec);
+		fc.fc_ctime_extra = ext4_encode_extra_time(&inode->i_ctime);
+		memcpy(fc.fc_data, ei->i_data, sizeof(fc.fc_data));
+		ret = 0;
+	}
+	up_read(&ei->i_data_sem);
+	ext4_journal_stop(handle);
+	if (ret)
+		goto fallback;
+
+	/*
+	 * Recovery only looks at records of the first transaction missing
+	 * from the log, so the previous one has to be complete before this
+	 * record can be relied on or can replace that one's records.
+	 */
+	ret = jbd2_log_wait_commit(journal, tid - 1);
+	if (ret)
+		return ret;
+	if (journal->j_fs_dev != journal->j_dev &&
+	    (journal->j_flags & JBD2_BARRIER)) {
+		ret = jbd2_journal_flush_fs_dev(journal);
+		if (ret)
+			return ret;
+	}
+
+	/*
+	 * Records are replayed in order; i_mutex keeps those of one inode
+	 * in the order their state was copied.
+	 */
+	mutex_lock(&sbi->s_fc_lock);
+	if (sbi->s_fc_tid != tid) {
+		if (tid_gt(sbi->s_fc_tid, tid)) {
+			mutex_unlock(&sbi->s_fc_lock);
+			goto fallback;
+		}
+		sbi->s_fc_tid = tid;
+		sbi->s_fc_next = 0;
+	}
+	if (sbi->s_fc_next >= journal->j_fc_last - journal->j_fc_first) {
+		mutex_unlock(&sbi->s_fc_lock);
+		goto fallback;
+	}
+	fc.fc_index = cpu_to_le32(sbi->s_fc_next);
+	fc.fc_csum = ext4_fc_csum(sb, &fc);
+	ret = ext4_fc_write_block(journal, sbi->s_fc_next, &fc);
+	if (!ret) {
+		sbi->s_fc_next++;
+		sbi->s_fc_commits++;
+	}
+	mutex_unlock(&sbi->s_fc_lock);
+	if (!ret)
+		return 0;
+
+fallback:
+	sbi->s_fc_fallbacks++;
+	return -EAGAIN;
+}
+
+/*
+ * Mark the blocks of a replayed extent in use.  The transaction that
+ * allocated them never made it to the log.
+ */
+static int ext4_fc_mark_used(struct super_block *sb, ext4_fsblk_t block,
+			     unsigned int count)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_group_desc *gdp;
+	struct buffer_head *bitmap_bh, *gdp_bh;
+	ext4_group_t group;
+	ext4_grpblk_t bit;
+	unsigned int i, n, newly;
+
+	while (count) {
+		ext4_get_group_no_and_offset(sb, block, &group, &bit);
+		n = min_t(unsigned int, count, EXT4_BLOCKS_PER_GROUP(sb) - bit);
+
+		bitmap_bh = ext4_read_block_bitmap(sb, group);
+		if (!bitmap_bh)
+			return -EIO;
+		gdp = ext4_get_group_desc(sb, group, &gdp_bh);
+		if (!gdp) {
+			brelse(bitmap_bh);
+			return -EIO;
+		}
+
+		ext4_lock_group(sb, group);
+		if (gdp->bg_flags & cpu_to_le16(EXT4_BG_BLOCK_UNINIT)) {
+			gdp->bg_flags &= cpu_to_le16(~EXT4_BG_BLOCK_UNINIT);
+			ext4_free_blks_set(sb, gdp,
+				ext4_free_blocks_after_init(sb, group, gdp));
+		}
+		for (i = 0, newly = 0; i < n; i++)
+			if (!ext4_set_bit(bit + i, bitmap_bh->b_data))
+				newly++;
+		ext4_free_blks_set(sb, gdp,
+				   ext4_free_blks_count(sb, gdp) - newly);
+		gdp->bg_checksum = ext4_group_desc_csum(sbi, group, gdp);
+		ext4_unlock_group(sb, group);
+
+		if (sbi->s_log_groups_per_flex && sbi->s_flex_groups)
+			atomic_sub(newly, &sbi->s_flex_groups[
+				   ext4_flex_group(sbi, group)].free_blocks);
+
+		mark_buffer_dirty(bitmap_bh);
+		mark_buffer_dirty(gdp_bh);
+		brelse(bitmap_bh);
+
+		block += n;
+		count -= n;
+	}
+	return 0;
+}
+
+static int ext4_fc_replay_inode(struct super_block *sb,
+				struct ext4_fc_block *fc)
+{
+	struct ext4_super_block *es = EXT4_SB(sb)->s_es;
+	struct ext4_extent_header *eh;
+	struct ext4_extent *ex;
+	struct ext4_group_desc *gdp;
+	struct ext4_inode *raw;
+	struct buffer_head *bh;
+	unsigned long ino = le32_to_cpu(fc->fc_ino);
+	unsigned long offset;
+	ext4_fsblk_t pblk;
+	unsigned int len, extra_isize;
+	int i, ret;
+
+	if (ino < EXT4_FIRST_INO(sb) || ino > le32_to_cpu(es->s_inodes_count))
+		return -EIO;
+
+	eh = (struct ext4_extent_header *)fc->fc_data;
+	if (eh->eh_magic != EXT4_EXT_MAGIC || eh->eh_depth ||
+	    le16_to_cpu(eh->eh_max) > (sizeof(fc->fc_data) - sizeof(*eh)) /
+				      sizeof(struct ext4_extent) ||
+	    le16_to_cpu(eh->eh_entries) > le16_to_cpu(eh->eh_max))
+		return -EIO;
+	for (i = 0, ex = EXT_FIRST_EXTENT(eh);
+	     i < le16_to_cpu(eh->eh_entries); i++, ex++) {
+		pblk = ext4_ext_pblock(ex);
+		len = ext4_ext_get_actual_len(ex);
+		if (!len || pblk < le32_to_cpu(es->s_first_data_block) ||
+		    pblk + len > ext4_blocks_count(es))
+			return -EIO;
+	}
+
+	offset = ((ino - 1) % EXT4_INODES_PER_GROUP(sb)) * EXT4_INODE_SIZE(sb);
+	gdp = ext4_get_group_desc(sb, (ino - 1) / EXT4_INODES_PER_GROUP(sb),
+				  NULL);
+	if (!gdp)
+		return -EIO;
+	bh = sb_bread(sb, ext4_inode_table(sb, gdp) +
+		      offset / EXT4_BLOCK_SIZE(sb));
+	if (!bh)
+		return -EIO;
+	raw = (struct ext4_inode *)(bh->b_data + offset % EXT4_BLOCK_SIZE(sb));
+
+	/* Deleted or reused by the time the log was last committed */
+	if (!raw->i_links_count || !S_ISREG(le16_to_cpu(raw->i_mode)) ||
+	    !(le32_to_cpu(raw->i_flags) & EXT4_EXTENTS_FL) ||
+	    !(le32_to_cpu(fc->fc_flags) & EXT4_EXTENTS_FL)) {
+		brelse(bh);
+		return 0;
+	}
+
+	for (i = 0, ex = EXT_FIRST_EXTENT(eh);
+	     i < le16_to_cpu(eh->eh_entries); i++, ex++) {
+		ret = ext4_fc_mark_used(sb, ext4_ext_pblock(ex),
+					ext4_ext_get_actual_len(ex));
+		if (ret) {
+			brelse(bh);
+			return ret;
+		}
+	}
+
+	raw->i_flags = fc->fc_flags;
+	memcpy(raw->i_block, fc->fc_data, sizeof(raw->i_block));
+	ext4_isize_set(raw, le64_to_cpu(fc->fc_size));
+	raw->i_blocks_lo = fc->fc_blocks;
+	raw->i_blocks_high = 0;
+	raw->i_mtime = fc->fc_mtime;
+	raw->i_ctime = fc->fc_ctime;
+	if (EXT4_INODE_SIZE(sb) > EXT4_GOOD_OLD_INODE_SIZE) {
+		extra_isize = EXT4_GOOD_OLD_INODE_SIZE +
+			      le16_to_cpu(raw->i_extra_isize);
+		if (offsetof(struct ext4_inode, i_ctime_extra) +
+		    sizeof(raw->i_ctime_extra) <= extra_isize)
+			raw->i_ctime_extra = fc->fc_ctime_extra;
+		if (offsetof(struct ext4_inode, i_mtime_extra) +
+		    sizeof(raw->i_mtime_extra) <= extra_isize)
+			raw->i_mtime_extra = fc->fc_mtime_extra;
+	}
+	mark_buffer_dirty(bh);
+	brelse(bh);
+	return 0;
+}
+
+/**
+ * ext4_fc_replay - replay the fast commit area after journal recovery
+ * @journal:	journal being recovered
+ * @tid:	first transaction that is not in the log
+ *
+ * Records are applied in order up to the first one that is invalid or
+ * belongs to another transaction.  Everything is written in place
+ * before jbd2 resets the log, so a crash in here replays again.
+ */
+int ext4_fc_replay(journal_t *journal, tid_t tid)
+{
+	struct super_block *sb = journal->j_private;
+	struct ext4_fc_block *fc;
+	struct buffer_head *bh;
+	unsigned int i;
+	int ret = 0;
+
+	for (i = 0; i < journal->j_fc_last - journal->j_fc_first; i++) {
+		bh = jbd2_fc_get_buf(journal, i);
+		if (!bh) {
+			ret = -EIO;
+			break;
+		}
+		if (!buffer_uptodate(bh)) {
+			ll_rw_block(READ, 1, &bh);
+			wait_on_buffer(bh);
+		}
+		if (!buffer_uptodate(bh)) {
+			brelse(bh);
+			ret = -EIO;
+			break;
+		}
+
+		fc = (struct ext4_fc_block *)bh->b_data;
+		if (fc->fc_magic != cpu_to_le32(EXT4_FC_MAGIC) ||
+		    le32_to_cpu(fc->fc_tid) != tid ||
+		    le32_to_cpu(fc->fc_index) != i ||
+		    fc->fc_csum != ext4_fc_csum(sb, fc)) {
+			brelse(bh);
+			break;
+		}
+		ret = ext4_fc_replay_inode(sb, fc);
+		brelse(bh);
+		if (ret)
+			break;
+	}
+
+	if (ret)
+		ext4_msg(sb, KERN_ERR, "fast commit replay failed at "
+			 "record %u of transaction %u", i, tid);
+	else if (i)
+		ext4_msg(sb, KERN_INFO, "replayed %u fast commit record(s) "
+			 "of transaction %u", i, tid);
+	return ret;
+}
+
+/**
+ * ext4_fc_setup - size the fast commit area after the journal is loaded
+ * @sb:		filesystem
+ *
+ * Without the fast_commit option the area is handed back to the log so
+ * that tools unaware of it can use the journal again.
+ */
+void ext4_fc_setup(struct super_block *sb)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	journal_t *journal = sbi->s_journal;
+	int err;
+
+	mutex_init(&sbi->s_fc_lock);
+	sbi->s_fc_tid = journal->j_transaction_sequence - 1;
+	sbi->s_fc_next = 0;
+	sbi->s_fc_ineligible_tid = sbi->s_fc_tid;
+
+	if (sb->s_flags & MS_RDONLY)
+		return;
+
+	err = jbd2_fc_init(journal, test_opt2(sb, FAST_COMMIT) ?
+			   EXT4_FC_BLOCKS : 0);
+	if (err) {
+		ext4_msg(sb, KERN_WARNING, "cannot set up fast commit area "
+			 "(%d), fast_commit disabled", err);
+		clear_opt2(sb, FAST_COMMIT);
+	}
+}
@@ -1059,6 +1059,8 @@ got:
 		ei->i_sync_tid = handle->h_transaction->t_tid;
 		ei->i_datasync_tid = handle->h_transaction->t_tid;
 	}
+	/* Neither the inode bitmap nor the directory entry are logged */
+	ext4_fc_mark_ineligible(sb, inode);
 
 	err = ext4_mark_inode_dirty(handle, inode);
 	if (err) {
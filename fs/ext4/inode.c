@@ -3940,6 +3940,8 @@ int ext4_setattr(struct dentry *dentry, struct iattr *attr)
 		setattr_copy(inode, attr);
 		mark_inode_dirty(inode);
 	}
+	/* Ownership, mode and the orphan list are not in fast commits */
+	ext4_fc_mark_ineligible(inode->i_sb, inode);
 
 	/*
 	 * If the call to ext4_truncate failed to get a transaction handle at
@@ -132,6 +132,7 @@ flags_err:
 		if (migrate)
 			err = ext4_ext_migrate(inode);
 flags_out:
+		ext4_fc_mark_ineligible(inode->i_sb, inode);
 		mutex_unlock(&inode->i_mutex);
 		mnt_drop_write(filp->f_path.mnt);
 		return err;
@@ -167,6 +168,7 @@ flags_out:
 			inode->i_ctime = ext4_current_time(inode);
 			inode->i_generation = generation;
 			err = ext4_mark_iloc_dirty(handle, inode, &iloc);
+			ext4_fc_mark_ineligible(inode->i_sb, inode);
 		}
 		ext4_journal_stop(handle);
 setversion_out:
@@ -256,6 +258,10 @@ setversion_out:
 
 		err = ext4_move_extents(filp, donor_filp, me.orig_start,
 					me.donor_start, me.len, &me.moved_len);
+		/* a record of either file alone would cross-link their blocks */
+		ext4_fc_mark_ineligible(inode->i_sb, inode);
+		ext4_fc_mark_ineligible(inode->i_sb,
+					donor_filp->f_path.dentry->d_inode);
 		mnt_drop_write(filp->f_path.mnt);
 		if (me.moved_len > 0)
 			file_remove_suid(donor_filp);
@@ -316,6 +322,7 @@ mext_out:
 		 */
 		mutex_lock(&(inode->i_mutex));
 		err = ext4_ext_migrate(inode);
+		ext4_fc_mark_ineligible(inode->i_sb, inode);
 		mutex_unlock(&(inode->i_mutex));
 		mnt_drop_write(filp->f_path.mnt);
 		return err;
@@ -681,23 +681,41 @@ static void ext4_mb_mark_free_simple(struct super_block *sb,
 
 /*
  * Cache the order of the largest free extent we have available in this block
- * group.
+ * group, and move the group to the matching per-order list so the allocator
+ * can find it without walking every group. Called with the group locked.
  */
 static void
 mb_set_largest_free_order(struct super_block *sb, struct ext4_group_info *grp)
 {
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
 	int i;
 	int bits;
-
-	grp->bb_largest_free_order = -1; /* uninit */
+	int old = grp->bb_largest_free_order;
+	int new = -1; /* uninit */
 
 	bits = sb->s_blocksize_bits + 1;
 	for (i = bits; i >= 0; i--) {
 		if (grp->bb_counters[i] > 0) {
-			grp->bb_largest_free_order = i;
+			new = i;
 			break;
 		}
 	}
+	grp->bb_largest_free_order = new;
+
+	if (new == old)
+		return;
+
+	if (old >= 0) {
+		write_lock(&sbi->s_mb_largest_free_orders_locks[old]);
+		list_del_init(&grp->bb_largest_free_order_node);
+		write_unlock(&sbi->s_mb_largest_free_orders_locks[old]);
+	}
+	if (new >= 0) {
+		write_lock(&sbi->s_mb_largest_free_orders_locks[new]);
+		list_add_tail(&grp->bb_largest_free_order_node,
+			      &sbi->s_mb_largest_free_orders[new]);
+		write_unlock(&sbi->s_mb_largest_free_orders_locks[new]);
+	}
 }
 
 static noinline_for_stack
@@ -1555,10 +1573,11 @@ static void ext4_mb_use_best_found(struct ext4_allocation_context *ac,
 	get_page(ac->ac_buddy_page);
 	/* store last allocated for subsequent stream allocation */
 	if (ac->ac_flags & EXT4_MB_STREAM_ALLOC) {
-		spin_lock(&sbi->s_md_lock);
-		sbi->s_mb_last_group = ac->ac_f_ex.fe_group;
-		sbi->s_mb_last_start = ac->ac_f_ex.fe_start;
-		spin_unlock(&sbi->s_md_lock);
+		struct ext4_mb_goal *goal = get_cpu_ptr(sbi->s_mb_last_goals);
+
+		goal->group = ac->ac_f_ex.fe_group;
+		goal->start = ac->ac_f_ex.fe_start;
+		put_cpu_ptr(sbi->s_mb_last_goals);
 	}
 }
 
@@ -1956,10 +1975,142 @@ static int ext4_mb_good_group(struct ext4_allocation_context *ac,
 	return 0;
 }
 
+/*
+ * Load the buddy of @group and, if the group still satisfies criteria @cr
+ * once it is locked, scan it for a free extent.
+ */
+static int ext4_mb_scan_group(struct ext4_allocation_context *ac,
+			      ext4_group_t group, int cr,
+			      struct ext4_buddy *e4b)
+{
+	struct super_block *sb = ac->ac_sb;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	int err;
+
+	err = ext4_mb_load_buddy(sb, group, e4b);
+	if (err)
+		return err;
+
+	ext4_lock_group(sb, group);
+
+	/*
+	 * We need to check again after locking the
+	 * block group
+	 */
+	if (!ext4_mb_good_group(ac, group, cr)) {
+		ext4_unlock_group(sb, group);
+		ext4_mb_unload_buddy(e4b);
+		return 0;
+	}
+
+	ac->ac_groups_scanned++;
+	if (cr == 0)
+		ext4_mb_simple_scan_group(ac, e4b);
+	else if (cr == 1 && sbi->s_stripe &&
+			!(ac->ac_g_ex.fe_len % sbi->s_stripe))
+		ext4_mb_scan_aligned(ac, e4b);
+	else
+		ext4_mb_complex_scan_group(ac, e4b);
+
+	ext4_unlock_group(sb, group);
+	ext4_mb_unload_buddy(e4b);
+	return 0;
+}
+
+/*
+ * Pick a group from the list of groups whose largest free extent has
+ * order @order. Groups already tried by this request are skipped, and
+ * a group whose lock is currently held by another allocator is only
+ * returned when nothing idle satisfies @cr.
+ */
+static int ext4_mb_pick_from_order(struct ext4_allocation_context *ac,
+				   int cr, int order, ext4_group_t ngroups,
+				   ext4_group_t *tried, int ntried,
+				   unsigned int *considered,
+				   ext4_group_t *found)
+{
+	struct super_block *sb = ac->ac_sb;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct ext4_group_info *grp;
+	int ret = 0, i;
+
+	read_lock(&sbi->s_mb_largest_free_orders_locks[order]);
+	list_for_each_entry(grp, &sbi->s_mb_largest_free_orders[order],
+			    bb_largest_free_order_node) {
+		/* ext4_mb_good_group() must not initialize under the lock */
+		if (grp->bb_group >= ngroups || EXT4_MB_GRP_NEED_INIT(grp))
+			continue;
+		for (i = 0; i < ntried; i++)
+			if (tried[i] == grp->bb_group)
+				break;
+		if (i < ntried)
+			continue;
+		(*considered)++;
+		if (!ext4_mb_good_group(ac, grp->bb_group, cr))
+			continue;
+		if (!spin_is_locked(ext4_group_lock_ptr(sb, grp->bb_group))) {
+			*found = grp->bb_group;
+			ret = 1;
+			break;
+		}
+		/* remember the first busy candidate as a fallback */
+		if (!ret) {
+			*found = grp->bb_group;
+			ret = 1;
+		}
+	}
+	read_unlock(&sbi->s_mb_largest_free_orders_locks[order]);
+
+	return ret;
+}
+
+/*
+ * Try the groups the per-order lists say can satisfy criteria 0 or 1,
+ * smallest sufficient order first. A free extent of length len always
+ * contains an aligned buddy of order fls(len) - 2, so for criteria 1 no
+ * initialized group below that order can qualify.
+ */
+static int ext4_mb_scan_order_lists(struct ext4_allocation_context *ac,
+				    int cr, ext4_group_t ngroups,
+				    unsigned int *considered,
+				    struct ext4_buddy *e4b)
+{
+	struct super_block *sb = ac->ac_sb;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	ext4_group_t tried[MB_DEFAULT_MAX_GROUPS_TO_SCAN];
+	ext4_group_t group;
+	int ntried = 0;
+	int order;
+	int err;
+
+	if (cr == 0)
+		order = ac->ac_2order;
+	else
+		order = max(fls(ac->ac_g_ex.fe_len) - 2, 0);
+
+	while (ntried < MB_DEFAULT_MAX_GROUPS_TO_SCAN &&
+	       order < MB_NUM_ORDERS(sb)) {
+		if (!ext4_mb_pick_from_order(ac, cr, order, ngroups, tried,
+					     ntried, considered, &group)) {
+			order++;
+			continue;
+		}
+		tried[ntried++] = group;
+		if (sbi->s_mb_stats)
+			atomic_inc(&sbi->s_bal_order_picks);
+
+		err = ext4_mb_scan_group(ac, group, cr, e4b);
+		if (err || ac->ac_status != AC_STATUS_CONTINUE)
+			return err;
+	}
+	return 0;
+}
+
 static noinline_for_stack int
 ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 {
 	ext4_group_t ngroups, group, i;
+	unsigned int considered;
 	int cr;
 	int err = 0;
 	struct ext4_sb_info *sbi;
@@ -2003,13 +2154,21 @@ ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 			ac->ac_2order = i - 1;
 	}
 
-	/* if stream allocation is enabled, use global goal */
+	/*
+	 * if stream allocation is enabled, continue where the last stream
+	 * allocation on this cpu ended, so concurrent writers on different
+	 * cpus don't all start from (and contend on) the same group
+	 */
 	if (ac->ac_flags & EXT4_MB_STREAM_ALLOC) {
-		/* TBD: may be hot point */
-		spin_lock(&sbi->s_md_lock);
-		ac->ac_g_ex.fe_group = sbi->s_mb_last_group;
-		ac->ac_g_ex.fe_start = sbi->s_mb_last_start;
-		spin_unlock(&sbi->s_md_lock);
+		struct ext4_mb_goal *goal = get_cpu_ptr(sbi->s_mb_last_goals);
+
+		ac->ac_g_ex.fe_group = goal->group;
+		ac->ac_g_ex.fe_start = goal->start;
+		put_cpu_ptr(sbi->s_mb_last_goals);
+		if (ac->ac_g_ex.fe_group >= ngroups) {
+			ac->ac_g_ex.fe_group = 0;
+			ac->ac_g_ex.fe_start = 0;
+		}
 	}
 
 	/* Let's just scan groups to find more-less suitable blocks */
@@ -2020,51 +2179,53 @@ ext4_mb_regular_allocator(struct ext4_allocation_context *ac)
 	 */
 repeat:
 	for (; cr < 4 && ac->ac_status == AC_STATUS_CONTINUE; cr++) {
+		int optimized = cr < 2 && sbi->s_mb_optimize_scan;
+
 		ac->ac_criteria = cr;
+		considered = 0;
+
+		/*
+		 * every initialized group that can satisfy criteria 0 or 1
+		 * sits on one of the per-order lists, so look there first;
+		 * the scan below then only has to initialize new groups
+		 */
+		if (optimized) {
+			err = ext4_mb_scan_order_lists(ac, cr, ngroups,
+						       &considered, &e4b);
+			if (err)
+				goto out;
+		}
+
 		/*
 		 * searching for the right group start
 		 * from the goal value specified
 		 */
 		group = ac->ac_g_ex.fe_group;
 
-		for (i = 0; i < ngroups; group++, i++) {
+		for (i = 0; i < ngroups &&
+			    ac->ac_status == AC_STATUS_CONTINUE; group++, i++) {
 			if (group == ngroups)
 				group = 0;
 
+			if (optimized && !EXT4_MB_GRP_NEED_INIT(
+					ext4_get_group_info(sb, group)))
+				continue;
+
 			/* This now checks without needing the buddy page */
+			considered++;
 			if (!ext4_mb_good_group(ac, group, cr))
 				continue;
 
-			err = ext4_mb_load_buddy(sb, group, &e4b);
+			err = ext4_mb_scan_group(ac, group, cr, &e4b);
 			if (err)
 				goto out;
+		}
 
-			ext4_lock_group(sb, group);
-
-			/*
-			 * We need to check again after locking the
-			 * block group
-			 */
-			if (!ext4_mb_good_group(ac, group, cr)) {
-				ext4_unlock_group(sb, group);
-				ext4_mb_unload_buddy(&e4b);
-				continue;
-			}
-
-			ac->ac_groups_scanned++;
-			if (cr == 0)
-				ext4_mb_simple_scan_group(ac, &e4b);
-			else if (cr == 1 && sbi->s_stripe &&
-					!(ac->ac_g_ex.fe_len % sbi->s_stripe))
-				ext4_mb_scan_aligned(ac, &e4b);
-			else
-				ext4_mb_complex_scan_group(ac, &e4b);
-
-			ext4_unlock_group(sb, group);
-			ext4_mb_unload_buddy(&e4b);
-
-			if (ac->ac_status != AC_STATUS_CONTINUE)
-				break;
+		if (sbi->s_mb_stats) {
+			atomic_add(considered,
+				   &sbi->s_bal_cX_groups_considered[cr]);
+			if (ac->ac_status == AC_STATUS_CONTINUE)
+				atomic_inc(&sbi->s_bal_cX_failed[cr]);
 		}
 	}
 
@@ -2093,6 +2254,8 @@ repeat:
 			goto repeat;
 		}
 	}
+	if (sbi->s_mb_stats && ac->ac_status == AC_STATUS_FOUND)
+		atomic_inc(&sbi->s_bal_cX_hits[ac->ac_criteria]);
 out:
 	return err;
 }
@@ -2196,6 +2359,67 @@ static const struct file_operations ext4_mb_seq_groups_fops = {
 	.release	= seq_release,
 };
 
+static int ext4_mb_seq_stats_show(struct seq_file *seq, void *v)
+{
+	struct super_block *sb = seq->private;
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	int cr;
+
+	seq_printf(seq, "mballoc:\n");
+	if (!sbi->s_mb_stats) {
+		seq_printf(seq, "\tmb stats collection turned off, "
+			   "write 1 to /sys/fs/ext4/%s/mb_stats to enable\n",
+			   sb->s_id);
+		return 0;
+	}
+	seq_printf(seq, "\treqs: %u\n", atomic_read(&sbi->s_bal_reqs));
+	seq_printf(seq, "\tsuccess: %u\n", atomic_read(&sbi->s_bal_success));
+	seq_printf(seq, "\tblocks_allocated: %u\n",
+		   atomic_read(&sbi->s_bal_allocated));
+	seq_printf(seq, "\tgroups_scanned: %u\n",
+		   atomic_read(&sbi->s_bal_groups_scanned));
+	seq_printf(seq, "\textents_scanned: %u\n",
+		   atomic_read(&sbi->s_bal_ex_scanned));
+	seq_printf(seq, "\tgoal_hits: %u\n", atomic_read(&sbi->s_bal_goals));
+	seq_printf(seq, "\t2^n_hits: %u\n", atomic_read(&sbi->s_bal_2orders));
+	seq_printf(seq, "\tbreaks: %u\n", atomic_read(&sbi->s_bal_breaks));
+	seq_printf(seq, "\tlost: %u\n", atomic_read(&sbi->s_mb_lost_chunks));
+	seq_printf(seq, "\toptimize_scan: %u\n", sbi->s_mb_optimize_scan);
+	seq_printf(seq, "\torder_list_picks: %u\n",
+		   atomic_read(&sbi->s_bal_order_picks));
+	for (cr = 0; cr < 4; cr++) {
+		seq_printf(seq, "\tcr%d_stats:\n", cr);
+		seq_printf(seq, "\t\thits: %u\n",
+			   atomic_read(&sbi->s_bal_cX_hits[cr]));
+		seq_printf(seq, "\t\tgroups_considered: %u\n",
+			   atomic_read(&sbi->s_bal_cX_groups_considered[cr]));
+		seq_printf(seq, "\t\tuseless_loops: %u\n",
+			   atomic_read(&sbi->s_bal_cX_failed[cr]));
+	}
+	seq_printf(seq, "\tbuddies_generated: %lu\n",
+		   sbi->s_mb_buddies_generated);
+	seq_printf(seq, "\tbuddies_time_used: %llu\n",
+		   sbi->s_mb_generation_time);
+	seq_printf(seq, "\tpreallocated: %u\n",
+		   atomic_read(&sbi->s_mb_preallocated));
+	seq_printf(seq, "\tdiscarded: %u\n",
+		   atomic_read(&sbi->s_mb_discarded));
+	return 0;
+}
+
+static int ext4_mb_seq_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ext4_mb_seq_stats_show, PDE(inode)->data);
+}
+
+static const struct file_operations ext4_mb_seq_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= ext4_mb_seq_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static struct kmem_cache *get_groupinfo_cache(int blocksize_bits)
 {
 	int cache_index = blocksize_bits - EXT4_MIN_BLOCK_LOG_SIZE;
@@ -2259,9 +2483,11 @@ int ext4_mb_add_groupinfo(struct super_block *sb, ext4_group_t group,
 	}
 
 	INIT_LIST_HEAD(&meta_group_info[i]->bb_prealloc_list);
+	INIT_LIST_HEAD(&meta_group_info[i]->bb_largest_free_order_node);
 	init_rwsem(&meta_group_info[i]->alloc_sem);
 	meta_group_info[i]->bb_free_root = RB_ROOT;
 	meta_group_info[i]->bb_largest_free_order = -1;  /* uninit */
+	meta_group_info[i]->bb_group = group;
 
 #ifdef DOUBLE_CHECK
 	{
@@ -2465,6 +2691,37 @@ int ext4_mb_init(struct super_block *sb, int needs_recovery)
 		i++;
 	} while (i <= sb->s_blocksize_bits + 1);
 
+	i = MB_NUM_ORDERS(sb) * sizeof(*sbi->s_mb_largest_free_orders);
+	sbi->s_mb_largest_free_orders = kmalloc(i, GFP_KERNEL);
+	if (sbi->s_mb_largest_free_orders == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	i = MB_NUM_ORDERS(sb) * sizeof(*sbi->s_mb_largest_free_orders_locks);
+	sbi->s_mb_largest_free_orders_locks = kmalloc(i, GFP_KERNEL);
+	if (sbi->s_mb_largest_free_orders_locks == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	for (i = 0; i < MB_NUM_ORDERS(sb); i++) {
+		INIT_LIST_HEAD(&sbi->s_mb_largest_free_orders[i]);
+		rwlock_init(&sbi->s_mb_largest_free_orders_locks[i]);
+	}
+
+	sbi->s_mb_last_goals = alloc_percpu(struct ext4_mb_goal);
+	if (sbi->s_mb_last_goals == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	/* spread the stream allocation goals of the cpus over the disk */
+	for_each_possible_cpu(i) {
+		struct ext4_mb_goal *goal;
+		goal = per_cpu_ptr(sbi->s_mb_last_goals, i);
+		goal->group = ext4_get_groups_count(sb) / nr_cpu_ids * i;
+		goal->start = 0;
+	}
+
 	spin_lock_init(&sbi->s_md_lock);
 	spin_lock_init(&sbi->s_bal_lock);
 
@@ -2474,6 +2731,7 @@ int ext4_mb_init(struct super_block *sb, int needs_recovery)
 	sbi->s_mb_stream_request = MB_DEFAULT_STREAM_THRESHOLD;
 	sbi->s_mb_order2_reqs = MB_DEFAULT_ORDER2_REQS;
 	sbi->s_mb_group_prealloc = MB_DEFAULT_GROUP_PREALLOC;
+	sbi->s_mb_optimize_scan = MB_DEFAULT_OPTIMIZE_SCAN;
 	/*
 	 * If there is a s_stripe > 1, then we set the s_mb_group_prealloc
 	 * to the lowest multiple of s_stripe which is bigger than
@@ -2507,14 +2765,20 @@ int ext4_mb_init(struct super_block *sb, int needs_recovery)
 		goto out;
 	}
 
-	if (sbi->s_proc)
+	if (sbi->s_proc) {
 		proc_create_data("mb_groups", S_IRUGO, sbi->s_proc,
 				 &ext4_mb_seq_groups_fops, sb);
+		proc_create_data("mb_stats", S_IRUGO, sbi->s_proc,
+				 &ext4_mb_seq_stats_fops, sb);
+	}
 
 	if (sbi->s_journal)
 		sbi->s_journal->j_commit_callback = release_blocks_on_commit;
 out:
 	if (ret) {
+		free_percpu(sbi->s_mb_last_goals);
+		kfree(sbi->s_mb_largest_free_orders_locks);
+		kfree(sbi->s_mb_largest_free_orders);
 		kfree(sbi->s_mb_offsets);
 		kfree(sbi->s_mb_maxs);
 	}
@@ -2566,6 +2830,8 @@ int ext4_mb_release(struct super_block *sb)
 			kfree(sbi->s_group_info[i]);
 		ext4_kvfree(sbi->s_group_info);
 	}
+	kfree(sbi->s_mb_largest_free_orders);
+	kfree(sbi->s_mb_largest_free_orders_locks);
 	kfree(sbi->s_mb_offsets);
 	kfree(sbi->s_mb_maxs);
 	if (sbi->s_buddy_cache)
@@ -2595,8 +2861,11 @@ int ext4_mb_release(struct super_block *sb)
 	}
 
 	free_percpu(sbi->s_locality_groups);
-	if (sbi->s_proc)
+	free_percpu(sbi->s_mb_last_goals);
+	if (sbi->s_proc) {
+		remove_proc_entry("mb_stats", sbi->s_proc);
 		remove_proc_entry("mb_groups", sbi->s_proc);
+	}
 
 	return 0;
 }
@@ -3075,6 +3344,7 @@ static void ext4_mb_collect_stats(struct ext4_allocation_context *ac)
 		if (ac->ac_b_ex.fe_len >= ac->ac_o_ex.fe_len)
 			atomic_inc(&sbi->s_bal_success);
 		atomic_add(ac->ac_found, &sbi->s_bal_ex_scanned);
+		atomic_add(ac->ac_groups_scanned, &sbi->s_bal_groups_scanned);
 		if (ac->ac_g_ex.fe_start == ac->ac_b_ex.fe_start &&
 				ac->ac_g_ex.fe_group == ac->ac_b_ex.fe_group)
 			atomic_inc(&sbi->s_bal_goals);
@@ -4543,6 +4813,10 @@ void ext4_free_blocks(handle_t *handle, struct inode *inode,
 	 */
 	if (!ext4_should_writeback_data(inode))
 		flags |= EXT4_FREE_BLOCKS_METADATA;
+	else
+		/* a fast commit could hand the blocks to another file */
+		ext4_fc_mark_ineligible(sb, NULL);
+	ext4_fc_mark_ineligible(sb, inode);
 
 do_more:
 	overflow = 0;
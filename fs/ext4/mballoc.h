@@ -69,6 +69,16 @@ extern u8 mb_enable_debug;
  */
 #define MB_DEFAULT_MAX_GROUPS_TO_SCAN	5
 
+/*
+ * Pick groups for criteria 0 and 1 from the per-order lists of groups
+ * instead of scanning all groups from the goal onwards.
+ * Can be changed via /sys/fs/ext4/<partition>/mb_optimize_scan
+ */
+#define MB_DEFAULT_OPTIMIZE_SCAN	1
+
+/* number of buddy orders tracked per group, order 0 being the bitmap */
+#define MB_NUM_ORDERS(sb)		((sb)->s_blocksize_bits + 2)
+
 /*
  * with 'ext4_mb_stats' allocator will collect stats that will be
  * shown at umount. The collecting costs though!
@@ -162,6 +172,15 @@ struct ext4_locality_group {
 	spinlock_t		lg_prealloc_lock;
 };
 
+/*
+ * Where the last stream allocation on this cpu ended; the next stream
+ * allocation starts looking from there.
+ */
+struct ext4_mb_goal {
+	ext4_group_t		group;
+	ext4_grpblk_t		start;
+};
+
 struct ext4_allocation_context {
 	struct inode *ac_inode;
 	struct super_block *ac_sb;
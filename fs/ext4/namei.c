@@ -2227,6 +2227,7 @@ static int ext4_unlink(struct inode *dir, struct dentry *dentry)
 		ext4_orphan_add(handle, inode);
 	inode->i_ctime = ext4_current_time(inode);
 	ext4_mark_inode_dirty(handle, inode);
+	ext4_fc_mark_ineligible(inode->i_sb, inode);
 	retval = 0;
 
 end_unlink:
@@ -2371,6 +2372,7 @@ retry:
 	err = ext4_add_entry(handle, dentry, inode);
 	if (!err) {
 		ext4_mark_inode_dirty(handle, inode);
+		ext4_fc_mark_ineligible(inode->i_sb, inode);
 		d_instantiate(dentry, inode);
 	} else {
 		drop_nlink(inode);
@@ -2491,6 +2493,8 @@ static int ext4_rename(struct inode *old_dir, struct dentry *old_dentry,
 	 */
 	old_inode->i_ctime = ext4_current_time(old_inode);
 	ext4_mark_inode_dirty(handle, old_inode);
+	/* fsync of a renamed file is expected to persist the rename */
+	ext4_fc_mark_ineligible(old_dir->i_sb, old_inode);
 
 	/*
 	 * ok, that's it
@@ -2549,6 +2553,7 @@ static int ext4_rename(struct inode *old_dir, struct dentry *old_dentry,
 	ext4_mark_inode_dirty(handle, old_dir);
 	if (new_inode) {
 		ext4_mark_inode_dirty(handle, new_inode);
+		ext4_fc_mark_ineligible(new_dir->i_sb, new_inode);
 		if (!new_inode->i_nlink)
 			ext4_orphan_add(handle, new_inode);
 		if (!test_opt(new_dir->i_sb, NO_AUTO_DA_ALLOC))
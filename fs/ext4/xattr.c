@@ -1061,6 +1061,7 @@ ext4_xattr_set_handle(handle_t *handle, struct inode *inode, int name_index,
 		 * error != 0.
 		 */
 		is.iloc.bh = NULL;
+		ext4_fc_mark_ineligible(inode->i_sb, inode);
 		if (IS_SYNC(inode))
 			ext4_handle_sync(handle);
 	}
@@ -320,6 +320,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	unsigned long long blocknr;
 	ktime_t start_time;
 	u64 commit_time;
+	int fsync_count;
 	char *tagp = NULL;
 	journal_header_t *header;
 	journal_block_tag_t *tag = NULL;
@@ -994,6 +995,10 @@ restart_loop:
 	journal->j_stats.run.rs_handle_count += stats.run.rs_handle_count;
 	journal->j_stats.run.rs_blocks += stats.run.rs_blocks;
 	journal->j_stats.run.rs_blocks_logged += stats.run.rs_blocks_logged;
+	fsync_count = atomic_read(&commit_transaction->t_fsync_count);
+	if (fsync_count)
+		journal->j_stats.ts_fsync_batch[min(fls(fsync_count - 1),
+					JBD2_FSYNC_BATCH_BUCKETS - 1)]++;
 	spin_unlock(&journal->j_history_lock);
 
 	commit_transaction->t_state = T_FINISHED;
@@ -44,6 +44,8 @@
 #include <linux/backing-dev.h>
 #include <linux/bitops.h>
 #include <linux/ratelimit.h>
+#include <linux/blkdev.h>
+#include <linux/hrtimer.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/jbd2.h>
@@ -82,10 +84,14 @@ EXPORT_SYMBOL(jbd2_journal_errno);
 EXPORT_SYMBOL(jbd2_journal_ack_err);
 EXPORT_SYMBOL(jbd2_journal_clear_err);
 EXPORT_SYMBOL(jbd2_log_wait_commit);
+EXPORT_SYMBOL(jbd2_complete_fsync);
+EXPORT_SYMBOL(jbd2_journal_flush_fs_dev);
 EXPORT_SYMBOL(jbd2_log_start_commit);
 EXPORT_SYMBOL(jbd2_journal_start_commit);
 EXPORT_SYMBOL(jbd2_journal_force_commit_nested);
 EXPORT_SYMBOL(jbd2_journal_wipe);
+EXPORT_SYMBOL(jbd2_fc_init);
+EXPORT_SYMBOL(jbd2_fc_get_buf);
 EXPORT_SYMBOL(jbd2_journal_blocks_per_page);
 EXPORT_SYMBOL(jbd2_journal_invalidatepage);
 EXPORT_SYMBOL(jbd2_journal_try_to_free_buffers);
@@ -662,6 +668,115 @@ int jbd2_log_wait_commit(journal_t *journal, tid_t tid)
 	return err;
 }
 
+static void jbd2_account_fsync(journal_t *journal, ktime_t start)
+{
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	spin_lock(&journal->j_history_lock);
+	lat_hist_add(&journal->j_stats.ts_fsync_lat, ns);
+	spin_unlock(&journal->j_history_lock);
+}
+
+/**
+ * int jbd2_complete_fsync() - commit a transaction for fsync
+ * @journal: journal of the file being synced
+ * @tid: transaction that has to reach the disk
+ *
+ * Equivalent to jbd2_log_start_commit() followed by jbd2_log_wait_commit(),
+ * except that when @tid is still running and fsync callers from other
+ * processes are arriving, the commit is held back until the transaction
+ * has been open for about as long as a commit takes.  Concurrent fsyncs
+ * then join the same transaction and share one commit and one cache
+ * flush instead of queueing up behind each other.  Like the batching in
+ * jbd2_journal_stop(), the delay is bounded by j_min_batch_time and
+ * j_max_batch_time, and a single process doing a stream of fsyncs
+ * never waits.
+ */
+int jbd2_complete_fsync(journal_t *journal, tid_t tid)
+{
+	transaction_t *transaction;
+	ktime_t start = ktime_get();
+	pid_t pid = current->pid;
+	u64 commit_time = 0, trans_time = 0;
+	int err;
+
+	read_lock(&journal->j_state_lock);
+	transaction = journal->j_running_transaction;
+	if (transaction && transaction->t_tid == tid) {
+		atomic_inc(&transaction->t_fsync_count);
+		if (journal->j_last_fsync_pid != pid) {
+			commit_time = journal->j_average_commit_time;
+			trans_time = ktime_to_ns(ktime_sub(start,
+						transaction->t_start_time));
+		}
+	} else {
+		transaction = journal->j_committing_transaction;
+		if (transaction && transaction->t_tid == tid)
+			atomic_inc(&transaction->t_fsync_count);
+	}
+	read_unlock(&journal->j_state_lock);
+	journal->j_last_fsync_pid = pid;
+
+	if (commit_time) {
+		commit_time = max_t(u64, commit_time,
+				    1000*journal->j_min_batch_time);
+		commit_time = min_t(u64, commit_time,
+				    1000*journal->j_max_batch_time);
+
+		if (trans_time < commit_time) {
+			ktime_t expires = ktime_add_ns(start,
+						commit_time - trans_time);
+			set_current_state(TASK_UNINTERRUPTIBLE);
+			schedule_hrtimeout(&expires, HRTIMER_MODE_ABS);
+		}
+	}
+
+	jbd2_log_start_commit(journal, tid);
+	err = jbd2_log_wait_commit(journal, tid);
+
+	jbd2_account_fsync(journal, start);
+	return err;
+}
+
+/**
+ * int jbd2_journal_flush_fs_dev() - flush the filesystem device cache
+ * @journal: journal of the filesystem
+ *
+ * Used by fsync when the commit does not flush the data for it.  Callers
+ * that arrive while a flush is running wait for it and then share the
+ * next one, so a burst of fsyncs sends one flush per batch rather than
+ * one per caller.
+ */
+int jbd2_journal_flush_fs_dev(journal_t *journal)
+{
+	unsigned long seq;
+	int issued = 0;
+	int err;
+
+	/* order against the completion of the caller's data writes */
+	smp_mb();
+	seq = ACCESS_ONCE(journal->j_flush_seq);
+
+	mutex_lock(&journal->j_flush_mutex);
+	if (journal->j_flush_seq != seq) {
+		/* a flush that started after we got here covers us */
+		err = journal->j_flush_err;
+	} else {
+		journal->j_flush_seq++;
+		err = blkdev_issue_flush(journal->j_fs_dev, GFP_KERNEL, NULL);
+		journal->j_flush_err = err;
+		issued = 1;
+	}
+	mutex_unlock(&journal->j_flush_mutex);
+
+	spin_lock(&journal->j_history_lock);
+	journal->j_stats.ts_flushes += issued;
+	journal->j_stats.ts_flush_callers++;
+	spin_unlock(&journal->j_history_lock);
+
+	return err;
+}
+
 /*
  * Log buffer allocation routines:
  */
@@ -744,6 +859,25 @@ struct journal_head *jbd2_journal_get_descriptor_buffer(journal_t *journal)
 	return jbd2_journal_add_journal_head(bh);
 }
 
+/**
+ * struct buffer_head *jbd2_fc_get_buf() - Get a fast commit area block
+ * @journal: Journal to act on.
+ * @index: Block within the fast commit area.
+ *
+ * Returns the buffer without reading it; the caller owns the contents
+ * and does its own I/O.  NULL if the block is out of range or unmapped.
+ */
+struct buffer_head *jbd2_fc_get_buf(journal_t *journal, unsigned int index)
+{
+	unsigned long long blocknr;
+
+	if (index >= journal->j_fc_last - journal->j_fc_first)
+		return NULL;
+	if (jbd2_journal_bmap(journal, journal->j_fc_first + index, &blocknr))
+		return NULL;
+	return __getblk(journal->j_dev, blocknr, journal->j_blocksize);
+}
+
 struct jbd2_stats_proc_session {
 	journal_t *journal;
 	struct transaction_stats_s *stats;
@@ -764,6 +898,7 @@ static void *jbd2_seq_info_next(struct seq_file *seq, void *v, loff_t *pos)
 static int jbd2_seq_info_show(struct seq_file *seq, void *v)
 {
 	struct jbd2_stats_proc_session *s = seq->private;
+	int i;
 
 	if (v != SEQ_START_TOKEN)
 		return 0;
@@ -790,6 +925,22 @@ static int jbd2_seq_info_show(struct seq_file *seq, void *v)
 	    s->stats->run.rs_blocks / s->stats->ts_tid);
 	seq_printf(seq, "  %lu logged blocks per transaction\n",
 	    s->stats->run.rs_blocks_logged / s->stats->ts_tid);
+
+	seq_printf(seq, "fsync callers per commit:\n");
+	for (i = 0; i < JBD2_FSYNC_BATCH_BUCKETS; i++) {
+		if (i == JBD2_FSYNC_BATCH_BUCKETS - 1)
+			seq_printf(seq, "  %4u+     %lu\n",
+				   (1U << (i - 1)) + 1,
+				   s->stats->ts_fsync_batch[i]);
+		else
+			seq_printf(seq, "  %4u-%-4u %lu\n",
+				   i ? (1U << (i - 1)) + 1 : 1, 1U << i,
+				   s->stats->ts_fsync_batch[i]);
+	}
+	lat_hist_seq_header(seq, "");
+	lat_hist_seq_show(seq, "fsync commit", &s->stats->ts_fsync_lat);
+	seq_printf(seq, "%lu data flushes for %lu fsync callers\n",
+		   s->stats->ts_flushes, s->stats->ts_flush_callers);
 	return 0;
 }
 
@@ -896,6 +1047,7 @@ static journal_t * journal_init_common (void)
 	init_waitqueue_head(&journal->j_wait_updates);
 	mutex_init(&journal->j_barrier);
 	mutex_init(&journal->j_checkpoint_mutex);
+	mutex_init(&journal->j_flush_mutex);
 	spin_lock_init(&journal->j_revoke_lock);
 	spin_lock_init(&journal->j_list_lock);
 	rwlock_init(&journal->j_state_lock);
@@ -1085,13 +1237,25 @@ static void journal_fail_superblock (journal_t *journal)
  * subsequent use.
  */
 
+/*
+ * Number of blocks at the end of the journal that the client keeps for
+ * its fast commits.  The log wraps before them.
+ */
+static unsigned int journal_fc_blocks(journal_t *journal)
+{
+	if (!JBD2_HAS_INCOMPAT_FEATURE(journal,
+				       JBD2_FEATURE_INCOMPAT_FC_AREA))
+		return 0;
+	return be32_to_cpu(journal->j_superblock->s_fc_area_blks);
+}
+
 static int journal_reset(journal_t *journal)
 {
 	journal_superblock_t *sb = journal->j_superblock;
 	unsigned long long first, last;
 
 	first = be32_to_cpu(sb->s_first);
-	last = be32_to_cpu(sb->s_maxlen);
+	last = be32_to_cpu(sb->s_maxlen) - journal_fc_blocks(journal);
 	if (first + JBD2_MIN_JOURNAL_BLOCKS > last + 1) {
 		printk(KERN_ERR "JBD: Journal too short (blocks %llu-%llu).\n",
 		       first, last);
@@ -1101,6 +1265,8 @@ static int journal_reset(journal_t *journal)
 
 	journal->j_first = first;
 	journal->j_last = last;
+	journal->j_fc_first = last;
+	journal->j_fc_last = be32_to_cpu(sb->s_maxlen);
 
 	journal->j_head = first;
 	journal->j_tail = first;
@@ -1259,6 +1425,14 @@ static int journal_get_superblock(journal_t *journal)
 		goto out;
 	}
 
+	if (be32_to_cpu(sb->s_first) + JBD2_MIN_JOURNAL_BLOCKS +
+	    journal_fc_blocks(journal) > journal->j_maxlen) {
+		printk(KERN_WARNING
+			"JBD2: Invalid fast commit area size: %u\n",
+			journal_fc_blocks(journal));
+		goto out;
+	}
+
 	return 0;
 
 out:
@@ -1285,7 +1459,9 @@ static int load_superblock(journal_t *journal)
 	journal->j_tail_sequence = be32_to_cpu(sb->s_sequence);
 	journal->j_tail = be32_to_cpu(sb->s_start);
 	journal->j_first = be32_to_cpu(sb->s_first);
-	journal->j_last = be32_to_cpu(sb->s_maxlen);
+	journal->j_last = be32_to_cpu(sb->s_maxlen) - journal_fc_blocks(journal);
+	journal->j_fc_first = journal->j_last;
+	journal->j_fc_last = be32_to_cpu(sb->s_maxlen);
 	journal->j_errno = be32_to_cpu(sb->s_errno);
 
 	return 0;
@@ -1549,6 +1725,62 @@ void jbd2_journal_clear_features(journal_t *journal, unsigned long compat,
 }
 EXPORT_SYMBOL(jbd2_journal_clear_features);
 
+/**
+ * int jbd2_fc_init() - Resize the fast commit area
+ * @journal: Journal to act on, loaded and with nothing logged yet.
+ * @num_fc_blks: Blocks to set aside, 0 to give them back to the log.
+ *
+ * The area is taken from the end of the journal and flagged with
+ * INCOMPAT_FC_AREA, so that tools which do not know to replay it
+ * leave the journal alone.  Its contents belong to the client, which
+ * replays them from j_fc_replay_callback during recovery.
+ */
+int jbd2_fc_init(journal_t *journal, unsigned int num_fc_blks)
+{
+	journal_superblock_t *sb = journal->j_superblock;
+	unsigned long last;
+	int err = 0;
+
+	if (num_fc_blks == journal_fc_blocks(journal))
+		return 0;
+	if (num_fc_blks && !jbd2_journal_check_available_features(journal,
+				0, 0, JBD2_FEATURE_INCOMPAT_FC_AREA))
+		return -EINVAL;
+
+	last = journal->j_maxlen - num_fc_blks;
+	if (journal->j_first + JBD2_MIN_JOURNAL_BLOCKS > last)
+		return -EINVAL;
+
+	write_lock(&journal->j_state_lock);
+	if (journal->j_running_transaction ||
+	    journal->j_committing_transaction ||
+	    journal->j_checkpoint_transactions ||
+	    journal->j_head != journal->j_tail) {
+		err = -EBUSY;
+		goto out;
+	}
+
+	journal->j_last = last;
+	journal->j_fc_first = last;
+	journal->j_fc_last = journal->j_maxlen;
+	journal->j_head = journal->j_first;
+	journal->j_tail = journal->j_first;
+	journal->j_free = last - journal->j_first;
+
+	if (num_fc_blks)
+		sb->s_feature_incompat |=
+			cpu_to_be32(JBD2_FEATURE_INCOMPAT_FC_AREA);
+	else
+		sb->s_feature_incompat &=
+			~cpu_to_be32(JBD2_FEATURE_INCOMPAT_FC_AREA);
+	sb->s_fc_area_blks = cpu_to_be32(num_fc_blks);
+out:
+	write_unlock(&journal->j_state_lock);
+	if (!err)
+		jbd2_journal_update_superblock(journal, 1);
+	return err;
+}
+
 /**
  * int jbd2_journal_update_format () - Update on-disk journal structure.
  * @journal: Journal to act on.
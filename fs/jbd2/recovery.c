@@ -210,6 +210,20 @@ do {									\
 		var -= ((journal)->j_last - (journal)->j_first);	\
 } while (0)
 
+/*
+ * Hand the fast commit area to the client once the log is replayed.
+ * Anything it holds was written for the first transaction that did not
+ * make it to the log; records of committed transactions are stale.
+ */
+static int fc_replay(journal_t *journal)
+{
+	if (!journal->j_fc_replay_callback ||
+	    journal->j_fc_first == journal->j_fc_last)
+		return 0;
+	return journal->j_fc_replay_callback(journal,
+					journal->j_transaction_sequence - 1);
+}
+
 /**
  * jbd2_journal_recover - recovers a on-disk journal
  * @journal: the journal to recover
@@ -242,7 +256,10 @@ int jbd2_journal_recover(journal_t *journal)
 		jbd_debug(1, "No recovery required, last transaction %d\n",
 			  be32_to_cpu(sb->s_sequence));
 		journal->j_transaction_sequence = be32_to_cpu(sb->s_sequence) + 1;
-		return 0;
+		err = fc_replay(journal);
+		if (!err)
+			err = sync_blockdev(journal->j_fs_dev);
+		return err;
 	}
 
 	err = do_one_pass(journal, &info, PASS_SCAN);
@@ -261,6 +278,9 @@ int jbd2_journal_recover(journal_t *journal)
 	 * any existing commit records in the log. */
 	journal->j_transaction_sequence = ++info.end_transaction;
 
+	if (!err)
+		err = fc_replay(journal);
+
 	jbd2_journal_clear_revoke(journal);
 	err2 = sync_blockdev(journal->j_fs_dev);
 	if (!err)
@@ -77,6 +77,7 @@
 #include <linux/cpuset.h>
 #include <linux/audit.h>
 #include <linux/poll.h>
+#include <linux/eventpoll.h>
 #include <linux/nsproxy.h>
 #include <linux/oom.h>
 #include <linux/elf.h>
@@ -1942,7 +1943,7 @@ out:
 	return ~0U;
 }
 
-#define PROC_FDINFO_MAX 64
+#define PROC_FDINFO_MAX 256
 
 static int proc_fd_info(struct inode *inode, struct path *path, char *info)
 {
@@ -1975,12 +1976,17 @@ static int proc_fd_info(struct inode *inode, struct path *path, char *info)
 				*path = file->f_path;
 				path_get(&file->f_path);
 			}
-			if (info)
-				snprintf(info, PROC_FDINFO_MAX,
-					 "pos:\t%lli\n"
-					 "flags:\t0%o\n",
-					 (long long) file->f_pos,
-					 f_flags);
+			if (info) {
+				int len;
+
+				len = snprintf(info, PROC_FDINFO_MAX,
+					       "pos:\t%lli\n"
+					       "flags:\t0%o\n",
+					       (long long) file->f_pos,
+					       f_flags);
+				eventpoll_fdinfo(file, info + len,
+						 PROC_FDINFO_MAX - len);
+			}
 			spin_unlock(&files->file_lock);
 			put_files_struct(files);
 			return 0;
@@ -0,0 +1,251 @@
+/*
+ * YAFFS: Yet Another Flash File System. A NAND-flash specific file system.
+ *
+ * Copyright (C) 2002-2010 Aleph One Ltd.
+ *   for Toby Churchill Ltd and Brightstar Engineering
+ *
+ * Created by Charles Manning <charles@aleph1.co.uk>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include "yaffs_gcindex.h"
+#include "yaffs_getblockinfo.h"
+#include "yaffs_yaffs2.h"
+#include "yaffs_trace.h"
+
+/*
+ * Cost-benefit garbage collection index
+ *
+ * Every full block is filed in the tree for its number of live chunks
+ * (in use less soft deleted), ordered by sequence number. The collector
+ * wants the block that gives back the most space for the least copying,
+ * weighted by how long its data has been left alone:
+ *
+ *	benefit    free * age
+ *	------- = ------------
+ *	  cost    cpb + n_live
+ *
+ * free is what erasing the block gains, cpb + n_live the chunks read and
+ * rewritten to get there, and age the number of blocks allocated since.
+ * Blocks in the same tree only differ in age, so only the oldest of each
+ * tree can win and a selection costs chunks_per_block lookups rather than
+ * a scan of the device.
+ */
+
+/* How many blocks of a tree to try if the oldest may not be collected yet */
+#define YAFFS_GC_INDEX_TRIES	4
+
+static inline struct yaffs_gc_node *yaffs_gc_node(struct yaffs_dev *dev,
+						  int blk)
+{
+	return &dev->gc_nodes[blk - dev->internal_start_block];
+}
+
+static inline int yaffs_gc_node_blk(struct yaffs_dev *dev,
+				    struct yaffs_gc_node *gn)
+{
+	return (gn - dev->gc_nodes) + dev->internal_start_block;
+}
+
+/* The tree a block belongs in, -1 if it is not a gc candidate */
+static int yaffs_gc_live(struct yaffs_dev *dev, struct yaffs_block_info *bi)
+{
+	int n_live;
+
+	if (bi->block_state != YAFFS_BLOCK_STATE_FULL)
+		return -1;
+
+	n_live = bi->pages_in_use - bi->soft_del_pages;
+	if (n_live < 0)
+		n_live = 0;
+	if (n_live > dev->param.chunks_per_block)
+		n_live = dev->param.chunks_per_block;
+
+	return n_live;
+}
+
+int yaffs_gc_index_init(struct yaffs_dev *dev)
+{
+	int n_blocks = dev->internal_end_block - dev->internal_start_block + 1;
+	int i;
+
+	dev->gc_index = kmalloc((dev->param.chunks_per_block + 1) *
+				sizeof(struct rb_root), GFP_NOFS);
+	if (!dev->gc_index)
+		return YAFFS_FAIL;
+
+	dev->gc_nodes =
+		kmalloc(n_blocks * sizeof(struct yaffs_gc_node), GFP_NOFS);
+	if (!dev->gc_nodes) {
+		dev->gc_nodes =
+		    vmalloc(n_blocks * sizeof(struct yaffs_gc_node));
+		dev->gc_nodes_alt = 1;
+	} else {
+		dev->gc_nodes_alt = 0;
+	}
+
+	if (!dev->gc_nodes) {
+		kfree(dev->gc_index);
+		dev->gc_index = NULL;
+		return YAFFS_FAIL;
+	}
+
+	for (i = 0; i <= dev->param.chunks_per_block; i++)
+		dev->gc_index[i] = RB_ROOT;
+
+	for (i = 0; i < n_blocks; i++) {
+		dev->gc_nodes[i].seq_number = 0;
+		dev->gc_nodes[i].n_live = -1;
+	}
+
+	return YAFFS_OK;
+}
+
+void yaffs_gc_index_deinit(struct yaffs_dev *dev)
+{
+	if (dev->gc_nodes_alt && dev->gc_nodes)
+		vfree(dev->gc_nodes);
+	else if (dev->gc_nodes)
+		kfree(dev->gc_nodes);
+	dev->gc_nodes_alt = 0;
+	dev->gc_nodes = NULL;
+
+	kfree(dev->gc_index);
+	dev->gc_index = NULL;
+}
+
+/*
+ * yaffs_gc_index_update()
+ * Refile a block after its state or number of live chunks changed.
+ */
+void yaffs_gc_index_update(struct yaffs_dev *dev, int blk)
+{
+	struct yaffs_block_info *bi;
+	struct yaffs_gc_node *gn;
+	struct yaffs_gc_node *this;
+	struct rb_node **link;
+	struct rb_node *parent = NULL;
+	int n_live;
+
+	if (!dev->gc_index)
+		return;
+
+	bi = yaffs_get_block_info(dev, blk);
+	gn = yaffs_gc_node(dev, blk);
+	n_live = yaffs_gc_live(dev, bi);
+
+	if (gn->n_live == n_live &&
+	    (n_live < 0 || gn->seq_number == bi->seq_number))
+		return;
+
+	if (gn->n_live >= 0)
+		rb_erase(&gn->node, &dev->gc_index[gn->n_live]);
+
+	gn->n_live = n_live;
+	gn->seq_number = bi->seq_number;
+
+	if (n_live < 0)
+		return;
+
+	link = &dev->gc_index[n_live].rb_node;
+	while (*link) {
+		parent = *link;
+		this = rb_entry(parent, struct yaffs_gc_node, node);
+
+		if (gn->seq_number < this->seq_number ||
+		    (gn->seq_number == this->seq_number && gn < this))
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+
+	rb_link_node(&gn->node, parent, link);
+	rb_insert_color(&gn->node, &dev->gc_index[n_live]);
+}
+
+/*
+ * yaffs_gc_index_rebuild()
+ * Refile every block, for after a scan or checkpoint restore has set up
+ * the block info behind our back.
+ */
+void yaffs_gc_index_rebuild(struct yaffs_dev *dev)
+{
+	int blk;
+
+	if (!dev->gc_index)
+		return;
+
+	for (blk = dev->internal_start_block; blk <= dev->internal_end_block;
+	     blk++)
+		yaffs_gc_index_update(dev, blk);
+}
+
+/*
+ * yaffs_gc_index_find()
+ * Returns the block with the best cost-benefit among the full blocks that
+ * have at most max_live live chunks, or 0 if there is none.
+ */
+int yaffs_gc_index_find(struct yaffs_dev *dev, int max_live, int *n_live)
+{
+	int cpb = dev->param.chunks_per_block;
+	u64 best_gain = 0;
+	int best_live = 0;
+	int selected = 0;
+	int live;
+
+	if (!dev->gc_index)
+		return 0;
+
+	if (max_live > cpb - 1)
+		max_live = cpb - 1;
+
+	for (live = 0; live <= max_live; live++) {
+		struct rb_node *rb = rb_first(&dev->gc_index[live]);
+		int tries = 0;
+
+		while (rb && tries < YAFFS_GC_INDEX_TRIES) {
+			struct yaffs_gc_node *gn =
+			    rb_entry(rb, struct yaffs_gc_node, node);
+			int blk = yaffs_gc_node_blk(dev, gn);
+			struct yaffs_block_info *bi =
+			    yaffs_get_block_info(dev, blk);
+			u64 gain;
+
+			if (yaffs_gc_live(dev, bi) != live ||
+			    gn->seq_number != bi->seq_number) {
+				/* Missed an update. Refile it and start over */
+				yaffs_trace(YAFFS_TRACE_ERROR,
+					"gc index: block %d state %d is stale",
+					blk, bi->block_state);
+				yaffs_gc_index_update(dev, blk);
+				rb = rb_first(&dev->gc_index[live]);
+				continue;
+			}
+
+			tries++;
+			if (!yaffs_block_ok_for_gc(dev, bi)) {
+				rb = rb_next(rb);
+				continue;
+			}
+
+			/* gain / (cpb + live) > best_gain / (cpb + best_live) */
+			gain = (u64) (cpb - live) *
+			    (dev->seq_number - gn->seq_number + 1);
+			if (!selected ||
+			    gain * (cpb + best_live) > best_gain * (cpb + live)) {
+				selected = blk;
+				best_gain = gain;
+				best_live = live;
+			}
+			break;
+		}
+	}
+
+	if (selected)
+		*n_live = best_live;
+
+	return selected;
+}
@@ -34,11 +34,17 @@
 #include "yaffs_allocator.h"
 
 #include "yaffs_attribs.h"
+#include "yaffs_gcindex.h"
 
 /* Note YAFFS_GC_GOOD_ENOUGH must be <= YAFFS_GC_PASSIVE_THRESHOLD */
 #define YAFFS_GC_GOOD_ENOUGH 2
 #define YAFFS_GC_PASSIVE_THRESHOLD 4
 
+/* An object is hot while fewer than 1/8th of the blocks have been
+ * allocated since one of its chunks was last overwritten.
+ */
+#define YAFFS_HOT_WINDOW_SHIFT 3
+
 #include "yaffs_ecc.h"
 
 /* Forward declarations */
@@ -285,7 +291,6 @@ static void yaffs_handle_chunk_wr_error(struct yaffs_dev *dev, int nand_chunk,
 
 	/* Delete the chunk */
 	yaffs_chunk_del(dev, nand_chunk, 1, __LINE__);
-	yaffs_skip_rest_of_block(dev);
 }
 
 /*
@@ -440,16 +445,33 @@ static int yaffs_find_alloc_block(struct yaffs_dev *dev)
 	return -1;
 }
 
+/* The allocation block and page of a stream */
+static int *yaffs_stream_block(struct yaffs_dev *dev, int stream,
+			       u32 **alloc_page)
+{
+	if (stream == YAFFS_STREAM_COLD) {
+		if (alloc_page)
+			*alloc_page = &dev->cold_alloc_page;
+		return &dev->cold_alloc_block;
+	}
+
+	if (alloc_page)
+		*alloc_page = &dev->alloc_page;
+	return &dev->alloc_block;
+}
+
 static int yaffs_alloc_chunk(struct yaffs_dev *dev, int use_reserver,
-			     struct yaffs_block_info **block_ptr)
+			     int stream, struct yaffs_block_info **block_ptr)
 {
 	int ret_val;
 	struct yaffs_block_info *bi;
+	u32 *alloc_page;
+	int *alloc_block = yaffs_stream_block(dev, stream, &alloc_page);
 
-	if (dev->alloc_block < 0) {
+	if (*alloc_block < 0) {
 		/* Get next block to allocate off */
-		dev->alloc_block = yaffs_find_alloc_block(dev);
-		dev->alloc_page = 0;
+		*alloc_block = yaffs_find_alloc_block(dev);
+		*alloc_page = 0;
 	}
 
 	if (!use_reserver && !yaffs_check_alloc_available(dev, 1)) {
@@ -458,26 +480,27 @@ static int yaffs_alloc_chunk(struct yaffs_dev *dev, int use_reserver,
 	}
 
 	if (dev->n_erased_blocks < dev->param.n_reserved_blocks
-	    && dev->alloc_page == 0)
+	    && *alloc_page == 0)
 		yaffs_trace(YAFFS_TRACE_ALLOCATE, "Allocating reserve");
 
 	/* Next page please.... */
-	if (dev->alloc_block >= 0) {
-		bi = yaffs_get_block_info(dev, dev->alloc_block);
+	if (*alloc_block >= 0) {
+		bi = yaffs_get_block_info(dev, *alloc_block);
 
-		ret_val = (dev->alloc_block * dev->param.chunks_per_block) +
-		    dev->alloc_page;
+		ret_val = (*alloc_block * dev->param.chunks_per_block) +
+		    *alloc_page;
 		bi->pages_in_use++;
-		yaffs_set_chunk_bit(dev, dev->alloc_block, dev->alloc_page);
+		yaffs_set_chunk_bit(dev, *alloc_block, *alloc_page);
 
-		dev->alloc_page++;
+		(*alloc_page)++;
 
 		dev->n_free_chunks--;
 
 		/* If the block is full set the state to full */
-		if (dev->alloc_page >= dev->param.chunks_per_block) {
+		if (*alloc_page >= dev->param.chunks_per_block) {
 			bi->block_state = YAFFS_BLOCK_STATE_FULL;
-			dev->alloc_block = -1;
+			yaffs_gc_index_update(dev, *alloc_block);
+			*alloc_block = -1;
 		}
 
 		if (block_ptr)
@@ -500,41 +523,109 @@ static int yaffs_get_erased_chunks(struct yaffs_dev *dev)
 	if (dev->alloc_block > 0)
 		n += (dev->param.chunks_per_block - dev->alloc_page);
 
+	if (dev->cold_alloc_block > 0)
+		n += (dev->param.chunks_per_block - dev->cold_alloc_page);
+
 	return n;
 
 }
 
 /*
- * yaffs_skip_rest_of_block() skips over the rest of the allocation block
- * if we don't want to write to it.
+ * yaffs_skip_rest_of_stream() skips over the rest of a stream's allocation
+ * block if we don't want to write to it.
  */
-void yaffs_skip_rest_of_block(struct yaffs_dev *dev)
+static void yaffs_skip_rest_of_stream(struct yaffs_dev *dev, int stream)
 {
-	if (dev->alloc_block > 0) {
+	int *alloc_block = yaffs_stream_block(dev, stream, NULL);
+
+	if (*alloc_block > 0) {
 		struct yaffs_block_info *bi =
-		    yaffs_get_block_info(dev, dev->alloc_block);
+		    yaffs_get_block_info(dev, *alloc_block);
 		if (bi->block_state == YAFFS_BLOCK_STATE_ALLOCATING) {
 			bi->block_state = YAFFS_BLOCK_STATE_FULL;
-			dev->alloc_block = -1;
+			yaffs_gc_index_update(dev, *alloc_block);
+			*alloc_block = -1;
+		}
+	}
+}
+
+void yaffs_skip_rest_of_block(struct yaffs_dev *dev)
+{
+	yaffs_skip_rest_of_stream(dev, YAFFS_STREAM_HOT);
+}
+
+/* Has the object had a chunk overwritten lately? */
+static int yaffs_obj_is_hot(struct yaffs_obj *obj)
+{
+	struct yaffs_dev *dev = obj->my_dev;
+	u32 window = (dev->internal_end_block - dev->internal_start_block + 1)
+	    >> YAFFS_HOT_WINDOW_SHIFT;
+
+	return obj->rewrite_seq && dev->seq_number - obj->rewrite_seq <= window;
+}
+
+/*
+ * yaffs_pick_stream() settles which stream a chunk of obj is written to.
+ *
+ * The yaffs2 scan takes the copy of a chunk in the newest block as the
+ * live one, so no chunk of an object may go to a block older than one the
+ * object was written to before. A cold chunk goes to the hot block instead
+ * when that would break the order, or when opening a new cold block would
+ * eat into the reserve. If the hot block is out of order it is closed so
+ * the chunk goes to a fresh block.
+ */
+static int yaffs_pick_stream(struct yaffs_dev *dev, struct yaffs_obj *obj,
+			     int stream)
+{
+	int *alloc_block;
+
+	if (dev->param.disable_hot_cold)
+		stream = YAFFS_STREAM_HOT;
+
+	if (stream == YAFFS_STREAM_COLD) {
+		if (dev->cold_alloc_block < 0) {
+			if (dev->n_erased_blocks <=
+			    dev->param.n_reserved_blocks +
+			    yaffs_calc_checkpt_blocks_required(dev) + 1)
+				stream = YAFFS_STREAM_HOT;
+		} else if (yaffs_get_block_info(dev, dev->cold_alloc_block)->
+			   seq_number < obj->newest_seq) {
+			stream = YAFFS_STREAM_HOT;
 		}
 	}
+
+	alloc_block = yaffs_stream_block(dev, stream, NULL);
+	if (*alloc_block > 0 &&
+	    yaffs_get_block_info(dev, *alloc_block)->seq_number <
+	    obj->newest_seq) {
+		yaffs_trace(YAFFS_TRACE_ALLOCATE,
+			"Closing block %d, object %d is in newer block seq %d",
+			*alloc_block, obj->obj_id, obj->newest_seq);
+		yaffs_skip_rest_of_stream(dev, stream);
+		dev->n_stream_closes++;
+	}
+
+	return stream;
 }
 
 static int yaffs_write_new_chunk(struct yaffs_dev *dev,
 				 const u8 * data,
-				 struct yaffs_ext_tags *tags, int use_reserver)
+				 struct yaffs_ext_tags *tags, int use_reserver,
+				 struct yaffs_obj *obj, int stream)
 {
 	int attempts = 0;
 	int write_ok = 0;
 	int chunk;
+	struct yaffs_block_info *bi = 0;
 
 	yaffs2_checkpt_invalidate(dev);
 
+	stream = yaffs_pick_stream(dev, obj, stream);
+
 	do {
-		struct yaffs_block_info *bi = 0;
 		int erased_ok = 0;
 
-		chunk = yaffs_alloc_chunk(dev, use_reserver, &bi);
+		chunk = yaffs_alloc_chunk(dev, use_reserver, stream, &bi);
 		if (chunk < 0) {
 			/* no space */
 			break;
@@ -581,7 +672,7 @@ static int yaffs_write_new_chunk(struct yaffs_dev *dev,
 				 * skip rest of block and
 				 * try another chunk */
 				yaffs_chunk_del(dev, chunk, 1, __LINE__);
-				yaffs_skip_rest_of_block(dev);
+				yaffs_skip_rest_of_stream(dev, stream);
 				continue;
 			}
 		}
@@ -596,6 +687,7 @@ static int yaffs_write_new_chunk(struct yaffs_dev *dev,
 			/* Clean up aborted write, skip to next block and
 			 * try another chunk */
 			yaffs_handle_chunk_wr_error(dev, chunk, erased_ok);
+			yaffs_skip_rest_of_stream(dev, stream);
 			continue;
 		}
 
@@ -607,8 +699,16 @@ static int yaffs_write_new_chunk(struct yaffs_dev *dev,
 	} while (write_ok != YAFFS_OK &&
 		 (yaffs_wr_attempts <= 0 || attempts <= yaffs_wr_attempts));
 
-	if (!write_ok)
+	if (!write_ok) {
 		chunk = -1;
+	} else {
+		if (bi->seq_number > obj->newest_seq)
+			obj->newest_seq = bi->seq_number;
+		if (stream == YAFFS_STREAM_COLD)
+			dev->n_cold_writes++;
+		else
+			dev->n_hot_writes++;
+	}
 
 	if (attempts > 1) {
 		yaffs_trace(YAFFS_TRACE_ERROR,
@@ -662,6 +762,7 @@ static void yaffs_retire_block(struct yaffs_dev *dev, int flash_block)
 	bi->block_state = YAFFS_BLOCK_STATE_DEAD;
 	bi->gc_prioritise = 0;
 	bi->needs_retiring = 0;
+	yaffs_gc_index_update(dev, flash_block);
 
 	dev->n_retired_blocks++;
 }
@@ -1201,6 +1302,7 @@ static void yaffs_soft_del_chunk(struct yaffs_dev *dev, int chunk)
 		the_block->soft_del_pages++;
 		dev->n_free_chunks++;
 		yaffs2_update_oldest_dirty_seq(dev, block_no, the_block);
+		yaffs_gc_index_update(dev, block_no);
 	}
 }
 
@@ -2306,6 +2408,7 @@ static int yaffs_init_blocks(struct yaffs_dev *dev)
 	dev->chunk_bits = NULL;
 
 	dev->alloc_block = -1;	/* force it to get a new one */
+	dev->cold_alloc_block = -1;
 
 	/* If the first allocation strategy fails, thry the alternate one */
 	dev->block_info =
@@ -2332,7 +2435,9 @@ static int yaffs_init_blocks(struct yaffs_dev *dev)
                 }
 	}
 
-	if (dev->block_info && dev->chunk_bits) {
+	if (dev->block_info && dev->chunk_bits &&
+	    (dev->param.disable_cost_benefit ||
+	     yaffs_gc_index_init(dev) == YAFFS_OK)) {
 		memset(dev->block_info, 0,
 		       n_blocks * sizeof(struct yaffs_block_info));
 		memset(dev->chunk_bits, 0, dev->chunk_bit_stride * n_blocks);
@@ -2359,6 +2464,8 @@ static void yaffs_deinit_blocks(struct yaffs_dev *dev)
 		kfree(dev->chunk_bits);
 	dev->chunk_bits_alt = 0;
 	dev->chunk_bits = NULL;
+
+	yaffs_gc_index_deinit(dev);
 }
 
 void yaffs_block_became_dirty(struct yaffs_dev *dev, int block_no)
@@ -2379,6 +2486,7 @@ void yaffs_block_became_dirty(struct yaffs_dev *dev, int block_no)
 	yaffs2_clear_oldest_dirty_seq(dev, bi);
 
 	bi->block_state = YAFFS_BLOCK_STATE_DIRTY;
+	yaffs_gc_index_update(dev, block_no);
 
 	/* If this is the block being garbage collected then stop gc'ing this block */
 	if (block_no == dev->gc_block)
@@ -2468,8 +2576,10 @@ static int yaffs_gc_block(struct yaffs_dev *dev, int block, int whole_block)
 
 	/*yaffs_verify_free_chunks(dev); */
 
-	if (bi->block_state == YAFFS_BLOCK_STATE_FULL)
+	if (bi->block_state == YAFFS_BLOCK_STATE_FULL) {
 		bi->block_state = YAFFS_BLOCK_STATE_COLLECTING;
+		yaffs_gc_index_update(dev, block);
+	}
 
 	bi->has_shrink_hdr = 0;	/* clear the flag so that the block can erase */
 
@@ -2631,14 +2741,24 @@ static int yaffs_gc_block(struct yaffs_dev *dev, int block, int whole_block)
 									  (u8 *)
 									  oh,
 									  &tags,
-									  1);
+									  1,
+									  object,
+									  YAFFS_STREAM_HOT);
 					} else {
+						/* Data that outlived its block
+						 * is cold unless the file is
+						 * still being rewritten.
+						 */
 						new_chunk =
 						    yaffs_write_new_chunk(dev,
 									  buffer,
 									  &tags,
-									  1);
-                                        }
+									  1,
+									  object,
+									  yaffs_obj_is_hot(object) ?
+									  YAFFS_STREAM_HOT :
+									  YAFFS_STREAM_COLD);
+					}
 
 					if (new_chunk < 0) {
 						ret_val = YAFFS_FAIL;
@@ -2679,6 +2799,7 @@ static int yaffs_gc_block(struct yaffs_dev *dev, int block, int whole_block)
 		 * because checkpointing does not restore gc.
 		 */
 		bi->block_state = YAFFS_BLOCK_STATE_FULL;
+		yaffs_gc_index_update(dev, block);
 	} else {
 		/* The gc completed. */
 		/* Do any required cleanups */
@@ -2798,6 +2919,15 @@ static unsigned yaffs_find_gc_block(struct yaffs_dev *dev,
 				iterations = 100;
 		}
 
+		/* The index looks at every candidate, no need to iterate */
+		if (dev->gc_index) {
+			dev->gc_dirtiest =
+			    yaffs_gc_index_find(dev, threshold, &pages_used);
+			if (dev->gc_dirtiest > 0)
+				dev->gc_pages_in_use = pages_used;
+			iterations = 0;
+		}
+
 		for (i = 0;
 		     i < iterations &&
 		     (dev->gc_dirtiest < 1 ||
@@ -2891,6 +3021,9 @@ static int yaffs_check_gc(struct yaffs_dev *dev, int background)
 	int min_erased;
 	int erased_chunks;
 	int checkpt_block_adjust;
+	int collected = 0;
+	u64 start = 0;
+	u32 elapsed;
 
 	if (dev->param.gc_control && (dev->param.gc_control(dev) & 1) == 0)
 		return YAFFS_OK;
@@ -2950,6 +3083,10 @@ static int yaffs_check_gc(struct yaffs_dev *dev, int background)
 		}
 
 		if (dev->gc_block > 0) {
+			if (!collected)
+				start = Y_CLOCK_US();
+			collected = 1;
+
 			dev->all_gcs++;
 			if (!aggressive)
 				dev->passive_gc_count++;
@@ -2971,6 +3108,22 @@ static int yaffs_check_gc(struct yaffs_dev *dev, int background)
 	} while ((dev->n_erased_blocks < dev->param.n_reserved_blocks) &&
 		 (dev->gc_block > 0) && (max_tries < 2));
 
+	/* Time spent collecting, which is write latency unless in background */
+	if (collected) {
+		elapsed = (u32) (Y_CLOCK_US() - start);
+		if (background) {
+			dev->bg_gc_passes++;
+			dev->bg_gc_total_us += elapsed;
+			if (elapsed > dev->bg_gc_max_us)
+				dev->bg_gc_max_us = elapsed;
+		} else {
+			dev->fg_gc_passes++;
+			dev->fg_gc_total_us += elapsed;
+			if (elapsed > dev->fg_gc_max_us)
+				dev->fg_gc_max_us = elapsed;
+		}
+	}
+
 	return aggressive ? gc_ok : YAFFS_OK;
 }
 
@@ -3061,6 +3214,7 @@ void yaffs_chunk_del(struct yaffs_dev *dev, int chunk_id, int mark_flash,
 		yaffs_clear_chunk_bit(dev, block, page);
 
 		bi->pages_in_use--;
+		yaffs_gc_index_update(dev, block);
 
 		if (bi->pages_in_use == 0 &&
 		    !bi->has_shrink_hdr &&
@@ -3116,10 +3270,16 @@ static int yaffs_wr_data_obj(struct yaffs_obj *in, int inode_chunk,
 		YBUG();
 	}
 
+	if (prev_chunk_id > 0)
+		in->rewrite_seq = dev->seq_number;
+
 	new_chunk_id =
-	    yaffs_write_new_chunk(dev, buffer, &new_tags, use_reserve);
+	    yaffs_write_new_chunk(dev, buffer, &new_tags, use_reserve,
+				  in, YAFFS_STREAM_HOT);
 
 	if (new_chunk_id > 0) {
+		dev->n_host_writes++;
+
 		yaffs_put_chunk_in_file(in, inode_chunk, new_chunk_id, 0);
 
 		if (prev_chunk_id > 0)
@@ -3490,12 +3650,23 @@ int yaffs_update_oh(struct yaffs_obj *in, const YCHAR * name, int force,
 
 		yaffs_verify_oh(in, oh, &new_tags, 1);
 
+		/* The shadowed object must not turn up newer than its shadow */
+		if (shadows > 0) {
+			struct yaffs_obj *shadowed =
+			    yaffs_find_by_number(dev, shadows);
+
+			if (shadowed && shadowed->newest_seq > in->newest_seq)
+				in->newest_seq = shadowed->newest_seq;
+		}
+
 		/* Create new chunk in NAND */
 		new_chunk_id =
 		    yaffs_write_new_chunk(dev, buffer, &new_tags,
-					  (prev_chunk_id > 0) ? 1 : 0);
+					  (prev_chunk_id > 0) ? 1 : 0,
+					  in, YAFFS_STREAM_HOT);
 
 		if (new_chunk_id >= 0) {
+			dev->n_host_writes++;
 
 			in->hdr_chunk = new_chunk_id;
 
@@ -4759,6 +4930,34 @@ static int yaffs_create_initial_dir(struct yaffs_dev *dev)
 	return YAFFS_FAIL;
 }
 
+/*
+ * The checkpoint only knows about the hot allocation block, so a cold block
+ * that was open when it was taken comes back as an orphan. Close it, and
+ * also close the hot block if any block is newer, so that every chunk
+ * written from now on goes to a block newer than all those on flash.
+ */
+static void yaffs_close_stale_alloc_blocks(struct yaffs_dev *dev)
+{
+	struct yaffs_block_info *bi;
+	int blk;
+
+	for (blk = dev->internal_start_block; blk <= dev->internal_end_block;
+	     blk++) {
+		bi = yaffs_get_block_info(dev, blk);
+		if (bi->block_state == YAFFS_BLOCK_STATE_ALLOCATING &&
+		    blk != dev->alloc_block) {
+			yaffs_trace(YAFFS_TRACE_MOUNT,
+				"Closing orphan allocation block %d", blk);
+			bi->block_state = YAFFS_BLOCK_STATE_FULL;
+		}
+	}
+
+	if (dev->alloc_block > 0 &&
+	    yaffs_get_block_info(dev, dev->alloc_block)->seq_number !=
+	    dev->seq_number)
+		yaffs_skip_rest_of_block(dev);
+}
+
 int yaffs_guts_initialise(struct yaffs_dev *dev)
 {
 	int init_failed = 0;
@@ -4983,6 +5182,12 @@ int yaffs_guts_initialise(struct yaffs_dev *dev)
 	if (dev->param.is_yaffs2)
 		dev->param.use_header_file_size = 1;
 
+	/* yaffs1 has neither block ages nor the ordering rules to go by */
+	if (!dev->param.is_yaffs2) {
+		dev->param.disable_hot_cold = 1;
+		dev->param.disable_cost_benefit = 1;
+	}
+
 	if (!init_failed && !yaffs_init_blocks(dev))
 		init_failed = 1;
 
@@ -5036,6 +5241,9 @@ int yaffs_guts_initialise(struct yaffs_dev *dev)
 		yaffs_fix_hanging_objs(dev);
 		if (dev->param.empty_lost_n_found)
 			yaffs_empty_l_n_f(dev);
+
+		yaffs_close_stale_alloc_blocks(dev);
+		yaffs_gc_index_rebuild(dev);
 	}
 
 	if (init_failed) {
@@ -5056,6 +5264,17 @@ int yaffs_guts_initialise(struct yaffs_dev *dev)
 
 	dev->n_retired_blocks = 0;
 
+	dev->n_host_writes = 0;
+	dev->n_hot_writes = 0;
+	dev->n_cold_writes = 0;
+	dev->n_stream_closes = 0;
+	dev->fg_gc_passes = 0;
+	dev->fg_gc_max_us = 0;
+	dev->fg_gc_total_us = 0;
+	dev->bg_gc_passes = 0;
+	dev->bg_gc_max_us = 0;
+	dev->bg_gc_total_us = 0;
+
 	yaffs_verify_free_chunks(dev);
 	yaffs_verify_blocks(dev);
 
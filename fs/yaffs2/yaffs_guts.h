@@ -267,6 +267,17 @@ enum yaffs_block_state {
 
 #define	YAFFS_NUMBER_OF_BLOCK_STATES (YAFFS_BLOCK_STATE_DEAD + 1)
 
+/* Allocation streams.
+ * Chunks that keep being rewritten are allocated from the hot stream, the
+ * chunks that survive garbage collection from the cold stream, so that
+ * they do not share blocks and the cold ones are not copied over and over.
+ * The hot stream is the allocation block known to checkpoints and scans.
+ */
+enum yaffs_stream {
+	YAFFS_STREAM_HOT,
+	YAFFS_STREAM_COLD
+};
+
 struct yaffs_block_info {
 
 	int soft_del_pages:10;	/* number of soft deleted pages */
@@ -286,6 +297,13 @@ struct yaffs_block_info {
 
 };
 
+/* Garbage collection index entry, one per block. See yaffs_gcindex.c */
+struct yaffs_gc_node {
+	struct rb_node node;
+	u32 seq_number;		/* sequence number the block is filed under */
+	int n_live;		/* live chunks the block is filed under, -1 if not indexed */
+};
+
 /* -------------------------- Object structure -------------------------------*/
 /* This is the object structure as stored on NAND */
 
@@ -402,6 +420,12 @@ struct yaffs_obj {
 	u8 serial;		/* serial number of chunk in NAND. Cached here */
 	u16 sum;		/* sum of the name to speed searching */
 
+	u32 newest_seq;		/* Newest block written to for this object (yaffs2).
+				 * Later chunks of the object must not go to an
+				 * older block or scanning would prefer stale ones.
+				 */
+	u32 rewrite_seq;	/* seq_number when a chunk was last overwritten */
+
 	struct yaffs_dev *my_dev;	/* The device I'm on */
 
 	struct list_head hash_link;	/* list of objects in this hash bucket */
@@ -574,6 +598,10 @@ struct yaffs_param {
 	int auto_unicode;
 #endif
 	int always_check_erased;	/* Force chunk erased check always on */
+
+	/* Garbage collection policy, yaffs2 only */
+	int disable_hot_cold;	/* Allocate hot and cold chunks from the same blocks */
+	int disable_cost_benefit;	/* Select gc blocks by fewest live chunks only */
 };
 
 struct yaffs_dev {
@@ -645,6 +673,8 @@ struct yaffs_dev {
 	int alloc_block;	/* Current block being allocated off */
 	u32 alloc_page;
 	int alloc_block_finder;	/* Used to search for next allocation block */
+	int cold_alloc_block;	/* Block the cold stream allocates from */
+	u32 cold_alloc_page;
 
 	/* Object and Tnode memory management */
 	void *allocator;
@@ -672,6 +702,11 @@ struct yaffs_dev {
 	unsigned gc_chunk;
 	unsigned gc_skip;
 
+	/* Cost-benefit index of the full blocks, NULL if not in use */
+	struct rb_root *gc_index;	/* one tree per number of live chunks */
+	struct yaffs_gc_node *gc_nodes;	/* one node per block */
+	unsigned gc_nodes_alt:1;	/* was allocated using alternative strategy */
+
 	/* Special directories */
 	struct yaffs_obj *root_dir;
 	struct yaffs_obj *lost_n_found;
@@ -734,6 +769,16 @@ struct yaffs_dev {
 	u32 n_unmarked_deletions;
 	u32 refresh_count;
 	u32 cache_hits;
+	u32 n_host_writes;	/* chunks written on behalf of the user */
+	u32 n_hot_writes;
+	u32 n_cold_writes;
+	u32 n_stream_closes;	/* blocks closed early to keep chunk order */
+	u32 fg_gc_passes;	/* gc passes done in the write path */
+	u32 fg_gc_max_us;
+	u64 fg_gc_total_us;
+	u32 bg_gc_passes;	/* gc passes done by the background thread */
+	u32 bg_gc_max_us;
+	u64 bg_gc_total_us;
 
 };
 
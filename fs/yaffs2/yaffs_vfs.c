@@ -1763,6 +1763,8 @@ struct yaffs_options {
 	int lazy_loading_overridden;
 	int empty_lost_and_found;
 	int empty_lost_and_found_overridden;
+	int no_hot_cold;
+	int no_cost_benefit_gc;
 };
 
 #define MAX_OPT_LEN 30
@@ -1819,6 +1821,10 @@ static int yaffs_parse_options(struct yaffs_options *options,
 		} else if (!strcmp(cur_opt, "no-checkpoint")) {
 			options->skip_checkpoint_read = 1;
 			options->skip_checkpoint_write = 1;
+		} else if (!strcmp(cur_opt, "hot-cold-off")) {
+			options->no_hot_cold = 1;
+		} else if (!strcmp(cur_opt, "cost-benefit-gc-off")) {
+			options->no_cost_benefit_gc = 1;
 		} else {
 			printk(KERN_INFO "yaffs: Bad mount option \"%s\"\n",
 			       cur_opt);
@@ -2296,6 +2302,9 @@ static struct super_block *yaffs_internal_read_super(int yaffs_version,
 	param->skip_checkpt_rd = options.skip_checkpoint_read;
 	param->skip_checkpt_wr = options.skip_checkpoint_write;
 
+	param->disable_hot_cold = options.no_hot_cold;
+	param->disable_cost_benefit = options.no_cost_benefit_gc;
+
 	mutex_lock(&yaffs_context_lock);
 	/* Get a mount id */
 	found = 0;
@@ -2440,6 +2449,10 @@ static char *yaffs_dump_dev_part0(char *buf, struct yaffs_dev *dev)
 			param->n_reserved_blocks);
 	buf += sprintf(buf, "always_check_erased... %d\n",
 			param->always_check_erased);
+	buf += sprintf(buf, "disable_hot_cold...... %d\n",
+			param->disable_hot_cold);
+	buf += sprintf(buf, "disable_cost_benefit.. %d\n",
+			param->disable_cost_benefit);
 
 	return buf;
 }
@@ -2490,6 +2503,25 @@ static char *yaffs_dump_dev_part1(char *buf, struct yaffs_dev *dev)
 	    sprintf(buf, "n_unlinked_files...... %u\n", dev->n_unlinked_files);
 	buf += sprintf(buf, "refresh_count......... %u\n", dev->refresh_count);
 	buf += sprintf(buf, "n_bg_deletions........ %u\n", dev->n_bg_deletions);
+	buf += sprintf(buf, "\n");
+	buf += sprintf(buf, "n_host_writes......... %u\n", dev->n_host_writes);
+	buf += sprintf(buf, "write_amp_x100........ %u\n",
+		       dev->n_host_writes ?
+		       (u32) div_u64(((u64) dev->n_host_writes +
+				      dev->n_gc_copies) * 100,
+				     dev->n_host_writes) : 0);
+	buf += sprintf(buf, "n_hot_writes.......... %u\n", dev->n_hot_writes);
+	buf += sprintf(buf, "n_cold_writes......... %u\n", dev->n_cold_writes);
+	buf +=
+	    sprintf(buf, "n_stream_closes....... %u\n", dev->n_stream_closes);
+	buf += sprintf(buf, "fg_gc_passes.......... %u\n", dev->fg_gc_passes);
+	buf += sprintf(buf, "fg_gc_total_us........ %llu\n",
+		       (unsigned long long)dev->fg_gc_total_us);
+	buf += sprintf(buf, "fg_gc_max_us.......... %u\n", dev->fg_gc_max_us);
+	buf += sprintf(buf, "bg_gc_passes.......... %u\n", dev->bg_gc_passes);
+	buf += sprintf(buf, "bg_gc_total_us........ %llu\n",
+		       (unsigned long long)dev->bg_gc_total_us);
+	buf += sprintf(buf, "bg_gc_max_us.......... %u\n", dev->bg_gc_max_us);
 
 	return buf;
 }
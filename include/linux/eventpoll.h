@@ -26,6 +26,16 @@
 #define EPOLL_CTL_DEL 2
 #define EPOLL_CTL_MOD 3
 
+/*
+ * Wake up only one of the epoll sets that watch the target file with this
+ * flag, instead of all of them. Only valid with EPOLL_CTL_ADD, and not on
+ * epoll file descriptors.
+ */
+#define EPOLLEXCLUSIVE (1 << 27)
+
+/* Like EPOLLEXCLUSIVE, and hand the wakeups to those epoll sets in turn */
+#define EPOLLROUNDROBIN (1 << 28)
+
 /* Set the One Shot behaviour for the target file descriptor */
 #define EPOLLONESHOT (1 << 30)
 
@@ -49,6 +59,43 @@ struct epoll_event {
 	__u64 data;
 } EPOLL_PACKED;
 
+/* One operation of sys_epoll_ctl_batch() */
+struct epoll_ctl_cmd {
+	/* Reserved, must be 0 */
+	int flags;
+	/* EPOLL_CTL_* */
+	int op;
+	int fd;
+	/* Same as epoll_event.events and epoll_event.data */
+	__u32 events;
+	__u64 data;
+	/* Output: 0 or -errno */
+	int result;
+	int __pad;
+};
+
+/* Maximum number of operations in one sys_epoll_ctl_batch() call */
+#define EPOLL_CTL_BATCH_MAX 1024
+
+/*
+ * Header of the ready ring obtained by mmap()ing an epoll fd at offset 0.
+ * It is followed by "nr" struct epoll_event entries. The kernel fills
+ * events[head % nr] and then advances head; userspace consumes entries
+ * up to head and then advances tail. Only events of EPOLLET items whose
+ * source reports its events to the wakeup callback go through the ring,
+ * everything else (and everything that did not fit, see overflow) is
+ * still returned by epoll_wait(), which also returns 0 early when the
+ * ring is not empty.
+ */
+struct epoll_ring {
+	__u32 head;
+	__u32 tail;
+	__u32 nr;
+	/* Set by the kernel when an event did not fit in the ring */
+	__u32 overflow;
+	struct epoll_event events[0];
+};
+
 #ifdef __KERNEL__
 
 /* Forward declarations to avoid compiler errors */
@@ -95,10 +142,17 @@ static inline void eventpoll_release(struct file *file)
 	eventpoll_release_file(file);
 }
 
+/* Used by /proc/<pid>/fdinfo to show the epoll wakeup counters */
+int eventpoll_fdinfo(struct file *file, char *buf, int size);
+
 #else
 
 static inline void eventpoll_init_file(struct file *file) {}
 static inline void eventpoll_release(struct file *file) {}
+static inline int eventpoll_fdinfo(struct file *file, char *buf, int size)
+{
+	return 0;
+}
 
 #endif
 
@@ -0,0 +1,24 @@
+/*
+ * include/linux/input_boost.h
+ *
+ * Coordinated, time-bounded performance boost on user input.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _LINUX_INPUT_BOOST_H
+#define _LINUX_INPUT_BOOST_H
+
+#ifdef CONFIG_INPUT_BOOST
+/* Raise all boost floors for duration_ms milliseconds (0: default). */
+void input_boost_kick(unsigned int duration_ms);
+/* Called by the display driver when a frame has been presented. */
+void input_boost_frame_done(void);
+#else
+static inline void input_boost_kick(unsigned int duration_ms) { }
+static inline void input_boost_frame_done(void) { }
+#endif
+
+#endif /* _LINUX_INPUT_BOOST_H */
@@ -31,6 +31,7 @@
 #include <linux/mutex.h>
 #include <linux/timer.h>
 #include <linux/slab.h>
+#include <linux/lat_hist.h>
 #endif
 
 #define journal_oom_retry 1
@@ -241,7 +242,12 @@ typedef struct journal_superblock_s
 	__be32	s_max_trans_data;	/* Limit of data blocks per trans. */
 
 /* 0x0050 */
-	__u32	s_padding[44];
+	__u32	s_padding2;
+	__u32	s_padding[41];
+/* 0x00F8 */
+	/* Clear of 0x0054, where newer jbd2 keeps its own fast commit count */
+	__be32	s_fc_area_blks;		/* Blocks reserved for fast commits */
+	__u32	s_padding3;
 
 /* 0x0100 */
 	__u8	s_users[16*48];		/* ids of all fs'es sharing the log */
@@ -263,13 +269,19 @@ typedef struct journal_superblock_s
 #define JBD2_FEATURE_INCOMPAT_REVOKE		0x00000001
 #define JBD2_FEATURE_INCOMPAT_64BIT		0x00000002
 #define JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT	0x00000004
+/*
+ * Our fast commit area.  Newer jbd2 allocates its incompat bits from the
+ * bottom, 0x20 being its own, incompatible, fast commit format.
+ */
+#define JBD2_FEATURE_INCOMPAT_FC_AREA		0x80000000
 
 /* Features known to this kernel version: */
 #define JBD2_KNOWN_COMPAT_FEATURES	JBD2_FEATURE_COMPAT_CHECKSUM
 #define JBD2_KNOWN_ROCOMPAT_FEATURES	0
 #define JBD2_KNOWN_INCOMPAT_FEATURES	(JBD2_FEATURE_INCOMPAT_REVOKE | \
 					JBD2_FEATURE_INCOMPAT_64BIT | \
-					JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT)
+					JBD2_FEATURE_INCOMPAT_ASYNC_COMMIT | \
+					JBD2_FEATURE_INCOMPAT_FC_AREA)
 
 #ifdef __KERNEL__
 
@@ -654,6 +666,11 @@ struct transaction_s
 	 */
 	atomic_t		t_handle_count;
 
+	/*
+	 * How many fsync callers waited for this transaction? [no locking]
+	 */
+	atomic_t		t_fsync_count;
+
 	/*
 	 * This transaction is being forced and some process is
 	 * waiting for it to finish.
@@ -682,9 +699,17 @@ struct transaction_run_stats_s {
 	__u32			rs_blocks_logged;
 };
 
+/* fsync callers per commit: 1, 2, 3-4, 5-8, ..., 65+ */
+#define JBD2_FSYNC_BATCH_BUCKETS	8
+
 struct transaction_stats_s {
 	unsigned long		ts_tid;
 	struct transaction_run_stats_s run;
+
+	unsigned long		ts_fsync_batch[JBD2_FSYNC_BATCH_BUCKETS];
+	struct lat_hist		ts_fsync_lat;
+	unsigned long		ts_flushes;
+	unsigned long		ts_flush_callers;
 };
 
 static inline unsigned long
@@ -728,6 +753,8 @@ jbd2_time_diff(unsigned long start, unsigned long end)
  * @j_free: Journal free - how many free blocks are there in the journal?
  * @j_first: The block number of the first usable block
  * @j_last: The block number one beyond the last usable block
+ * @j_fc_first: The first block of the fast commit area
+ * @j_fc_last: The block number one beyond the last fast commit block
  * @j_dev: Device where we store the journal
  * @j_blocksize: blocksize for the location where we store the journal.
  * @j_blk_offset: starting block offset for into the device where we store the
@@ -759,12 +786,17 @@ jbd2_time_diff(unsigned long start, unsigned long end)
  * @j_wbufsize: maximum number of buffer_heads allowed in j_wbuf, the
  *	number that will fit in j_blocksize
  * @j_last_sync_writer: most recent pid which did a synchronous write
+ * @j_last_fsync_pid: most recent pid which went through jbd2_complete_fsync()
+ * @j_flush_mutex: Serialises data flushes issued on behalf of fsync
+ * @j_flush_seq: Number of data flushes issued so far
+ * @j_flush_err: Result of the most recent data flush
  * @j_history: Buffer storing the transactions statistics history
  * @j_history_max: Maximum number of transactions in the statistics history
  * @j_history_cur: Current number of transactions in the statistics history
  * @j_history_lock: Protect the transactions statistics history
  * @j_proc_entry: procfs entry for the jbd statistics directory
  * @j_stats: Overall statistics
+ * @j_fc_replay_callback: Replays the fast commit area after recovery
  * @j_private: An opaque pointer to fs-private information.
  */
 
@@ -874,6 +906,13 @@ struct journal_s
 	unsigned long		j_first;
 	unsigned long		j_last;
 
+	/*
+	 * Fast commit area, carved from the end of the journal and owned by
+	 * the client filesystem.  Empty unless INCOMPAT_FC_AREA is set.
+	 */
+	unsigned long		j_fc_first;
+	unsigned long		j_fc_last;
+
 	/*
 	 * Device, blocksize and starting block offset for the location where we
 	 * store the journal.
@@ -969,6 +1008,20 @@ struct journal_s
 	 */
 	pid_t			j_last_sync_writer;
 
+	/*
+	 * the pid of the last process to fsync through the journal, used
+	 * to detect concurrent fsync callers worth batching
+	 */
+	pid_t			j_last_fsync_pid;
+
+	/*
+	 * fs device cache flushes for fsync, shared by all callers that
+	 * queue up behind one in progress [j_flush_mutex]
+	 */
+	struct mutex		j_flush_mutex;
+	unsigned long		j_flush_seq;
+	int			j_flush_err;
+
 	/*
 	 * the average amount of time in nanoseconds it takes to commit a
 	 * transaction to disk. [j_state_lock]
@@ -997,6 +1050,13 @@ struct journal_s
 	/* Failed journal commit ID */
 	unsigned int		j_failed_commit;
 
+	/*
+	 * Called at the end of recovery with the ID of the first transaction
+	 * that did not make it to the log, so that the client can replay
+	 * whatever it wrote to the fast commit area on behalf of it.
+	 */
+	int (*j_fc_replay_callback)(journal_t *journal, tid_t tid);
+
 	/*
 	 * An opaque pointer to fs-private information.  ext3 puts its
 	 * superblock pointer here
@@ -1146,6 +1206,8 @@ extern int	   jbd2_journal_recover    (journal_t *journal);
 extern int	   jbd2_journal_wipe       (journal_t *, int);
 extern int	   jbd2_journal_skip_recovery	(journal_t *);
 extern void	   jbd2_journal_update_superblock	(journal_t *, int);
+extern int	   jbd2_fc_init(journal_t *, unsigned int);
+extern struct buffer_head *jbd2_fc_get_buf(journal_t *, unsigned int);
 extern void	   __jbd2_journal_abort_hard	(journal_t *);
 extern void	   jbd2_journal_abort      (journal_t *, int);
 extern int	   jbd2_journal_errno      (journal_t *);
@@ -1228,6 +1290,8 @@ int __jbd2_log_start_commit(journal_t *journal, tid_t tid);
 int jbd2_journal_start_commit(journal_t *journal, tid_t *tid);
 int jbd2_journal_force_commit_nested(journal_t *journal);
 int jbd2_log_wait_commit(journal_t *journal, tid_t tid);
+int jbd2_complete_fsync(journal_t *journal, tid_t tid);
+int jbd2_journal_flush_fs_dev(journal_t *journal);
 int jbd2_log_do_checkpoint(journal_t *journal);
 int jbd2_trans_will_send_data_barrier(journal_t *journal, tid_t tid);
 
@@ -0,0 +1,56 @@
+#ifndef _LINUX_LAT_HIST_H
+#define _LINUX_LAT_HIST_H
+
+/*
+ * Log2 latency histograms for debug statistics.  Bucket 0 counts
+ * latencies under 1us, bucket i those from 2^(i-1)us, and the last one
+ * everything from 2^18us (about 262ms) up.  Callers provide
+ * the locking, or accept the odd lost update.
+ */
+
+#include <linux/kernel.h>
+#include <linux/bitops.h>
+#include <linux/math64.h>
+#include <linux/string.h>
+#include <linux/time.h>
+
+#define LAT_HIST_BUCKETS	20
+
+struct lat_hist {
+	unsigned int	count[LAT_HIST_BUCKETS];
+	u64		max;		/* worst latency in ns */
+};
+
+static inline void lat_hist_add(struct lat_hist *hist, u64 ns)
+{
+	unsigned int us = min_t(u64, div_u64(ns, NSEC_PER_USEC), UINT_MAX);
+
+	if (ns > hist->max)
+		hist->max = ns;
+	hist->count[min_t(int, fls(us), LAT_HIST_BUCKETS - 1)]++;
+}
+
+static inline void lat_hist_reset(struct lat_hist *hist)
+{
+	memset(hist, 0, sizeof(*hist));
+}
+
+struct seq_file;
+
+/* a line of column titles, then one line per histogram */
+void lat_hist_seq_header(struct seq_file *m, const char *title);
+void lat_hist_seq_show(struct seq_file *m, const char *name,
+		       const struct lat_hist *hist);
+
+/*
+ * A debugfs file that prints with @show and calls @reset on any write.
+ */
+struct lat_hist_file {
+	int	(*show)(struct seq_file *m, void *v);
+	void	(*reset)(void);
+};
+
+struct dentry *lat_hist_debugfs_create(const char *name,
+				       const struct lat_hist_file *file);
+
+#endif /* _LINUX_LAT_HIST_H */
@@ -87,6 +87,36 @@ struct mmc_ext_csd {
 	bool			refresh;		/* refresh of blocks supported */
 	__kernel_time_t		last_tv_sec;		/* last time a block was refreshed */
 	__kernel_time_t		last_bkops_tv_sec;	/* last time bkops was done */
+	u8			max_packed_writes;	/* 500 */
+	u8			max_packed_reads;	/* 501 */
+	bool			packed_event_en;	/* packed failure event enabled */
+};
+
+/*
+ * A packed command header is a single 512 byte block holding a
+ * version/count word pair followed by one CMD23/CMD25 argument pair
+ * per packed request, which bounds the number of packed entries.
+ */
+#define MMC_PACKED_NR_MAX	((512 / 8) - 1)
+
+enum mmc_packed_stop_reasons {
+	EXCEEDS_SEGMENTS = 0,
+	EXCEEDS_SECTORS,
+	WRONG_DATA_DIR,
+	FLUSH_OR_DISCARD,
+	EMPTY_QUEUE,
+	REL_WRITE,
+	THRESHOLD,
+	MAX_REASONS,
+};
+
+struct mmc_wr_pack_stats {
+	u32			packing_events[MMC_PACKED_NR_MAX + 1];
+	u32			pack_stop_reason[MAX_REASONS];
+	u32			packed_failures;	/* card reported errors */
+	u32			unpacked_fallbacks;	/* packs reissued singly */
+	spinlock_t		lock;
+	bool			enabled;
 };
 
 struct sd_scr {
@@ -235,6 +265,8 @@ struct mmc_card {
 
 	struct dentry		*debugfs_root;
 
+	struct mmc_wr_pack_stats wr_pack_stats;	/* packed write statistics */
+
 	struct timer_list	timer;
 	struct work_struct	bkops;
 	struct work_struct	refresh;
@@ -4,10 +4,70 @@
 /* For now we just replace the xt_owner.
  * FIXME: make iptables aware of qtaguid. */
 #include <linux/netfilter/xt_owner.h>
+#include <linux/if.h>
+#include <linux/ioctl.h>
+#include <linux/types.h>
 
 #define XT_QTAGUID_UID    XT_OWNER_UID
 #define XT_QTAGUID_GID    XT_OWNER_GID
 #define XT_QTAGUID_SOCKET XT_OWNER_SOCKET
 #define xt_qtaguid_match_info xt_owner_match_info
 
+/*
+ * Binary stats export through /dev/xt_qtaguid.
+ *
+ * XT_QTAGUID_IOC_GET_STATS fills req.records with the iface and tag stats
+ * that changed since req.generation (0 returns everything), in the same
+ * units as /proc/net/xt_qtaguid/stats and iface_stat_fmt. On return,
+ * req.generation is to be passed in on the next call, and req.count holds
+ * the number of records. If the records don't fit, -ENOSPC is returned with
+ * req.count set to the number needed and nothing consumed.
+ * Counters are totals, not deltas, and a record may show up again in the
+ * call after the one that reported its change. Deleted tags are not
+ * reported.
+ */
+#define XT_QTAGUID_STATS_MAX_RECORDS	(1 << 16)
+
+#define XT_QTAGUID_STATS_IFACE	0
+#define XT_QTAGUID_STATS_TAG	1
+
+/* Counter indexes, same order as the proc files */
+#define XT_QTAGUID_MAX_COUNTER_SETS	2
+#define XT_QTAGUID_TX		0
+#define XT_QTAGUID_RX		1
+#define XT_QTAGUID_MAX_DIRS	2
+#define XT_QTAGUID_TCP		0
+#define XT_QTAGUID_UDP		1
+#define XT_QTAGUID_OTHER	2
+#define XT_QTAGUID_MAX_PROTOS	3
+
+struct xt_qtaguid_bpc {
+	__u64 bytes;
+	__u64 packets;
+};
+
+struct xt_qtaguid_stats_rec {
+	__u32 type;			/* XT_QTAGUID_STATS_* */
+	__u32 pad;
+	char iface[IFNAMSIZ];
+	/* acct_tag in the upper 32 bits, uid in the lower ones */
+	__u64 tag;
+	union {
+		/* [counter set][direction][protocol] */
+		struct xt_qtaguid_bpc tag[XT_QTAGUID_MAX_COUNTER_SETS]
+					 [XT_QTAGUID_MAX_DIRS]
+					 [XT_QTAGUID_MAX_PROTOS];
+		/* [direction], the total_skb_* of iface_stat_fmt */
+		struct xt_qtaguid_bpc iface[XT_QTAGUID_MAX_DIRS];
+	} counters;
+};
+
+struct xt_qtaguid_stats_req {
+	__u32 generation;
+	__u32 count;			/* records array size, in entries */
+	__u64 records;			/* struct xt_qtaguid_stats_rec * */
+};
+
+#define XT_QTAGUID_IOC_GET_STATS _IOWR('q', 0x40, struct xt_qtaguid_stats_req)
+
 #endif /* _XT_QTAGUID_MATCH_H */
@@ -432,6 +432,11 @@ struct dev_pm_info {
 	struct list_head	entry;
 	struct completion	completion;
 	struct wakeup_source	*wakeup;
+	struct list_head	suppliers;	/* Owned by the PM core */
+	struct list_head	consumers;	/* Ditto */
+	ktime_t			dpm_start;	/* Last suspend/resume callback */
+	ktime_t			dpm_end;
+	struct device		*dpm_waited_on;	/* Dependency finishing last */
 #else
 	unsigned int		should_wakeup:1;
 #endif
@@ -551,6 +556,10 @@ extern void __suspend_report_result(const char *function, void *fn, int ret);
 	} while (0)
 
 extern int device_pm_wait_for_dev(struct device *sub, struct device *dev);
+extern int device_pm_add_supplier(struct device *consumer,
+				  struct device *supplier);
+extern void device_pm_remove_supplier(struct device *consumer,
+				      struct device *supplier);
 
 extern int pm_generic_prepare(struct device *dev);
 extern int pm_generic_suspend_noirq(struct device *dev);
@@ -584,6 +593,15 @@ static inline int device_pm_wait_for_dev(struct device *a, struct device *b)
 	return 0;
 }
 
+static inline int device_pm_add_supplier(struct device *consumer,
+					 struct device *supplier)
+{
+	return 0;
+}
+
+static inline void device_pm_remove_supplier(struct device *consumer,
+					     struct device *supplier) {}
+
 #define pm_generic_prepare	NULL
 #define pm_generic_suspend	NULL
 #define pm_generic_resume	NULL
@@ -7,6 +7,7 @@
 #include <linux/plist.h>
 #include <linux/notifier.h>
 #include <linux/miscdevice.h>
+#include <linux/workqueue.h>
 
 enum {
 	PM_QOS_RESERVED = 0,
@@ -17,6 +18,7 @@ enum {
 	PM_QOS_MAX_ONLINE_CPUS,
 	PM_QOS_CPU_FREQ_MIN,
 	PM_QOS_CPU_FREQ_MAX,
+	PM_QOS_EMC_FREQ_MIN,
 
 	/* insert new class ID */
 
@@ -32,15 +34,19 @@ enum {
 #define PM_QOS_MAX_ONLINE_CPUS_DEFAULT_VALUE	LONG_MAX
 #define PM_QOS_CPU_FREQ_MIN_DEFAULT_VALUE	0
 #define PM_QOS_CPU_FREQ_MAX_DEFAULT_VALUE	LONG_MAX
+#define PM_QOS_EMC_FREQ_MIN_DEFAULT_VALUE	0
 
 struct pm_qos_request_list {
 	struct plist_node list;
 	int pm_qos_class;
+	struct delayed_work work; /* for pm_qos_update_request_timeout */
 };
 
 void pm_qos_add_request(struct pm_qos_request_list *l, int pm_qos_class, s32 value);
 void pm_qos_update_request(struct pm_qos_request_list *pm_qos_req,
 		s32 new_value);
+void pm_qos_update_request_timeout(struct pm_qos_request_list *pm_qos_req,
+		s32 new_value, unsigned long timeout_us);
 void pm_qos_remove_request(struct pm_qos_request_list *pm_qos_req);
 
 int pm_qos_request(int pm_qos_class);
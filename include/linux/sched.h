@@ -1164,6 +1164,26 @@ struct sched_statistics {
 	u64			nr_wakeups_affine_attempts;
 	u64			nr_wakeups_passive;
 	u64			nr_wakeups_idle;
+	u64			nr_wakeups_packed;
+	u64			nr_failed_migrations_packed;
+};
+#endif
+
+#ifdef CONFIG_SMP
+/*
+ * Decayed utilization of a scheduling entity (or of a whole cpu).
+ *
+ * Time is accounted in ~1ms periods; the contribution of a period
+ * decays geometrically so that one that is 32 periods old is worth
+ * half of the current one.  util_avg is the resulting running ratio
+ * scaled to SCHED_LOAD_SCALE.
+ */
+struct sched_avg {
+	u64			last_update;
+	u32			runnable_sum;
+	u32			period_sum;
+	u32			period_contrib;
+	unsigned long		util_avg;
 };
 #endif
 
@@ -1184,6 +1204,10 @@ struct sched_entity {
 	struct sched_statistics statistics;
 #endif
 
+#ifdef CONFIG_SMP
+	struct sched_avg	avg;
+#endif
+
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	struct sched_entity	*parent;
 	/* rq on which this entity is (to be) queued: */
@@ -1525,7 +1549,12 @@ struct task_struct {
 #ifdef CONFIG_FAULT_INJECTION
 	int make_it_fail;
 #endif
-	struct prop_local_single dirties;
+	/*
+	 * when (nr_dirtied >= nr_dirtied_pause), it's time to call
+	 * balance_dirty_pages() for some dirty throttling pause
+	 */
+	int nr_dirtied;
+	int nr_dirtied_pause;
 #ifdef CONFIG_LATENCYTOP
 	int latency_record_count;
 	struct latency_record latency_record[LT_SAVECOUNT];
@@ -2715,6 +2744,23 @@ static inline unsigned long rlimit_max(unsigned int limit)
 	return task_rlimit_max(current, limit);
 }
 
+#ifdef CONFIG_CPU_FREQ_GOV_SCHED
+/*
+ * Utilization callback for scheduler-driven cpufreq governors.  func is
+ * called with the runqueue lock held and interrupts disabled, so it
+ * must not sleep or wake anything up.  util is relative to max.  If func
+ * returns true, kick is called on the same cpu once the runqueue lock
+ * has been dropped, with preemption disabled.
+ */
+struct update_util_data {
+	bool (*func)(struct update_util_data *data,
+		     u64 time, unsigned long util, unsigned long max);
+	void (*kick)(struct update_util_data *data);
+};
+
+void cpufreq_set_update_util_data(int cpu, struct update_util_data *data);
+#endif
+
 #endif /* __KERNEL__ */
 
 #endif
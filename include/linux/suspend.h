@@ -334,4 +334,13 @@ static inline void unlock_system_sleep(void)
 }
 #endif
 
+#if defined(CONFIG_SUSPEND_TIME) && defined(CONFIG_PM_SLEEP)
+/* kernel/power/suspend_time.c: per-device timings of the last transition */
+extern void suspend_time_dev_begin(bool resume);
+extern void suspend_time_dev_record(struct device *dev, bool resume,
+				    ktime_t phase_start);
+extern void suspend_time_dev_end(struct device *last, bool resume,
+				 ktime_t phase_start);
+#endif
+
 #endif /* _LINUX_SUSPEND_H */
@@ -365,6 +365,10 @@ struct tcp_sock {
 	u32	snd_up;		/* Urgent pointer		*/
 
 	u8	keepalive_probes; /* num of allowed keep alive probes	*/
+	u8	rx_flow_cached;	/* May sit in a per-cpu flow cache	*/
+
+	unsigned long	tsq_flags;	/* TCP small queues, see below	*/
+	struct list_head tsq_node;	/* anchor in tsq_tasklet.head list */
 /*
  *      Options received (usually on last packet, some only on SYN packets).
  */
@@ -463,6 +467,12 @@ struct tcp_sock {
 	struct tcp_cookie_values  *cookie_values;
 };
 
+enum tsq_flags {
+	TSQ_THROTTLED,		/* tcp_write_xmit() stopped on the queue limit */
+	TSQ_QUEUED,		/* socket sits on a tsq_tasklet list */
+	TCP_TSQ_DEFERRED,	/* tasklet found the socket owned by user */
+};
+
 static inline struct tcp_sock *tcp_sk(const struct sock *sk)
 {
 	return (struct tcp_sock *)sk;
@@ -25,6 +25,7 @@ struct timer_list {
 
 #ifdef CONFIG_TIMER_STATS
 	int start_pid;
+	int coalesced;		/* expiry was moved to share a wakeup */
 	void *start_site;
 	char start_comm[16];
 #endif
@@ -237,6 +238,8 @@ extern unsigned long get_next_timer_interrupt(unsigned long now);
 extern int timer_stats_active;
 
 #define TIMER_STATS_FLAG_DEFERRABLE	0x1
+/* not part of the entry: expiry shared a wakeup thanks to coalescing */
+#define TIMER_STATS_FLAG_SAVED		0x2
 
 extern void init_timer_stats(void);
 
@@ -286,6 +289,12 @@ extern int try_to_del_timer_sync(struct timer_list *timer);
 
 extern void init_timers(void);
 extern void run_local_timers(void);
+
+extern unsigned int sysctl_timer_coalesce_ms;
+struct ctl_table;
+extern int timer_coalesce_handler(struct ctl_table *table, int write,
+				  void __user *buffer, size_t *lenp,
+				  loff_t *ppos);
 struct hrtimer;
 extern enum hrtimer_restart it_real_fn(struct hrtimer *);
 
@@ -32,6 +32,7 @@ int default_wake_function(wait_queue_t *wait, unsigned mode, int flags, void *ke
 struct __wait_queue {
 	unsigned int flags;
 #define WQ_FLAG_EXCLUSIVE	0x01
+#define WQ_FLAG_ROUNDROBIN	0x02	/* requeued at the tail once woken */
 	void *private;
 	wait_queue_func_t func;
 	struct list_head task_list;
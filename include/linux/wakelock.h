@@ -18,6 +18,8 @@
 
 #include <linux/list.h>
 #include <linux/ktime.h>
+#include <linux/spinlock.h>
+#include <linux/timer.h>
 
 /* A wake_lock prevents the system from entering suspend or other low power
  * states when active. If the type is set to WAKE_LOCK_SUSPEND, the wake_lock
@@ -35,9 +37,11 @@ enum {
 struct wake_lock {
 #ifdef CONFIG_HAS_WAKELOCK
 	struct list_head    link;
+	spinlock_t          lock;
 	int                 flags;
 	const char         *name;
 	unsigned long       expires;
+	struct timer_list   timer;
 #ifdef CONFIG_WAKELOCK_STAT
 	struct {
 		int             count;
@@ -45,6 +49,7 @@ struct wake_lock {
 		int             wakeup_count;
 		ktime_t         total_time;
 		ktime_t         prevent_suspend_time;
+		ktime_t         prevent_suspend_start;
 		ktime_t         max_time;
 		ktime_t         last_time;
 	} stat;
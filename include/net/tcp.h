@@ -252,6 +252,7 @@ extern int sysctl_tcp_max_ssthresh;
 extern int sysctl_tcp_cookie_size;
 extern int sysctl_tcp_thin_linear_timeouts;
 extern int sysctl_tcp_thin_dupack;
+extern int sysctl_tcp_limit_output_bytes;
 
 extern atomic_long_t tcp_memory_allocated;
 extern struct percpu_counter tcp_sockets_allocated;
@@ -317,6 +318,12 @@ extern void tcp_v4_err(struct sk_buff *skb, u32);
 extern void tcp_shutdown (struct sock *sk, int how);
 
 extern int tcp_v4_rcv(struct sk_buff *skb);
+extern void tcp_v4_early_demux(struct sk_buff *skb);
+extern void tcp_v4_rx_flow_reset(struct sock *sk);
+
+extern void tcp_wfree(struct sk_buff *skb);
+extern void tcp_release_cb(struct sock *sk);
+extern void __init tcp_tasklet_init(void);
 
 extern struct inet_peer *tcp_v4_get_peer(struct sock *sk, bool *release_it);
 extern void *tcp_v4_tw_get_peer(struct sock *sk);
@@ -102,6 +102,44 @@ TRACE_EVENT(workqueue_execute_start,
 	TP_printk("work struct %p: function %pf", __entry->work, __entry->function)
 );
 
+/**
+ * workqueue_execute_latency - time a work spent queued before execution
+ * @work:	pointer to struct work_struct
+ * @cpu:	cpu of the worker pool, WORK_CPU_UNBOUND for unbound works
+ * @highpri:	whether the work ran on the high priority pool
+ * @latency:	ns from queueing to the start of execution
+ *
+ * Only available with CONFIG_WORKQUEUE_LATENCY.
+ */
+TRACE_EVENT(workqueue_execute_latency,
+
+	TP_PROTO(struct work_struct *work, unsigned int cpu, int highpri,
+		 u64 latency),
+
+	TP_ARGS(work, cpu, highpri, latency),
+
+	TP_STRUCT__entry(
+		__field( void *,	work	)
+		__field( void *,	function)
+		__field( unsigned int,	cpu	)
+		__field( int,		highpri	)
+		__field( u64,		latency	)
+	),
+
+	TP_fast_assign(
+		__entry->work		= work;
+		__entry->function	= work->func;
+		__entry->cpu		= cpu;
+		__entry->highpri	= highpri;
+		__entry->latency	= latency;
+	),
+
+	TP_printk("work struct %p: function %pf cpu=%u%s latency=%llu ns",
+		  __entry->work, __entry->function, __entry->cpu,
+		  __entry->highpri ? " highpri" : "",
+		  (unsigned long long)__entry->latency)
+);
+
 /**
  * workqueue_execute_end - called immediately before the workqueue callback
  * @work:	pointer to struct work_struct
@@ -148,6 +148,17 @@ static struct pm_qos_object cpu_freq_max_pm_qos = {
 };
 
 
+static BLOCKING_NOTIFIER_HEAD(emc_freq_min_notifier);
+static struct pm_qos_object emc_freq_min_pm_qos = {
+	.requests = PLIST_HEAD_INIT(emc_freq_min_pm_qos.requests),
+	.notifiers = &emc_freq_min_notifier,
+	.name = "emc_freq_min",
+	.target_value = PM_QOS_EMC_FREQ_MIN_DEFAULT_VALUE,
+	.default_value = PM_QOS_EMC_FREQ_MIN_DEFAULT_VALUE,
+	.type = PM_QOS_MAX,
+};
+
+
 static struct pm_qos_object *pm_qos_array[] = {
 	&null_pm_qos,
 	&cpu_dma_pm_qos,
@@ -156,7 +167,8 @@ static struct pm_qos_object *pm_qos_array[] = {
 	&min_online_cpus_pm_qos,
 	&max_online_cpus_pm_qos,
 	&cpu_freq_min_pm_qos,
-	&cpu_freq_max_pm_qos
+	&cpu_freq_max_pm_qos,
+	&emc_freq_min_pm_qos
 };
 
 static ssize_t pm_qos_power_write(struct file *filp, const char __user *buf,
@@ -281,6 +293,21 @@ int pm_qos_request_active(struct pm_qos_request_list *req)
 }
 EXPORT_SYMBOL_GPL(pm_qos_request_active);
 
+/*
+ * pm_qos_work_fn - the timeout handler of pm_qos_update_request_timeout
+ * @work: work struct for the delayed work (timeout)
+ *
+ * This cancels the timeout request by falling back to the default.
+ */
+static void pm_qos_work_fn(struct work_struct *work)
+{
+	struct pm_qos_request_list *req = container_of(to_delayed_work(work),
+						       struct pm_qos_request_list,
+						       work);
+
+	pm_qos_update_request(req, PM_QOS_DEFAULT_VALUE);
+}
+
 /**
  * pm_qos_add_request - inserts new qos request into the list
  * @dep: pointer to a preallocated handle
@@ -310,6 +337,7 @@ void pm_qos_add_request(struct pm_qos_request_list *dep,
 		new_value = value;
 	plist_node_init(&dep->list, new_value);
 	dep->pm_qos_class = pm_qos_class;
+	INIT_DELAYED_WORK(&dep->work, pm_qos_work_fn);
 	update_target(o, &dep->list, 0, PM_QOS_DEFAULT_VALUE);
 }
 EXPORT_SYMBOL_GPL(pm_qos_add_request);
@@ -338,6 +366,14 @@ void pm_qos_update_request(struct pm_qos_request_list *pm_qos_req,
 		return;
 	}
 
+	/*
+	 * An explicit update overrides a pending timeout.  This may be
+	 * called from atomic context, so the timeout is not waited for if
+	 * it is already running; don't mix both kinds of update on one
+	 * request from different contexts.
+	 */
+	cancel_delayed_work(&pm_qos_req->work);
+
 	o = pm_qos_array[pm_qos_req->pm_qos_class];
 
 	if (new_value == PM_QOS_DEFAULT_VALUE)
@@ -350,6 +386,46 @@ void pm_qos_update_request(struct pm_qos_request_list *pm_qos_req,
 }
 EXPORT_SYMBOL_GPL(pm_qos_update_request);
 
+/**
+ * pm_qos_update_request_timeout - modifies an existing qos request temporarily.
+ * @pm_qos_req : handle to list element holding a pm_qos request to use
+ * @new_value: defines the temporal qos request
+ * @timeout_us: the effective duration of this qos request in usecs.
+ *
+ * After timeout_us, this qos request is cancelled and falls back to the
+ * default value.  Calling it again before the timeout expires replaces
+ * the value and restarts the timeout.  May sleep.
+ */
+void pm_qos_update_request_timeout(struct pm_qos_request_list *pm_qos_req,
+				   s32 new_value, unsigned long timeout_us)
+{
+	s32 temp;
+	struct pm_qos_object *o;
+
+	if (!pm_qos_req)
+		return;
+
+	if (!pm_qos_request_active(pm_qos_req)) {
+		WARN(1, KERN_ERR "pm_qos_update_request_timeout() called for unknown object\n");
+		return;
+	}
+
+	cancel_delayed_work_sync(&pm_qos_req->work);
+
+	o = pm_qos_array[pm_qos_req->pm_qos_class];
+
+	if (new_value == PM_QOS_DEFAULT_VALUE)
+		temp = o->default_value;
+	else
+		temp = new_value;
+
+	if (temp != pm_qos_req->list.prio)
+		update_target(o, &pm_qos_req->list, 0, temp);
+
+	schedule_delayed_work(&pm_qos_req->work, usecs_to_jiffies(timeout_us));
+}
+EXPORT_SYMBOL_GPL(pm_qos_update_request_timeout);
+
 /**
  * pm_qos_remove_request - modifies an existing qos request
  * @pm_qos_req: handle to request list element
@@ -371,6 +447,8 @@ void pm_qos_remove_request(struct pm_qos_request_list *pm_qos_req)
 		return;
 	}
 
+	cancel_delayed_work_sync(&pm_qos_req->work);
+
 	o = pm_qos_array[pm_qos_req->pm_qos_class];
 	update_target(o, &pm_qos_req->list, 1, PM_QOS_DEFAULT_VALUE);
 	memset(pm_qos_req, 0, sizeof(*pm_qos_req));
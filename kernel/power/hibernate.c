@@ -30,6 +30,7 @@
 
 
 static int nocompress = 0;
+static int dropcache = 0;
 static int noresume = 0;
 static char resume_file[256] = CONFIG_PM_STD_PARTITION;
 dev_t swsusp_resume_device;
@@ -334,6 +335,10 @@ int hibernation_snapshot(int platform_mode)
 	if (error)
 		goto Close;
 
+	/* Clean page cache can be read back from disk, don't save it. */
+	if (dropcache)
+		drop_pagecache();
+
 	error = dpm_prepare(PMSG_FREEZE);
 	if (error)
 		goto Complete_devices;
@@ -650,6 +655,8 @@ int hibernate(void)
 			flags |= SF_PLATFORM_MODE;
 		if (nocompress)
 			flags |= SF_NOCOMPRESS_MODE;
+		else
+			flags |= SF_CRC32_MODE;
 		pr_debug("PM: writing image.\n");
 		error = swsusp_write(flags);
 		swsusp_free();
@@ -1051,6 +1058,8 @@ static int __init hibernate_setup(char *str)
 		noresume = 1;
 	else if (!strncmp(str, "nocompress", 10))
 		nocompress = 1;
+	else if (!strncmp(str, "dropcache", 9))
+		dropcache = 1;
 	return 1;
 }
 
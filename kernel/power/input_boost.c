@@ -0,0 +1,360 @@
+/*
+ * kernel/power/input_boost.c
+ *
+ * Coordinated, time-bounded performance boost on user input.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * A touch event, or a hint written by userspace, raises the minimum cpu
+ * frequency, the minimum number of online cpus and the minimum memory
+ * clock together through PM QoS, so cpufreq, cpuquiet and the EMC
+ * driver all ramp up at the same time instead of each reacting to load
+ * on its own schedule.  The requests expire on their own after the
+ * boost duration.
+ *
+ * The time from the start of a boost to the next frame the display
+ * driver presents is recorded, see input_boost_frame_done().
+ */
+
+#include <linux/debugfs.h>
+#include <linux/hrtimer.h>
+#include <linux/init.h>
+#include <linux/input.h>
+#include <linux/input_boost.h>
+#include <linux/jiffies.h>
+#include <linux/kernel.h>
+#include <linux/kobject.h>
+#include <linux/ktime.h>
+#include <linux/log2.h>
+#include <linux/pm_qos_params.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/sysfs.h>
+#include <linux/workqueue.h>
+
+#define DEFAULT_BOOST_DURATION_MS	1500
+/* Input events closer together than this do not extend the boost */
+#define BOOST_REFRESH_MS		100
+
+/* cpu frequency floor in kHz; cpufreq clamps it to the policy maximum */
+static unsigned int boost_cpu_freq = INT_MAX;
+static unsigned int boost_online_cpus = 2;
+/* memory clock floor in kHz */
+static unsigned int boost_emc_freq = 400000;
+static unsigned int boost_duration_ms = DEFAULT_BOOST_DURATION_MS;
+
+static struct pm_qos_request_list online_cpus_req;
+static struct pm_qos_request_list cpu_freq_req;
+static struct pm_qos_request_list emc_freq_req;
+
+static DEFINE_SPINLOCK(boost_lock);
+static unsigned long boost_end = INITIAL_JIFFIES;
+static unsigned int pending_duration_ms;
+
+/* boost-to-frame latency, in ms buckets 0-4, 4-8, ..., 256+ */
+#define LATENCY_BINS	8
+static ktime_t boost_start;
+static bool frame_pending;
+static unsigned int latency_bins[LATENCY_BINS];
+static unsigned int latency_count;
+static unsigned int latency_last_us;
+static unsigned int latency_max_us;
+
+static void input_boost_work_fn(struct work_struct *work)
+{
+	unsigned long flags;
+	unsigned int duration_ms;
+	unsigned long timeout_us;
+
+	spin_lock_irqsave(&boost_lock, flags);
+	duration_ms = pending_duration_ms;
+	spin_unlock_irqrestore(&boost_lock, flags);
+
+	if (!duration_ms) {
+		pm_qos_update_request(&online_cpus_req, PM_QOS_DEFAULT_VALUE);
+		pm_qos_update_request(&cpu_freq_req, PM_QOS_DEFAULT_VALUE);
+		pm_qos_update_request(&emc_freq_req, PM_QOS_DEFAULT_VALUE);
+		return;
+	}
+
+	/*
+	 * Bring the cores up first so that the frequency floor applies to
+	 * the cluster the boosted work is going to run on.
+	 */
+	timeout_us = duration_ms * USEC_PER_MSEC;
+	if (boost_online_cpus)
+		pm_qos_update_request_timeout(&online_cpus_req,
+					      boost_online_cpus, timeout_us);
+	if (boost_cpu_freq)
+		pm_qos_update_request_timeout(&cpu_freq_req,
+					      boost_cpu_freq, timeout_us);
+	if (boost_emc_freq)
+		pm_qos_update_request_timeout(&emc_freq_req,
+					      boost_emc_freq, timeout_us);
+}
+
+static DECLARE_WORK(input_boost_work, input_boost_work_fn);
+
+static void __input_boost(unsigned int duration_ms)
+{
+	unsigned long flags;
+	unsigned long now = jiffies;
+	unsigned long end = now + msecs_to_jiffies(duration_ms);
+	bool active;
+
+	spin_lock_irqsave(&boost_lock, flags);
+	active = time_before(now, boost_end);
+
+	if (duration_ms && active &&
+	    time_before(end, boost_end + msecs_to_jiffies(BOOST_REFRESH_MS))) {
+		spin_unlock_irqrestore(&boost_lock, flags);
+		return;
+	}
+
+	if (duration_ms && !active) {
+		boost_start = ktime_get();
+		frame_pending = true;
+	}
+
+	boost_end = duration_ms ? end : now;
+	pending_duration_ms = duration_ms;
+	spin_unlock_irqrestore(&boost_lock, flags);
+
+	schedule_work(&input_boost_work);
+}
+
+/**
+ * input_boost_kick - raise all boost floors
+ * @duration_ms: how long the boost lasts, 0 for the configured default
+ *
+ * May be called from atomic context.  Kicks that would not extend a
+ * running boost by at least BOOST_REFRESH_MS are ignored.
+ */
+void input_boost_kick(unsigned int duration_ms)
+{
+	__input_boost(duration_ms ? : boost_duration_ms);
+}
+EXPORT_SYMBOL_GPL(input_boost_kick);
+
+/**
+ * input_boost_frame_done - account the first frame presented in a boost
+ *
+ * Called by display drivers after a flip has completed.
+ */
+void input_boost_frame_done(void)
+{
+	unsigned long flags;
+	unsigned int us, ms;
+	int bin;
+
+	if (!frame_pending)
+		return;
+
+	spin_lock_irqsave(&boost_lock, flags);
+	if (frame_pending) {
+		frame_pending = false;
+
+		us = (unsigned int)ktime_us_delta(ktime_get(), boost_start);
+		ms = us / USEC_PER_MSEC;
+		bin = ms < 4 ? 0 : min(ilog2(ms) - 1, LATENCY_BINS - 1);
+
+		latency_bins[bin]++;
+		latency_count++;
+		latency_last_us = us;
+		if (us > latency_max_us)
+			latency_max_us = us;
+	}
+	spin_unlock_irqrestore(&boost_lock, flags);
+}
+EXPORT_SYMBOL_GPL(input_boost_frame_done);
+
+static void input_boost_event(struct input_handle *handle, unsigned int type,
+		unsigned int code, int value)
+{
+	input_boost_kick(0);
+}
+
+static int input_boost_connect(struct input_handler *handler,
+		struct input_dev *dev, const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int error;
+
+	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = "input_boost";
+
+	error = input_register_handle(handle);
+	if (error)
+		goto err2;
+
+	error = input_open_device(handle);
+	if (error)
+		goto err1;
+
+	return 0;
+err1:
+	input_unregister_handle(handle);
+err2:
+	kfree(handle);
+	return error;
+}
+
+static void input_boost_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+static const struct input_device_id input_boost_ids[] = {
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.absbit = { [BIT_WORD(ABS_MT_POSITION_X)] =
+			    BIT_MASK(ABS_MT_POSITION_X) |
+			    BIT_MASK(ABS_MT_POSITION_Y) },
+	}, /* multi-touch touchscreen */
+	{},
+};
+
+static struct input_handler input_boost_handler = {
+	.event		= input_boost_event,
+	.connect	= input_boost_connect,
+	.disconnect	= input_boost_disconnect,
+	.name		= "input_boost",
+	.id_table	= input_boost_ids,
+};
+
+#define input_boost_attr(_name)						\
+static ssize_t _name##_show(struct kobject *kobj,			\
+		struct kobj_attribute *attr, char *buf)			\
+{									\
+	return sprintf(buf, "%u\n", boost_##_name);			\
+}									\
+									\
+static ssize_t _name##_store(struct kobject *kobj,			\
+		struct kobj_attribute *attr, const char *buf, size_t n)	\
+{									\
+	unsigned long val;						\
+									\
+	if (strict_strtoul(buf, 0, &val) || val > INT_MAX)		\
+		return -EINVAL;						\
+	boost_##_name = val;						\
+	return n;							\
+}									\
+									\
+static struct kobj_attribute _name##_attr =				\
+	__ATTR(_name, 0644, _name##_show, _name##_store)
+
+input_boost_attr(cpu_freq);
+input_boost_attr(online_cpus);
+input_boost_attr(emc_freq);
+input_boost_attr(duration_ms);
+
+/* Userspace hint: boost for the given number of ms, 0 to cancel */
+static ssize_t boost_store(struct kobject *kobj,
+		struct kobj_attribute *attr, const char *buf, size_t n)
+{
+	unsigned long val;
+
+	if (strict_strtoul(buf, 0, &val) || val > INT_MAX)
+		return -EINVAL;
+
+	__input_boost(val);
+	return n;
+}
+
+static struct kobj_attribute boost_attr = __ATTR(boost, 0200, NULL,
+		boost_store);
+
+static struct attribute *input_boost_attrs[] = {
+	&cpu_freq_attr.attr,
+	&online_cpus_attr.attr,
+	&emc_freq_attr.attr,
+	&duration_ms_attr.attr,
+	&boost_attr.attr,
+	NULL,
+};
+
+static struct attribute_group input_boost_attr_group = {
+	.attrs = input_boost_attrs,
+	.name = "input_boost",
+};
+
+#ifdef CONFIG_DEBUG_FS
+static int input_boost_latency_show(struct seq_file *s, void *data)
+{
+	int bin;
+
+	seq_printf(s, "boosts with a frame: %u\n", latency_count);
+	seq_printf(s, "last latency (us):   %u\n", latency_last_us);
+	seq_printf(s, "max latency (us):    %u\n", latency_max_us);
+	seq_printf(s, "latency (ms)  count\n");
+	seq_printf(s, "------------------\n");
+	for (bin = 0; bin < LATENCY_BINS; bin++) {
+		if (bin == LATENCY_BINS - 1)
+			seq_printf(s, "%4d -      %6u\n",
+				   2 << bin, latency_bins[bin]);
+		else
+			seq_printf(s, "%4d - %4d %6u\n",
+				   bin ? 2 << bin : 0, 4 << bin,
+				   latency_bins[bin]);
+	}
+	return 0;
+}
+
+static int input_boost_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, input_boost_latency_show, NULL);
+}
+
+static const struct file_operations input_boost_latency_fops = {
+	.open		= input_boost_latency_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void __init input_boost_debug_init(void)
+{
+	struct dentry *d;
+
+	d = debugfs_create_file("input_boost_latency", 0444, NULL, NULL,
+				&input_boost_latency_fops);
+	if (!d)
+		pr_err("Failed to create input_boost_latency debug file\n");
+}
+#else
+static inline void input_boost_debug_init(void) { }
+#endif
+
+static int __init input_boost_init(void)
+{
+	int ret;
+
+	pm_qos_add_request(&online_cpus_req, PM_QOS_MIN_ONLINE_CPUS,
+			   PM_QOS_DEFAULT_VALUE);
+	pm_qos_add_request(&cpu_freq_req, PM_QOS_CPU_FREQ_MIN,
+			   PM_QOS_DEFAULT_VALUE);
+	pm_qos_add_request(&emc_freq_req, PM_QOS_EMC_FREQ_MIN,
+			   PM_QOS_DEFAULT_VALUE);
+
+	ret = sysfs_create_group(power_kobj, &input_boost_attr_group);
+	if (ret)
+		pr_err("input_boost: failed to create sysfs group\n");
+
+	input_boost_debug_init();
+
+	return input_register_handler(&input_boost_handler);
+}
+
+late_initcall(input_boost_init);
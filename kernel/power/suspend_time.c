@@ -15,16 +15,98 @@
  */
 
 #include <linux/debugfs.h>
+#include <linux/device.h>
 #include <linux/err.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
+#include <linux/module.h>
 #include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/suspend.h>
 #include <linux/syscore_ops.h>
 #include <linux/time.h>
 
 static struct timespec suspend_time_before;
 static unsigned int time_in_suspend_bins[32];
 
+#ifdef CONFIG_PM_SLEEP
+/*
+ * The slowest device callbacks of the last suspend and the last resume,
+ * ordered by duration.  Names are copied, devices may go away meanwhile.
+ */
+#define SUSPEND_TIME_DEVS	16
+
+struct suspend_time_dev {
+	char name[32];
+	s64 start_us;		/* since the start of the phase */
+	s64 duration_us;
+};
+
+static struct suspend_time_dev slowest_devs[2][SUSPEND_TIME_DEVS];
+static unsigned int nr_slowest_devs[2];
+static DEFINE_SPINLOCK(suspend_time_dev_lock);
+
+/* suspend_time.critical_path=1 logs the chain that bounded each phase */
+static bool critical_path;
+module_param(critical_path, bool, S_IRUGO | S_IWUSR);
+
+void suspend_time_dev_begin(bool resume)
+{
+	spin_lock(&suspend_time_dev_lock);
+	nr_slowest_devs[resume] = 0;
+	spin_unlock(&suspend_time_dev_lock);
+}
+
+void suspend_time_dev_record(struct device *dev, bool resume,
+			     ktime_t phase_start)
+{
+	struct suspend_time_dev *devs = slowest_devs[resume];
+	s64 duration = ktime_us_delta(dev->power.dpm_end, dev->power.dpm_start);
+	unsigned int i;
+
+	spin_lock(&suspend_time_dev_lock);
+	i = nr_slowest_devs[resume];
+	if (i == SUSPEND_TIME_DEVS) {
+		if (duration <= devs[i - 1].duration_us)
+			goto out;
+		i--;
+	} else {
+		nr_slowest_devs[resume]++;
+	}
+	for (; i > 0 && devs[i - 1].duration_us < duration; i--)
+		devs[i] = devs[i - 1];
+	strlcpy(devs[i].name, dev_name(dev), sizeof(devs[i].name));
+	devs[i].start_us = ktime_us_delta(dev->power.dpm_start, phase_start);
+	devs[i].duration_us = duration;
+ out:
+	spin_unlock(&suspend_time_dev_lock);
+}
+
+/*
+ * @last finished last in the phase.  Following the dependencies each device
+ * waited for back from it gives the chain of callbacks that bounded the
+ * duration of the phase, which is what has to get faster.
+ */
+void suspend_time_dev_end(struct device *last, bool resume,
+			  ktime_t phase_start)
+{
+	struct device *dev;
+
+	if (!critical_path || !last)
+		return;
+
+	pr_info("PM: %s critical path, %lld usecs:\n",
+		resume ? "resume" : "suspend",
+		ktime_us_delta(last->power.dpm_end, phase_start));
+	for (dev = last; dev; dev = dev->power.dpm_waited_on)
+		pr_info("PM:   %s: started at %lld, took %lld usecs\n",
+			dev_name(dev),
+			ktime_us_delta(dev->power.dpm_start, phase_start),
+			ktime_us_delta(dev->power.dpm_end,
+				       dev->power.dpm_start));
+}
+#endif
+
 #ifdef CONFIG_DEBUG_FS
 static int suspend_time_debug_show(struct seq_file *s, void *data)
 {
@@ -53,6 +135,38 @@ static const struct file_operations suspend_time_debug_fops = {
 	.release	= single_release,
 };
 
+#ifdef CONFIG_PM_SLEEP
+static int suspend_time_devs_show(struct seq_file *s, void *data)
+{
+	int resume, i;
+
+	spin_lock(&suspend_time_dev_lock);
+	for (resume = 0; resume < 2; resume++) {
+		seq_printf(s, "%s: device  start (usecs)  time (usecs)\n",
+			   resume ? "resume" : "suspend");
+		for (i = 0; i < nr_slowest_devs[resume]; i++)
+			seq_printf(s, "%s %lld %lld\n",
+				   slowest_devs[resume][i].name,
+				   slowest_devs[resume][i].start_us,
+				   slowest_devs[resume][i].duration_us);
+	}
+	spin_unlock(&suspend_time_dev_lock);
+	return 0;
+}
+
+static int suspend_time_devs_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, suspend_time_devs_show, NULL);
+}
+
+static const struct file_operations suspend_time_devs_fops = {
+	.open		= suspend_time_devs_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
+
 static int __init suspend_time_debug_init(void)
 {
 	struct dentry *d;
@@ -64,6 +178,15 @@ static int __init suspend_time_debug_init(void)
 		return -ENOMEM;
 	}
 
+#ifdef CONFIG_PM_SLEEP
+	d = debugfs_create_file("suspend_time_devices", 0444, NULL, NULL,
+		&suspend_time_devs_fops);
+	if (!d) {
+		pr_err("Failed to create suspend_time_devices debug file\n");
+		return -ENOMEM;
+	}
+#endif
+
 	return 0;
 }
 
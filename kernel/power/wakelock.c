@@ -44,10 +44,18 @@ module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 #define WAKE_LOCK_AUTO_EXPIRE            (1U << 10)
 #define WAKE_LOCK_PREVENTING_SUSPEND     (1U << 11)
 
+/*
+ * list_lock only protects the list of all wake locks, which is walked for
+ * /proc/wakelocks, debug output and the rare main_wake_lock transitions.
+ * Locking and unlocking take just the wake lock's own spinlock and keep
+ * per-type active counts, so suspend can be decided without walking lists.
+ * Timeouts are per lock timers, so they expire without rescans.
+ */
 static DEFINE_SPINLOCK(list_lock);
-static LIST_HEAD(inactive_locks);
-static struct list_head active_wake_locks[WAKE_LOCK_TYPE_COUNT];
-static int current_event_num;
+static LIST_HEAD(wake_locks);
+static atomic_t active_count[WAKE_LOCK_TYPE_COUNT];	/* active locks */
+static atomic_t untimed_count[WAKE_LOCK_TYPE_COUNT];	/* ... without timeout */
+static atomic_t current_event_num;
 struct workqueue_struct *suspend_work_queue;
 struct wake_lock main_wake_lock;
 suspend_state_t requested_suspend_state = PM_SUSPEND_MEM;
@@ -59,10 +67,17 @@ static struct wake_lock suspend_backoff_lock;
 
 static unsigned suspend_short_count;
 
+static void suspend(struct work_struct *work);
+static DECLARE_WORK(suspend_work, suspend);
+
 #ifdef CONFIG_WAKELOCK_STAT
 static struct wake_lock deleted_wake_locks;
-static ktime_t last_sleep_time_update;
 static int wait_for_wakeup;
+/*
+ * Set while main_wake_lock is released; active suspend locks are then
+ * accounted as preventing suspend.
+ */
+static int main_lock_released;
 
 int get_expired_time(struct wake_lock *lock, ktime_t *expire_time)
 {
@@ -89,13 +104,24 @@ int get_expired_time(struct wake_lock *lock, ktime_t *expire_time)
 
 static int print_lock_stat(struct seq_file *m, struct wake_lock *lock)
 {
-	int lock_count = lock->stat.count;
-	int expire_count = lock->stat.expire_count;
+	int lock_count;
+	int expire_count;
+	int wakeup_count;
 	ktime_t active_time = ktime_set(0, 0);
-	ktime_t total_time = lock->stat.total_time;
-	ktime_t max_time = lock->stat.max_time;
+	ktime_t total_time;
+	ktime_t max_time;
+	ktime_t prevent_suspend_time;
+	ktime_t last_time;
+	unsigned long irqflags;
 
-	ktime_t prevent_suspend_time = lock->stat.prevent_suspend_time;
+	spin_lock_irqsave(&lock->lock, irqflags);
+	lock_count = lock->stat.count;
+	expire_count = lock->stat.expire_count;
+	wakeup_count = lock->stat.wakeup_count;
+	total_time = lock->stat.total_time;
+	max_time = lock->stat.max_time;
+	prevent_suspend_time = lock->stat.prevent_suspend_time;
+	last_time = lock->stat.last_time;
 	if (lock->flags & WAKE_LOCK_ACTIVE) {
 		ktime_t now, add_time;
 		int expired = get_expired_time(lock, &now);
@@ -110,18 +136,19 @@ static int print_lock_stat(struct seq_file *m, struct wake_lock *lock)
 		total_time = ktime_add(total_time, add_time);
 		if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND)
 			prevent_suspend_time = ktime_add(prevent_suspend_time,
-					ktime_sub(now, last_sleep_time_update));
+				ktime_sub(now, lock->stat.prevent_suspend_start));
 		if (add_time.tv64 > max_time.tv64)
 			max_time = add_time;
 	}
+	spin_unlock_irqrestore(&lock->lock, irqflags);
 
 	return seq_printf(m,
 		     "\"%s\"\t%d\t%d\t%d\t%lld\t%lld\t%lld\t%lld\t%lld\n",
 		     lock->name, lock_count, expire_count,
-		     lock->stat.wakeup_count, ktime_to_ns(active_time),
+		     wakeup_count, ktime_to_ns(active_time),
 		     ktime_to_ns(total_time),
 		     ktime_to_ns(prevent_suspend_time), ktime_to_ns(max_time),
-		     ktime_to_ns(lock->stat.last_time));
+		     ktime_to_ns(last_time));
 }
 
 static int wakelock_stats_show(struct seq_file *m, void *unused)
@@ -129,28 +156,54 @@ static int wakelock_stats_show(struct seq_file *m, void *unused)
 	unsigned long irqflags;
 	struct wake_lock *lock;
 	int ret;
-	int type;
 
 	spin_lock_irqsave(&list_lock, irqflags);
 
 	ret = seq_puts(m, "name\tcount\texpire_count\twake_count\tactive_since"
 			"\ttotal_time\tsleep_time\tmax_time\tlast_change\n");
-	list_for_each_entry(lock, &inactive_locks, link)
+	list_for_each_entry(lock, &wake_locks, link)
 		ret = print_lock_stat(m, lock);
-	for (type = 0; type < WAKE_LOCK_TYPE_COUNT; type++) {
-		list_for_each_entry(lock, &active_wake_locks[type], link)
-			ret = print_lock_stat(m, lock);
-	}
 	spin_unlock_irqrestore(&list_lock, irqflags);
 	return 0;
 }
 
+/* Caller must hold lock->lock */
+static void stop_preventing_suspend_locked(struct wake_lock *lock)
+{
+	ktime_t now;
+
+	if (!(lock->flags & WAKE_LOCK_PREVENTING_SUSPEND))
+		return;
+	if (!get_expired_time(lock, &now))
+		now = ktime_get();
+	lock->stat.prevent_suspend_time = ktime_add(
+		lock->stat.prevent_suspend_time,
+		ktime_sub(now, lock->stat.prevent_suspend_start));
+	lock->flags &= ~WAKE_LOCK_PREVENTING_SUSPEND;
+}
+
+/* Caller must hold lock->lock */
+static void start_preventing_suspend_locked(struct wake_lock *lock)
+{
+	if ((lock->flags & WAKE_LOCK_TYPE_MASK) != WAKE_LOCK_SUSPEND ||
+	    !(lock->flags & WAKE_LOCK_ACTIVE) ||
+	    (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND) ||
+	    !main_lock_released)
+		return;
+	if ((lock->flags & WAKE_LOCK_AUTO_EXPIRE) &&
+	    (long)(lock->expires - jiffies) <= 0)
+		return;
+	lock->stat.prevent_suspend_start = ktime_get();
+	lock->flags |= WAKE_LOCK_PREVENTING_SUSPEND;
+}
+
 static void wake_unlock_stat_locked(struct wake_lock *lock, int expired)
 {
 	ktime_t duration;
 	ktime_t now;
 	if (!(lock->flags & WAKE_LOCK_ACTIVE))
 		return;
+	stop_preventing_suspend_locked(lock);
 	if (get_expired_time(lock, &now))
 		expired = 1;
 	else
@@ -163,62 +216,71 @@ static void wake_unlock_stat_locked(struct wake_lock *lock, int expired)
 	if (ktime_to_ns(duration) > ktime_to_ns(lock->stat.max_time))
 		lock->stat.max_time = duration;
 	lock->stat.last_time = ktime_get();
-	if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND) {
-		duration = ktime_sub(now, last_sleep_time_update);
-		lock->stat.prevent_suspend_time = ktime_add(
-			lock->stat.prevent_suspend_time, duration);
-		lock->flags &= ~WAKE_LOCK_PREVENTING_SUSPEND;
-	}
 }
 
-static void update_sleep_wait_stats_locked(int done)
+/*
+ * main_wake_lock was taken (done) or released: stop or start accounting
+ * the active suspend locks as preventing suspend.
+ */
+static void update_sleep_wait_stats(int done)
 {
 	struct wake_lock *lock;
-	ktime_t now, etime, elapsed, add;
-	int expired;
-
-	now = ktime_get();
-	elapsed = ktime_sub(now, last_sleep_time_update);
-	list_for_each_entry(lock, &active_wake_locks[WAKE_LOCK_SUSPEND], link) {
-		expired = get_expired_time(lock, &etime);
-		if (lock->flags & WAKE_LOCK_PREVENTING_SUSPEND) {
-			if (expired)
-				add = ktime_sub(etime, last_sleep_time_update);
-			else
-				add = elapsed;
-			lock->stat.prevent_suspend_time = ktime_add(
-				lock->stat.prevent_suspend_time, add);
-		}
-		if (done || expired)
-			lock->flags &= ~WAKE_LOCK_PREVENTING_SUSPEND;
+	unsigned long irqflags;
+
+	spin_lock_irqsave(&list_lock, irqflags);
+	main_lock_released = !done;
+	list_for_each_entry(lock, &wake_locks, link) {
+		spin_lock(&lock->lock);
+		if (done)
+			stop_preventing_suspend_locked(lock);
 		else
-			lock->flags |= WAKE_LOCK_PREVENTING_SUSPEND;
+			start_preventing_suspend_locked(lock);
+		spin_unlock(&lock->lock);
 	}
-	last_sleep_time_update = now;
+	spin_unlock_irqrestore(&list_lock, irqflags);
 }
 #endif
 
-
-static void expire_wake_lock(struct wake_lock *lock)
+/*
+ * Caller must hold lock->lock. Returns true when this was the last active
+ * lock of its type.
+ */
+static bool wake_lock_deactivate_locked(struct wake_lock *lock, int expired)
 {
+	int type = lock->flags & WAKE_LOCK_TYPE_MASK;
+
+	if (!(lock->flags & WAKE_LOCK_ACTIVE))
+		return false;
 #ifdef CONFIG_WAKELOCK_STAT
-	wake_unlock_stat_locked(lock, 1);
+	wake_unlock_stat_locked(lock, expired);
 #endif
+	if (!(lock->flags & WAKE_LOCK_AUTO_EXPIRE))
+		atomic_dec(&untimed_count[type]);
 	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
-	list_del(&lock->link);
-	list_add(&lock->link, &inactive_locks);
+	return atomic_dec_and_test(&active_count[type]);
+}
+
+static bool expire_wake_lock(struct wake_lock *lock)
+{
+	bool last = wake_lock_deactivate_locked(lock, 1);
+
 	if (debug_mask & (DEBUG_WAKE_LOCK | DEBUG_EXPIRE))
 		pr_info("expired wake lock %s\n", lock->name);
+	return last;
 }
 
-/* Caller must acquire the list_lock spinlock */
 static void print_active_locks(int type)
 {
 	struct wake_lock *lock;
 	bool print_expired = true;
+	unsigned long irqflags;
 
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
-	list_for_each_entry(lock, &active_wake_locks[type], link) {
+	spin_lock_irqsave(&list_lock, irqflags);
+	list_for_each_entry(lock, &wake_locks, link) {
+		if ((lock->flags & WAKE_LOCK_TYPE_MASK) != type ||
+		    !(lock->flags & WAKE_LOCK_ACTIVE))
+			continue;
 		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
 			long timeout = lock->expires - jiffies;
 			if (timeout > 0)
@@ -232,36 +294,54 @@ static void print_active_locks(int type)
 				print_expired = false;
 		}
 	}
+	spin_unlock_irqrestore(&list_lock, irqflags);
 }
 
-static long has_wake_lock_locked(int type)
+/*
+ * Only timed locks of @type are active: return the longest time left,
+ * expiring the locks whose timer is due but has not run yet.
+ */
+static long max_wake_lock_timeout(int type)
 {
-	struct wake_lock *lock, *n;
+	struct wake_lock *lock;
 	long max_timeout = 0;
+	unsigned long irqflags;
 
-	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
-	list_for_each_entry_safe(lock, n, &active_wake_locks[type], link) {
+	spin_lock_irqsave(&list_lock, irqflags);
+	list_for_each_entry(lock, &wake_locks, link) {
+		if ((lock->flags & WAKE_LOCK_TYPE_MASK) != type)
+			continue;
+		spin_lock(&lock->lock);
 		if (lock->flags & WAKE_LOCK_AUTO_EXPIRE) {
 			long timeout = lock->expires - jiffies;
-			if (timeout <= 0)
+			if (timeout <= 0) {
+				del_timer(&lock->timer);
 				expire_wake_lock(lock);
-			else if (timeout > max_timeout)
+			} else if (timeout > max_timeout)
 				max_timeout = timeout;
-		} else
-			return -1;
+		} else if (lock->flags & WAKE_LOCK_ACTIVE)
+			max_timeout = -1;
+		spin_unlock(&lock->lock);
+		if (max_timeout < 0)
+			break;
 	}
+	spin_unlock_irqrestore(&list_lock, irqflags);
 	return max_timeout;
 }
 
 long has_wake_lock(int type)
 {
 	long ret;
-	unsigned long irqflags;
-	spin_lock_irqsave(&list_lock, irqflags);
-	ret = has_wake_lock_locked(type);
+
+	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
+	if (atomic_read(&untimed_count[type]))
+		ret = -1;
+	else if (!atomic_read(&active_count[type]))
+		ret = 0;
+	else
+		ret = max_wake_lock_timeout(type);
 	if (ret && (debug_mask & DEBUG_WAKEUP) && type == WAKE_LOCK_SUSPEND)
 		print_active_locks(type);
-	spin_unlock_irqrestore(&list_lock, irqflags);
 	return ret;
 }
 
@@ -284,7 +364,7 @@ static void suspend(struct work_struct *work)
 		return;
 	}
 
-	entry_event_num = current_event_num;
+	entry_event_num = atomic_read(&current_event_num);
 	sys_sync();
 	if (debug_mask & DEBUG_SUSPEND)
 		pr_info("suspend: enter suspend\n");
@@ -312,31 +392,31 @@ static void suspend(struct work_struct *work)
 		suspend_short_count = 0;
 	}
 
-	if (current_event_num == entry_event_num) {
+	if (atomic_read(&current_event_num) == entry_event_num) {
 		if (debug_mask & DEBUG_SUSPEND)
 			pr_info("suspend: pm_suspend returned with no event\n");
 		wake_lock_timeout(&unknown_wakeup, HZ / 2);
 	}
 }
-static DECLARE_WORK(suspend_work, suspend);
-
-static void expire_wake_locks(unsigned long data)
+static void wake_lock_expire_timer(unsigned long data)
 {
-	long has_lock;
+	struct wake_lock *lock = (struct wake_lock *)data;
 	unsigned long irqflags;
-	if (debug_mask & DEBUG_EXPIRE)
-		pr_info("expire_wake_locks: start\n");
-	spin_lock_irqsave(&list_lock, irqflags);
-	if (debug_mask & DEBUG_SUSPEND)
-		print_active_locks(WAKE_LOCK_SUSPEND);
-	has_lock = has_wake_lock_locked(WAKE_LOCK_SUSPEND);
-	if (debug_mask & DEBUG_EXPIRE)
-		pr_info("expire_wake_locks: done, has_lock %ld\n", has_lock);
-	if (has_lock == 0)
+	bool last = false;
+
+	spin_lock_irqsave(&lock->lock, irqflags);
+	if ((lock->flags & WAKE_LOCK_AUTO_EXPIRE) &&
+	    (long)(lock->expires - jiffies) <= 0)
+		last = expire_wake_lock(lock);
+	spin_unlock_irqrestore(&lock->lock, irqflags);
+
+	if (last && (lock->flags & WAKE_LOCK_TYPE_MASK) == WAKE_LOCK_SUSPEND) {
+		if (debug_mask & DEBUG_EXPIRE)
+			pr_info("expire_wake_locks: %s was the last lock\n",
+				lock->name);
 		queue_work(suspend_work_queue, &suspend_work);
-	spin_unlock_irqrestore(&list_lock, irqflags);
+	}
 }
-static DEFINE_TIMER(expire_timer, expire_wake_locks, 0, 0);
 
 static int power_suspend_late(struct device *dev)
 {
@@ -377,14 +457,18 @@ void wake_lock_init(struct wake_lock *lock, int type, const char *name)
 	lock->stat.wakeup_count = 0;
 	lock->stat.total_time = ktime_set(0, 0);
 	lock->stat.prevent_suspend_time = ktime_set(0, 0);
+	lock->stat.prevent_suspend_start = ktime_set(0, 0);
 	lock->stat.max_time = ktime_set(0, 0);
 	lock->stat.last_time = ktime_set(0, 0);
 #endif
 	lock->flags = (type & WAKE_LOCK_TYPE_MASK) | WAKE_LOCK_INITIALIZED;
 
+	spin_lock_init(&lock->lock);
+	setup_timer(&lock->timer, wake_lock_expire_timer, (unsigned long)lock);
+
 	INIT_LIST_HEAD(&lock->link);
 	spin_lock_irqsave(&list_lock, irqflags);
-	list_add(&lock->link, &inactive_locks);
+	list_add(&lock->link, &wake_locks);
 	spin_unlock_irqrestore(&list_lock, irqflags);
 }
 EXPORT_SYMBOL(wake_lock_init);
@@ -394,7 +478,10 @@ void wake_lock_destroy(struct wake_lock *lock)
 	unsigned long irqflags;
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_lock_destroy name=%s\n", lock->name);
+	del_timer_sync(&lock->timer);
 	spin_lock_irqsave(&list_lock, irqflags);
+	spin_lock(&lock->lock);
+	wake_lock_deactivate_locked(lock, 0);
 	lock->flags &= ~WAKE_LOCK_INITIALIZED;
 #ifdef CONFIG_WAKELOCK_STAT
 	if (lock->stat.count) {
@@ -411,6 +498,7 @@ void wake_lock_destroy(struct wake_lock *lock)
 				  lock->stat.max_time);
 	}
 #endif
+	spin_unlock(&lock->lock);
 	list_del(&lock->link);
 	spin_unlock_irqrestore(&list_lock, irqflags);
 }
@@ -421,17 +509,16 @@ static void wake_lock_internal(
 {
 	int type;
 	unsigned long irqflags;
-	long expire_in;
+	bool was_untimed;
 
-	spin_lock_irqsave(&list_lock, irqflags);
+	spin_lock_irqsave(&lock->lock, irqflags);
 	type = lock->flags & WAKE_LOCK_TYPE_MASK;
 	BUG_ON(type >= WAKE_LOCK_TYPE_COUNT);
 	BUG_ON(!(lock->flags & WAKE_LOCK_INITIALIZED));
 #ifdef CONFIG_WAKELOCK_STAT
-	if (type == WAKE_LOCK_SUSPEND && wait_for_wakeup) {
+	if (type == WAKE_LOCK_SUSPEND && xchg(&wait_for_wakeup, 0)) {
 		if (debug_mask & DEBUG_WAKEUP)
 			pr_info("wakeup wake lock: %s\n", lock->name);
-		wait_for_wakeup = 0;
 		lock->stat.wakeup_count++;
 	}
 	if ((lock->flags & WAKE_LOCK_AUTO_EXPIRE) &&
@@ -440,55 +527,46 @@ static void wake_lock_internal(
 		lock->stat.last_time = ktime_get();
 	}
 #endif
+	was_untimed = (lock->flags & WAKE_LOCK_ACTIVE) &&
+		      !(lock->flags & WAKE_LOCK_AUTO_EXPIRE);
 	if (!(lock->flags & WAKE_LOCK_ACTIVE)) {
 		lock->flags |= WAKE_LOCK_ACTIVE;
+		atomic_inc(&active_count[type]);
 #ifdef CONFIG_WAKELOCK_STAT
 		lock->stat.last_time = ktime_get();
 #endif
 	}
-	list_del(&lock->link);
 	if (has_timeout) {
 		if (debug_mask & DEBUG_WAKE_LOCK)
 			pr_info("wake_lock: %s, type %d, timeout %ld.%03lu\n",
 				lock->name, type, timeout / HZ,
 				(timeout % HZ) * MSEC_PER_SEC / HZ);
+		if (was_untimed)
+			atomic_dec(&untimed_count[type]);
 		lock->expires = jiffies + timeout;
 		lock->flags |= WAKE_LOCK_AUTO_EXPIRE;
-		list_add_tail(&lock->link, &active_wake_locks[type]);
+		mod_timer(&lock->timer, lock->expires);
 	} else {
 		if (debug_mask & DEBUG_WAKE_LOCK)
 			pr_info("wake_lock: %s, type %d\n", lock->name, type);
+		if (!was_untimed)
+			atomic_inc(&untimed_count[type]);
 		lock->expires = LONG_MAX;
 		lock->flags &= ~WAKE_LOCK_AUTO_EXPIRE;
-		list_add(&lock->link, &active_wake_locks[type]);
+		del_timer(&lock->timer);
 	}
 	if (type == WAKE_LOCK_SUSPEND) {
-		current_event_num++;
+		atomic_inc(&current_event_num);
 #ifdef CONFIG_WAKELOCK_STAT
-		if (lock == &main_wake_lock)
-			update_sleep_wait_stats_locked(1);
-		else if (!wake_lock_active(&main_wake_lock))
-			update_sleep_wait_stats_locked(0);
+		start_preventing_suspend_locked(lock);
 #endif
-		if (has_timeout)
-			expire_in = has_wake_lock_locked(type);
-		else
-			expire_in = -1;
-		if (expire_in > 0) {
-			if (debug_mask & DEBUG_EXPIRE)
-				pr_info("wake_lock: %s, start expire timer, "
-					"%ld\n", lock->name, expire_in);
-			mod_timer(&expire_timer, jiffies + expire_in);
-		} else {
-			if (del_timer(&expire_timer))
-				if (debug_mask & DEBUG_EXPIRE)
-					pr_info("wake_lock: %s, stop expire timer\n",
-						lock->name);
-			if (expire_in == 0)
-				queue_work(suspend_work_queue, &suspend_work);
-		}
 	}
-	spin_unlock_irqrestore(&list_lock, irqflags);
+	spin_unlock_irqrestore(&lock->lock, irqflags);
+
+#ifdef CONFIG_WAKELOCK_STAT
+	if (lock == &main_wake_lock)
+		update_sleep_wait_stats(1);
+#endif
 }
 
 void wake_lock(struct wake_lock *lock)
@@ -507,40 +585,27 @@ void wake_unlock(struct wake_lock *lock)
 {
 	int type;
 	unsigned long irqflags;
-	spin_lock_irqsave(&list_lock, irqflags);
+	bool last;
+
+	del_timer(&lock->timer);
+	spin_lock_irqsave(&lock->lock, irqflags);
 	type = lock->flags & WAKE_LOCK_TYPE_MASK;
-#ifdef CONFIG_WAKELOCK_STAT
-	wake_unlock_stat_locked(lock, 0);
-#endif
 	if (debug_mask & DEBUG_WAKE_LOCK)
 		pr_info("wake_unlock: %s\n", lock->name);
-	lock->flags &= ~(WAKE_LOCK_ACTIVE | WAKE_LOCK_AUTO_EXPIRE);
-	list_del(&lock->link);
-	list_add(&lock->link, &inactive_locks);
-	if (type == WAKE_LOCK_SUSPEND) {
-		long has_lock = has_wake_lock_locked(type);
-		if (has_lock > 0) {
-			if (debug_mask & DEBUG_EXPIRE)
-				pr_info("wake_unlock: %s, start expire timer, "
-					"%ld\n", lock->name, has_lock);
-			mod_timer(&expire_timer, jiffies + has_lock);
-		} else {
-			if (del_timer(&expire_timer))
-				if (debug_mask & DEBUG_EXPIRE)
-					pr_info("wake_unlock: %s, stop expire "
-						"timer\n", lock->name);
-			if (has_lock == 0)
-				queue_work(suspend_work_queue, &suspend_work);
-		}
-		if (lock == &main_wake_lock) {
-			if (debug_mask & DEBUG_SUSPEND)
-				print_active_locks(WAKE_LOCK_SUSPEND);
+	last = wake_lock_deactivate_locked(lock, 0);
+	spin_unlock_irqrestore(&lock->lock, irqflags);
+
+	if (type != WAKE_LOCK_SUSPEND)
+		return;
+	if (last)
+		queue_work(suspend_work_queue, &suspend_work);
+	if (lock == &main_wake_lock) {
+		if (debug_mask & DEBUG_SUSPEND)
+			print_active_locks(WAKE_LOCK_SUSPEND);
 #ifdef CONFIG_WAKELOCK_STAT
-			update_sleep_wait_stats_locked(0);
+		update_sleep_wait_stats(0);
 #endif
-		}
 	}
-	spin_unlock_irqrestore(&list_lock, irqflags);
 }
 EXPORT_SYMBOL(wake_unlock);
 
@@ -566,10 +631,6 @@ static const struct file_operations wakelock_stats_fops = {
 static int __init wakelocks_init(void)
 {
 	int ret;
-	int i;
-
-	for (i = 0; i < ARRAY_SIZE(active_wake_locks); i++)
-		INIT_LIST_HEAD(&active_wake_locks[i]);
 
 #ifdef CONFIG_WAKELOCK_STAT
 	wake_lock_init(&deleted_wake_locks, WAKE_LOCK_SUSPEND,
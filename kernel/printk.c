@@ -41,6 +41,9 @@
 #include <linux/cpu.h>
 #include <linux/notifier.h>
 #include <linux/rculist.h>
+#include <linux/kthread.h>
+#include <linux/lat_hist.h>
+#include <linux/seq_file.h>
 
 #include <asm/uaccess.h>
 
@@ -117,6 +120,24 @@ static unsigned log_start;	/* Index into log_buf: next char to be read by syslog
 static unsigned con_start;	/* Index into log_buf: next char to be sent to consoles */
 static unsigned log_end;	/* Index into log_buf: most-recently-written-char + 1 */
 
+/*
+ * Work left for printk_tick() on this cpu, for callers that may hold
+ * scheduler locks and so cannot wake anybody up themselves.
+ */
+#define PRINTK_PENDING_WAKEUP	0x01	/* wake up klogd */
+#define PRINTK_PENDING_OUTPUT	0x02	/* wake up the console kthread */
+
+static DEFINE_PER_CPU(int, printk_pending);
+
+/* Writes out log_buf to the consoles when printk() defers it */
+static struct task_struct *printk_thread;
+
+static void printk_wake_console(void)
+{
+	if (printk_thread)
+		wake_up_process(printk_thread);
+}
+
 /*
  * If exclusive_console is non-NULL then only this console is to be printed to.
  */
@@ -862,7 +883,45 @@ static const char recursion_bug_msg [] =
 		KERN_CRIT "BUG: recent printk recursion!\n";
 static int recursion_bug;
 static int new_text_line = 1;
-static char printk_buf[1024];
+
+/*
+ * Messages are formatted into a per-cpu staging buffer with only local
+ * interrupts disabled, so logbuf_lock is held just long enough to copy
+ * the result into log_buf.  printk_stage_busy catches recursion on this
+ * cpu while the staging buffer is in use.
+ */
+#define PRINTK_STAGE_LEN	1024
+static DEFINE_PER_CPU(char [PRINTK_STAGE_LEN], printk_stage);
+static DEFINE_PER_CPU(int, printk_stage_busy);
+
+/*
+ * Once the console kthread runs, printk() only appends to log_buf and
+ * leaves the (possibly slow) console drivers to the thread.  Oopses,
+ * panics and shutdown still print synchronously.
+ */
+static int printk_offload = 1;
+module_param_named(console_offload, printk_offload, bool, S_IRUGO | S_IWUSR);
+
+static inline int printk_offload_console(void)
+{
+	return printk_offload && printk_thread && !oops_in_progress &&
+		system_state == SYSTEM_RUNNING;
+}
+
+#ifdef CONFIG_PRINTK_LATENCY
+/* printk() call latency */
+static DEFINE_PER_CPU(struct lat_hist, printk_latency);
+
+/* Called with interrupts disabled on the cpu that started at @start */
+static void printk_account_latency(u64 start)
+{
+	lat_hist_add(&__get_cpu_var(printk_latency), local_clock() - start);
+}
+#define printk_latency_start()	local_clock()
+#else
+static inline void printk_account_latency(u64 start) { }
+#define printk_latency_start()	0
+#endif
 
 int printk_delay_msec __read_mostly;
 
@@ -884,9 +943,11 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 	int current_log_level = default_message_loglevel;
 	unsigned long flags;
 	int this_cpu;
-	char *p;
+	char *buf, *p;
 	size_t plen;
 	char special;
+	int deferred = 0;
+	u64 start;
 
 	boot_delay_msec();
 	printk_delay();
@@ -895,11 +956,12 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 	/* This stops the holder of console_sem just where we want him */
 	raw_local_irq_save(flags);
 	this_cpu = smp_processor_id();
+	start = printk_latency_start();
 
 	/*
 	 * Ouch, printk recursed into itself!
 	 */
-	if (unlikely(printk_cpu == this_cpu)) {
+	if (unlikely(__this_cpu_read(printk_stage_busy))) {
 		/*
 		 * If a crash is occurring during printk() on this CPU,
 		 * then try to get the crash message out but make sure
@@ -913,25 +975,26 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 		}
 		zap_locks();
 	}
+	__this_cpu_write(printk_stage_busy, 1);
+	buf = __get_cpu_var(printk_stage);
 
-	lockdep_off();
-	spin_lock(&logbuf_lock);
-	printk_cpu = this_cpu;
-
-	if (recursion_bug) {
-		recursion_bug = 0;
-		strcpy(printk_buf, recursion_bug_msg);
+	if (unlikely(recursion_bug) && xchg(&recursion_bug, 0)) {
+		strcpy(buf, recursion_bug_msg);
 		printed_len = strlen(recursion_bug_msg);
 	}
-	/* Emit the output into the temporary buffer */
-	printed_len += vscnprintf(printk_buf + printed_len,
-				  sizeof(printk_buf) - printed_len, fmt, args);
+	/* Emit the output into the staging buffer, without logbuf_lock */
+	printed_len += vscnprintf(buf + printed_len,
+				  PRINTK_STAGE_LEN - printed_len, fmt, args);
 
 #ifdef	CONFIG_DEBUG_LL
-	printascii(printk_buf);
+	printascii(buf);
 #endif
 
-	p = printk_buf;
+	lockdep_off();
+	spin_lock(&logbuf_lock);
+	printk_cpu = this_cpu;
+
+	p = buf;
 
 	/* Read log level and handle special printk prefix */
 	plen = log_prefix(p, &current_log_level, &special);
@@ -965,7 +1028,7 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 				int i;
 
 				for (i = 0; i < plen; i++)
-					emit_log_char(printk_buf[i]);
+					emit_log_char(buf[i]);
 				printed_len += plen;
 			} else {
 				/* Add log prefix */
@@ -1002,23 +1065,47 @@ asmlinkage int vprintk(const char *fmt, va_list args)
 			new_text_line = 1;
 	}
 
-	/*
-	 * Try to acquire and then immediately release the
-	 * console semaphore. The release will do all the
-	 * actual magic (print out buffers, wake up klogd,
-	 * etc). 
-	 *
-	 * The console_trylock_for_printk() function
-	 * will release 'logbuf_lock' regardless of whether it
-	 * actually gets the semaphore or not.
-	 */
-	if (console_trylock_for_printk(this_cpu))
-		console_unlock();
+	if (printk_offload_console()) {
+		/* The console kthread will pick the new text up */
+		printk_cpu = UINT_MAX;
+		spin_unlock(&logbuf_lock);
+		__this_cpu_write(printk_stage_busy, 0);
+		deferred = 1;
+	} else {
+		/*
+		 * Try to acquire and then immediately release the
+		 * console semaphore. The release will do all the
+		 * actual magic (print out buffers, wake up klogd,
+		 * etc).
+		 *
+		 * The console_trylock_for_printk() function
+		 * will release 'logbuf_lock' regardless of whether it
+		 * actually gets the semaphore or not.
+		 */
+		int locked = console_trylock_for_printk(this_cpu);
+
+		__this_cpu_write(printk_stage_busy, 0);
+		if (locked)
+			console_unlock();
+	}
 
 	lockdep_on();
+	printk_account_latency(start);
 out_restore_irqs:
 	raw_local_irq_restore(flags);
 
+	/*
+	 * A caller running with interrupts enabled cannot be holding a
+	 * runqueue lock, so the thread can be woken right away.  Anyone
+	 * else leaves it to the next tick.
+	 */
+	if (deferred) {
+		if (raw_irqs_disabled_flags(flags))
+			__this_cpu_or(printk_pending, PRINTK_PENDING_OUTPUT);
+		else
+			printk_wake_console();
+	}
+
 	preempt_enable();
 	return printed_len;
 }
@@ -1259,13 +1346,16 @@ int is_console_locked(void)
 	return console_locked;
 }
 
-static DEFINE_PER_CPU(int, printk_pending);
-
 void printk_tick(void)
 {
-	if (__this_cpu_read(printk_pending)) {
+	int pending = __this_cpu_read(printk_pending);
+
+	if (pending) {
 		__this_cpu_write(printk_pending, 0);
-		wake_up_interruptible(&log_wait);
+		if (pending & PRINTK_PENDING_OUTPUT)
+			printk_wake_console();
+		if (pending & PRINTK_PENDING_WAKEUP)
+			wake_up_interruptible(&log_wait);
 	}
 }
 
@@ -1279,7 +1369,7 @@ int printk_needs_cpu(int cpu)
 void wake_up_klogd(void)
 {
 	if (waitqueue_active(&log_wait))
-		this_cpu_write(printk_pending, 1);
+		this_cpu_or(printk_pending, PRINTK_PENDING_WAKEUP);
 }
 
 /**
@@ -1653,6 +1743,38 @@ int unregister_console(struct console *console)
 }
 EXPORT_SYMBOL(unregister_console);
 
+#ifdef CONFIG_PRINTK
+static int printk_console_thread(void *unused)
+{
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		/* resume_console() flushes whatever piles up meanwhile */
+		if (con_start == log_end || console_suspended)
+			schedule();
+		__set_current_state(TASK_RUNNING);
+
+		console_lock();
+		console_unlock();
+	}
+	return 0;
+}
+
+static void __init printk_console_thread_init(void)
+{
+	struct task_struct *p;
+
+	p = kthread_run(printk_console_thread, NULL, "printk");
+	if (IS_ERR(p)) {
+		printk(KERN_ERR "printk: console thread not started, "
+		       "printing synchronously\n");
+		return;
+	}
+	printk_thread = p;
+}
+#else
+static inline void printk_console_thread_init(void) { }
+#endif
+
 static int __init printk_late_init(void)
 {
 	struct console *con;
@@ -1665,6 +1787,7 @@ static int __init printk_late_init(void)
 		}
 	}
 	hotcpu_notifier(console_cpu_notify, 0);
+	printk_console_thread_init();
 	return 0;
 }
 late_initcall(printk_late_init);
@@ -1809,4 +1932,46 @@ void kmsg_dump(enum kmsg_dump_reason reason)
 		dumper->dump(dumper, reason, s1, l1, s2, l2);
 	rcu_read_unlock();
 }
+
+#ifdef CONFIG_PRINTK_LATENCY
+static int printk_latency_show(struct seq_file *m, void *v)
+{
+	struct lat_hist hist;
+	unsigned int cpu;
+	char name[16];
+
+	lat_hist_seq_header(m, "cpu");
+
+	for_each_possible_cpu(cpu) {
+		/* unlocked snapshot, good enough for statistics */
+		hist = per_cpu(printk_latency, cpu);
+
+		snprintf(name, sizeof(name), "cpu%u", cpu);
+		lat_hist_seq_show(m, name, &hist);
+	}
+	seq_printf(m, "console offload: %s\n",
+		   printk_offload && printk_thread ? "on" : "off");
+	return 0;
+}
+
+static void printk_latency_reset(void)
+{
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu)
+		lat_hist_reset(&per_cpu(printk_latency, cpu));
+}
+
+static const struct lat_hist_file printk_latency_file = {
+	.show	= printk_latency_show,
+	.reset	= printk_latency_reset,
+};
+
+static int __init printk_latency_init(void)
+{
+	lat_hist_debugfs_create("printk_latency", &printk_latency_file);
+	return 0;
+}
+late_initcall(printk_latency_init);
+#endif /* CONFIG_PRINTK_LATENCY */
 #endif
@@ -532,6 +532,9 @@ struct rq {
 	u64 age_stamp;
 	u64 idle_stamp;
 	u64 avg_idle;
+
+	/* decayed fraction of time this cpu was not idle */
+	struct sched_avg avg;
 #endif
 
 #ifdef CONFIG_IRQ_TIME_ACCOUNTING
@@ -2079,6 +2082,66 @@ static int irqtime_account_si_update(void)
 
 #endif
 
+#ifdef CONFIG_CPU_FREQ_GOV_SCHED
+static DEFINE_PER_CPU(struct update_util_data *, cpufreq_update_util_data);
+/* callback that asked for a kick once the runqueue lock is dropped */
+static DEFINE_PER_CPU(struct update_util_data *, cpufreq_update_util_kick);
+
+/**
+ * cpufreq_set_update_util_data - Populate the CPU's update_util_data pointer.
+ * @cpu: The CPU to set the pointer for.
+ * @data: New pointer value, or NULL to clear it.
+ *
+ * The callback is invoked from the scheduler with the runqueue of @cpu
+ * locked.  After clearing the pointer the caller has to wait for a
+ * synchronize_sched() grace period before freeing @data.
+ */
+void cpufreq_set_update_util_data(int cpu, struct update_util_data *data)
+{
+	rcu_assign_pointer(per_cpu(cpufreq_update_util_data, cpu), data);
+}
+EXPORT_SYMBOL_GPL(cpufreq_set_update_util_data);
+
+static inline void cpufreq_update_util(struct rq *rq, unsigned long util)
+{
+	struct update_util_data *data;
+
+	data = rcu_dereference_sched(per_cpu(cpufreq_update_util_data,
+					     cpu_of(rq)));
+	if (data && data->func(data, rq->clock, util, SCHED_LOAD_SCALE))
+		__this_cpu_write(cpufreq_update_util_kick, data);
+}
+
+/*
+ * Called after a runqueue lock was dropped.  Paths that enqueue or
+ * dequeue without calling this leave the kick pending until the next
+ * schedule() or tick on this cpu, which are never far off.
+ */
+static void cpufreq_update_util_post(void)
+{
+	struct update_util_data *data;
+
+	preempt_disable();
+	data = __this_cpu_read(cpufreq_update_util_kick);
+	if (data) {
+		__this_cpu_write(cpufreq_update_util_kick, NULL);
+		data->kick(data);
+	}
+	preempt_enable();
+}
+#else
+static inline void cpufreq_update_util(struct rq *rq, unsigned long util) { }
+static inline void cpufreq_update_util_post(void) { }
+#endif
+
+#ifdef CONFIG_SMP
+static void idle_enter_fair(struct rq *this_rq);
+static void idle_exit_fair(struct rq *this_rq);
+#else
+static inline void idle_enter_fair(struct rq *this_rq) { }
+static inline void idle_exit_fair(struct rq *this_rq) { }
+#endif
+
 #include "sched_idletask.c"
 #include "sched_fair.c"
 #include "sched_rt.c"
@@ -2650,6 +2713,7 @@ void scheduler_ipi(void)
 	 */
 	irq_enter();
 	sched_ttwu_do_pending(list);
+	cpufreq_update_util_post();
 	irq_exit();
 }
 
@@ -2784,6 +2848,9 @@ stat:
 out:
 	raw_spin_unlock_irqrestore(&p->pi_lock, flags);
 
+	if (success)
+		cpufreq_update_util_post();
+
 	return success;
 }
 
@@ -2864,6 +2931,9 @@ static void __sched_fork(struct task_struct *p)
 #ifdef CONFIG_SCHEDSTATS
 	memset(&p->se.statistics, 0, sizeof(p->se.statistics));
 #endif
+#ifdef CONFIG_SMP
+	memset(&p->se.avg, 0, sizeof(p->se.avg));
+#endif
 
 	INIT_LIST_HEAD(&p->rt.run_list);
 
@@ -2982,6 +3052,7 @@ void wake_up_new_task(struct task_struct *p)
 		p->sched_class->task_woken(rq, p);
 #endif
 	task_rq_unlock(rq, p, &flags);
+	cpufreq_update_util_post();
 }
 
 #ifdef CONFIG_PREEMPT_NOTIFIERS
@@ -3177,6 +3248,7 @@ asmlinkage void schedule_tail(struct task_struct *prev)
 	 * task_switch?
 	 */
 	post_schedule(rq);
+	cpufreq_update_util_post();
 
 #ifdef __ARCH_WANT_UNLOCKED_CTXSW
 	/* In this case, finish_task_switch does not reenable preemption */
@@ -4180,6 +4252,7 @@ void scheduler_tick(void)
 	update_cpu_load_active(rq);
 	curr->sched_class->task_tick(rq, curr, 0);
 	raw_spin_unlock(&rq->lock);
+	cpufreq_update_util_post();
 
 	perf_event_task_tick();
 
@@ -4398,6 +4471,7 @@ need_resched:
 		raw_spin_unlock_irq(&rq->lock);
 
 	post_schedule(rq);
+	cpufreq_update_util_post();
 
 	preempt_enable_no_resched();
 	if (need_resched())
@@ -4551,14 +4625,23 @@ static void __wake_up_common(wait_queue_head_t *q, unsigned int mode,
 			int nr_exclusive, int wake_flags, void *key)
 {
 	wait_queue_t *curr, *next;
+	LIST_HEAD(rotated);
 
 	list_for_each_entry_safe(curr, next, &q->task_list, task_list) {
 		unsigned flags = curr->flags;
 
-		if (curr->func(curr, mode, wake_flags, key) &&
-				(flags & WQ_FLAG_EXCLUSIVE) && !--nr_exclusive)
+		if (!curr->func(curr, mode, wake_flags, key))
+			continue;
+		/*
+		 * Round-robin entries that took a wakeup go to the tail, but
+		 * only once the walk is over so that none is visited twice.
+		 */
+		if (flags & WQ_FLAG_ROUNDROBIN)
+			list_move_tail(&curr->task_list, &rotated);
+		if ((flags & WQ_FLAG_EXCLUSIVE) && !--nr_exclusive)
 			break;
 	}
+	list_splice_tail(&rotated, &q->task_list);
 }
 
 /**
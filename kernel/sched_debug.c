@@ -280,6 +280,9 @@ static void print_cpu(struct seq_file *m, int cpu)
 	P(cpu_load[2]);
 	P(cpu_load[3]);
 	P(cpu_load[4]);
+#ifdef CONFIG_SMP
+	P(avg.util_avg);
+#endif
 #undef P
 #undef PN
 
@@ -425,6 +428,11 @@ void proc_sched_show_task(struct task_struct *p, struct seq_file *m)
 	PN(se.exec_start);
 	PN(se.vruntime);
 	PN(se.sum_exec_runtime);
+#ifdef CONFIG_SMP
+	P(se.avg.runnable_sum);
+	P(se.avg.period_sum);
+	P(se.avg.util_avg);
+#endif
 
 	nr_switches = p->nvcsw + p->nivcsw;
 
@@ -456,6 +464,8 @@ void proc_sched_show_task(struct task_struct *p, struct seq_file *m)
 	P(se.statistics.nr_wakeups_affine_attempts);
 	P(se.statistics.nr_wakeups_passive);
 	P(se.statistics.nr_wakeups_idle);
+	P(se.statistics.nr_wakeups_packed);
+	P(se.statistics.nr_failed_migrations_packed);
 
 	{
 		u64 avg_atom, avg_per_cpu;
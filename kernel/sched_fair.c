@@ -527,6 +527,231 @@ static u64 sched_vslice(struct cfs_rq *cfs_rq, struct sched_entity *se)
 	return calc_delta_fair(sched_slice(cfs_rq, se), se);
 }
 
+#ifdef CONFIG_SMP
+/*
+ * Per-entity utilization tracking.
+ *
+ * Time is split into 1024us periods (clock_task >> 10).  The time an
+ * entity spent running during period p_i contributes u_i, and the
+ * history is folded as
+ *
+ *   u_0 + u_1*y + u_2*y^2 + ...
+ *
+ * with y^32 = 1/2, so a period from ~32ms ago weighs half as much as
+ * the current one.  The same series is kept for the wall time that
+ * elapsed, and util_avg is the ratio of the two.
+ */
+#define LOAD_AVG_PERIOD		32
+#define LOAD_AVG_MAX		47742	/* maximum possible sum */
+#define LOAD_AVG_MAX_N		345	/* periods needed to reach it */
+
+/* Precomputed fixed inverse multiplies for multiplication by y^n */
+static const u32 runnable_avg_yN_inv[] = {
+	0xffffffff, 0xfa83b2db, 0xf5257d15, 0xefe4b99b, 0xeac0c6e7, 0xe5b906e7,
+	0xe0ccdeec, 0xdbfbb797, 0xd744fcca, 0xd2a81d91, 0xce248c15, 0xc9b9bd86,
+	0xc5672a11, 0xc12c4cca, 0xbd08a39f, 0xb8fbaf47, 0xb504f333, 0xb123f581,
+	0xad583eea, 0xa9a15ab4, 0xa5fed6a9, 0xa2704303, 0x9ef53260, 0x9b8d39b9,
+	0x9837f051, 0x94f4efa8, 0x91c3d373, 0x8ea4398b, 0x8b95c1e3, 0x88980e80,
+	0x85aac367, 0x82cd8698,
+};
+
+/*
+ * Precomputed \Sum 1024*y^n for n = 1..32, i.e. the contribution of
+ * n full periods.
+ */
+static const u32 runnable_avg_yN_sum[] = {
+	    0, 1002, 1982, 2942, 3881, 4800, 5699, 6579, 7440, 8282, 9107,
+	 9914, 10704, 11476, 12232, 12972, 13696, 14405, 15098, 15777, 16441,
+	17091, 17726, 18349, 18957, 19553, 20136, 20707, 21265, 21812, 22346,
+	22870, 23382,
+};
+
+/*
+ * Approximate val * y^n, where y^32 ~= 0.5 (~1 scheduling period).
+ */
+static __always_inline u64 decay_load(u64 val, u64 n)
+{
+	unsigned int local_n;
+
+	if (!n)
+		return val;
+	else if (unlikely(n > LOAD_AVG_PERIOD * 63))
+		return 0;
+
+	/* after bounds checking we can collapse to 32-bit */
+	local_n = n;
+
+	/*
+	 * As y^PERIOD = 1/2, we can combine
+	 *    y^n = 1/2^(n/PERIOD) * y^(n%PERIOD)
+	 * with a look-up table which covers y^n (n<PERIOD).
+	 */
+	if (unlikely(local_n >= LOAD_AVG_PERIOD)) {
+		val >>= local_n / LOAD_AVG_PERIOD;
+		local_n %= LOAD_AVG_PERIOD;
+	}
+
+	val *= runnable_avg_yN_inv[local_n];
+	return val >> 32;
+}
+
+/*
+ * Contribution of n full periods: \Sum 1024*y^k for k = 1..n.
+ */
+static u32 __compute_runnable_contrib(u64 n)
+{
+	u32 contrib = 0;
+
+	if (likely(n <= LOAD_AVG_PERIOD))
+		return runnable_avg_yN_sum[n];
+	else if (unlikely(n >= LOAD_AVG_MAX_N))
+		return LOAD_AVG_MAX;
+
+	/* Since n < LOAD_AVG_MAX_N, n/LOAD_AVG_PERIOD < 11 */
+	do {
+		contrib /= 2; /* y^LOAD_AVG_PERIOD = 1/2 */
+		contrib += runnable_avg_yN_sum[LOAD_AVG_PERIOD];
+
+		n -= LOAD_AVG_PERIOD;
+	} while (n > LOAD_AVG_PERIOD);
+
+	contrib = decay_load(contrib, n);
+	return contrib + runnable_avg_yN_sum[n];
+}
+
+/*
+ * Account the time since sa->last_update as running or not running
+ * and refresh sa->util_avg.  Returns 1 if a period boundary was
+ * crossed, i.e. the history was decayed.
+ */
+static __always_inline int
+__update_util_avg(u64 now, struct sched_avg *sa, int running)
+{
+	u64 delta, periods;
+	u32 delta_w, contrib;
+	int decayed = 0;
+
+	delta = now - sa->last_update;
+	/*
+	 * The clock can go backwards when a task is migrated between cpus
+	 * whose clock_task are not in sync; just restart from here.
+	 */
+	if ((s64)delta < 0) {
+		sa->last_update = now;
+		return 0;
+	}
+
+	/*
+	 * Use 1024ns as the unit of measurement since it's a reasonable
+	 * approximation of 1us and fast to compute.
+	 */
+	delta >>= 10;
+	if (!delta)
+		return 0;
+	sa->last_update = now;
+
+	delta_w = sa->period_contrib;
+	if (delta + delta_w >= 1024) {
+		decayed = 1;
+
+		/* complete the period that was in progress */
+		delta_w = 1024 - delta_w;
+		if (running)
+			sa->runnable_sum += delta_w;
+		sa->period_sum += delta_w;
+		delta -= delta_w;
+
+		/* figure out how many additional full periods elapsed */
+		periods = delta / 1024;
+		delta %= 1024;
+
+		sa->runnable_sum = decay_load(sa->runnable_sum, periods + 1);
+		sa->period_sum = decay_load(sa->period_sum, periods + 1);
+
+		contrib = __compute_runnable_contrib(periods);
+		if (running)
+			sa->runnable_sum += contrib;
+		sa->period_sum += contrib;
+
+		sa->period_contrib = 0;
+	}
+
+	/* remainder of delta, accrued against the current period */
+	if (running)
+		sa->runnable_sum += delta;
+	sa->period_sum += delta;
+	sa->period_contrib += delta;
+
+	sa->util_avg = (sa->runnable_sum * SCHED_LOAD_SCALE) /
+			(sa->period_sum + 1);
+
+	return decayed;
+}
+
+static inline void
+update_entity_util(struct sched_entity *se, u64 now, int running)
+{
+	__update_util_avg(now, &se->avg, running);
+}
+
+static inline unsigned long task_util(struct task_struct *p)
+{
+	return p->se.avg.util_avg;
+}
+
+static inline unsigned long cpu_util(int cpu)
+{
+	return cpu_rq(cpu)->avg.util_avg;
+}
+
+/*
+ * The idle task is being scheduled in: the time since the last update
+ * was busy.  put_prev_task_idle() closes the idle period again.
+ */
+static void idle_enter_fair(struct rq *this_rq)
+{
+	__update_util_avg(this_rq->clock_task, &this_rq->avg, 1);
+}
+
+static void idle_exit_fair(struct rq *this_rq)
+{
+	__update_util_avg(this_rq->clock_task, &this_rq->avg, 0);
+}
+
+static inline void update_rq_util(struct rq *rq)
+{
+	__update_util_avg(rq->clock_task, &rq->avg, 1);
+}
+
+/*
+ * Report the utilization of rq to the cpufreq governor.  A task that
+ * is being enqueued is added on top so that the frequency goes up
+ * before the cpu average has had time to catch up with it.
+ */
+static inline void cpufreq_update_fair(struct rq *rq, struct task_struct *p)
+{
+	unsigned long util = cpu_util(cpu_of(rq));
+
+	if (p)
+		util += task_util(p);
+
+	cpufreq_update_util(rq, min_t(unsigned long, util, SCHED_LOAD_SCALE));
+}
+#else
+static inline void
+update_entity_util(struct sched_entity *se, u64 now, int running)
+{
+}
+
+static inline void update_rq_util(struct rq *rq)
+{
+}
+
+static inline void cpufreq_update_fair(struct rq *rq, struct task_struct *p)
+{
+}
+#endif /* CONFIG_SMP */
+
 static void update_cfs_load(struct cfs_rq *cfs_rq, int global_update);
 static void update_cfs_shares(struct cfs_rq *cfs_rq);
 
@@ -575,6 +800,7 @@ static void update_curr(struct cfs_rq *cfs_rq)
 
 	__update_curr(cfs_rq, curr, delta_exec);
 	curr->exec_start = now;
+	update_entity_util(curr, now, 1);
 
 	if (entity_is_task(curr)) {
 		struct task_struct *curtask = task_of(curr);
@@ -1127,6 +1353,8 @@ set_next_entity(struct cfs_rq *cfs_rq, struct sched_entity *se)
 		__dequeue_entity(cfs_rq, se);
 	}
 
+	/* everything since se last ran was spent off the cpu */
+	update_entity_util(se, rq_of(cfs_rq)->clock_task, 0);
 	update_stats_curr_start(cfs_rq, se);
 	cfs_rq->curr = se;
 #ifdef CONFIG_SCHEDSTATS
@@ -1323,6 +1551,7 @@ enqueue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 		update_cfs_shares(cfs_rq);
 	}
 
+	cpufreq_update_fair(rq, p);
 	hrtick_update(rq);
 }
 
@@ -1366,6 +1595,7 @@ static void dequeue_task_fair(struct rq *rq, struct task_struct *p, int flags)
 		update_cfs_shares(cfs_rq);
 	}
 
+	cpufreq_update_fair(rq, NULL);
 	hrtick_update(rq);
 }
 
@@ -1657,6 +1887,47 @@ static int select_idle_sibling(struct task_struct *p, int target)
 	return target;
 }
 
+/*
+ * Small task packing: a task whose decayed utilization is below
+ * SMALL_TASK_UTIL is woken on a cpu that is already busy as long as
+ * that cpu stays below PACK_CPU_UTIL with the task added.
+ */
+#define SMALL_TASK_UTIL		(SCHED_LOAD_SCALE / 5)
+#define PACK_CPU_UTIL		(SCHED_LOAD_SCALE * 4 / 5)
+
+static inline int is_small_task(struct task_struct *p)
+{
+	return task_util(p) < SMALL_TASK_UTIL;
+}
+
+static inline int pack_cpu_fits(int cpu, unsigned long util)
+{
+	return !idle_cpu(cpu) && cpu_util(cpu) + util < PACK_CPU_UTIL;
+}
+
+/*
+ * Find a busy cpu with room for the small task p: prev_cpu if it
+ * qualifies, to keep the cache warm, otherwise the lowest numbered
+ * one, so that the load collects on the cpus a hotplug governor takes
+ * down last.  Returns -1 if there is none.
+ */
+static int find_pack_cpu(struct task_struct *p, int prev_cpu)
+{
+	unsigned long util = task_util(p);
+	int i;
+
+	if (cpumask_test_cpu(prev_cpu, &p->cpus_allowed) &&
+	    pack_cpu_fits(prev_cpu, util))
+		return prev_cpu;
+
+	for_each_cpu_and(i, &p->cpus_allowed, cpu_active_mask) {
+		if (pack_cpu_fits(i, util))
+			return i;
+	}
+
+	return -1;
+}
+
 /*
  * sched_balance_self: balance the current task (running on cpu) in domains
  * that have the 'flag' flag set. In practice, this is SD_BALANCE_FORK and
@@ -1680,6 +1951,15 @@ select_task_rq_fair(struct task_struct *p, int sd_flag, int wake_flags)
 	int sync = wake_flags & WF_SYNC;
 
 	if (sd_flag & SD_BALANCE_WAKE) {
+		if (sched_feat(SMALL_TASK_PACKING) && is_small_task(p)) {
+			int pack_cpu = find_pack_cpu(p, prev_cpu);
+
+			if (pack_cpu >= 0) {
+				schedstat_inc(p, se.statistics.nr_wakeups_packed);
+				return pack_cpu;
+			}
+		}
+
 		if (cpumask_test_cpu(cpu, &p->cpus_allowed))
 			want_affine = 1;
 		new_cpu = prev_cpu;
@@ -2053,6 +2333,19 @@ int can_migrate_task(struct task_struct *p, struct rq *rq, int this_cpu,
 		schedstat_inc(p, se.statistics.nr_failed_migrations_affine);
 		return 0;
 	}
+
+	/*
+	 * Don't spread packed small tasks back out to an idle cpu while
+	 * their cpu still has spare capacity.  This is checked before
+	 * clearing all_pinned so that a runqueue holding only such tasks
+	 * is treated as pinned and the balancer backs off instead of
+	 * escalating to active balancing.
+	 */
+	if (sched_feat(SMALL_TASK_PACKING) && idle != CPU_NOT_IDLE &&
+	    is_small_task(p) && cpu_util(cpu_of(rq)) < PACK_CPU_UTIL) {
+		schedstat_inc(p, se.statistics.nr_failed_migrations_packed);
+		return 0;
+	}
 	*all_pinned = 0;
 
 	if (task_running(rq, p)) {
@@ -4132,6 +4425,9 @@ static void task_tick_fair(struct rq *rq, struct task_struct *curr, int queued)
 		cfs_rq = cfs_rq_of(se);
 		entity_tick(cfs_rq, se, queued);
 	}
+
+	update_rq_util(rq);
+	cpufreq_update_fair(rq, NULL);
 }
 
 /*
@@ -4174,6 +4470,17 @@ static void task_fork_fair(struct task_struct *p)
 
 	se->vruntime -= cfs_rq->min_vruntime;
 
+#ifdef CONFIG_SMP
+	/*
+	 * Start new tasks out as fully busy so that they are not packed
+	 * before we know anything about them; the history decays within
+	 * a few periods.
+	 */
+	se->avg.last_update = rq->clock_task;
+	se->avg.runnable_sum = se->avg.period_sum = 1024;
+	se->avg.util_avg = SCHED_LOAD_SCALE;
+#endif
+
 	raw_spin_unlock_irqrestore(&rq->lock, flags);
 }
 
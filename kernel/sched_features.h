@@ -71,4 +71,15 @@ SCHED_FEAT(NONTASK_POWER, 1)
  */
 SCHED_FEAT(TTWU_QUEUE, 1)
 
+/*
+ * Wake tasks with a low decayed utilization on an already busy cpu
+ * that still has room for them, rather than on an idle one, so that
+ * the remaining cpus can stay idle or be taken offline.
+ */
+#ifdef CONFIG_SCHED_PACK_SMALL_TASKS
+SCHED_FEAT(SMALL_TASK_PACKING, 1)
+#else
+SCHED_FEAT(SMALL_TASK_PACKING, 0)
+#endif
+
 SCHED_FEAT(FORCE_SD_OVERLAP, 0)
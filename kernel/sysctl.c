@@ -122,6 +122,7 @@ static int __maybe_unused two = 2;
 static int __maybe_unused three = 3;
 static unsigned long one_ul = 1;
 static int one_hundred = 100;
+static int one_thousand = 1000;
 #ifdef CONFIG_PRINTK
 static int ten_thousand = 10000;
 #endif
@@ -355,6 +356,15 @@ static struct ctl_table kern_table[] = {
 		.extra2		= &one,
 	},
 #endif
+	{
+		.procname	= "timer_coalesce_ms",
+		.data		= &sysctl_timer_coalesce_ms,
+		.maxlen		= sizeof(unsigned int),
+		.mode		= 0644,
+		.proc_handler	= timer_coalesce_handler,
+		.extra1		= &zero,
+		.extra2		= &one_thousand,
+	},
 	{
 		.procname	= "sched_rt_period_us",
 		.data		= &sysctl_sched_rt_period,
@@ -65,9 +65,11 @@ struct entry {
 	pid_t			pid;
 
 	/*
-	 * Number of timeout events:
+	 * Number of timeout events, and how many of them shared a
+	 * wakeup because timer coalescing moved their expiry:
 	 */
 	unsigned long		count;
+	unsigned long		saved;
 	unsigned int		timer_flag;
 
 	/*
@@ -204,6 +206,7 @@ static struct entry *tstat_lookup(struct entry *entry, char *comm)
 	if (curr) {
 		*curr = *entry;
 		curr->count = 0;
+		curr->saved = 0;
 		curr->next = NULL;
 		memcpy(curr->comm, comm, TASK_COMM_LEN);
 
@@ -251,16 +254,18 @@ void timer_stats_update_stats(void *timer, pid_t pid, void *startf,
 	input.start_func = startf;
 	input.expire_func = timerf;
 	input.pid = pid;
-	input.timer_flag = timer_flag;
+	input.timer_flag = timer_flag & ~TIMER_STATS_FLAG_SAVED;
 
 	raw_spin_lock_irqsave(lock, flags);
 	if (!timer_stats_active)
 		goto out_unlock;
 
 	entry = tstat_lookup(&input, comm);
-	if (likely(entry))
+	if (likely(entry)) {
 		entry->count++;
-	else
+		if (timer_flag & TIMER_STATS_FLAG_SAVED)
+			entry->saved++;
+	} else
 		atomic_inc(&overflow_count);
 
  out_unlock:
@@ -282,7 +287,7 @@ static int tstats_show(struct seq_file *m, void *v)
 	struct timespec period;
 	struct entry *entry;
 	unsigned long ms;
-	long events = 0;
+	long events = 0, saved = 0;
 	ktime_t time;
 	int i;
 
@@ -320,6 +325,7 @@ static int tstats_show(struct seq_file *m, void *v)
 		seq_puts(m, ")\n");
 
 		events += entry->count;
+		saved += entry->saved;
 	}
 
 	ms += period.tv_sec * 1000;
@@ -333,6 +339,26 @@ static int tstats_show(struct seq_file *m, void *v)
 	else
 		seq_printf(m, "%ld total events\n", events);
 
+	/*
+	 * Kept after the totals so that parsers of the event list above
+	 * are not confused by the extra section:
+	 */
+	if (saved) {
+		seq_puts(m, "Wakeups saved by timer coalescing:\n");
+		for (i = 0; i < nr_entries; i++) {
+			entry = entries + i;
+			if (!entry->saved)
+				continue;
+			seq_printf(m, " %4lu, %5d %-16s ",
+				   entry->saved, entry->pid, entry->comm);
+			print_name_offset(m, (unsigned long)entry->start_func);
+			seq_puts(m, " (");
+			print_name_offset(m, (unsigned long)entry->expire_func);
+			seq_puts(m, ")\n");
+		}
+		seq_printf(m, "%ld total wakeups saved\n", saved);
+	}
+
 	mutex_unlock(&show_mutex);
 
 	return 0;
@@ -40,6 +40,8 @@
 #include <linux/irq_work.h>
 #include <linux/sched.h>
 #include <linux/slab.h>
+#include <linux/log2.h>
+#include <linux/sysctl.h>
 
 #include <asm/uaccess.h>
 #include <asm/unistd.h>
@@ -311,6 +313,34 @@ unsigned long round_jiffies_up_relative(unsigned long j)
 }
 EXPORT_SYMBOL_GPL(round_jiffies_up_relative);
 
+/*
+ * Timer coalescing: deferrable timers, and timers with the default slack
+ * that are within 1/8 of their timeout of the next boundary of a global
+ * grid of sysctl_timer_coalesce_ms wide slots, are moved to that boundary.
+ * Timers of all cpus then tend to expire in the same ticks and each
+ * wakeup serves many of them.  The slot is rounded to a power of two
+ * jiffies; 0 disables coalescing.
+ */
+unsigned int sysctl_timer_coalesce_ms __read_mostly = 40;
+static unsigned long timer_coalesce_mask __read_mostly;
+
+static void timer_coalesce_update(void)
+{
+	unsigned long slot = msecs_to_jiffies(sysctl_timer_coalesce_ms);
+
+	timer_coalesce_mask = slot > 1 ? roundup_pow_of_two(slot) - 1 : 0;
+}
+
+int timer_coalesce_handler(struct ctl_table *table, int write,
+			   void __user *buffer, size_t *lenp, loff_t *ppos)
+{
+	int ret = proc_dointvec_minmax(table, write, buffer, lenp, ppos);
+
+	if (!ret && write)
+		timer_coalesce_update();
+	return ret;
+}
+
 /**
  * set_timer_slack - set the allowed slack for a timer
  * @timer: the timer to be modified
@@ -322,7 +352,8 @@ EXPORT_SYMBOL_GPL(round_jiffies_up_relative);
  * the time mod_timer() asks for, and that time plus the slack.
  *
  * By setting the slack to -1, a percentage of the delay is used
- * instead.
+ * instead.  Where the slack reaches a timer coalescing slot boundary
+ * the timer expires on that boundary.
  */
 void set_timer_slack(struct timer_list *timer, int slack_hz)
 {
@@ -383,7 +414,11 @@ void __timer_stats_timer_set_start_info(struct timer_list *timer, void *addr)
 	timer->start_pid = current->pid;
 }
 
-static void timer_stats_account_timer(struct timer_list *timer)
+/*
+ * @shared: other timers expire in the same tick, so a timer whose expiry
+ * was coalesced did not cost a wakeup of its own.
+ */
+static void timer_stats_account_timer(struct timer_list *timer, bool shared)
 {
 	unsigned int flag = 0;
 
@@ -391,13 +426,22 @@ static void timer_stats_account_timer(struct timer_list *timer)
 		return;
 	if (unlikely(tbase_get_deferrable(timer->base)))
 		flag |= TIMER_STATS_FLAG_DEFERRABLE;
+	if (shared && timer->coalesced)
+		flag |= TIMER_STATS_FLAG_SAVED;
 
 	timer_stats_update_stats(timer, timer->start_pid, timer->start_site,
 				 timer->function, timer->start_comm, flag);
 }
 
+static inline void timer_stats_set_coalesced(struct timer_list *timer,
+					     bool coalesced)
+{
+	timer->coalesced = coalesced;
+}
 #else
-static void timer_stats_account_timer(struct timer_list *timer) {}
+static void timer_stats_account_timer(struct timer_list *timer, bool shared) {}
+static inline void timer_stats_set_coalesced(struct timer_list *timer,
+					     bool coalesced) {}
 #endif
 
 #ifdef CONFIG_DEBUG_OBJECTS_TIMERS
@@ -562,6 +606,7 @@ static void __init_timer(struct timer_list *timer,
 #ifdef CONFIG_TIMER_STATS
 	timer->start_site = NULL;
 	timer->start_pid = -1;
+	timer->coalesced = 0;
 	memset(timer->start_comm, 0, TASK_COMM_LEN);
 #endif
 	lockdep_init_map(&timer->lockdep_map, name, key, 0);
@@ -729,6 +774,7 @@ out_unlock:
  */
 int mod_timer_pending(struct timer_list *timer, unsigned long expires)
 {
+	timer_stats_set_coalesced(timer, false);
 	return __mod_timer(timer, expires, true, TIMER_NOT_PINNED);
 }
 EXPORT_SYMBOL(mod_timer_pending);
@@ -744,21 +790,11 @@ EXPORT_SYMBOL(mod_timer_pending);
  *      bits are zeros
  */
 static inline
-unsigned long apply_slack(struct timer_list *timer, unsigned long expires)
+unsigned long round_slack(unsigned long expires, unsigned long expires_limit)
 {
-	unsigned long expires_limit, mask;
+	unsigned long mask;
 	int bit;
 
-	if (timer->slack >= 0) {
-		expires_limit = expires + timer->slack;
-	} else {
-		long delta = expires - jiffies;
-
-		if (delta < 256)
-			return expires;
-
-		expires_limit = expires + delta / 256;
-	}
 	mask = expires ^ expires_limit;
 	if (mask == 0)
 		return expires;
@@ -772,6 +808,50 @@ unsigned long apply_slack(struct timer_list *timer, unsigned long expires)
 	return expires_limit;
 }
 
+/*
+ * Whenever the slack covers a boundary of the coalescing grid, the rounding
+ * above already ends on one, so coalescing only has to widen the slack of
+ * timers that do not reach a boundary on their own: a deferrable timer may
+ * be late anyway and waits for the next boundary, a timer with the default
+ * slack may be moved by up to 1/8 of its timeout.  Explicit slack is left
+ * as it was set.
+ */
+static inline
+unsigned long apply_slack(struct timer_list *timer, unsigned long expires)
+{
+	unsigned long expires_limit, coalesce_limit, rounded, slot;
+	long delta = expires - jiffies;
+
+	if (timer->slack >= 0)
+		expires_limit = expires + timer->slack;
+	else if (delta < 256)
+		expires_limit = expires;
+	else
+		expires_limit = expires + delta / 256;
+
+	rounded = round_slack(expires, expires_limit);
+	timer_stats_set_coalesced(timer, false);
+
+	if (!timer_coalesce_mask || !(rounded & timer_coalesce_mask))
+		return rounded;
+
+	if (tbase_get_deferrable(timer->base))
+		coalesce_limit = expires + timer_coalesce_mask;
+	else if (timer->slack < 0 && delta > 0)
+		coalesce_limit = expires + min_t(unsigned long, delta / 8,
+						 timer_coalesce_mask);
+	else
+		return rounded;
+
+	slot = (expires + timer_coalesce_mask) & ~timer_coalesce_mask;
+	if (time_after(slot, coalesce_limit))
+		return rounded;
+
+	/* the shared slot, not the timer's own slack, chose the expiry */
+	timer_stats_set_coalesced(timer, true);
+	return slot;
+}
+
 /**
  * mod_timer - modify a timer's timeout
  * @timer: the timer to be modified
@@ -826,6 +906,7 @@ int mod_timer_pinned(struct timer_list *timer, unsigned long expires)
 	if (timer->expires == expires && timer_pending(timer))
 		return 1;
 
+	timer_stats_set_coalesced(timer, false);
 	return __mod_timer(timer, expires, false, TIMER_PINNED);
 }
 EXPORT_SYMBOL(mod_timer_pinned);
@@ -864,6 +945,7 @@ void add_timer_on(struct timer_list *timer, int cpu)
 	unsigned long flags;
 
 	timer_stats_timer_set_start_info(timer);
+	timer_stats_set_coalesced(timer, false);
 	BUG_ON(timer_pending(timer) || !timer->function);
 	spin_lock_irqsave(&base->lock, flags);
 	timer_set_base(timer, base);
@@ -1098,6 +1180,7 @@ static inline void __run_timers(struct tvec_base *base)
 		struct list_head work_list;
 		struct list_head *head = &work_list;
 		int index = base->timer_jiffies & TVR_MASK;
+		bool shared;
 
 		/*
 		 * Cascade timers:
@@ -1109,6 +1192,7 @@ static inline void __run_timers(struct tvec_base *base)
 			cascade(base, &base->tv5, INDEX(3));
 		++base->timer_jiffies;
 		list_replace_init(base->tv1.vec + index, &work_list);
+		shared = !list_empty(head) && !list_is_singular(head);
 		while (!list_empty(head)) {
 			void (*fn)(unsigned long);
 			unsigned long data;
@@ -1117,7 +1201,7 @@ static inline void __run_timers(struct tvec_base *base)
 			fn = timer->function;
 			data = timer->data;
 
-			timer_stats_account_timer(timer);
+			timer_stats_account_timer(timer, shared);
 
 			base->running_timer = timer;
 			detach_timer(timer, 1);
@@ -1734,6 +1818,7 @@ void __init init_timers(void)
 				(void *)(long)smp_processor_id());
 
 	init_timer_stats();
+	timer_coalesce_update();
 
 	BUG_ON(err != NOTIFY_OK);
 	register_cpu_notifier(&timers_nb);
@@ -41,6 +41,8 @@
 #include <linux/debug_locks.h>
 #include <linux/lockdep.h>
 #include <linux/idr.h>
+#include <linux/lat_hist.h>
+#include <linux/seq_file.h>
 
 #include "workqueue_sched.h"
 
@@ -167,6 +169,11 @@ struct worker_pool {
 
 	struct mutex		manager_mutex;	/* mutex manager should hold */
 	struct ida		worker_ida;	/* L: for worker IDs */
+
+#ifdef CONFIG_WORKQUEUE_LATENCY
+	/* queue-to-execute latency of works run by this pool */
+	struct lat_hist		lat;		/* L: histogram */
+#endif
 };
 
 /*
@@ -906,6 +913,37 @@ static struct worker *find_worker_executing_work(struct global_cwq *gcwq,
 					    work);
 }
 
+#ifdef CONFIG_WORKQUEUE_LATENCY
+static inline void work_stamp_queued(struct work_struct *work)
+{
+	work->queued_ns = local_clock();
+}
+
+/*
+ * Account the time @work sat on a worklist (including any time on
+ * cwq->delayed_works due to max_active) against @pool.  Called with
+ * gcwq->lock held when a worker claims @work.
+ */
+static void pool_account_latency(struct worker_pool *pool,
+				 struct work_struct *work)
+{
+	s64 lat = local_clock() - work->queued_ns;
+
+	/* local_clock() may be slightly off between cpus */
+	if (lat < 0)
+		lat = 0;
+
+	lat_hist_add(&pool->lat, lat);
+
+	trace_workqueue_execute_latency(work, pool->gcwq->cpu,
+					worker_pool_pri(pool), lat);
+}
+#else
+static inline void work_stamp_queued(struct work_struct *work) { }
+static inline void pool_account_latency(struct worker_pool *pool,
+					struct work_struct *work) { }
+#endif
+
 /**
  * insert_work - insert a work into gcwq
  * @cwq: cwq @work belongs to
@@ -927,6 +965,7 @@ static void insert_work(struct cpu_workqueue_struct *cwq,
 
 	/* we own @work, set data and link */
 	set_work_cwq(work, cwq, extra_flags);
+	work_stamp_queued(work);
 
 	/*
 	 * Ensure that we get the right work->data if we see the
@@ -1966,6 +2005,7 @@ __acquires(&gcwq->lock)
 
 	/* claim and process */
 	debug_work_deactivate(work);
+	pool_account_latency(pool, work);
 	hlist_add_head(&worker->hentry, bwh);
 	worker->current_work = work;
 	worker->current_cwq = cwq;
@@ -3747,3 +3787,62 @@ static int __init init_workqueues(void)
 	return 0;
 }
 early_initcall(init_workqueues);
+
+#ifdef CONFIG_WORKQUEUE_LATENCY
+static int wq_latency_show(struct seq_file *m, void *v)
+{
+	struct lat_hist hist;
+	unsigned int cpu;
+
+	lat_hist_seq_header(m, "pool");
+
+	for_each_gcwq_cpu(cpu) {
+		struct global_cwq *gcwq = get_gcwq(cpu);
+		struct worker_pool *pool;
+		char name[16];
+
+		for_each_worker_pool(pool, gcwq) {
+			spin_lock_irq(&gcwq->lock);
+			hist = pool->lat;
+			spin_unlock_irq(&gcwq->lock);
+
+			if (cpu == WORK_CPU_UNBOUND)
+				snprintf(name, sizeof(name), "unbound%s",
+					 worker_pool_pri(pool) ? "-H" : "");
+			else
+				snprintf(name, sizeof(name), "cpu%u%s", cpu,
+					 worker_pool_pri(pool) ? "-H" : "");
+
+			lat_hist_seq_show(m, name, &hist);
+		}
+	}
+	return 0;
+}
+
+static void wq_latency_reset(void)
+{
+	unsigned int cpu;
+
+	for_each_gcwq_cpu(cpu) {
+		struct global_cwq *gcwq = get_gcwq(cpu);
+		struct worker_pool *pool;
+
+		spin_lock_irq(&gcwq->lock);
+		for_each_worker_pool(pool, gcwq)
+			lat_hist_reset(&pool->lat);
+		spin_unlock_irq(&gcwq->lock);
+	}
+}
+
+static const struct lat_hist_file wq_latency_file = {
+	.show	= wq_latency_show,
+	.reset	= wq_latency_reset,
+};
+
+static int __init wq_latency_init(void)
+{
+	lat_hist_debugfs_create("workqueue_latency", &wq_latency_file);
+	return 0;
+}
+late_initcall(wq_latency_init);
+#endif /* CONFIG_WORKQUEUE_LATENCY */
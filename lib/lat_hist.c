@@ -0,0 +1,84 @@
+/*
+ * lib/lat_hist.c - printing and debugfs helpers for log2 latency histograms
+ *
+ * This file is released under the GPLv2.
+ */
+
+#include <linux/lat_hist.h>
+#include <linux/module.h>
+#include <linux/seq_file.h>
+#include <linux/debugfs.h>
+#include <linux/fs.h>
+
+void lat_hist_seq_header(struct seq_file *m, const char *title)
+{
+	int i;
+
+	seq_printf(m, "%-16s %10s %8s", title, "max_us", "<1");
+	for (i = 1; i < LAT_HIST_BUCKETS; i++)
+		seq_printf(m, " %8u", 1U << (i - 1));
+	seq_putc(m, '\n');
+}
+EXPORT_SYMBOL(lat_hist_seq_header);
+
+void lat_hist_seq_show(struct seq_file *m, const char *name,
+		       const struct lat_hist *hist)
+{
+	int i;
+
+	seq_printf(m, "%-16s %10llu", name,
+		   (unsigned long long)div_u64(hist->max, NSEC_PER_USEC));
+	for (i = 0; i < LAT_HIST_BUCKETS; i++)
+		seq_printf(m, " %8u", hist->count[i]);
+	seq_putc(m, '\n');
+}
+EXPORT_SYMBOL(lat_hist_seq_show);
+
+#ifdef CONFIG_DEBUG_FS
+static int lat_hist_open(struct inode *inode, struct file *file)
+{
+	const struct lat_hist_file *lf = inode->i_private;
+
+	return single_open(file, lf->show, inode->i_private);
+}
+
+/* any write resets all histograms */
+static ssize_t lat_hist_write(struct file *file, const char __user *buf,
+			      size_t count, loff_t *ppos)
+{
+	struct seq_file *m = file->private_data;
+	const struct lat_hist_file *lf = m->private;
+
+	lf->reset();
+	return count;
+}
+
+static const struct file_operations lat_hist_fops = {
+	.open		= lat_hist_open,
+	.read		= seq_read,
+	.write		= lat_hist_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/**
+ * lat_hist_debugfs_create - create a histogram file in the debugfs root
+ * @name: file name
+ * @file: how to print and reset the histograms, must stay around
+ *
+ * Returns the dentry, or NULL (after logging it) if it could not be
+ * created.
+ */
+struct dentry *lat_hist_debugfs_create(const char *name,
+				       const struct lat_hist_file *file)
+{
+	struct dentry *dentry;
+
+	dentry = debugfs_create_file(name, 0644, NULL, (void *)file,
+				     &lat_hist_fops);
+	if (!dentry)
+		pr_err("failed to create debugfs file %s\n", name);
+	return dentry;
+}
+EXPORT_SYMBOL(lat_hist_debugfs_create);
+#endif
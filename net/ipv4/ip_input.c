@@ -314,11 +314,29 @@ drop:
 	return -1;
 }
 
+int sysctl_ip_early_demux __read_mostly = 1;
+
 static int ip_rcv_finish(struct sk_buff *skb)
 {
 	const struct iphdr *iph = ip_hdr(skb);
 	struct rtable *rt;
 
+	/*
+	 *	Let the transport find its socket first: an established
+	 *	connection may already know the input route of the flow.
+	 */
+	if (sysctl_ip_early_demux && !skb_dst(skb) && !skb->sk) {
+		const struct net_protocol *ipprot;
+
+		ipprot = rcu_dereference(inet_protos[iph->protocol &
+						      (MAX_INET_PROTOS - 1)]);
+		if (ipprot && ipprot->early_demux) {
+			ipprot->early_demux(skb);
+			/* skb->head may have been reallocated */
+			iph = ip_hdr(skb);
+		}
+	}
+
 	/*
 	 *	Initialise the virtual path cache for the packet. It describes
 	 *	how the packet travels inside Linux networking.
@@ -3619,6 +3619,28 @@ static int tcp_process_frto(struct sock *sk, int flag)
 	return 0;
 }
 
+/* Set sk_pacing_rate to twice the current rate, mss * cwnd / srtt, so
+ * that a pacing qdisc spreads a window over half an RTT instead of
+ * sending it in one burst.  Slow start still doubles the rate each RTT.
+ */
+static void tcp_update_pacing_rate(struct sock *sk)
+{
+	const struct tcp_sock *tp = tcp_sk(sk);
+	u64 rate;
+
+	rate = (u64)tp->mss_cache * 2 * (HZ << 3);
+	rate *= max(tp->snd_cwnd, tp->packets_out);
+
+	/* srtt is in jiffies << 3.  Treat anything shorter than a jiffy,
+	 * including srtt == 0 before the first sample, as one jiffy, so
+	 * that short paths are paced at a rate that is too high rather
+	 * than not at all.
+	 */
+	do_div(rate, max(tp->srtt, 8U));
+
+	sk->sk_pacing_rate = min_t(u64, rate, ~0U);
+}
+
 /* This routine deals with incoming acks, but not outgoing ones. */
 static int tcp_ack(struct sock *sk, struct sk_buff *skb, int flag)
 {
@@ -3718,6 +3740,7 @@ static int tcp_ack(struct sock *sk, struct sk_buff *skb, int flag)
 		if ((flag & FLAG_DATA_ACKED) && !frto_cwnd)
 			tcp_cong_avoid(sk, ack, prior_in_flight);
 	}
+	tcp_update_pacing_rate(sk);
 
 	if ((flag & FLAG_FORWARD_PROGRESS) || !(flag & FLAG_NOT_DUP))
 		dst_confirm(__sk_dst_get(sk));
@@ -1565,6 +1565,24 @@ static __sum16 tcp_v4_checksum_init(struct sk_buff *skb)
 }
 
 
+/*
+ * Remember the input route of an established connection for
+ * tcp_v4_early_demux().  Called with the socket locked, from softirq.
+ */
+static void tcp_v4_rx_dst_update(struct sock *sk, struct sk_buff *skb)
+{
+	struct dst_entry *old = rcu_dereference_protected(sk->sk_rx_dst, 1);
+	struct dst_entry *dst = skb_dst(skb);
+
+	if (likely(dst == old) || !dst ||
+	    !rt_is_input_route((struct rtable *)dst))
+		return;
+
+	dst_hold(dst);
+	rcu_assign_pointer(sk->sk_rx_dst, dst);
+	dst_release(old);
+}
+
 /* The socket must have it's spinlock held when we get
  * here.
  *
@@ -1589,6 +1607,13 @@ int tcp_v4_do_rcv(struct sock *sk, struct sk_buff *skb)
 
 	if (sk->sk_state == TCP_ESTABLISHED) { /* Fast path */
 		sock_rps_save_rxhash(sk, skb->rxhash);
+		/*
+		 * Segments the owner processes from the prequeue may carry
+		 * a noref dst that is no longer protected, so only remember
+		 * the route when called straight from softirq.
+		 */
+		if (!sock_owned_by_user(sk))
+			tcp_v4_rx_dst_update(sk, skb);
 		if (tcp_rcv_established(sk, skb, tcp_hdr(skb), skb->len)) {
 			rsk = sk;
 			goto reset;
@@ -1638,6 +1663,155 @@ csum_err:
 }
 EXPORT_SYMBOL(tcp_v4_do_rcv);
 
+/*
+ * Per-cpu cache of established sockets, indexed by the flow hash that
+ * RPS computes for the packet anyway.  Entries hold no reference: a hit
+ * is validated the way an ehash lookup is (refcount, then the 4-tuple
+ * again), which is enough because tcp sockets are SLAB_DESTROY_BY_RCU.
+ * tcp_v4_rx_flow_reset() evicts a socket from every cpu once it has been
+ * unhashed, so no entry outlives the grace period before its memory can
+ * leave the slab.
+ */
+#define TCP_FLOW_CACHE_BITS	8
+#define TCP_FLOW_CACHE_SIZE	(1 << TCP_FLOW_CACHE_BITS)
+
+struct tcp_flow_cache {
+	struct sock	*sk[TCP_FLOW_CACHE_SIZE];
+};
+
+static DEFINE_PER_CPU(struct tcp_flow_cache, tcp_flow_cache);
+
+static inline bool tcp_v4_flow_match(const struct sock *sk, struct net *net,
+				     const __be32 saddr, const __be32 daddr,
+				     const __portpair ports, const int dif)
+{
+	const struct inet_sock *inet = inet_sk(sk);
+
+	return net_eq(sock_net(sk), net) &&
+	       inet->inet_daddr == saddr && inet->inet_rcv_saddr == daddr &&
+	       *(const __portpair *)&inet->inet_dport == ports &&
+	       (!sk->sk_bound_dev_if || sk->sk_bound_dev_if == dif);
+}
+
+static struct sock *tcp_v4_flow_lookup(struct net *net, struct sk_buff *skb,
+				       const __be32 saddr, const __be16 sport,
+				       const __be32 daddr, const u16 hnum,
+				       const int dif)
+{
+	const __portpair ports = INET_COMBINED_PORTS(sport, hnum);
+	struct sock **slot;
+	struct sock *sk;
+
+	slot = &__get_cpu_var(tcp_flow_cache).sk[skb_get_rxhash(skb) &
+						 (TCP_FLOW_CACHE_SIZE - 1)];
+	sk = ACCESS_ONCE(*slot);
+	if (sk && tcp_v4_flow_match(sk, net, saddr, daddr, ports, dif)) {
+		if (likely(atomic_inc_not_zero(&sk->sk_refcnt))) {
+			if (likely(tcp_v4_flow_match(sk, net, saddr, daddr,
+						     ports, dif) &&
+				   !sk_unhashed(sk)))
+				return sk;
+			sock_put(sk);
+		}
+	}
+
+	sk = __inet_lookup_established(net, &tcp_hashinfo, saddr, sport,
+				       daddr, hnum, dif);
+	if (!sk || sk->sk_state == TCP_TIME_WAIT)
+		return sk;
+
+	tcp_sk(sk)->rx_flow_cached = 1;
+	*slot = sk;
+	/* Pairs with the barrier in tcp_v4_rx_flow_reset() */
+	smp_mb();
+	if (unlikely(sk_unhashed(sk)))
+		cmpxchg(slot, sk, NULL);
+	return sk;
+}
+
+/*
+ * Called before the route lookup in ip_rcv_finish(): attach the socket of
+ * an established connection, and the input route it cached, to the skb.
+ * tcp_v4_rcv() then takes the socket from the skb and ip_rcv_finish()
+ * skips the route lookup when a valid dst is attached.
+ */
+void tcp_v4_early_demux(struct sk_buff *skb)
+{
+	const struct iphdr *iph;
+	const struct tcphdr *th;
+	struct dst_entry *dst;
+	struct sock *sk;
+	int dif;
+
+	if (skb->pkt_type != PACKET_HOST)
+		return;
+
+	if (!pskb_may_pull(skb, ip_hdrlen(skb) + sizeof(struct tcphdr)))
+		return;
+
+	iph = ip_hdr(skb);
+	if (ip_is_fragment(iph))
+		return;
+
+	th = (const struct tcphdr *)((const char *)iph + ip_hdrlen(skb));
+	if (th->doff < sizeof(struct tcphdr) / 4)
+		return;
+
+	dif = skb->dev->ifindex;
+	sk = tcp_v4_flow_lookup(dev_net(skb->dev), skb, iph->saddr, th->source,
+				iph->daddr, ntohs(th->dest), dif);
+	if (!sk)
+		return;
+
+	/*
+	 * Netfilter matches on the INPUT hook expect a full socket in
+	 * skb->sk, leave timewait sockets to tcp_v4_rcv().
+	 */
+	if (sk->sk_state == TCP_TIME_WAIT) {
+		inet_twsk_put(inet_twsk(sk));
+		return;
+	}
+
+	skb->sk = sk;
+	skb->destructor = sock_edemux;
+
+	dst = rcu_dereference(sk->sk_rx_dst);
+	if (dst)
+		dst = dst_check(dst, 0);
+	if (dst && ((struct rtable *)dst)->rt_iif == dif)
+		skb_dst_set_noref(skb, dst);
+}
+
+/*
+ * Forget the cached input route and evict the socket from the flow
+ * caches.  Called when the socket moves to TCP_CLOSE, after it has been
+ * unhashed.
+ */
+void tcp_v4_rx_flow_reset(struct sock *sk)
+{
+	struct dst_entry *dst = rcu_dereference_protected(sk->sk_rx_dst, 1);
+	int cpu, i;
+
+	if (dst) {
+		RCU_INIT_POINTER(sk->sk_rx_dst, NULL);
+		dst_release(dst);
+	}
+
+	/* Pairs with the barrier in tcp_v4_flow_lookup() */
+	smp_mb();
+	if (!tcp_sk(sk)->rx_flow_cached)
+		return;
+	tcp_sk(sk)->rx_flow_cached = 0;
+
+	for_each_possible_cpu(cpu) {
+		struct tcp_flow_cache *fc = &per_cpu(tcp_flow_cache, cpu);
+
+		for (i = 0; i < TCP_FLOW_CACHE_SIZE; i++)
+			if (unlikely(fc->sk[i] == sk))
+				cmpxchg(&fc->sk[i], sk, NULL);
+	}
+}
+
 /*
  *	From tcp_input.c
  */
@@ -2604,6 +2778,7 @@ struct proto tcp_prot = {
 	.sendmsg		= tcp_sendmsg,
 	.sendpage		= tcp_sendpage,
 	.backlog_rcv		= tcp_v4_do_rcv,
+	.release_cb		= tcp_release_cb,
 	.hash			= inet_hash,
 	.unhash			= inet_unhash,
 	.get_port		= inet_csk_get_port,
@@ -15,11 +15,15 @@
 #define DEBUG
 
 #include <linux/file.h>
+#include <linux/hash.h>
 #include <linux/inetdevice.h>
 #include <linux/module.h>
 #include <linux/netfilter/x_tables.h>
 #include <linux/netfilter/xt_qtaguid.h>
+#include <linux/rculist.h>
 #include <linux/skbuff.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
 #include <linux/workqueue.h>
 #include <net/addrconf.h>
 #include <net/sock.h>
@@ -135,6 +139,11 @@ static struct proc_dir_entry *iface_stat_fmt_procfile;
  * Notice how sock_tag_list_lock is held sometimes when uid_tag_data_tree_lock
  * is acquired.
  *
+ * The packet path only takes RCU read locks: iface_stat_list, the
+ * per iface tag_stat_hash, sock_tag_hash and tag_counter_set_hash are
+ * RCU protected lists that are modified under the locks above, and
+ * the counters are per cpu. Entries removed from them are kfree_rcu()'d.
+ *
  * Call tree with all lock holders as of 2012-04-27:
  *
  * iface_stat_fmt_proc_read()
@@ -189,15 +198,8 @@ static struct proc_dir_entry *iface_stat_fmt_procfile;
  * qtaguid_mt()
  *   account_for_uid()
  *     if_tag_stat_update()
- *       get_sock_stat()
- *         sock_tag_list_lock
+ *       (only for the first packet of a tag on an iface)
  *       struct iface_stat->tag_stat_list_lock
- *         tag_stat_update()
- *           get_active_counter_set()
- *             tag_counter_set_list_lock
- *         tag_stat_update()
- *           get_active_counter_set()
- *             tag_counter_set_list_lock
  *
  *
  * qtaguid_ctrl_parse()
@@ -226,9 +228,11 @@ static LIST_HEAD(iface_stat_list);
 static DEFINE_SPINLOCK(iface_stat_list_lock);
 
 static struct rb_root sock_tag_tree = RB_ROOT;
+static struct hlist_head sock_tag_hash[1 << SOCK_TAG_HASH_BITS];
 static DEFINE_SPINLOCK(sock_tag_list_lock);
 
 static struct rb_root tag_counter_set_tree = RB_ROOT;
+static struct hlist_head tag_counter_set_hash[1 << TAG_COUNTER_SET_HASH_BITS];
 static DEFINE_SPINLOCK(tag_counter_set_list_lock);
 
 static struct rb_root uid_tag_data_tree = RB_ROOT;
@@ -238,6 +242,28 @@ static struct rb_root proc_qtu_data_tree = RB_ROOT;
 /* No proc_qtu_data_tree_lock; use uid_tag_data_tree_lock */
 
 static struct qtaguid_event_counts qtu_events;
+
+/*
+ * Bumped by each binary stats read. Counter updates are stamped with it so
+ * the next read can skip what did not change, see qtudev_get_stats().
+ */
+static atomic_t qtu_stats_generation = ATOMIC_INIT(1);
+
+/*
+ * Stamp a per cpu counter share after updating it. An update can load the
+ * generation just before a read bumps it and store the stamp after that
+ * read has walked past it, so a read also reports shares stamped with the
+ * generation before the one it was asked for.
+ */
+static inline u32 qtu_stats_stamp(void)
+{
+	return atomic_read(&qtu_stats_generation);
+}
+
+static inline bool qtu_stats_changed(u32 stamp, u32 since)
+{
+	return !since || (s32)(stamp - (since - 1)) >= 0;
+}
 /*----------------------------------------------*/
 static bool can_manipulate_uids(void)
 {
@@ -337,6 +363,35 @@ static void tag_node_tree_insert(struct tag_node *data, struct rb_root *root)
 	rb_insert_color(&data->node, root);
 }
 
+static struct hlist_head *tag_node_hash_bucket(struct hlist_head *table,
+					       unsigned int bits, tag_t tag)
+{
+	return &table[hash_64(tag, bits)];
+}
+
+/* Caller must be in an RCU read side section or hold the writer's lock. */
+static struct tag_node *tag_node_hash_search(struct hlist_head *table,
+					     unsigned int bits, tag_t tag)
+{
+	struct hlist_node *pos;
+	struct tag_node *data;
+
+	hlist_for_each_entry_rcu(data, pos,
+				 tag_node_hash_bucket(table, bits, tag),
+				 hash_node) {
+		if (!tag_compare(tag, data->tag))
+			return data;
+	}
+	return NULL;
+}
+
+static void tag_node_hash_insert(struct tag_node *data,
+				 struct hlist_head *table, unsigned int bits)
+{
+	hlist_add_head_rcu(&data->hash_node,
+			   tag_node_hash_bucket(table, bits, data->tag));
+}
+
 static void tag_stat_tree_insert(struct tag_stat *data, struct rb_root *root)
 {
 	tag_node_tree_insert(&data->tn, root);
@@ -350,6 +405,16 @@ static struct tag_stat *tag_stat_tree_search(struct rb_root *root, tag_t tag)
 	return rb_entry(&node->node, struct tag_stat, tn.node);
 }
 
+static struct tag_stat *tag_stat_hash_search(struct iface_stat *iface_entry,
+					     tag_t tag)
+{
+	struct tag_node *node = tag_node_hash_search(iface_entry->tag_stat_hash,
+						     TAG_STAT_HASH_BITS, tag);
+	if (!node)
+		return NULL;
+	return container_of(node, struct tag_stat, tn);
+}
+
 static void tag_counter_set_tree_insert(struct tag_counter_set *data,
 					struct rb_root *root)
 {
@@ -366,6 +431,16 @@ static struct tag_counter_set *tag_counter_set_tree_search(struct rb_root *root,
 
 }
 
+static struct tag_counter_set *tag_counter_set_hash_search(tag_t tag)
+{
+	struct tag_node *node = tag_node_hash_search(tag_counter_set_hash,
+						     TAG_COUNTER_SET_HASH_BITS,
+						     tag);
+	if (!node)
+		return NULL;
+	return container_of(node, struct tag_counter_set, tn);
+}
+
 static void tag_ref_tree_insert(struct tag_ref *data, struct rb_root *root)
 {
 	tag_node_tree_insert(&data->tn, root);
@@ -419,6 +494,26 @@ static void sock_tag_tree_insert(struct sock_tag *data, struct rb_root *root)
 	rb_insert_color(&data->sock_node, root);
 }
 
+static struct hlist_head *sock_tag_hash_bucket(const struct sock *sk)
+{
+	return &sock_tag_hash[hash_ptr(sk, SOCK_TAG_HASH_BITS)];
+}
+
+/* Caller must hold sock_tag_list_lock */
+static void sock_tag_add(struct sock_tag *st_entry)
+{
+	sock_tag_tree_insert(st_entry, &sock_tag_tree);
+	hlist_add_head_rcu(&st_entry->hash_node,
+			   sock_tag_hash_bucket(st_entry->sk));
+}
+
+/* Caller must hold sock_tag_list_lock */
+static void sock_tag_del(struct sock_tag *st_entry)
+{
+	rb_erase(&st_entry->sock_node, &sock_tag_tree);
+	hlist_del_rcu(&st_entry->hash_node);
+}
+
 static void sock_tag_tree_erase(struct rb_root *st_to_free_tree)
 {
 	struct rb_node *node;
@@ -435,7 +530,7 @@ static void sock_tag_tree_erase(struct rb_root *st_to_free_tree)
 			 get_uid_from_tag(st_entry->tag));
 		rb_erase(&st_entry->sock_node, st_to_free_tree);
 		sockfd_put(st_entry->socket);
-		kfree(st_entry);
+		kfree_rcu(st_entry, rcu);
 	}
 }
 
@@ -756,17 +851,17 @@ static int get_active_counter_set(tag_t tag)
 		 tag, get_uid_from_tag(tag));
 	/* For now we only handle UID tags for active sets */
 	tag = get_utag_from_tag(tag);
-	spin_lock_bh(&tag_counter_set_list_lock);
-	tcs = tag_counter_set_tree_search(&tag_counter_set_tree, tag);
+	rcu_read_lock();
+	tcs = tag_counter_set_hash_search(tag);
 	if (tcs)
-		active_set = tcs->active_set;
-	spin_unlock_bh(&tag_counter_set_list_lock);
+		active_set = ACCESS_ONCE(tcs->active_set);
+	rcu_read_unlock();
 	return active_set;
 }
 
 /*
  * Find the entry for tracking the specified interface.
- * Caller must hold iface_stat_list_lock
+ * Caller must hold iface_stat_list_lock or be in an RCU read side section.
  */
 static struct iface_stat *get_iface_entry(const char *ifname)
 {
@@ -779,7 +874,7 @@ static struct iface_stat *get_iface_entry(const char *ifname)
 	}
 
 	/* Iterate over interfaces */
-	list_for_each_entry(iface_entry, &iface_stat_list, list) {
+	list_for_each_entry_rcu(iface_entry, &iface_stat_list, list) {
 		if (!strcmp(ifname, iface_entry->ifname))
 			goto done;
 	}
@@ -799,6 +894,7 @@ static int iface_stat_fmt_proc_read(char *page, char **num_items_returned,
 	struct iface_stat *iface_entry;
 	struct rtnl_link_stats64 dev_stats, *stats;
 	struct rtnl_link_stats64 no_dev_stats = {0};
+	struct byte_packet_counters totals_via_skb[IFS_MAX_DIRECTIONS];
 
 	if (unlikely(module_passive)) {
 		*eof = 1;
@@ -866,15 +962,16 @@ static int iface_stat_fmt_proc_read(char *page, char **num_items_returned,
 				stats->tx_bytes, stats->tx_packets
 				);
 		} else {
+			iface_stat_sum_skb(iface_entry, totals_via_skb);
 			len = snprintf(
 				outp, char_count,
 				"%s "
 				"%llu %llu %llu %llu\n",
 				iface_entry->ifname,
-				iface_entry->totals_via_skb[IFS_RX].bytes,
-				iface_entry->totals_via_skb[IFS_RX].packets,
-				iface_entry->totals_via_skb[IFS_TX].bytes,
-				iface_entry->totals_via_skb[IFS_TX].packets
+				totals_via_skb[IFS_RX].bytes,
+				totals_via_skb[IFS_RX].packets,
+				totals_via_skb[IFS_TX].bytes,
+				totals_via_skb[IFS_TX].packets
 				);
 		}
 		if (len >= char_count) {
@@ -961,7 +1058,9 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 	struct iface_stat *new_iface;
 	struct iface_stat_work *isw;
 
-	new_iface = kzalloc(sizeof(*new_iface), GFP_ATOMIC);
+	new_iface = kzalloc(sizeof(*new_iface) +
+			    nr_cpu_ids * sizeof(new_iface->totals_via_skb[0]),
+			    GFP_ATOMIC);
 	if (new_iface == NULL) {
 		pr_err("qtaguid: iface_stat: create(%s): "
 		       "iface_stat alloc failed\n", net_dev->name);
@@ -994,7 +1093,7 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 	isw->iface_entry = new_iface;
 	INIT_WORK(&isw->iface_work, iface_create_proc_worker);
 	schedule_work(&isw->iface_work);
-	list_add(&new_iface->list, &iface_stat_list);
+	list_add_rcu(&new_iface->list, &iface_stat_list);
 	return new_iface;
 }
 
@@ -1186,16 +1285,34 @@ static struct sock_tag *get_sock_stat_nl(const struct sock *sk)
 	return sock_tag_tree_search(&sock_tag_tree, sk);
 }
 
-static struct sock_tag *get_sock_stat(const struct sock *sk)
+/*
+ * Lockless lookup of the tag that sk's traffic is billed to.
+ * Returns false if the socket is not tagged.
+ */
+static bool get_sock_tag(const struct sock *sk, tag_t *tag)
 {
 	struct sock_tag *sock_tag_entry;
-	MT_DEBUG("qtaguid: get_sock_stat(sk=%p)\n", sk);
+	struct hlist_node *pos;
+	unsigned int seq;
+	bool found = false;
+
+	MT_DEBUG("qtaguid: get_sock_tag(sk=%p)\n", sk);
 	if (!sk)
-		return NULL;
-	spin_lock_bh(&sock_tag_list_lock);
-	sock_tag_entry = get_sock_stat_nl(sk);
-	spin_unlock_bh(&sock_tag_list_lock);
-	return sock_tag_entry;
+		return false;
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(sock_tag_entry, pos,
+				 sock_tag_hash_bucket(sk), hash_node) {
+		if (sock_tag_entry->sk != sk)
+			continue;
+		do {
+			seq = read_seqcount_begin(&sock_tag_entry->tag_seq);
+			*tag = sock_tag_entry->tag;
+		} while (read_seqcount_retry(&sock_tag_entry->tag_seq, seq));
+		found = true;
+		break;
+	}
+	rcu_read_unlock();
+	return found;
 }
 
 static int ipx_proto(const struct sk_buff *skb,
@@ -1219,10 +1336,18 @@ static int ipx_proto(const struct sk_buff *skb,
 	return tproto;
 }
 
+/*
+ * Bill the packet to this cpu's share of the tag_stat counters.
+ * ip(6)t_do_table() runs with BHs disabled, so we can't move cpus.
+ */
 static void
-data_counters_update(struct data_counters *dc, int set,
+data_counters_update(struct tag_stat *ts, int set,
 		     enum ifs_tx_rx direction, int proto, int bytes)
 {
+	struct data_counters_pcpu *pc = &ts->counters[smp_processor_id()];
+	struct data_counters *dc = &pc->dc;
+
+	u64_stats_update_begin(&pc->syncp);
 	switch (proto) {
 	case IPPROTO_TCP:
 		dc_add_byte_packets(dc, set, direction, IFS_TCP, bytes, 1);
@@ -1236,6 +1361,8 @@ data_counters_update(struct data_counters *dc, int set,
 				    1);
 		break;
 	}
+	pc->generation = qtu_stats_stamp();
+	u64_stats_update_end(&pc->syncp);
 }
 
 /*
@@ -1302,6 +1429,7 @@ static void iface_stat_update_from_skb(const struct sk_buff *skb,
 				       struct xt_action_param *par)
 {
 	struct iface_stat *entry;
+	struct iface_stat_pcpu *pc;
 	const struct net_device *el_dev;
 	enum ifs_tx_rx direction = par->in ? IFS_RX : IFS_TX;
 	int bytes = skb->len;
@@ -1336,21 +1464,25 @@ static void iface_stat_update_from_skb(const struct sk_buff *skb,
 			 par->family, proto);
 	}
 
-	spin_lock_bh(&iface_stat_list_lock);
+	rcu_read_lock();
 	entry = get_iface_entry(el_dev->name);
 	if (entry == NULL) {
 		IF_DEBUG("qtaguid: iface_stat: %s(%s): not tracked\n",
 			 __func__, el_dev->name);
-		spin_unlock_bh(&iface_stat_list_lock);
+		rcu_read_unlock();
 		return;
 	}
 
 	IF_DEBUG("qtaguid: %s(%s): entry=%p\n", __func__,
 		 el_dev->name, entry);
 
-	entry->totals_via_skb[direction].bytes += bytes;
-	entry->totals_via_skb[direction].packets++;
-	spin_unlock_bh(&iface_stat_list_lock);
+	pc = &entry->totals_via_skb[smp_processor_id()];
+	u64_stats_update_begin(&pc->syncp);
+	pc->totals_via_skb[direction].bytes += bytes;
+	pc->totals_via_skb[direction].packets++;
+	pc->generation = qtu_stats_stamp();
+	u64_stats_update_end(&pc->syncp);
+	rcu_read_unlock();
 }
 
 static void tag_stat_update(struct tag_stat *tag_entry,
@@ -1362,32 +1494,37 @@ static void tag_stat_update(struct tag_stat *tag_entry,
 		 "dir=%d proto=%d bytes=%d)\n",
 		 tag_entry->tn.tag, get_uid_from_tag(tag_entry->tn.tag),
 		 active_set, direction, proto, bytes);
-	data_counters_update(&tag_entry->counters, active_set, direction,
-			     proto, bytes);
-	if (tag_entry->parent_counters)
-		data_counters_update(tag_entry->parent_counters, active_set,
+	data_counters_update(tag_entry, active_set, direction, proto, bytes);
+	if (tag_entry->parent)
+		data_counters_update(tag_entry->parent, active_set,
 				     direction, proto, bytes);
 }
 
 /*
  * Create a new entry for tracking the specified {acct_tag,uid_tag} within
- * the interface.
+ * the interface. parent is the {0, uid_tag} entry for acct_tag based tags.
  * iface_entry->tag_stat_list_lock should be held.
  */
 static struct tag_stat *create_if_tag_stat(struct iface_stat *iface_entry,
-					   tag_t tag)
+					   tag_t tag, struct tag_stat *parent)
 {
 	struct tag_stat *new_tag_stat_entry = NULL;
 	IF_DEBUG("qtaguid: iface_stat: %s(): ife=%p tag=0x%llx"
 		 " (uid=%u)\n", __func__,
 		 iface_entry, tag, get_uid_from_tag(tag));
-	new_tag_stat_entry = kzalloc(sizeof(*new_tag_stat_entry), GFP_ATOMIC);
+	new_tag_stat_entry = kzalloc(sizeof(*new_tag_stat_entry) +
+				     nr_cpu_ids *
+				     sizeof(new_tag_stat_entry->counters[0]),
+				     GFP_ATOMIC);
 	if (!new_tag_stat_entry) {
 		pr_err("qtaguid: iface_stat: tag stat alloc failed\n");
 		goto done;
 	}
 	new_tag_stat_entry->tn.tag = tag;
+	new_tag_stat_entry->parent = parent;
 	tag_stat_tree_insert(new_tag_stat_entry, &iface_entry->tag_stat_tree);
+	tag_node_hash_insert(&new_tag_stat_entry->tn,
+			     iface_entry->tag_stat_hash, TAG_STAT_HASH_BITS);
 done:
 	return new_tag_stat_entry;
 }
@@ -1399,20 +1536,18 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 	struct tag_stat *tag_stat_entry;
 	tag_t tag, acct_tag;
 	tag_t uid_tag;
-	struct data_counters *uid_tag_counters;
-	struct sock_tag *sock_tag_entry;
+	struct tag_stat *uid_tag_stat;
 	struct iface_stat *iface_entry;
-	struct tag_stat *new_tag_stat;
 	MT_DEBUG("qtaguid: if_tag_stat_update(ifname=%s "
 		"uid=%u sk=%p dir=%d proto=%d bytes=%d)\n",
 		 ifname, uid, sk, direction, proto, bytes);
 
-
+	rcu_read_lock();
 	iface_entry = get_iface_entry(ifname);
 	if (!iface_entry) {
 		pr_err("qtaguid: iface_stat: stat_update() %s not found\n",
 		       ifname);
-		return;
+		goto unlock;
 	}
 	/* It is ok to process data when an iface_entry is inactive */
 
@@ -1423,9 +1558,7 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 	 * Look for a tagged sock.
 	 * It will have an acct_uid.
 	 */
-	sock_tag_entry = get_sock_stat(sk);
-	if (sock_tag_entry) {
-		tag = sock_tag_entry->tag;
+	if (get_sock_tag(sk, &tag)) {
 		acct_tag = get_atag_from_tag(tag);
 		uid_tag = get_utag_from_tag(tag);
 	} else {
@@ -1436,42 +1569,47 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 	MT_DEBUG("qtaguid: iface_stat: stat_update(): "
 		 " looking for tag=0x%llx (uid=%u) in ife=%p\n",
 		 tag, get_uid_from_tag(tag), iface_entry);
-	/* Loop over tag list under this interface for {acct_tag,uid_tag} */
-	spin_lock_bh(&iface_entry->tag_stat_list_lock);
-
-	tag_stat_entry = tag_stat_tree_search(&iface_entry->tag_stat_tree,
-					      tag);
-	if (tag_stat_entry) {
+	tag_stat_entry = tag_stat_hash_search(iface_entry, tag);
+	if (likely(tag_stat_entry)) {
 		/*
 		 * Updating the {acct_tag, uid_tag} entry handles both stats:
 		 * {0, uid_tag} will also get updated.
 		 */
 		tag_stat_update(tag_stat_entry, direction, proto, bytes);
-		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
-		return;
+		goto unlock;
 	}
 
-	/* Loop over tag list under this interface for {0,uid_tag} */
+	/*
+	 * First packet for this tag on this interface. Look again under the
+	 * lock, another cpu might just have created the entries.
+	 */
+	spin_lock_bh(&iface_entry->tag_stat_list_lock);
 	tag_stat_entry = tag_stat_tree_search(&iface_entry->tag_stat_tree,
-					      uid_tag);
+					      tag);
 	if (!tag_stat_entry) {
-		/* Here: the base uid_tag did not exist */
-		/*
-		 * No parent counters. So
-		 *  - No {0, uid_tag} stats and no {acc_tag, uid_tag} stats.
-		 */
-		new_tag_stat = create_if_tag_stat(iface_entry, uid_tag);
-		uid_tag_counters = &new_tag_stat->counters;
-	} else {
-		uid_tag_counters = &tag_stat_entry->counters;
-	}
-
-	if (acct_tag) {
-		new_tag_stat = create_if_tag_stat(iface_entry, tag);
-		new_tag_stat->parent_counters = uid_tag_counters;
+		/* Loop over tag list under this interface for {0,uid_tag} */
+		uid_tag_stat = tag_stat_tree_search(
+			&iface_entry->tag_stat_tree, uid_tag);
+		if (!uid_tag_stat) {
+			/* Here: the base uid_tag did not exist */
+			/*
+			 * No parent counters. So
+			 *  - No {0, uid_tag} stats and no {acc_tag, uid_tag}
+			 *    stats.
+			 */
+			uid_tag_stat = create_if_tag_stat(iface_entry, uid_tag,
+							  NULL);
+		}
+		tag_stat_entry = uid_tag_stat;
+		if (acct_tag && uid_tag_stat)
+			tag_stat_entry = create_if_tag_stat(iface_entry, tag,
+							    uid_tag_stat);
 	}
-	tag_stat_update(new_tag_stat, direction, proto, bytes);
 	spin_unlock_bh(&iface_entry->tag_stat_list_lock);
+	if (tag_stat_entry)
+		tag_stat_update(tag_stat_entry, direction, proto, bytes);
+unlock:
+	rcu_read_unlock();
 }
 
 static int iface_netdev_event_handler(struct notifier_block *nb,
@@ -2083,7 +2221,7 @@ static int ctrl_cmd_delete(const char *input)
 			 input, st_entry->tag, entry_uid);
 
 		if (!acct_tag || st_entry->tag == tag) {
-			rb_erase(&st_entry->sock_node, &sock_tag_tree);
+			sock_tag_del(st_entry);
 			/* Can't sockfd_put() within spinlock, do it later. */
 			sock_tag_tree_insert(st_entry, &st_to_free_tree);
 			tr_entry = lookup_tag_ref(st_entry->tag, NULL);
@@ -2116,7 +2254,8 @@ static int ctrl_cmd_delete(const char *input)
 			 get_uid_from_tag(tcs_entry->tn.tag),
 			 tcs_entry->active_set);
 		rb_erase(&tcs_entry->tn.node, &tag_counter_set_tree);
-		kfree(tcs_entry);
+		hlist_del_rcu(&tcs_entry->tn.hash_node);
+		kfree_rcu(tcs_entry, tn.rcu);
 	}
 	spin_unlock_bh(&tag_counter_set_list_lock);
 
@@ -2147,7 +2286,8 @@ static int ctrl_cmd_delete(const char *input)
 					 entry_uid);
 				rb_erase(&ts_entry->tn.node,
 					 &iface_entry->tag_stat_tree);
-				kfree(ts_entry);
+				hlist_del_rcu(&ts_entry->tn.hash_node);
+				kfree_rcu(ts_entry, tn.rcu);
 			}
 		}
 		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
@@ -2229,7 +2369,10 @@ static int ctrl_cmd_counter_set(const char *input)
 			goto err;
 		}
 		tcs->tn.tag = tag;
+		tcs->active_set = counter_set;
 		tag_counter_set_tree_insert(tcs, &tag_counter_set_tree);
+		tag_node_hash_insert(&tcs->tn, tag_counter_set_hash,
+				     TAG_COUNTER_SET_HASH_BITS);
 		CT_DEBUG("qtaguid: ctrl_counterset(%s): added tcs tag=0x%llx "
 			 "(uid=%u) set=%d\n",
 			 input, tag, get_uid_from_tag(tag), counter_set);
@@ -2330,7 +2473,9 @@ static int ctrl_cmd_tag(const char *input)
 		BUG_ON(IS_ERR_OR_NULL(prev_tag_ref_entry));
 		BUG_ON(prev_tag_ref_entry->num_sock_tags <= 0);
 		prev_tag_ref_entry->num_sock_tags--;
+		write_seqcount_begin(&sock_tag_entry->tag_seq);
 		sock_tag_entry->tag = full_tag;
+		write_seqcount_end(&sock_tag_entry->tag_seq);
 	} else {
 		CT_DEBUG("qtaguid: ctrl_tag(%s): newtag for sk=%p\n",
 			 input, el_socket->sk);
@@ -2347,6 +2492,7 @@ static int ctrl_cmd_tag(const char *input)
 		sock_tag_entry->sk = el_socket->sk;
 		sock_tag_entry->socket = el_socket;
 		sock_tag_entry->pid = current->tgid;
+		seqcount_init(&sock_tag_entry->tag_seq);
 		sock_tag_entry->tag = combine_atag_with_uid(acct_tag,
 							    uid);
 		spin_lock_bh(&uid_tag_data_tree_lock);
@@ -2369,7 +2515,7 @@ static int ctrl_cmd_tag(const char *input)
 				 &pqd_entry->sock_tag_list);
 		spin_unlock_bh(&uid_tag_data_tree_lock);
 
-		sock_tag_tree_insert(sock_tag_entry, &sock_tag_tree);
+		sock_tag_add(sock_tag_entry);
 		atomic64_inc(&qtu_events.sockets_tagged);
 	}
 	spin_unlock_bh(&sock_tag_list_lock);
@@ -2435,7 +2581,7 @@ static int ctrl_cmd_untag(const char *input)
 	 * The socket already belongs to the current process
 	 * so it can do whatever it wants to it.
 	 */
-	rb_erase(&sock_tag_entry->sock_node, &sock_tag_tree);
+	sock_tag_del(sock_tag_entry);
 
 	tag_ref_entry = lookup_tag_ref(sock_tag_entry->tag, &utd_entry);
 	BUG_ON(!tag_ref_entry);
@@ -2472,7 +2618,7 @@ static int ctrl_cmd_untag(const char *input)
 		 atomic_long_read(&el_socket->file->f_count) - 1);
 	sockfd_put(el_socket);
 
-	kfree(sock_tag_entry);
+	kfree_rcu(sock_tag_entry, rcu);
 	atomic64_inc(&qtu_events.sockets_untagged);
 
 	return 0;
@@ -2559,7 +2705,8 @@ struct proc_print_info {
 static int pp_stats_line(struct proc_print_info *ppi, int cnt_set)
 {
 	int len;
-	struct data_counters *cnts;
+	struct data_counters counters;
+	struct data_counters *cnts = &counters;
 
 	if (!ppi->item_index) {
 		if (ppi->item_index++ < ppi->items_to_skip)
@@ -2589,7 +2736,7 @@ static int pp_stats_line(struct proc_print_info *ppi, int cnt_set)
 		}
 		if (ppi->item_index++ < ppi->items_to_skip)
 			return 0;
-		cnts = &ppi->ts_entry->counters;
+		tag_stat_sum_counters(ppi->ts_entry, cnts);
 		len = snprintf(
 			ppi->outp, ppi->char_count,
 			"%d %s 0x%llx %u %u "
@@ -2836,7 +2983,7 @@ static int qtudev_release(struct inode *inode, struct file *file)
 		tr->num_sock_tags--;
 		free_tag_ref_from_utd_entry(tr, utd_entry);
 
-		rb_erase(&st_entry->sock_node, &sock_tag_tree);
+		sock_tag_del(st_entry);
 		list_del(&st_entry->list);
 		/* Can't sockfd_put() within spinlock, do it later. */
 		sock_tag_tree_insert(st_entry, &st_to_free_tree);
@@ -2867,11 +3014,171 @@ static int qtudev_release(struct inode *inode, struct file *file)
 	return 0;
 }
 
+static bool tag_stat_changed(struct tag_stat *ts, u32 since)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		if (qtu_stats_changed(ACCESS_ONCE(ts->counters[cpu].generation),
+				      since))
+			return true;
+	return false;
+}
+
+static bool iface_stat_changed(struct iface_stat *is, u32 since)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		if (qtu_stats_changed(
+			    ACCESS_ONCE(is->totals_via_skb[cpu].generation),
+			    since))
+			return true;
+	return false;
+}
+
+/*
+ * Collect the records changed since the given generation into recs.
+ * Returns the number of matching records, which can be more than max_recs.
+ */
+static unsigned int qtu_collect_stats(struct xt_qtaguid_stats_rec *recs,
+				      unsigned int max_recs, u32 since)
+{
+	struct iface_stat *iface_entry;
+	struct tag_stat *ts_entry;
+	struct xt_qtaguid_stats_rec *rec;
+	struct data_counters counters;
+	struct rb_node *node;
+	unsigned int total = 0;
+
+	spin_lock_bh(&iface_stat_list_lock);
+	list_for_each_entry(iface_entry, &iface_stat_list, list) {
+		if (iface_stat_changed(iface_entry, since)) {
+			if (total < max_recs) {
+				rec = &recs[total];
+				memset(rec, 0, sizeof(*rec));
+				rec->type = XT_QTAGUID_STATS_IFACE;
+				strlcpy(rec->iface, iface_entry->ifname,
+					sizeof(rec->iface));
+				iface_stat_sum_skb(iface_entry,
+					(struct byte_packet_counters *)
+					rec->counters.iface);
+			}
+			total++;
+		}
+
+		spin_lock_bh(&iface_entry->tag_stat_list_lock);
+		for (node = rb_first(&iface_entry->tag_stat_tree);
+		     node;
+		     node = rb_next(node)) {
+			ts_entry = rb_entry(node, struct tag_stat, tn.node);
+			if (!can_read_other_uid_stats(
+				    get_uid_from_tag(ts_entry->tn.tag)))
+				continue;
+			if (!tag_stat_changed(ts_entry, since))
+				continue;
+			if (total < max_recs) {
+				rec = &recs[total];
+				memset(rec, 0, sizeof(*rec));
+				rec->type = XT_QTAGUID_STATS_TAG;
+				strlcpy(rec->iface, iface_entry->ifname,
+					sizeof(rec->iface));
+				rec->tag = ts_entry->tn.tag;
+				tag_stat_sum_counters(ts_entry, &counters);
+				memcpy(rec->counters.tag, counters.bpc,
+				       sizeof(rec->counters.tag));
+			}
+			total++;
+		}
+		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
+	}
+	spin_unlock_bh(&iface_stat_list_lock);
+	return total;
+}
+
+static int qtudev_get_stats(struct xt_qtaguid_stats_req __user *ureq)
+{
+	struct xt_qtaguid_stats_req req;
+	struct xt_qtaguid_stats_rec *recs = NULL;
+	unsigned int max_recs, total;
+	u32 generation;
+	int res = 0;
+
+	if (copy_from_user(&req, ureq, sizeof(req)))
+		return -EFAULT;
+
+	if (unlikely(module_passive)) {
+		req.count = 0;
+		goto done;
+	}
+
+	/*
+	 * Size the buffer from what there is to report rather than from
+	 * req.count. Records added before the second walk make it fail with
+	 * -ENOSPC like a short buffer would.
+	 */
+	total = qtu_collect_stats(NULL, 0, req.generation);
+	max_recs = min_t(u32, req.count, XT_QTAGUID_STATS_MAX_RECORDS);
+	if (total > max_recs) {
+		req.count = total;
+		res = -ENOSPC;
+		goto done;
+	}
+	max_recs = total;
+	if (max_recs) {
+		recs = vmalloc(max_recs * sizeof(*recs));
+		if (!recs)
+			return -ENOMEM;
+	}
+
+	/*
+	 * Updates racing with the walk get the new generation and are
+	 * reported again next time.
+	 */
+	generation = atomic_inc_return(&qtu_stats_generation);
+	if (unlikely(!generation))
+		generation = atomic_inc_return(&qtu_stats_generation);
+
+	total = qtu_collect_stats(recs, max_recs, req.generation);
+	CT_DEBUG("qtaguid: %s(): since=%u generation=%u records=%u/%u\n",
+		 __func__, req.generation, generation, total, max_recs);
+
+	if (total > max_recs) {
+		req.count = total;
+		res = -ENOSPC;
+	} else if (total && copy_to_user((void __user *)(uintptr_t)req.records,
+					 recs, total * sizeof(*recs))) {
+		res = -EFAULT;
+		goto out;
+	} else {
+		req.count = total;
+		req.generation = generation;
+	}
+done:
+	if (copy_to_user(ureq, &req, sizeof(req)))
+		res = -EFAULT;
+out:
+	vfree(recs);
+	return res;
+}
+
+static long qtudev_ioctl(struct file *file, unsigned int cmd,
+			 unsigned long arg)
+{
+	switch (cmd) {
+	case XT_QTAGUID_IOC_GET_STATS:
+		return qtudev_get_stats((void __user *)arg);
+	default:
+		return -ENOTTY;
+	}
+}
+
 /*------------------------------------------*/
 static const struct file_operations qtudev_fops = {
 	.owner = THIS_MODULE,
 	.open = qtudev_open,
 	.release = qtudev_release,
+	.unlocked_ioctl = qtudev_ioctl,
 };
 
 static struct miscdevice qtu_device = {
@@ -2941,6 +3248,15 @@ static struct xt_match qtaguid_mt_reg __read_mostly = {
 
 static int __init qtaguid_mt_init(void)
 {
+	/* The binary stats export copies these as is */
+	BUILD_BUG_ON(IFS_MAX_COUNTER_SETS != XT_QTAGUID_MAX_COUNTER_SETS);
+	BUILD_BUG_ON(IFS_TX != XT_QTAGUID_TX || IFS_RX != XT_QTAGUID_RX);
+	BUILD_BUG_ON(IFS_TCP != XT_QTAGUID_TCP ||
+		     IFS_UDP != XT_QTAGUID_UDP ||
+		     IFS_PROTO_OTHER != XT_QTAGUID_OTHER);
+	BUILD_BUG_ON(sizeof(struct byte_packet_counters) !=
+		     sizeof(struct xt_qtaguid_bpc));
+
 	if (qtaguid_proc_register(&xt_qtaguid_procdir)
 	    || iface_stat_init(xt_qtaguid_procdir)
 	    || xt_register_match(&qtaguid_mt_reg)
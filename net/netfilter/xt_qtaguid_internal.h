@@ -11,8 +11,15 @@
 #define __XT_QTAGUID_INTERNAL_H__
 
 #include <linux/types.h>
+#include <linux/cache.h>
+#include <linux/cpumask.h>
+#include <linux/list.h>
 #include <linux/rbtree.h>
+#include <linux/rcupdate.h>
+#include <linux/seqlock.h>
 #include <linux/spinlock_types.h>
+#include <linux/string.h>
+#include <linux/u64_stats_sync.h>
 #include <linux/workqueue.h>
 
 /* Iface handling */
@@ -156,6 +163,11 @@ static inline tag_t make_atag_from_value(uint32_t value)
  */
 #define IFS_MAX_COUNTER_SETS 2
 
+/* Buckets for the lockless lookups done per packet */
+#define TAG_STAT_HASH_BITS 6
+#define TAG_COUNTER_SET_HASH_BITS 6
+#define SOCK_TAG_HASH_BITS 8
+
 enum ifs_tx_rx {
 	IFS_TX,
 	IFS_RX,
@@ -179,22 +191,76 @@ struct data_counters {
 	struct byte_packet_counters bpc[IFS_MAX_COUNTER_SETS][IFS_MAX_DIRECTIONS][IFS_MAX_PROTOS];
 };
 
-/* Generic X based nodes used as a base for rb_tree ops */
+/*
+ * One cpu's share of a tag_stat's counters.
+ * Only that cpu writes it, from the packet path with BHs off. The shares
+ * are summed up when the stats are read.
+ */
+struct data_counters_pcpu {
+	struct data_counters dc;
+	struct u64_stats_sync syncp;
+	/* qtu_stats_generation at the last update */
+	u32 generation;
+} ____cacheline_aligned_in_smp;
+
+/*
+ * Generic X based nodes used as a base for rb_tree ops.
+ * The rb_tree is the ordered view used by the control and proc code, the
+ * hash_node is the RCU protected view used by the packet path.
+ */
 struct tag_node {
 	struct rb_node node;
+	struct hlist_node hash_node;
+	struct rcu_head rcu;
 	tag_t tag;
 };
 
 struct tag_stat {
 	struct tag_node tn;
-	struct data_counters counters;
 	/*
 	 * If this tag is acct_tag based, we need to count against the
 	 * matching parent uid_tag.
 	 */
-	struct data_counters *parent_counters;
+	struct tag_stat *parent;
+	/* nr_cpu_ids entries, see tag_stat_sum_counters() */
+	struct data_counters_pcpu counters[0];
 };
 
+static inline void tag_stat_sum_counters(struct tag_stat *ts,
+					 struct data_counters *sum)
+{
+	struct data_counters_pcpu *pc;
+	struct byte_packet_counters *in, *out;
+	unsigned int start;
+	int cpu, i;
+
+	memset(sum, 0, sizeof(*sum));
+	for_each_possible_cpu(cpu) {
+		pc = &ts->counters[cpu];
+		in = &pc->dc.bpc[0][0][0];
+		out = &sum->bpc[0][0][0];
+		for (i = 0; i < sizeof(*sum) / sizeof(*out); i++) {
+			u64 bytes, packets;
+
+			do {
+				start = u64_stats_fetch_begin(&pc->syncp);
+				bytes = in[i].bytes;
+				packets = in[i].packets;
+			} while (u64_stats_fetch_retry(&pc->syncp, start));
+			out[i].bytes += bytes;
+			out[i].packets += packets;
+		}
+	}
+}
+
+/* Per cpu packet totals of an iface_stat, see iface_stat_sum_skb() */
+struct iface_stat_pcpu {
+	struct byte_packet_counters totals_via_skb[IFS_MAX_DIRECTIONS];
+	struct u64_stats_sync syncp;
+	/* qtu_stats_generation at the last update */
+	u32 generation;
+} ____cacheline_aligned_in_smp;
+
 struct iface_stat {
 	struct list_head list;  /* in iface_stat_list */
 	char *ifname;
@@ -203,7 +269,6 @@ struct iface_stat {
 	struct net_device *net_dev;
 
 	struct byte_packet_counters totals_via_dev[IFS_MAX_DIRECTIONS];
-	struct byte_packet_counters totals_via_skb[IFS_MAX_DIRECTIONS];
 	/*
 	 * We keep the last_known, because some devices reset their counters
 	 * just before NETDEV_UP, while some will reset just before
@@ -219,9 +284,38 @@ struct iface_stat {
 	struct proc_dir_entry *proc_ptr;
 
 	struct rb_root tag_stat_tree;
+	/* Same tag_stats as tag_stat_tree, for lockless lookups */
+	struct hlist_head tag_stat_hash[1 << TAG_STAT_HASH_BITS];
 	spinlock_t tag_stat_list_lock;
+
+	/* nr_cpu_ids entries, updated for each skb seen in pre/post routing */
+	struct iface_stat_pcpu totals_via_skb[0];
 };
 
+static inline void iface_stat_sum_skb(struct iface_stat *is,
+				      struct byte_packet_counters *sum)
+{
+	struct iface_stat_pcpu *pc;
+	unsigned int start;
+	int cpu, dir;
+
+	memset(sum, 0, sizeof(*sum) * IFS_MAX_DIRECTIONS);
+	for_each_possible_cpu(cpu) {
+		pc = &is->totals_via_skb[cpu];
+		for (dir = 0; dir < IFS_MAX_DIRECTIONS; dir++) {
+			u64 bytes, packets;
+
+			do {
+				start = u64_stats_fetch_begin(&pc->syncp);
+				bytes = pc->totals_via_skb[dir].bytes;
+				packets = pc->totals_via_skb[dir].packets;
+			} while (u64_stats_fetch_retry(&pc->syncp, start));
+			sum[dir].bytes += bytes;
+			sum[dir].packets += packets;
+		}
+	}
+}
+
 /* This is needed to create proc_dir_entries from atomic context. */
 struct iface_stat_work {
 	struct work_struct iface_work;
@@ -236,6 +330,9 @@ struct iface_stat_work {
  */
 struct sock_tag {
 	struct rb_node sock_node;
+	/* in sock_tag_hash, looked up under RCU by the packet path */
+	struct hlist_node hash_node;
+	struct rcu_head rcu;
 	struct sock *sk;  /* Only used as a number, never dereferenced */
 	/* The socket is needed for sockfd_put() */
 	struct socket *socket;
@@ -243,6 +340,8 @@ struct sock_tag {
 	struct list_head list;   /* in proc_qtu_data.sock_tag_list */
 	pid_t pid;
 
+	/* Retagging rewrites the tag while the packet path may read it */
+	seqcount_t tag_seq;
 	tag_t tag;
 };
 
@@ -0,0 +1,80 @@
+#!/bin/sh
+#
+# Read back through dm-crypt with bios larger than CRYPT_BATCH_SECTORS
+# (64KiB), which kcryptd splits into pieces converted in parallel.
+#
+# The data is written through a single_cpu_crypt mapping, which never
+# splits, and read through mappings that do, with and without
+# inline_reads.  Everything runs on a ramdisk, so reads complete while
+# they are being submitted.  Needs root, brd and dmsetup.
+#
+# usage: split-read.sh [passes]
+#
+
+PASSES=${1:-20}
+SIZE_MB=64
+CIPHER=aes-cbc-essiv:sha256
+KEY=babebabebabebabebabebabebabebabe
+TMP=`mktemp -d` || exit 1
+
+fail ()
+{
+	echo "FAIL: $*"
+	cleanup
+	exit 1
+}
+
+cleanup ()
+{
+	for m in crypt_one crypt_split crypt_inline; do
+		dmsetup remove $m 2>/dev/null
+	done
+	rm -rf $TMP
+}
+
+table ()
+{
+	echo "0 $SECTORS crypt $CIPHER $KEY 0 $RAM 0 $*"
+}
+
+modprobe brd rd_nr=1 rd_size=$((SIZE_MB * 1024)) || fail "no brd"
+RAM=/dev/ram0
+SECTORS=`blockdev --getsz $RAM` || fail "no $RAM"
+
+dmsetup create crypt_one --table "`table 1 single_cpu_crypt`" ||
+	fail "create crypt_one"
+dmsetup create crypt_split --table "`table`" || fail "create crypt_split"
+dmsetup create crypt_inline --table "`table 1 inline_reads`" ||
+	fail "create crypt_inline"
+
+dd if=/dev/urandom of=$TMP/data bs=1M count=$SIZE_MB 2>/dev/null
+dd if=$TMP/data of=/dev/mapper/crypt_one bs=1M oflag=direct 2>/dev/null ||
+	fail "write"
+SUM=`md5sum < $TMP/data`
+
+pass=0
+while [ $pass -lt $PASSES ]; do
+	for m in crypt_split crypt_inline; do
+		# 1MiB, 192KiB (3 pieces) and 68KiB (a 4KiB remainder)
+		for bs in 1M 192K 68K; do
+			s=`dd if=/dev/mapper/$m bs=$bs iflag=direct \
+				2>/dev/null | md5sum`
+			[ "$s" = "$SUM" ] || fail "$m bs=$bs pass $pass"
+		done
+
+		# concurrent readers keep several split bios in flight
+		for i in 1 2 3 4; do
+			dd if=/dev/mapper/$m bs=1M iflag=direct \
+				of=$TMP/read$i 2>/dev/null &
+		done
+		wait
+		for i in 1 2 3 4; do
+			[ "`md5sum < $TMP/read$i`" = "$SUM" ] ||
+				fail "$m concurrent reader $i pass $pass"
+		done
+	done
+	pass=$((pass + 1))
+done
+
+cleanup
+echo "PASS"
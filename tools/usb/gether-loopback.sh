@@ -0,0 +1,86 @@
+#!/bin/sh
+#
+# Throughput and CPU cost of the gadget ethernet link, measured on one
+# machine through dummy_hcd: g_ether is bound to the dummy UDC, and the
+# host side interface it enumerates as is moved into a network namespace
+# so that traffic really goes over the (emulated) USB link.
+#
+# Needs dummy_hcd, g_ether with RNDIS, rndis_host, iproute2 with netns
+# support and iperf.  Run it as root on an otherwise idle machine.
+#
+#	./gether-loopback.sh [seconds] [g_ether options ...]
+#
+# e.g. "./gether-loopback.sh 30 rndis_dl_max_pkt_per_xfer=3"
+#
+# For each direction it prints iperf's bandwidth and the CPU time spent
+# in softirq and system context while the test ran, which is what the
+# rx NAPI/GRO and tx aggregation paths are meant to reduce.
+#
+
+SECS=${1:-20}
+[ $# -gt 0 ] && shift
+
+NS=gether
+GADGET_IP=192.168.250.1
+HOST_IP=192.168.250.2
+
+cleanup() {
+	kill $SERVER 2>/dev/null
+	ip netns del $NS 2>/dev/null
+	rmmod g_ether 2>/dev/null
+	rmmod dummy_hcd 2>/dev/null
+}
+trap cleanup EXIT
+
+modprobe dummy_hcd || exit 1
+modprobe g_ether "$@" || exit 1
+modprobe rndis_host || exit 1
+
+# wait for both ends of the link: usb0 is the gadget, the other the host
+for i in 1 2 3 4 5 6 7 8 9 10; do
+	HOSTIF=$(ls /sys/class/net | grep -v '^usb0$' | while read n; do
+		readlink /sys/class/net/$n/device | grep -q dummy_hcd && echo $n
+	done | head -n 1)
+	[ -n "$HOSTIF" ] && [ -e /sys/class/net/usb0 ] && break
+	sleep 1
+done
+if [ -z "$HOSTIF" ]; then
+	echo "host side interface did not show up"
+	exit 1
+fi
+
+ip netns add $NS
+ip link set $HOSTIF netns $NS
+ip addr add $GADGET_IP/24 dev usb0
+ip link set usb0 up
+ip netns exec $NS ip addr add $HOST_IP/24 dev $HOSTIF
+ip netns exec $NS ip link set $HOSTIF up
+ping -c 3 -w 10 $HOST_IP > /dev/null || { echo "link is not up"; exit 1; }
+
+# softirq and system jiffies from /proc/stat
+cpu_ticks() {
+	awk '/^cpu / { print $4 + $8 }' /proc/stat
+}
+
+run() {
+	local start end
+	start=$(cpu_ticks)
+	"$@" -t $SECS -f m | awk '/Mbits/ { print "  bandwidth:", $(NF-1), $NF }'
+	end=$(cpu_ticks)
+	echo "  sys+softirq ticks: $((end - start)) (USER_HZ $(getconf CLK_TCK))"
+}
+
+iperf -s > /dev/null 2>&1 &
+SERVER=$!
+sleep 1
+
+echo "gadget rx (host -> gadget):"
+run ip netns exec $NS iperf -c $GADGET_IP
+
+kill $SERVER
+ip netns exec $NS iperf -s > /dev/null 2>&1 &
+SERVER=$!
+sleep 1
+
+echo "gadget tx (gadget -> host):"
+run iperf -c $HOST_IP